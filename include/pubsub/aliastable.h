@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Persisted table of metric alias numbers.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <util/stringutil.h>
+
+namespace pub_sub {
+
+/** \brief Keeps the metric alias numbers of a node between restarts.
+ *
+ * The table maps a metric key to an alias number. Node metrics use
+ * '/metric' as key while device metrics use 'device/metric'. A device name
+ * cannot include a '/', so the keys are unique even if the metric names
+ * include '/'. Existing
+ * keys keep their alias while new keys get the next free alias. Aliases
+ * of removed metrics are never reused, so a consumer never resolves an
+ * alias to the wrong metric.
+ *
+ * The table is stored as a text file with one 'alias;key' line per metric.
+ * The file is replaced in one operation when the table is saved.
+ */
+class AliasTable final {
+ public:
+  /** \brief Reads the alias file.
+   *
+   * A missing file is not an error. The table is then empty and is
+   * created by the next Save().
+   * @param filename Full path to the alias file.
+   * @return False if the file exists but cannot be read.
+   */
+  bool Load(const std::string& filename);
+
+  /** \brief Writes the alias file if the table has changed. */
+  bool Save();
+
+  [[nodiscard]] std::string Filename() const;
+  [[nodiscard]] bool IsModified() const;
+  [[nodiscard]] size_t Size() const;
+  [[nodiscard]] uint64_t NextAlias() const;
+
+  /** \brief Returns the alias of a key. A new key gets the next free alias. */
+  uint64_t Alias(const std::string& key);
+
+  /** \brief Stores a fixed alias for a key.
+   *
+   * An alias that is used by another key is rejected.
+   * @return False if the alias is used by another key.
+   */
+  bool Alias(const std::string& key, uint64_t alias);
+
+  /** \brief Returns the alias of a key or 0 if the key doesn't exist. */
+  [[nodiscard]] uint64_t Find(const std::string& key) const;
+
+  /** \brief Creates the key of a node (empty device name) or device metric. */
+  [[nodiscard]] static std::string MakeKey(const std::string& device_name,
+                                           const std::string& metric_name);
+ private:
+  using KeyList = std::map<std::string, uint64_t, util::string::IgnoreCase>;
+
+  mutable std::mutex table_mutex_;
+  std::string filename_;
+  KeyList key_list_;
+  std::unordered_map<uint64_t, std::string> alias_list_; ///< Alias to key lookup.
+  uint64_t next_alias_ = 1;
+  bool modified_ = false;
+};
+
+} // pub_sub
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Asynchronous delivery of metric changes.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pubsub/metric.h"
+
+namespace pub_sub {
+
+/** \brief Metrics that were changed by one inbound message. */
+struct ChangeSet {
+  std::string topic_name; ///< Topic that holds the metrics.
+  uint64_t timestamp = 0; ///< Payload time (ms since 1970).
+  std::vector<std::shared_ptr<Metric>> metric_list; ///< Changed metrics.
+};
+
+/** \brief Defines what happens when the change queue is full. */
+enum class ChangePolicy : int {
+  Block = 0, ///< The receiving thread waits until the queue has space. Only on user threads.
+  Drop,      ///< The new change set is dropped.
+  Conflate   ///< The change set is merged with a queued set of the same topic.
+};
+
+/** \brief Delivers metric change sets on another thread.
+ *
+ * The client collects the metrics that one inbound message changed into a
+ * change set and adds it to a bounded queue. The change sets are delivered
+ * by an internal thread or by a user-supplied executor, so a slow callback
+ * doesn't stall the MQTT I/O.
+ *
+ * The metrics in a change set are the client's own metric objects, so the
+ * callback reads the latest values. If the queue is full, the policy
+ * defines if the receiving thread blocks, the new set is dropped or the
+ * new set is merged with a queued set of the same topic. If a conflated
+ * set doesn't find a queued set of the same topic, the oldest queued set
+ * is dropped. The default policy is Conflate. The Block policy acts as
+ * Conflate on the client's own threads, as the MQTT library's callback
+ * thread, see OutboundQueue::NonBlockingThread().
+ */
+class ChangeNotifier final {
+ public:
+  using OnChange = std::function<void(const ChangeSet& change_set)>;
+  /** \brief Runs a task on a user-selected thread. */
+  using Executor = std::function<void(std::function<void()> task)>;
+
+  ChangeNotifier() = default;
+  ~ChangeNotifier();
+
+  ChangeNotifier(const ChangeNotifier&) = delete;
+  ChangeNotifier& operator=(const ChangeNotifier&) = delete;
+
+  void Policy(ChangePolicy policy) { policy_ = policy; }
+  [[nodiscard]] ChangePolicy Policy() const { return policy_; }
+
+  void MaxQueueSize(size_t max_size) { max_queue_size_ = max_size > 0 ? max_size : 1; }
+  [[nodiscard]] size_t MaxQueueSize() const { return max_queue_size_; }
+
+  /** \brief Sets the executor that delivers the change sets.
+   *
+   * Shall be set before Start(). If no executor is set, an internal thread
+   * delivers the change sets.
+   * @param executor Function that runs a task.
+   */
+  void SetExecutor(Executor executor) { executor_ = std::move(executor); }
+
+  bool Start(OnChange on_change);
+  void Stop();
+  [[nodiscard]] bool IsActive() const { return active_; }
+
+  /** \brief Adds a change set to the queue.
+   *
+   * Called by the client's receiving thread.
+   * @param change_set Change set to deliver.
+   */
+  void Notify(ChangeSet&& change_set);
+
+  [[nodiscard]] size_t QueueDepth() const;
+  [[nodiscard]] uint64_t Delivered() const { return delivered_; }
+  [[nodiscard]] uint64_t Dropped() const { return dropped_; }
+  [[nodiscard]] uint64_t Conflated() const { return conflated_; }
+
+ private:
+  std::atomic<ChangePolicy> policy_ = ChangePolicy::Conflate;
+  std::atomic<size_t> max_queue_size_ = 1'000;
+  Executor executor_;
+  OnChange on_change_;
+
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_event_; ///< A set was added or the notifier stops.
+  std::condition_variable space_event_; ///< A set was removed or delivered.
+  std::deque<ChangeSet> queue_;
+  bool scheduled_ = false; ///< An executor task is pending.
+  bool delivering_ = false;
+
+  std::atomic<bool> active_ = false;
+  std::atomic<uint64_t> delivered_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::atomic<uint64_t> conflated_ = 0;
+  std::thread work_thread_;
+
+  void WorkTask();
+  void DeliverQueue();
+  static void Merge(ChangeSet& dest, ChangeSet& source);
+};
+
+} // pub_sub
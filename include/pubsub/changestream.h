@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Rate limited subscriptions on metric changes.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "pubsub/metric.h"
+
+namespace pub_sub {
+
+/** \brief Selects the metrics of a change stream subscription.
+ *
+ * A metric is selected if its name matches any of the name patterns or if
+ * its alias exists in the alias list. A name pattern may include the '*'
+ * (any characters) and '?' (one character) wildcards.
+ */
+struct MetricSelection {
+  std::vector<std::string> name_list; ///< Names or name patterns.
+  std::vector<uint64_t> alias_list;   ///< Metric aliases.
+};
+
+/** \brief Delivers the latest values of selected metrics at a maximum rate.
+ *
+ * Each subscription keeps a pending set of its selected metrics that have
+ * changed since the last delivery. A metric that changes several times
+ * between two deliveries is only delivered once, with its latest value.
+ * This means that the delivery cost depends on the number of distinct
+ * changed metrics, not on the update rate.
+ *
+ * The updates are delivered by an internal thread. A subscription delivers
+ * at most one update per interval.
+ */
+class ChangeStream final {
+ public:
+  using OnUpdate = std::function<void(const std::vector<std::shared_ptr<Metric>>& metric_list)>;
+
+  ChangeStream() = default;
+  ~ChangeStream();
+
+  ChangeStream(const ChangeStream&) = delete;
+  ChangeStream& operator=(const ChangeStream&) = delete;
+
+  /** \brief Adds a subscription.
+   *
+   * @param selection Selected metric names and aliases.
+   * @param interval_ms Minimum time between two updates (ms).
+   * @param on_update Callback that receives the changed metrics.
+   * @return Subscription identity or 0 if the callback is missing.
+   */
+  uint64_t Subscribe(MetricSelection selection, uint64_t interval_ms, OnUpdate on_update);
+  void Unsubscribe(uint64_t subscription_id);
+
+  [[nodiscard]] bool IsEmpty() const { return subscriptions_ == 0; }
+
+  /** \brief Adds changed metrics to the pending sets of the subscriptions. */
+  void Update(const std::vector<std::shared_ptr<Metric>>& metric_list);
+
+  /** \brief Returns true if a name matches a name pattern. */
+  [[nodiscard]] static bool IsMatch(std::string_view pattern, std::string_view name);
+
+ private:
+  struct Subscription {
+    uint64_t id = 0;
+    std::unordered_set<std::string> name_list; ///< Names without wildcards.
+    std::vector<std::string> pattern_list;     ///< Names with wildcards.
+    std::unordered_set<uint64_t> alias_list;
+    uint64_t interval_ms = 0;
+    OnUpdate on_update;
+
+    /** \brief Selection result per metric name. */
+    std::unordered_map<std::string, bool> selected_list;
+    std::unordered_set<const Metric*> pending_set;
+    std::vector<std::shared_ptr<Metric>> pending_list;
+    std::vector<std::shared_ptr<Metric>> delivery_list; ///< Only used by the worker thread.
+    uint64_t next_delivery = 0; ///< Earliest time of next update (ms since 1970).
+
+    [[nodiscard]] bool IsSelected(const std::shared_ptr<Metric>& metric);
+  };
+  using SubscriptionList = std::map<uint64_t, std::shared_ptr<Subscription>>;
+
+  mutable std::mutex stream_mutex_;
+  SubscriptionList subscription_list_;
+  uint64_t next_id_ = 1;
+  std::atomic<size_t> subscriptions_ = 0;
+
+  std::condition_variable stream_event_;
+  std::atomic<bool> stop_thread_ = true;
+  std::thread work_thread_;
+
+  void WorkTask();
+};
+
+} // pub_sub
@@ -12,10 +12,20 @@
 #include <vector>
 #include <functional>
 #include <set>
+#include <span>
 #include <mutex>
 #include <atomic>
 
 #include "pubsub/itopic.h"
+#include "pubsub/topicindex.h"
+#include "pubsub/topicfilter.h"
+#include "pubsub/topicmatcher.h"
+#include "pubsub/changenotifier.h"
+#include "pubsub/changestream.h"
+#include "pubsub/metricrecorder.h"
+#include "pubsub/messagecapture.h"
+#include "pubsub/statistics.h"
+#include "pubsub/outboundqueue.h"
 
 namespace util::xml {
   class IXmlNode;
@@ -28,6 +38,7 @@ enum class TransportLayer: int {
   MqttWebSocket,
   MqttTcpTls,
   MqttWebSocketTls,
+  InProcess, ///< In-process bus without any broker. Only for clients in the same process.
 };
 
 enum class ProtocolVersion : int {
@@ -36,6 +47,12 @@ enum class ProtocolVersion : int {
   Mqtt5 = 5
 };
 
+/** \brief Address of an MQTT broker. */
+struct BrokerAddress {
+  std::string broker; ///< Host name or IP address.
+  uint16_t port = 1883; ///< Server port.
+};
+
 class SparkplugDevice;
 class SparkplugNode;
 class SparkplugHost;
@@ -93,6 +110,59 @@ class IPubSubClient {
     return port_;
   }
 
+  /** \brief Adds a standby broker.
+   *
+   * The Broker() and Port() defines the primary broker. If the connection
+   * to the active broker is lost or fails, a Sparkplug node steps to the
+   * next broker in the list. After the last standby broker, it steps back
+   * to the primary broker.
+   * @param address Host name or IP address of the standby broker.
+   * @param port Server port of the standby broker.
+   */
+  void AddStandbyBroker(const std::string& address, uint16_t port);
+  void ClearStandbyBrokers() { standby_list_.clear(); }
+  [[nodiscard]] const std::vector<BrokerAddress>& StandbyBrokers() const {
+    return standby_list_;
+  }
+
+  /** \brief Keeps a connected session to the next broker.
+   *
+   * A Sparkplug node with hot standby connects to the next broker while it
+   * is online on the active broker. When the active connection is lost, the
+   * node switches to the standby session and publishes its birth messages
+   * directly, instead of creating a new connection. The standby session
+   * has its own death certificate with the next bdSeq number, so a host
+   * ignores it until the node switches. Requires at least one standby broker.
+   * Note that both sessions use the node name as client ID, so the brokers
+   * shall not share sessions as in a broker cluster.
+   * @param hot_standby True if the node should pre-connect the next broker.
+   */
+  void HotStandby(bool hot_standby) { hot_standby_ = hot_standby; }
+  [[nodiscard]] bool HotStandby() const { return hot_standby_; }
+
+  /** \brief Sets the reconnect delay range (ms).
+   *
+   * The delay after a failed connect starts at the minimum delay and is
+   * doubled for each new failure up to the maximum delay. A random jitter
+   * of up to half the delay is subtracted, so many nodes don't reconnect
+   * at the same time.
+   * @param min_delay Delay after the first failure (ms).
+   * @param max_delay Highest delay (ms).
+   */
+  void ReconnectDelay(uint64_t min_delay, uint64_t max_delay) {
+    reconnect_delay_min_ = min_delay;
+    reconnect_delay_max_ = max_delay;
+  }
+  [[nodiscard]] uint64_t ReconnectDelayMin() const { return reconnect_delay_min_; }
+  [[nodiscard]] uint64_t ReconnectDelayMax() const { return reconnect_delay_max_; }
+
+  /** \brief Requests a switch to the next broker.
+   *
+   * Same as the Sparkplug 'Node Control/Next Server' command. Only used by
+   * the Sparkplug node.
+   */
+  void NextServer() { next_server_ = true; }
+
   void Version(ProtocolVersion version) {
     version_ = version;
   }
@@ -119,6 +189,192 @@ class IPubSubClient {
   void SparkplugVersion(const std::string& version) { sparkplug_version_ = version; }
   [[nodiscard]] const std::string& SparkplugVersion() const { return sparkplug_version_; }
 
+  /** \brief Sets the MQTT 5 shared subscription group name.
+   *
+   * If the share name is set, a Sparkplug host subscribes to the data and
+   * command messages through a '$share/<share name>/' subscription. Several
+   * hosts with the same share name then split the data load while each host
+   * still receives all BIRTH, DEATH and STATE messages. The share name is
+   * only used with MQTT 5. An empty name (default) disables shared subscriptions.
+   * @param share_name Shared subscription group name.
+   */
+  void ShareName(const std::string& share_name) { share_name_ = share_name; }
+  [[nodiscard]] const std::string& ShareName() const { return share_name_; }
+
+  /** \brief Sets the file that persists the metric aliases of a Sparkplug node.
+   *
+   * Without an alias file, the node numbers its metrics at each start.
+   * With an alias file, the existing metrics keep their aliases between
+   * restarts and new metrics get the next free alias, see AliasTable.
+   * @param alias_file Full path to the alias file or empty for no file.
+   */
+  void AliasFile(const std::string& alias_file) { alias_file_ = alias_file; }
+  [[nodiscard]] const std::string& AliasFile() const { return alias_file_; }
+
+  /** \brief Moves the listen trace of messages to a background thread.
+   *
+   * By default, the messages are formatted in the MQTT callback and
+   * publisher threads when the listen window is active. In asynchronous
+   * mode, the raw messages are queued and formatted by a background
+   * thread. Messages are dropped if the queue is full.
+   * @param async_trace True if the message trace should be asynchronous.
+   */
+  void AsyncTrace(bool async_trace) { async_trace_ = async_trace; }
+  [[nodiscard]] bool AsyncTrace() const { return async_trace_; }
+
+  /** \brief Only traces every n-th message per topic (asynchronous trace). */
+  void TraceSampleRate(uint32_t sample_rate) { trace_sample_rate_ = sample_rate; }
+  [[nodiscard]] uint32_t TraceSampleRate() const { return trace_sample_rate_; }
+
+  /** \brief Returns number of messages that the trace dropped. */
+  [[nodiscard]] virtual uint64_t DroppedTraces() const;
+
+  /** \brief Returns the runtime statistics of the client.
+   *
+   * The statistics include message and byte counters, publish failures
+   * and histograms of the parse and encode times. Each topic
+   * also holds its own statistics.
+   * @return Reference to the statistics.
+   */
+  [[nodiscard]] ClientStatistics& Statistics() { return statistics_; }
+  [[nodiscard]] const ClientStatistics& Statistics() const { return statistics_; }
+
+  /** \brief Returns number of messages waiting to be delivered to the broker. */
+  [[nodiscard]] virtual size_t QueueDepth() const;
+
+  /** \brief Returns an estimate of the memory (bytes) that the topics use. */
+  [[nodiscard]] size_t MemoryUsage() const;
+
+  /** \brief Publish the statistics as 'Node Control/Stats' metrics.
+   *
+   * Only used by the Sparkplug node. The statistics metrics are defined in
+   * the NBIRTH message and periodically published in an NDATA message.
+   * @param publish True if the statistics should be published.
+   */
+  void PublishStatistics(bool publish) { publish_statistics_ = publish; }
+  [[nodiscard]] bool PublishStatistics() const { return publish_statistics_; }
+
+  /** \brief Enables the end-to-end latency probe (Sparkplug).
+   *
+   * A Sparkplug node adds a 'Node Control/Latency Probe' metric to its
+   * NBIRTH and NDATA messages. The metric value is the time (ns since 1970)
+   * when the message was encoded. The node publishes the probe every second.
+   *
+   * A Sparkplug host with the probe enabled measures the time until the
+   * message arrived and until the message was parsed. The result is stored in
+   * the remote node statistics, see GetRemoteNode(). Note that the node and
+   * host clocks need to be synchronized, typically the same computer.
+   * @param probe True if the latency probe is enabled.
+   */
+  void LatencyProbe(bool probe) { latency_probe_ = probe; }
+  [[nodiscard]] bool LatencyProbe() const { return latency_probe_; }
+
+  /** \brief Sets a local endpoint (Unix domain socket) for co-located consumers.
+   *
+   * A Sparkplug node with a local endpoint sends all its published messages
+   * to local consumers as well, see LocalSubscriber. The consumers receive
+   * the encoded buffers without going through the broker. An empty
+   * endpoint (default) disables the local fan-out.
+   * @param endpoint Socket file path.
+   */
+  void LocalEndpoint(const std::string& endpoint) { local_endpoint_ = endpoint; }
+  [[nodiscard]] const std::string& LocalEndpoint() const { return local_endpoint_; }
+
+  /** \brief Returns a remote node that a Sparkplug host or node tracks.
+   *
+   * @param group_id Group name.
+   * @param node_id Node name.
+   * @return Pointer to the remote node or nullptr if not found.
+   */
+  [[nodiscard]] virtual const IPubSubClient* GetRemoteNode(const std::string& group_id,
+                                                           const std::string& node_id) const;
+
+  /** \brief Returns the inbound topic filter.
+   *
+   * The filter is used by the Sparkplug host and node to narrow the
+   * subscriptions and to drop unwanted messages before they are parsed.
+   * @return Reference to the topic filter.
+   */
+  [[nodiscard]] TopicFilter& Filter() { return filter_; }
+  [[nodiscard]] const TopicFilter& Filter() const { return filter_; }
+
+  /** \brief Returns the wildcard message handlers.
+   *
+   * A plain MQTT client dispatches an inbound message to the handlers with
+   * a matching topic filter. Such messages are not stored in a topic. Note
+   * that the filter also needs a broker subscription, see AddSubscription().
+   * @return Reference to the topic matcher.
+   */
+  [[nodiscard]] TopicMatcher& Matcher() { return matcher_; }
+  [[nodiscard]] const TopicMatcher& Matcher() const { return matcher_; }
+
+  /** \brief Returns the asynchronous metric change notifier.
+   *
+   * When the notifier is started, the metrics that an inbound message
+   * changes are delivered as one change set on another thread. The
+   * metric OnMessage callbacks are still called synchronously.
+   * @return Reference to the change notifier.
+   */
+  [[nodiscard]] ChangeNotifier& Changes() { return change_notifier_; }
+  [[nodiscard]] const ChangeNotifier& Changes() const { return change_notifier_; }
+
+  /** \brief Returns the outbound queue of published messages.
+   *
+   * The queue limits the number of messages that are in flight in the MQTT
+   * library and the number of bytes that are queued. The publish policy of
+   * each topic defines what happens when the queue is full. BIRTH and
+   * DEATH messages are never dropped. The queue size should be
+   * configured before the client is started.
+   * @return Reference to the outbound queue.
+   */
+  [[nodiscard]] OutboundQueue& Outbound() { return outbound_; }
+  [[nodiscard]] const OutboundQueue& Outbound() const { return outbound_; }
+
+  /** \brief Subscribes on the latest values of some metrics.
+   *
+   * The callback receives the selected metrics that inbound messages have
+   * changed, at most once per interval. Intermediate values are skipped.
+   * The callback is called by an internal thread.
+   * @param selection Metric names, name patterns and aliases.
+   * @param interval_ms Minimum time between two updates (ms).
+   * @param on_update Callback that receives the changed metrics.
+   * @return Subscription identity or 0 on failure.
+   */
+  uint64_t SubscribeMetrics(MetricSelection selection, uint64_t interval_ms,
+                            ChangeStream::OnUpdate on_update);
+  void UnsubscribeMetrics(uint64_t subscription_id);
+
+  /** \brief Returns the time-series recorder.
+   *
+   * When the recorder is started, all metric values that inbound messages
+   * change are appended to segment files. It is typically used by a
+   * Sparkplug host to record all values from the edge nodes.
+   * @return Reference to the recorder.
+   */
+  [[nodiscard]] MetricRecorder& Recorder() { return recorder_; }
+  [[nodiscard]] const MetricRecorder& Recorder() const { return recorder_; }
+
+  /** \brief Returns the raw message capture.
+   *
+   * When the capture is started, all inbound messages are written to a
+   * capture file. The file can be replayed by the MessageReplay class.
+   * @return Reference to the message capture.
+   */
+  [[nodiscard]] MessageCapture& Capture() { return capture_; }
+  [[nodiscard]] const MessageCapture& Capture() const { return capture_; }
+
+  /** \brief Handles a message as if it was received from the broker.
+   *
+   * Used to replay captured messages. The message is handled in the
+   * calling thread.
+   * @param topic_name Topic name.
+   * @param payload Pointer to the payload bytes.
+   * @param payload_size Number of payload bytes.
+   * @param retained True if it's a retained message.
+   */
+  virtual void InjectMessage(const std::string& topic_name, const void* payload,
+                             size_t payload_size, bool retained);
+
   void WaitOnHostOnline(bool wait) { wait_on_host_online_ = wait;}
   [[nodiscard]] bool WaitOnHostOnline() const { return wait_on_host_online_; }
 
@@ -129,6 +385,17 @@ class IPubSubClient {
   virtual bool IsOffline() const = 0;
 
   virtual ITopic* AddMetric(const std::shared_ptr<Metric>& value) = 0;
+
+  /** \brief Declares many metrics in one call.
+   *
+   * A Sparkplug node or device creates the metrics in its birth payload in
+   * one pass and assigns the aliases directly, see Payload::CreateMetrics().
+   * Other clients add the metrics one by one.
+   * @param descriptor_list Metric definitions.
+   * @return Metrics in descriptor order.
+   */
+  virtual std::vector<std::shared_ptr<Metric>> AddMetrics(
+      std::span<const MetricDescriptor> descriptor_list);
   virtual ITopic* CreateTopic() = 0;
 
   ITopic* GetTopic(const std::string& topic_name);
@@ -164,6 +431,29 @@ class IPubSubClient {
 
   [[nodiscard]] bool IsConnectionLost() const {return connection_lost_; }
 
+  /** \brief Returns the Topic Alias Maximum that the broker accepts.
+   *
+   * The value is received in the MQTT 5 CONNACK message. Zero means that
+   * topic aliases shall not be used. The value is reset at each connect.
+   * @return Highest topic alias number the broker accepts.
+   */
+  [[nodiscard]] uint16_t TopicAliasMaximum() const { return topic_alias_max_; }
+
+  /** \brief Returns a unique number for the current broker session.
+   *
+   * Topic aliases are only valid within one network connection. The
+   * session number is stepped on each connect, so a topic can detect that
+   * its alias is stale and needs to be registered again.
+   * @return Topic alias session number.
+   */
+  [[nodiscard]] uint64_t TopicAliasSession() const { return topic_alias_session_; }
+
+  /** \brief Reserves the next free topic alias.
+   *
+   * @return Topic alias or 0 if all aliases are in use.
+   */
+  [[nodiscard]] uint16_t NextTopicAlias();
+
   void ConfigFile(const std::string& config_file) { config_file_ = config_file; };
   [[nodiscard]] const std::string& ConfigFile() const { return config_file_; }
 
@@ -176,6 +466,10 @@ class IPubSubClient {
   TransportLayer transport_ = TransportLayer::MqttTcp; ///< Defines the underlying transport protocol and encryption.
   std::string broker_ = "127.0.0.1"; ///< Address to the MQTT server (broker).
   uint16_t port_ = 1883; ///< The MQTT broker server port.
+  std::vector<BrokerAddress> standby_list_; ///< Standby brokers
+  bool hot_standby_ = false; ///< Pre-connect the next broker (Sparkplug node)
+  uint64_t reconnect_delay_min_ = 100; ///< First reconnect delay (ms)
+  uint64_t reconnect_delay_max_ = 10'000; ///< Highest reconnect delay (ms)
 
 
 
@@ -205,9 +499,25 @@ class IPubSubClient {
    * It is also use to trigger a NDEATH command if a host is going OFFLINE.
    */
   bool wait_on_host_online_ = false;
+  std::string share_name_; ///< Shared subscription group name (MQTT 5).
+  std::string alias_file_; ///< Persisted metric aliases (Sparkplug node).
+  TopicFilter filter_; ///< Inbound topic filter.
+  TopicMatcher matcher_; ///< Wildcard message handlers.
+  ChangeNotifier change_notifier_; ///< Asynchronous metric change sets.
+  OutboundQueue outbound_; ///< Bounded queue of published messages.
+  ChangeStream change_stream_; ///< Rate limited metric subscriptions.
+  MetricRecorder recorder_; ///< Time-series recorder of inbound values.
+  MessageCapture capture_; ///< Raw capture of inbound messages.
+  bool async_trace_ = false; ///< Format the listen trace in a background thread.
+  uint32_t trace_sample_rate_ = 1; ///< Trace every n-th message per topic.
+  ClientStatistics statistics_; ///< Runtime statistics
+  bool publish_statistics_ = false; ///< Publish statistics as NDATA metrics
+  bool latency_probe_ = false; ///< End-to-end latency probe
+  std::string local_endpoint_; ///< Local fan-out endpoint (Sparkplug node)
 
   mutable std::recursive_mutex topic_mutex_; ///< Thread protection of the topic list
   TopicList topic_list_; ///< List of topics.
+  TopicIndex topic_index_ = {topic_list_, topic_mutex_}; ///< Topic lookup by name and message type
   std::list<std::string> subscription_list_;
 
   std::string config_file_; ///< Full path to an XML configuration file
@@ -226,8 +536,14 @@ class IPubSubClient {
   bool disable_default_trust_store_ = false;
 
   void ResetConnectionLost() { connection_lost_ = false; }
+  void ResetTopicAliases(uint16_t alias_maximum);
   void SetConnectionLost() { connection_lost_ = true; }
   void AddSubscriptionFront(std::string topic_name);
+  ITopic* AddTopic(std::unique_ptr<ITopic> topic); ///< Adds and indexes a topic.
+  void ClearTopics();
+  void NotifyChanges(ITopic& topic); ///< Sends the metrics that the last parse updated.
+  void NotifyChanges(ITopic& topic, const std::vector<std::shared_ptr<Metric>>& metric_list);
+  [[nodiscard]] bool HasChangeListeners() const;
 
   void WriteGeneralXml(util::xml::IXmlNode& node) const;
   void ReadGeneralXml(const util::xml::IXmlNode& node);
@@ -245,6 +561,9 @@ private:
    */
   std::atomic<bool> connection_lost_ = false;
 
+  std::atomic<uint16_t> topic_alias_max_ = 0; ///< Broker Topic Alias Maximum (MQTT 5).
+  std::atomic<uint16_t> last_topic_alias_ = 0; ///< Last assigned topic alias.
+  std::atomic<uint64_t> topic_alias_session_ = 0; ///< Stepped on each connect.
 
 
 
@@ -10,11 +10,17 @@
 #include <cstdint>
 #include <mutex>
 #include <memory>
+#include <atomic>
 #include "pubsub/payload.h"
 #include "pubsub/metric.h"
+#include "pubsub/statistics.h"
+#include "pubsub/outboundqueue.h"
 
 namespace pub_sub {
 
+class IPubSubClient;
+class TopicIndex;
+
 enum class QualityOfService : int {
   Qos0 = 0, ///< Fire and forget. The message may not be delivered.
   Qos1 = 1, ///< At least once. The message will be delivered.
@@ -43,9 +49,7 @@ class ITopic {
     return group_id_;
   }
 
-  void MessageType(const std::string& message_type) {
-    message_type_ = message_type;
-  }
+  void MessageType(const std::string& message_type);
   [[nodiscard]] const std::string& MessageType() const {
     return message_type_;
   }
@@ -94,13 +98,75 @@ class ITopic {
     return retained_;
   }
 
+  /** \brief Sets what happens with a message when the client's outbound queue is full. */
+  void Policy(PublishPolicy policy) {
+    policy_ = policy;
+  }
+  [[nodiscard]] PublishPolicy Policy() const {
+    return policy_;
+  }
+
+  /** \brief Returns true if a message holds the full state of the topic.
+   *
+   * Only such messages may replace a queued message of the topic. A topic
+   * that only reports the changed values shall return false, so its
+   * messages are never conflated.
+   */
+  [[nodiscard]] virtual bool IsConflatable() const {
+    return true;
+  }
+
   [[nodiscard]] bool IsUpdated() const;
   void ResetUpdated() const;
 
+  [[nodiscard]] bool IsText() const {
+    return content_type_.empty() || content_type_.find("text") != std::string::npos;
+  }
+
+  [[nodiscard]] bool IsJson() const {
+    return content_type_.find("json") != std::string::npos;
+  }
+
+  [[nodiscard]] bool IsProtobuf() const {
+    return content_type_.find("protobuf") != std::string::npos;
+  }
+
   [[nodiscard]] Payload& GetPayload() { return payload_; }
   [[nodiscard]] const Payload& GetPayload() const { return payload_; }
 
-  virtual void DoPublish() = 0;
+  void DoPublish() {
+    DoPublish({});
+  }
+
+  /** \brief Publishes the topic and completes the delivery promise.
+   *
+   * The promise shall always be completed, as not delivered if the topic
+   * didn't send any message.
+   * @param delivery Promise of a PublishAsync() call or null.
+   */
+  virtual void DoPublish(std::shared_ptr<DeliveryPromise> delivery) = 0;
+
+  /** \brief Publishes the topic and returns a handle to its delivery.
+   *
+   * The handle completes when the MQTT library reports that the message
+   * was sent (QoS 0) or acknowledged by the broker (QoS 1/2). The result
+   * includes the time from the send until the acknowledge. If the topic
+   * didn't send any message, the handle completes as not delivered.
+   * @return Completion handle of the publish.
+   */
+  DeliveryFuture PublishAsync();
+
+  /** \brief Hands over an encoded message to the MQTT library.
+   *
+   * Called directly by the topic or by the client's outbound queue. A
+   * message that is accepted shall be completed in the outbound queue with
+   * its token, when the message is sent or failed. The topic may patch the
+   * body in place, as the Sparkplug sequence number.
+   * @param body Encoded message.
+   * @param token Set to the token of the MQTT library.
+   * @return True if the message was accepted.
+   */
+  virtual bool SendBody(std::vector<uint8_t>& body, int& token);
 
   [[nodiscard]] bool IsWildcard() const;
 
@@ -109,21 +175,38 @@ class ITopic {
 
   void SetAllMetricsInvalid();
 
- protected:
-  mutable std::recursive_mutex topic_mutex_;
+  [[nodiscard]] TopicStatistics& Statistics() { return statistics_; }
+  [[nodiscard]] const TopicStatistics& Statistics() const { return statistics_; }
 
-  [[nodiscard]] bool IsText() const {
-    return content_type_.empty() || content_type_.find("text") != std::string::npos;
-  }
+  /** \brief Returns an estimate of the memory (bytes) that the topic uses. */
+  [[nodiscard]] size_t MemoryUsage() const;
 
-  [[nodiscard]] bool IsJson() const {
-    return content_type_.find("json") != std::string::npos;
-  }
+ protected:
+  mutable std::recursive_mutex topic_mutex_;
 
-  [[nodiscard]] bool IsProtobuf() const {
-    return content_type_.find("protobuf") != std::string::npos;
-  }
+  /** \brief Returns the MQTT 5 topic alias to use in the next publish.
+   *
+   * A new alias is reserved from the client if the topic has no alias in
+   * the current broker session. The topic name must be sent together with
+   * the alias until the alias is confirmed, after that an empty topic
+   * name is sent. Aliases are only used for QoS 0 messages as
+   * retransmitted messages cannot use an alias from an older session.
+   * @param client Client that owns the broker session.
+   * @param send_name Set to true if the topic name needs to be sent.
+   * @return Topic alias or 0 if no alias shall be used.
+   */
+  uint16_t GetTopicAlias(IPubSubClient& client, bool& send_name);
+
+  /** \brief Confirms the alias when a message has been delivered.
+   *
+   * Called from the send success callback. The alias is only known by the
+   * broker if a message with both the topic name and the alias was
+   * delivered. A message that failed keeps the name in the next publish.
+   */
+  void ConfirmTopicAlias();
  private:
+  friend class TopicIndex;
+
   std::string content_type_;    ///< MIME type of data (MQTT 5)
 
   mutable std::string topic_;   ///< MQTT topic name. If empty '<namespace>/<group_id>/<message_type>/<node_id>/<device_id>'
@@ -134,10 +217,20 @@ class ITopic {
   std::string device_id_;
 
   Payload payload_; ///< MQTT topic data.
+  TopicStatistics statistics_; ///< Message counters and process time
 
   bool publish_ = false;
   QualityOfService qos_ = QualityOfService::Qos0;
   bool retained_ = false;
+  PublishPolicy policy_ = PublishPolicy::DropOldest;
+
+  std::atomic<uint16_t> topic_alias_ = 0; ///< MQTT 5 topic alias. 0 = No alias.
+  std::atomic<uint64_t> topic_alias_session_ = 0; ///< Broker session the alias belongs to.
+  std::atomic<bool> topic_alias_sent_ = false; ///< True if the broker knows the alias.
+  std::atomic<bool> topic_alias_pending_ = false; ///< True if the name and alias are in flight.
+
+  TopicIndex* index_ = nullptr; ///< Owner's topic index. Updated on rename.
+  uint64_t index_order_ = 0; ///< Order in the owner's topic list.
 
   void AssignLevelName(size_t level, const std::string& name);
 };
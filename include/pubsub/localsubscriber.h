@@ -0,0 +1,56 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pub_sub {
+
+/** \brief Receives the messages that a local Sparkplug node publishes.
+ *
+ * A Sparkplug node with a local endpoint, see IPubSubClient::LocalEndpoint(),
+ * sends all its published messages to local consumers over a Unix domain
+ * socket. The subscriber connects to the endpoint and calls the callback
+ * for each message. The message body is the encoded (protobuf) payload,
+ * the same bytes that are sent to the broker.
+ *
+ * The BIRTH messages are received directly after the connect. Note that
+ * the callback is called by an internal thread.
+ */
+class LocalSubscriber {
+ public:
+  using OnMessage = std::function<void(const std::string& topic_name,
+                                       const std::vector<uint8_t>& body)>;
+  LocalSubscriber() = default;
+  ~LocalSubscriber();
+
+  LocalSubscriber(const LocalSubscriber&) = delete;
+  LocalSubscriber& operator=(const LocalSubscriber&) = delete;
+
+  bool Connect(const std::string& endpoint, OnMessage on_message);
+  void Disconnect();
+  [[nodiscard]] bool IsConnected() const { return socket_ >= 0 && !closed_; }
+
+  [[nodiscard]] uint64_t Messages() const { return messages_; }
+
+ private:
+  std::atomic<int> socket_ = -1;
+  std::atomic<bool> closed_ = false; ///< Closed by the node.
+  OnMessage on_message_;
+  std::atomic<uint64_t> messages_ = 0;
+
+  std::atomic<bool> stop_thread_ = true;
+  std::thread work_thread_;
+
+  void WorkTask();
+};
+
+} // pub_sub
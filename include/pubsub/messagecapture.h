@@ -0,0 +1,164 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Capture of raw inbound messages and timed replay of captures.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace pub_sub {
+
+class IPubSubClient;
+
+/** \brief Captured message. The views point into the capture file. */
+struct CapturedMessage {
+  uint64_t arrival_time = 0; ///< Arrival time (ns since 1970).
+  bool retained = false;
+  std::string_view topic_name;
+  std::span<const uint8_t> payload;
+};
+
+/** \brief Writes the raw inbound messages of a client to a capture file.
+ *
+ * The receiving thread copies the arrival time, topic name and payload
+ * bytes into a fixed-size ring buffer. A background thread appends the
+ * ring buffer content to the capture file. If the ring buffer is full,
+ * the message is dropped and the dropped counter is stepped.
+ *
+ * The file starts with a short header followed by one record per message.
+ * Each record holds the arrival time, the retained flag, the topic name
+ * and the payload bytes. The file is read by the MessageReplay class.
+ */
+class MessageCapture final {
+ public:
+  MessageCapture() = default;
+  ~MessageCapture();
+
+  MessageCapture(const MessageCapture&) = delete;
+  MessageCapture& operator=(const MessageCapture&) = delete;
+
+  /** \brief Size (bytes) of the ring buffer. Shall be set before Start(). */
+  void RingSize(size_t ring_size) { ring_size_ = ring_size; }
+  [[nodiscard]] size_t RingSize() const { return ring_size_; }
+
+  /** \brief Creates the capture file and starts the writer thread.
+   *
+   * @param filename Full path to the capture file. Any existing file is replaced.
+   * @return True if the file was created.
+   */
+  bool Start(const std::string& filename);
+  /** \brief Writes all captured messages and closes the file. */
+  void Stop();
+  [[nodiscard]] bool IsActive() const { return active_; }
+  [[nodiscard]] const std::string& Filename() const { return filename_; }
+
+  /** \brief Adds a message to the ring buffer.
+   *
+   * Called by the client's receiving thread.
+   * @param topic_name Topic name.
+   * @param payload Pointer to the payload bytes.
+   * @param payload_size Number of payload bytes.
+   * @param retained True if it's a retained message.
+   */
+  void Capture(std::string_view topic_name, const void* payload, size_t payload_size,
+               bool retained);
+
+  [[nodiscard]] uint64_t Captured() const { return captured_; }
+  [[nodiscard]] uint64_t Dropped() const { return dropped_; }
+
+ private:
+  std::string filename_;
+  size_t ring_size_ = 4'000'000;
+  std::ofstream file_;
+
+  std::mutex ring_mutex_;
+  std::condition_variable ring_event_;
+  std::vector<uint8_t> ring_;
+  size_t read_pos_ = 0;  ///< Total number of bytes read from the ring.
+  size_t write_pos_ = 0; ///< Total number of bytes written to the ring.
+
+  std::atomic<bool> active_ = false;
+  std::atomic<uint64_t> captured_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::thread work_thread_;
+
+  void WorkTask();
+  void WriteRing(const void* data, size_t size); ///< Ring mutex shall be locked.
+  void SaveRing(); ///< Appends the ring buffer content to the file.
+};
+
+/** \brief Replays a capture file.
+ *
+ * The capture file is memory-mapped and the messages are fed to a
+ * callback, into a client's inbound message path or onto the in-process
+ * bus. The speed defines how the original arrival times are followed.
+ * Speed 1.0 replays in original time, 2.0 twice as fast and 0 (or less)
+ * as fast as possible. The replay runs in the calling thread.
+ */
+class MessageReplay final {
+ public:
+  using OnMessage = std::function<void(const CapturedMessage& message)>;
+
+  MessageReplay();
+  ~MessageReplay();
+
+  MessageReplay(const MessageReplay&) = delete;
+  MessageReplay& operator=(const MessageReplay&) = delete;
+
+  /** \brief Opens and indexes a capture file. */
+  bool Open(const std::string& filename);
+  void Close();
+  [[nodiscard]] bool IsOpen() const;
+
+  void Speed(double speed) { speed_ = speed; }
+  [[nodiscard]] double Speed() const { return speed_; }
+
+  /** \brief Number of messages in the capture file. */
+  [[nodiscard]] size_t NofMessages() const { return message_list_.size(); }
+  [[nodiscard]] const std::vector<CapturedMessage>& Messages() const { return message_list_; }
+
+  /** \brief Replays all messages to a callback.
+   *
+   * @param on_message Callback that receives the messages.
+   * @return Number of replayed messages.
+   */
+  size_t Replay(const OnMessage& on_message);
+
+  /** \brief Replays all messages into a client's inbound message path.
+   *
+   * The client handles the messages as if they were received from the
+   * broker, see IPubSubClient::InjectMessage().
+   * @param client Receiving client.
+   * @return Number of replayed messages.
+   */
+  size_t Replay(IPubSubClient& client);
+
+  /** \brief Publishes all messages onto the in-process bus. */
+  size_t ReplayToBus();
+
+  /** \brief Stops an ongoing replay. May be called from another thread. */
+  void Abort() { abort_ = true; }
+
+ private:
+  struct Mapping;
+  std::unique_ptr<Mapping> mapping_;
+  std::vector<CapturedMessage> message_list_;
+  double speed_ = 1.0;
+  std::atomic<bool> abort_ = false;
+};
+
+} // pub_sub
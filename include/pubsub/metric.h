@@ -14,7 +14,9 @@
 
 #include "pubsub/metrictype.h"
 #include "pubsub/metricproperty.h"
+#include "pubsub/propertyset.h"
 #include "pubsub/metricmetadata.h"
+#include "pubsub/smallstring.h"
 
 namespace pub_sub {
 
@@ -27,6 +29,11 @@ namespace pub_sub {
  *
  * Note that in the basic MQTT protocol, no properties exist but in SparkPlug B properties are optional.
  * This interface have interfaces to the most common properties as unit and description.
+ *
+ * A host may mirror millions of metrics, so the metric is kept small. The
+ * flags are packed into one byte, the name and value are stored inline if
+ * they are short and the metrics share a pool of locks. Rarely used data
+ * as metadata, callbacks and changeable properties are allocated on first use.
  */
  class Metric;
 
@@ -36,15 +43,20 @@ class Metric {
   friend class MqttClient;
 
  public:
-  Metric() = default;
+  Metric();
   explicit Metric(std::string name);
   explicit Metric(const std::string_view& name);
+  ~Metric();
+
+  Metric(const Metric&) = delete;
+  Metric& operator=(const Metric&) = delete;
 
   void Name(std::string name);
   [[nodiscard]] std::string Name() const;
 
   void Alias(uint64_t alias) {
     alias_ = alias;
+    ++definition_version_;
   }
   [[nodiscard]] uint64_t Alias() const {
     return alias_;
@@ -62,7 +74,8 @@ class Metric {
   [[nodiscard]] std::string Unit() const;
 
   void Type(MetricType type) {
-    datatype_ = static_cast<uint32_t >(type);
+    datatype_ = static_cast<uint8_t>(type);
+    ++definition_version_;
   }
 
   [[nodiscard]] MetricType Type() const {
@@ -70,52 +83,96 @@ class Metric {
   }
 
   void IsHistorical(bool historical_value) {
-    is_historical_ = historical_value;
+    SetFlag(kHistorical, historical_value);
   }
   [[nodiscard]] bool IsHistorical() const {
-    return is_historical_;
+    return GetFlag(kHistorical);
   }
 
   void IsTransient(bool transient_value) {
-    is_transient_ = transient_value;
+    SetFlag(kTransient, transient_value);
   }
   [[nodiscard]] bool IsTransient() const {
-    return is_transient_;
+    return GetFlag(kTransient);
   }
 
   void IsNull(bool null_value) {
-    is_null_ = null_value;
+    SetFlag(kNull, null_value);
   }
   [[nodiscard]] bool IsNull() const {
-    return is_null_;
+    return GetFlag(kNull);
   }
 
   void IsValid(bool valid) const {
-    valid_ = valid;
+    SetFlag(kValid, valid);
   }
   [[nodiscard]] bool IsValid() const {
-    return valid_;
+    return GetFlag(kValid);
   }
 
   void IsReadWrite(bool read_only) {
-    read_only_ = read_only;
+    SetFlag(kReadOnly, read_only);
   }
   [[nodiscard]] bool IsReadOnly() const {
-    return read_only_;
+    return GetFlag(kReadOnly);
   }
 
   [[nodiscard]] MetricMetadata* CreateMetaData();
   [[nodiscard]] MetricMetadata* GetMetaData();
   [[nodiscard]] const MetricMetadata* GetMetaData() const;
 
+  /** \brief Adds or replaces a property.
+   *
+   * The metric references an interned property set, see PropertySet. The
+   * call replaces the set with the interned set that includes the property.
+   * @param property Property to add.
+   */
   void AddProperty(const MetricProperty& property);
+  /** \brief Returns a property that the caller may change.
+   *
+   * The metric gets its own copy of the properties, so it no longer shares
+   * them with other metrics. Call InternProperties() when the properties
+   * have been changed.
+   * @param key Property key.
+   * @return Pointer to the property.
+   */
   [[nodiscard]] MetricProperty* CreateProperty(const std::string& key);
+  /** \brief Returns a property that the caller may change, see CreateProperty(). */
   [[nodiscard]] MetricProperty* GetProperty(const std::string& key);
   [[nodiscard]] const MetricProperty* GetProperty(const std::string& key) const;
 
-  const MetricPropertyList& Properties() const {
-    return property_list_;
-  }
+  /** \brief Returns the properties.
+   *
+   * The reference is valid until the properties are changed.
+   * @return List of properties.
+   */
+  [[nodiscard]] const MetricPropertyList& Properties() const;
+  /** \brief Replaces all properties with an interned property set.
+   *
+   * Note that property pointers from CreateProperty() or GetProperty() are
+   * invalid after this call.
+   * @param property_set Interned property set or an empty pointer for no properties.
+   */
+  void Properties(std::shared_ptr<const PropertySet> property_set);
+  /** \brief Returns the interned property set.
+   *
+   * @return Property set or an empty pointer if the metric has no properties
+   * or has its own copy of the properties.
+   */
+  [[nodiscard]] std::shared_ptr<const PropertySet> SharedProperties() const;
+  /** \brief Updates the properties with the values in the list.
+   *
+   * Existing properties are updated and new properties are added. Property
+   * pointers from CreateProperty() or GetProperty() remain valid.
+   * @param property_list Properties to update.
+   */
+  void UpdateProperties(const MetricPropertyList& property_list);
+  /** \brief Moves the metric's own properties into an interned set.
+   *
+   * Note that property pointers from CreateProperty() or GetProperty() are
+   * invalid after this call.
+   */
+  void InternProperties();
   void DeleteProperty(const std::string& key);
 
   template <typename T>
@@ -124,43 +181,77 @@ class Metric {
   template<typename T>
   [[nodiscard]] T Value() const;
 
+  /** \brief Returns a copy of the value text. A short value doesn't allocate memory. */
+  [[nodiscard]] SmallString ValueText() const;
+
   void GetBody(std::vector<uint8_t>& dest) const;
   std::string GetMqttString() const;
   [[nodiscard]] std::string DebugString() const;
 
-  void SetOnMessage(MetricCallback on_message) {
-    on_message_ = std::move(on_message);
-  }
+  void SetOnMessage(MetricCallback on_message);
 
-  void SetUpdated() { updated_ = true; }
-  void ResetUpdated() { updated_ = false; }
+  void SetUpdated() { SetFlag(kUpdated, true); }
+  void ResetUpdated() { SetFlag(kUpdated, false); }
   [[nodiscard]] bool IsUpdated() {
-    return updated_;
+    return GetFlag(kUpdated);
+  }
+
+  /** \brief Returns a counter that is stepped when the birth definition changes.
+   *
+   * The counter is stepped when the name, alias, data type or properties are
+   * changed. Note that a property pointer from CreateProperty() or GetProperty()
+   * steps the counter when it is fetched, not when the property is changed.
+   * The payload uses the counter to decide if a cached birth message is valid.
+   */
+  [[nodiscard]] uint64_t DefinitionVersion() const {
+    return definition_version_;
   }
 
+  /** \brief Returns an estimate of the memory (bytes) that the metric uses.
+   *
+   * A shared property set is split between the metrics that use it.
+   * @return Number of bytes.
+   */
+  [[nodiscard]] size_t MemoryUsage() const;
  private:
-  std::string name_;
+  enum Flag : uint8_t {
+    kHistorical = 0x01,
+    kTransient = 0x02,
+    kNull = 0x04,
+    kValid = 0x08, ///< Indicate if the metric is GOOD or STALE
+    kReadOnly = 0x10, ///< Indicate if the metric can be changes remotely
+    kUpdated = 0x20
+  };
+  struct ColdData; ///< Rarely used data that is allocated on first use.
+
+  SmallString name_;
+  SmallString value_;
   std::atomic<uint64_t> alias_ = 0;
   std::atomic<uint64_t> timestamp_ = 0;
-  std::atomic<uint32_t> datatype_ = 0;
-  std::atomic<bool> is_historical_ = false;
-  std::atomic<bool> is_transient_ = false;
-  std::atomic<bool> is_null_ = false;
-
-  mutable std::atomic<bool> valid_ = false; ///< Indicate if the metric is GOOD or STALE
-  std::atomic<bool> read_only_ = false; ///< Indicate if the metric can be changes remotely
-
-  MetricPropertyList property_list_;
-
-  mutable std::recursive_mutex metric_mutex_;
-  std::string value_;
-  MetricCallback on_message_;
-  MetricCallback on_publish_;
-  std::unique_ptr<MetricMetadata> meta_data_;
+  std::atomic<uint32_t> definition_version_ = 0;
+  std::atomic<uint8_t> datatype_ = 0;
+  mutable std::atomic<uint8_t> flags_ = 0;
+  std::shared_ptr<const PropertySet> property_set_; ///< Interned properties.
+  std::unique_ptr<ColdData> cold_;
+
+  void SetFlag(Flag flag, bool set) const {
+    if (set) {
+      flags_.fetch_or(flag);
+    } else {
+      flags_.fetch_and(static_cast<uint8_t>(~flag));
+    }
+  }
+  [[nodiscard]] bool GetFlag(Flag flag) const {
+    return (flags_.load() & flag) != 0;
+  }
 
-  std::atomic<bool> updated_ = false;
+  /** \brief Returns the lock of the metric. The metrics share a pool of locks. */
+  [[nodiscard]] std::recursive_mutex& Mutex() const;
+  ColdData& Cold(); ///< Metric mutex shall be locked.
+  [[nodiscard]] MetricPropertyList* OwnList() const; ///< Metric mutex shall be locked.
 
   void FireOnMessage();
+  MetricPropertyList& OwnProperties(); ///< Metric mutex shall be locked.
 };
 
 template<typename T>
@@ -169,10 +260,10 @@ void Metric::Value(T value) {
   try {
     bool updated = false;
     {
-      std::scoped_lock lock(metric_mutex_);
-      const std::string old_value = value_;
-      value_ = std::to_string(value);
-      updated = old_value != value_;
+      const std::string text = std::to_string(value);
+      std::scoped_lock lock(Mutex());
+      updated = !(value_ == text);
+      value_ = text;
     }
     IsValid(true);
     if (updated) {
@@ -188,7 +279,7 @@ template<>
 void Metric::Value(std::string value);
 
 template<>
-void Metric::Value(std::string_view& value);
+void Metric::Value(std::string_view value);
 
 template<>
 void Metric::Value(const char* value);
@@ -207,8 +298,8 @@ T Metric::Value() const {
   T temp = {};
 
   try {
-    std::lock_guard lock(metric_mutex_);
-    std::istringstream str(value_);
+    std::lock_guard lock(Mutex());
+    std::istringstream str(value_.Str());
     str >> temp;
   } catch (const std::exception& ) {
     IsValid(false);
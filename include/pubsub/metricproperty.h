@@ -48,6 +48,9 @@ class MetricProperty {
 
   std::vector<MetricPropertyList>& PropertyArray();
   const std::vector<MetricPropertyList>& PropertyArray() const;
+
+  /** \brief Returns an estimate of the memory (bytes) that the property uses. */
+  [[nodiscard]] size_t MemoryUsage() const;
  private:
   std::string key_;
   MetricType  type_ = MetricType::String;
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Append-only time-series recorder of inbound metric values.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "pubsub/metric.h"
+
+namespace pub_sub {
+
+/** \brief Quality of a recorded value. */
+enum class SampleQuality : uint8_t {
+  Good = 0,    ///< Valid value.
+  Invalid = 1, ///< The metric value was invalid.
+  Null = 2     ///< The metric value was null.
+};
+
+/** \brief One recorded value of a metric. */
+struct RecordedSample {
+  uint64_t timestamp = 0; ///< Metric time (ms since 1970).
+  SampleQuality quality = SampleQuality::Good;
+  int64_t int_value = 0;  ///< Value of integer, boolean and date time metrics.
+  double float_value = 0.0; ///< Value of float and double metrics.
+  std::string text_value; ///< Value of string and text metrics.
+};
+
+/** \brief Records all inbound metric values into column chunks.
+ *
+ * The recorder appends every value that a client receives to segment files
+ * in a directory. The values are grouped per metric (series) into chunks.
+ * Each chunk stores the timestamps, qualities and values as separate,
+ * compressed columns. The timestamps are delta-of-delta encoded, the
+ * integers delta encoded and the floating point values XOR encoded against
+ * the previous value.
+ *
+ * The receiving thread only copies the value texts into a queue. An internal
+ * thread converts the values, builds the chunks and appends them to the current segment file.
+ * A chunk is written when it is full or when the flush interval expires.
+ * If the queue is full, the values are dropped and the dropped counter is
+ * stepped. The segment files are never changed after a chunk has been
+ * written, so other processes may read them while the recorder runs.
+ *
+ * A series is identified by a key 'group/node/device/metric'. The device
+ * part is empty for node metrics. The Query() function reads a time range
+ * from memory-mapped segment files, so it can also be used on a directory
+ * without starting the recorder.
+ */
+class MetricRecorder final {
+ public:
+  MetricRecorder() = default;
+  ~MetricRecorder();
+
+  MetricRecorder(const MetricRecorder&) = delete;
+  MetricRecorder& operator=(const MetricRecorder&) = delete;
+
+  /** \brief Sets the directory of the segment files. */
+  void Directory(const std::string& directory) { directory_ = directory; }
+  [[nodiscard]] const std::string& Directory() const { return directory_; }
+
+  /** \brief Number of values per chunk before it is written. */
+  void ChunkSize(size_t chunk_size) { chunk_size_ = chunk_size > 0 ? chunk_size : 1; }
+  [[nodiscard]] size_t ChunkSize() const { return chunk_size_; }
+
+  /** \brief Max size (bytes) of a segment file before a new file is started. */
+  void MaxSegmentSize(uint64_t max_size) { max_segment_size_ = max_size; }
+  [[nodiscard]] uint64_t MaxSegmentSize() const { return max_segment_size_; }
+
+  /** \brief Max time (ms) that a value is kept in memory before it is written. */
+  void FlushInterval(uint64_t interval_ms) { flush_interval_ = interval_ms; }
+  [[nodiscard]] uint64_t FlushInterval() const { return flush_interval_; }
+
+  void MaxQueueSize(size_t max_size) { max_queue_size_ = max_size > 0 ? max_size : 1; }
+  [[nodiscard]] size_t MaxQueueSize() const { return max_queue_size_; }
+
+  /** \brief Creates a new segment file and starts the writer thread. */
+  bool Start();
+  /** \brief Writes all values and stops the writer thread. */
+  void Stop();
+  [[nodiscard]] bool IsActive() const { return active_; }
+
+  /** \brief Adds metric values to the queue.
+   *
+   * Called by the client's receiving thread.
+   * @param group_id Group name.
+   * @param node_id Node name.
+   * @param device_id Device name or empty for node metrics.
+   * @param metric_list Changed metrics.
+   */
+  void Record(const std::string& group_id, const std::string& node_id,
+              const std::string& device_id,
+              const std::vector<std::shared_ptr<Metric>>& metric_list);
+
+  /** \brief Waits until all queued values are written to the segment files. */
+  void Flush();
+
+  [[nodiscard]] uint64_t Recorded() const { return recorded_; }
+  [[nodiscard]] uint64_t Dropped() const { return dropped_; }
+
+  /** \brief Returns the series key of a metric. */
+  [[nodiscard]] static std::string MakeSeriesKey(std::string_view group_id,
+                                                 std::string_view node_id,
+                                                 std::string_view device_id,
+                                                 std::string_view metric_name);
+
+  /** \brief Returns the series keys in the segment files. */
+  [[nodiscard]] std::vector<std::string> SeriesKeys() const;
+
+  /** \brief Reads the values of a series within a time range.
+   *
+   * Only values written to the segment files are returned, see Flush().
+   * @param series_key Series key, see MakeSeriesKey().
+   * @param from_time Start time (ms since 1970), inclusive.
+   * @param to_time End time (ms since 1970), inclusive.
+   * @return Values sorted on time.
+   */
+  [[nodiscard]] std::vector<RecordedSample> Query(std::string_view series_key,
+                                                  uint64_t from_time,
+                                                  uint64_t to_time) const;
+
+ private:
+  /** \brief Value in the queue.
+   *
+   * The receiving thread only copies the value text. The writer thread builds
+   * the series key and converts the text to the column type.
+   */
+  struct QueueEntry {
+    std::shared_ptr<const std::string> key_prefix; ///< 'group/node/device/'
+    std::shared_ptr<Metric> metric;
+    uint64_t alias = 0;
+    MetricType type = MetricType::Unknown;
+    uint64_t timestamp = 0;
+    SampleQuality quality = SampleQuality::Good;
+    SmallString value;
+  };
+
+  /** \brief Values of one series that aren't written yet. */
+  struct Chunk {
+    uint64_t alias = 0;
+    MetricType type = MetricType::Unknown;
+    uint64_t first_time = 0; ///< Time when the first value was added (ms since 1970).
+    std::vector<RecordedSample> sample_list;
+  };
+
+  std::string directory_;
+  size_t chunk_size_ = 1'000;
+  uint64_t max_segment_size_ = 64'000'000;
+  uint64_t flush_interval_ = 1'000;
+  std::atomic<size_t> max_queue_size_ = 100'000;
+
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_event_; ///< Values added, flush requested or stop.
+  std::condition_variable flush_event_; ///< The queue was written.
+  std::deque<QueueEntry> queue_;
+  uint64_t flush_request_ = 0;
+  uint64_t flush_done_ = 0;
+
+  std::atomic<bool> active_ = false;
+  std::atomic<uint64_t> recorded_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::thread work_thread_;
+
+  // Only used by the writer thread.
+  std::map<std::string, Chunk, std::less<>> chunk_list_;
+  std::string series_key_; ///< Key buffer that is reused for each value.
+  std::ofstream segment_file_;
+  uint64_t segment_size_ = 0;
+  uint64_t segment_index_ = 0;
+
+  void WorkTask();
+  void AddToChunk(QueueEntry& entry);
+  void WriteChunk(const std::string& series_key, Chunk& chunk);
+  bool NewSegment();
+  [[nodiscard]] std::vector<std::string> SegmentFiles() const;
+};
+
+} // pub_sub
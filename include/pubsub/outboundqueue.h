@@ -0,0 +1,237 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Bounded queue of outbound messages.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "pubsub/statistics.h"
+
+namespace pub_sub {
+
+class ITopic;
+
+/** \brief Defines what happens with a published message when the outbound queue is full. */
+enum class PublishPolicy : int {
+  Block = 0,  ///< The publisher waits until the queue has space. Only on user threads.
+  DropOldest, ///< The oldest queued message is dropped.
+  Conflate    ///< A queued message of the same topic is replaced. Intended for QoS 0 telemetry.
+};
+
+/** \brief Result of a published message. */
+struct DeliveryResult {
+  int token = 0; ///< Token of the MQTT library. 0 if the message never was sent.
+  bool delivered = false; ///< True if the message was sent (QoS 0) or acknowledged (QoS 1/2).
+  uint64_t latency = 0; ///< Time (ns) from the send until the acknowledge.
+};
+
+using DeliveryPromise = std::promise<DeliveryResult>;
+using DeliveryFuture = std::shared_future<DeliveryResult>; ///< Completion handle of a publish.
+using DeliveryCallback = std::function<void(const std::vector<DeliveryResult>& result_list)>;
+
+/** \brief Limits the messages that a client hands over to the MQTT library.
+ *
+ * The MQTT library buffers all messages that it can't send directly, so a
+ * slow network or broker lets the memory grow without limit. The outbound
+ * queue only lets a window of messages be in flight at the same time. The
+ * transport calls Complete() when a message is sent or failed, so the next
+ * queued message can be sent by an internal thread.
+ *
+ * The queued messages are limited by a byte limit. When the limit is
+ * reached, the topic's publish policy defines if the publisher blocks, if
+ * the oldest message is dropped or if a queued message of the same topic is
+ * replaced by the new message. If a conflated message doesn't find a queued
+ * message of the same topic, the oldest message is dropped. Messages that
+ * shall be kept, as BIRTH and DEATH messages, are never dropped or replaced.
+ * If only kept messages are queued, the new message is dropped instead.
+ * Only messages that hold the full state of a topic are replaced, see
+ * ITopic::IsConflatable().
+ *
+ * The client's own threads shall never wait on the queue, as a blocked
+ * node thread delays the failover and a blocked callback of the MQTT
+ * library delays the acknowledges. The Block policy acts as DropOldest on
+ * these threads, see NonBlockingThread().
+ *
+ * The transport reports each completion with the token of the MQTT
+ * library. The completions are collected and handled as a batch by the
+ * internal thread, which also records the delivery time (send to
+ * acknowledge) and completes the delivery handles of the messages. A
+ * delivery callback gets each batch of results.
+ *
+ * If the queue isn't started, the messages are sent directly and the
+ * delivery handles complete when the message is handed over.
+ */
+class OutboundQueue final {
+ public:
+  OutboundQueue() = default;
+  ~OutboundQueue();
+
+  OutboundQueue(const OutboundQueue&) = delete;
+  OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+  /** \brief Sets the maximum number of messages in flight. */
+  void InFlightWindow(size_t window) { window_ = window > 0 ? window : 1; }
+  [[nodiscard]] size_t InFlightWindow() const { return window_; }
+
+  /** \brief Sets the maximum number of queued bytes. */
+  void ByteLimit(size_t bytes) { byte_limit_ = bytes; }
+  [[nodiscard]] size_t ByteLimit() const { return byte_limit_; }
+
+  /** \brief Sets the maximum time (ms) a blocked publisher waits before the message is dropped. */
+  void BlockTimeout(uint64_t timeout_ms) { block_timeout_ = timeout_ms; }
+  [[nodiscard]] uint64_t BlockTimeout() const { return block_timeout_; }
+
+  /** \brief Sets a callback that gets the delivery results in batches.
+   *
+   * The callback is called by the internal thread and should be set before
+   * the queue is started. Only messages that were sent are reported.
+   * @param callback Function that gets a batch of delivery results.
+   */
+  void OnDelivery(DeliveryCallback callback) { delivery_callback_ = std::move(callback); }
+
+  bool Start();
+  void Stop();
+  [[nodiscard]] bool IsActive() const { return active_; }
+
+  /** \brief Sends or queues an encoded message.
+   *
+   * The message is sent through ITopic::SendBody(), directly if the queue is
+   * empty and the window isn't full, otherwise by the internal thread. A
+   * directly sent body is not copied, so the topic may patch it on send.
+   * @param topic Topic that sends the message.
+   * @param body Encoded message.
+   * @param keep True if the message never shall be dropped.
+   * @param delivery Optional promise that is completed with the delivery result.
+   * @return False if the message was dropped or failed.
+   */
+  bool Publish(ITopic& topic, std::vector<uint8_t>& body, bool keep = false,
+               std::shared_ptr<DeliveryPromise> delivery = {});
+  /** \brief Sends or queues a temporary encoded message. */
+  bool Publish(ITopic& topic, std::vector<uint8_t>&& body, bool keep = false,
+               std::shared_ptr<DeliveryPromise> delivery = {}) {
+    return Publish(topic, body, keep, std::move(delivery));
+  }
+
+  /** \brief Called by the transport when an accepted message is sent or failed.
+   *
+   * Only the first completion of a batch wakes the internal thread. Each
+   * completion frees a slot in the window, also if its token is unknown.
+   * @param token Token that the MQTT library returned on send. 0 if unknown.
+   * @param delivered True if the message was sent or acknowledged.
+   */
+  void Complete(int token, bool delivered);
+
+  /** \brief Marks the calling thread as a thread that never waits on a full queue.
+   *
+   * Called by the client's worker thread and by the callbacks of the MQTT
+   * library. The internal thread is marked when it starts.
+   */
+  static void NonBlockingThread();
+  [[nodiscard]] static bool IsNonBlockingThread();
+
+  /** \brief Returns a lock that stops the messages from being handed over.
+   *
+   * The transport holds the lock while its MQTT handle is destroyed or
+   * replaced, as the internal thread sends with the current handle.
+   */
+  [[nodiscard]] std::unique_lock<std::mutex> LockSend() {
+    return std::unique_lock(send_mutex_);
+  }
+
+  /** \brief Drops all queued messages and clears the window.
+   *
+   * Called when the MQTT connection is destroyed, as the transport doesn't
+   * complete the pending messages. The next session starts with new
+   * BIRTH messages, so old messages shall not be sent.
+   */
+  void Reset();
+
+  /** \brief Drops the queued messages of a topic. Called when the topic is deleted. */
+  void Discard(const ITopic& topic);
+
+  [[nodiscard]] size_t QueueDepth() const;
+  [[nodiscard]] size_t QueueBytes() const;
+  [[nodiscard]] size_t InFlight() const;
+  [[nodiscard]] uint64_t Sent() const { return sent_; }
+  [[nodiscard]] uint64_t Dropped() const { return dropped_; }
+  [[nodiscard]] uint64_t Conflated() const { return conflated_; }
+
+  /** \brief Time from the send until the transport completed the message. */
+  [[nodiscard]] LatencyHistogram& DeliveryTime() { return delivery_time_; }
+  [[nodiscard]] const LatencyHistogram& DeliveryTime() const { return delivery_time_; }
+
+ private:
+  struct Message {
+    ITopic* topic = nullptr;
+    std::vector<uint8_t> body;
+    bool keep = false;
+    std::shared_ptr<DeliveryPromise> delivery;
+  };
+
+  /** \brief Message that the transport not yet completed. */
+  struct Pending {
+    uint64_t send_time = 0; ///< Steady clock (ns).
+    std::shared_ptr<DeliveryPromise> delivery;
+  };
+
+  /** \brief Completion that the transport reported. */
+  struct Done {
+    int token = 0;
+    bool delivered = false;
+    uint64_t done_time = 0; ///< Steady clock (ns).
+  };
+
+  /** \brief Completed message that is delivered outside the locks. */
+  struct Completion {
+    DeliveryResult result;
+    std::shared_ptr<DeliveryPromise> delivery;
+  };
+
+  std::atomic<size_t> window_ = 1'000;
+  std::atomic<size_t> byte_limit_ = 16'000'000;
+  std::atomic<uint64_t> block_timeout_ = 5'000;
+
+  std::mutex send_mutex_; ///< Keeps the send order between the publisher and the internal thread.
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_event_; ///< A message was queued or completed.
+  std::condition_variable space_event_; ///< A queued message was sent or dropped.
+  std::deque<Message> queue_;
+  size_t queue_bytes_ = 0;
+  size_t in_flight_ = 0;
+  size_t unknown_done_ = 0; ///< Completions of pending messages that had no token.
+  std::unordered_map<int, Pending> pending_list_; ///< Sent messages by token.
+  std::vector<Done> done_list_; ///< Completions that the internal thread handles.
+  DeliveryCallback delivery_callback_;
+  LatencyHistogram delivery_time_;
+
+  std::atomic<bool> active_ = false;
+  std::atomic<uint64_t> sent_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::atomic<uint64_t> conflated_ = 0;
+  std::thread work_thread_;
+
+  void WorkTask();
+  void SendQueue();
+  bool Send(ITopic& topic, std::vector<uint8_t>& body,
+            std::shared_ptr<DeliveryPromise> delivery);
+  void Deliver(std::vector<Completion>& completion_list);
+  void DropOldest(size_t bytes); ///< Queue mutex shall be locked.
+  void Drop(Message& message); ///< Queue mutex shall be locked.
+  void FailAll(); ///< Queue mutex shall be locked.
+};
+
+} // pub_sub
@@ -11,13 +11,28 @@
 #include <map>
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <span>
+#include <unordered_map>
 
 #include <util/stringutil.h>
 #include "pubsub/metric.h"
+#include "pubsub/payloadsnapshot.h"
 
 namespace pub_sub {
 
+/** \brief Defines a metric that is created by Payload::CreateMetrics(). */
+struct MetricDescriptor {
+  std::string name;
+  MetricType type = MetricType::Unknown;
+  std::string unit;
+  bool read_only = false;
+  uint64_t alias = 0; ///< Fixed alias or 0 if the alias should be assigned.
+  std::vector<MetricProperty> property_list;
+};
+
 class Payload {
+  friend class PayloadHelper;
  public:
   using BodyList = std::vector<uint8_t>;
   /** \brief Metric/Value list that is sorted on names.
@@ -29,6 +44,9 @@ class Payload {
   using MetricList = std::map<std::string, std::shared_ptr<Metric>,
       util::string::IgnoreCase>;
 
+  Payload();
+  ~Payload();
+
   /** \brief Sets the timestamp for the payload.
    *
    * Sets the timestamp for the payload. Note that bare MQTT doesn't
@@ -55,10 +73,50 @@ class Payload {
   std::shared_ptr<Metric> CreateMetric(const std::string& name);
   void AddMetric(const std::shared_ptr<Metric>& metric);
 
+  /** \brief Creates many metrics in one call.
+   *
+   * The metrics are allocated in one memory block and inserted into the
+   * metric list under one lock. Existing metrics are returned as is.
+   * If the first alias is non-zero, the new metrics without a fixed alias
+   * get aliases in descriptor order, starting with the first alias. If that
+   * alias already is in use, the metric gets a free alias of the range. A
+   * fixed alias that already is in use, is rejected and the metric gets no alias.
+   * Note that the memory block is released when all its metrics are deleted.
+   * @param descriptor_list Metric definitions.
+   * @param first_alias First alias to assign or 0 for no aliases.
+   * @return Metrics in descriptor order.
+   */
+  std::vector<std::shared_ptr<Metric>> CreateMetrics(
+      std::span<const MetricDescriptor> descriptor_list, uint64_t first_alias = 0);
+
   [[nodiscard]] std::shared_ptr<Metric> GetMetric(uint64_t alias) const;
   [[nodiscard]] std::shared_ptr<Metric> GetMetric(const std::string& name) const;
 
   [[nodiscard]] const MetricList& Metrics() const;
+
+  /** \brief Returns the metrics that have a name.
+   *
+   * The list is copied under the payload lock. The caller may walk the list
+   * without blocking other threads that add or look up metrics.
+   * @return List of metrics.
+   */
+  [[nodiscard]] std::vector<std::shared_ptr<Metric>> NamedMetrics() const;
+
+  /** \brief Publishes a new snapshot of the metric values.
+   *
+   * Shall be called by the writer after it has updated a set of values.
+   * Inbound messages are committed automatically by the parsers.
+   * @return Version of the new snapshot.
+   */
+  uint64_t Commit();
+
+  /** \brief Returns the latest snapshot of the metric values.
+   *
+   * The snapshot is shared by all readers until the values change. The first
+   * call after a parsed message, creates a new snapshot.
+   * @return Immutable snapshot.
+   */
+  [[nodiscard]] std::shared_ptr<const PayloadSnapshot> Snapshot() const;
   void DeleteMetrics(const std::string& name);
 
   template<typename T>
@@ -82,15 +140,59 @@ class Payload {
   [[nodiscard]] std::string BodyToString() const;
 
   void GenerateJson();
-  void GenerateProtobuf();
+  /** \brief Generates the protobuf body.
+   *
+   * The metric definitions (name, alias, data type and properties) of a
+   * birth message (write_all) are serialized once and kept by the payload.
+   * The next birth only encodes the timestamps, sequence number and values,
+   * and copies the kept bytes. A definition is encoded again when its metric
+   * is added or its definition is changed, see Metric::DefinitionVersion().
+   * @param write_all True for birth messages that include all metrics, names and data types.
+   */
+  void GenerateProtobuf(bool write_all = false);
+  /** \brief Number of metric definitions that have been encoded for births. */
+  [[nodiscard]] uint64_t DefinitionEncodeCount() const { return definition_encode_count_; }
+
+  /** \brief Returns the schema fingerprint of the last parsed birth message.
+   *
+   * The fingerprint is calculated from the metric names, aliases and data
+   * types of a received birth message. If the next birth has the same
+   * fingerprint, the metrics and their alias lookup are reused instead of
+   * being resolved by name. Data messages resolve aliases through the same
+   * lookup.
+   * @return Fingerprint or 0 if no birth message has been parsed.
+   */
+  [[nodiscard]] uint64_t SchemaFingerprint() const;
   void GenerateText();
 
   void ParseText(bool create_metrics);
   void ParseSparkplugJson(bool create_metrics);
-  void ParseSparkplugProtobuf(bool create_metrics);
+  /** \brief Parses a Sparkplug B protobuf body.
+   *
+   * Only birth messages updates the alias lookup and the schema fingerprint.
+   * @param create_metrics True if missing metrics shall be created.
+   * @param birth_message True for NBIRTH and DBIRTH messages.
+   */
+  void ParseSparkplugProtobuf(bool create_metrics, bool birth_message = false);
+
+  /** \brief Returns the metrics that were updated by the last parse.
+   *
+   * The list is filled by ParseSparkplugJson() and ParseSparkplugProtobuf().
+   * It avoids that the receiver scans all metrics for changes.
+   * @return Metrics in message order.
+   */
+  [[nodiscard]] std::vector<std::shared_ptr<Metric>> ParsedMetrics() const;
 
   std::string MakeJsonString() const;
   std::string MakeString() const;
+
+  /** \brief Returns an estimate of the memory (bytes) that the payload uses.
+   *
+   * The estimate includes the body buffer and all metrics. Note that
+   * metrics that are shared between payloads, are included in both payloads.
+   * @return Number of bytes.
+   */
+  [[nodiscard]] size_t MemoryUsage() const;
  protected:
   [[nodiscard]] bool IsUpdated() const;
  private:
@@ -99,7 +201,26 @@ class Payload {
   std::atomic<uint64_t> timestamp_ = 0;
   mutable std::atomic<uint64_t> sequence_number_ = 0;
   MetricList metric_list_;
+  std::vector<std::shared_ptr<Metric>> parsed_list_; ///< Metrics updated by the last parse.
   BodyList body_; ///< This is the payload data
+
+  mutable std::mutex commit_mutex_; ///< Serializes the snapshot writers.
+  std::atomic<uint64_t> value_version_ = 1; ///< Changed by commits and parsed messages.
+  mutable std::atomic<std::shared_ptr<const PayloadSnapshot>> snapshot_;
+
+  struct BirthCache;
+  std::mutex birth_mutex_;
+  std::unique_ptr<BirthCache> birth_cache_; ///< Kept birth definitions.
+  std::atomic<uint64_t> definition_encode_count_ = 0;
+
+  mutable std::mutex alias_mutex_; ///< Protects the parsed birth lookup below.
+  uint64_t schema_fingerprint_ = 0;
+  std::vector<std::shared_ptr<Metric>> birth_list_; ///< Metrics in birth message order.
+  std::unordered_map<uint64_t, std::shared_ptr<Metric>> alias_index_;
+
+  uint64_t MakeSnapshot() const;
+  [[nodiscard]] std::vector<uint64_t> MakeAliasList(
+      std::span<const MetricDescriptor> descriptor_list, uint64_t first_alias) const;
 };
 
 template<typename T>
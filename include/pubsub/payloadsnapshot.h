@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Immutable snapshot of the metric values in a payload.
+ */
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "pubsub/metrictype.h"
+
+namespace pub_sub {
+
+/** \brief Value of a metric at the time of the snapshot. */
+struct MetricValue {
+  std::string name;
+  uint64_t alias = 0;
+  uint64_t timestamp = 0; ///< Metric time (ms since 1970).
+  MetricType type = MetricType::Unknown;
+  bool is_null = false;
+  bool valid = false;
+  std::string value; ///< Value as text, same as in the metric.
+  std::string unit;
+
+  template <typename T>
+  [[nodiscard]] T Value() const;
+};
+
+/** \brief Consistent, read-only view of a payload's metrics.
+ *
+ * A snapshot is created by the payload writer, see Payload::Commit(), and
+ * is never changed after that. Readers get the latest snapshot in constant
+ * time, see Payload::Snapshot(), and may keep it as long as they need to.
+ * A reader never blocks the writers, and all values in a snapshot belong
+ * to the same version.
+ */
+class PayloadSnapshot {
+ public:
+  PayloadSnapshot(uint64_t version, uint64_t timestamp, std::vector<MetricValue> metric_list);
+
+  [[nodiscard]] uint64_t Version() const { return version_; }
+  [[nodiscard]] uint64_t Timestamp() const { return timestamp_; }
+
+  /** \brief Metric values sorted on name (case-insensitive). */
+  [[nodiscard]] const std::vector<MetricValue>& Metrics() const { return metric_list_; }
+
+  [[nodiscard]] const MetricValue* GetMetric(std::string_view name) const;
+  [[nodiscard]] const MetricValue* GetMetric(uint64_t alias) const;
+
+  template <typename T>
+  [[nodiscard]] T GetValue(std::string_view name) const;
+
+ private:
+  uint64_t version_ = 0;
+  uint64_t timestamp_ = 0;
+  std::vector<MetricValue> metric_list_;
+};
+
+template <typename T>
+T MetricValue::Value() const {
+  if constexpr (std::is_same_v<T, std::string>) {
+    return value;
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return value == "1" || value == "true" || value == "True" || value == "TRUE";
+  } else {
+    static_assert(std::is_arithmetic_v<T>, "Only text and numbers are supported");
+    T temp = {};
+    std::from_chars(value.data(), value.data() + value.size(), temp);
+    return temp;
+  }
+}
+
+template <typename T>
+T PayloadSnapshot::GetValue(std::string_view name) const {
+  const auto* metric = GetMetric(name);
+  return metric != nullptr ? metric->Value<T>() : T {};
+}
+
+} // pub_sub
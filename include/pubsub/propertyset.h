@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Immutable, shared set of metric properties.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "pubsub/metricproperty.h"
+
+namespace pub_sub {
+
+/** \brief Immutable property set that is shared between metrics.
+ *
+ * Most metrics have the same properties as many other metrics, for
+ * example the same engineering unit. Identical property sets are interned,
+ * so all metrics reference one set. The protobuf encoding of the set is
+ * done once, when the set is created, and is copied as bytes into the
+ * BIRTH and DATA messages.
+ *
+ * A set is removed from the intern pool when the last metric releases it.
+ */
+class PropertySet final {
+ public:
+  ~PropertySet();
+
+  PropertySet(const PropertySet&) = delete;
+  PropertySet& operator=(const PropertySet&) = delete;
+
+  /** \brief Returns the shared set that is equal to the property list.
+   *
+   * @param property_list Properties of the set.
+   * @return Shared set or an empty pointer if the list has no properties.
+   */
+  [[nodiscard]] static std::shared_ptr<const PropertySet> Intern(
+      MetricPropertyList property_list);
+
+  /** \brief Number of sets in the intern pool. */
+  [[nodiscard]] static size_t InternedCount();
+
+  [[nodiscard]] const MetricPropertyList& Properties() const { return property_list_; }
+  [[nodiscard]] const MetricProperty* GetProperty(const std::string& key) const;
+
+  /** \brief Returns the protobuf encoding (Payload.PropertySet) of the set.
+   *
+   * @param with_types True for birth messages that include the data types.
+   * @return Encoded bytes.
+   */
+  [[nodiscard]] const std::string& Encoded(bool with_types) const {
+    return with_types ? birth_encoding_ : data_encoding_;
+  }
+
+  /** \brief Returns an estimate of the memory (bytes) that the set uses. */
+  [[nodiscard]] size_t MemoryUsage() const;
+ private:
+  explicit PropertySet(MetricPropertyList property_list);
+
+  MetricPropertyList property_list_;
+  std::string birth_encoding_; ///< Encoding with data types. Also the intern key.
+  std::string data_encoding_;  ///< Encoding without data types.
+  bool interned_ = false;
+};
+
+} // pub_sub
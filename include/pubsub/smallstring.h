@@ -0,0 +1,73 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Compact string that stores short texts inline.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pub_sub {
+
+/** \brief String with a 31 character inline buffer.
+ *
+ * The string has the same size as a std::string but stores up to 31
+ * characters without any heap allocation, while a std::string only stores
+ * 15 characters inline. Metric values are stored as text and most
+ * numeric values fit inline. Longer texts are stored on the heap.
+ *
+ * The last byte of the buffer defines the mode. In inline mode, it holds
+ * the number of unused characters, so a full buffer ends with a 0 byte.
+ */
+class SmallString final {
+ public:
+  SmallString() { SetInlineSize(0); }
+  SmallString(std::string_view text); // NOLINT(google-explicit-constructor)
+  SmallString(const SmallString& text);
+  SmallString(SmallString&& text) noexcept;
+  ~SmallString();
+
+  SmallString& operator=(const SmallString& text);
+  SmallString& operator=(SmallString&& text) noexcept;
+  SmallString& operator=(std::string_view text) {
+    Assign(text);
+    return *this;
+  }
+
+  void Assign(std::string_view text);
+  void Clear();
+
+  [[nodiscard]] std::string_view View() const;
+  [[nodiscard]] std::string Str() const { return std::string(View()); }
+  [[nodiscard]] size_t Size() const { return View().size(); }
+  [[nodiscard]] bool Empty() const { return Size() == 0; }
+  [[nodiscard]] bool IsInline() const;
+  /** \brief Number of bytes allocated on the heap. */
+  [[nodiscard]] size_t HeapSize() const;
+
+  friend bool operator==(const SmallString& text1, std::string_view text2) {
+    return text1.View() == text2;
+  }
+ private:
+  static constexpr size_t kInlineSize = 31;
+  static constexpr unsigned char kHeapMode = 0xFF;
+
+  struct Heap {
+    char* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+  };
+  static_assert(sizeof(Heap) < kInlineSize);
+
+  alignas(Heap) char buffer_[kInlineSize + 1] = {};
+
+  [[nodiscard]] Heap GetHeap() const;
+  void SetHeap(const Heap& heap);
+  void SetInlineSize(size_t size);
+};
+
+} // pub_sub
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Runtime statistics for clients and topics.
+ *
+ * The counters and histograms are lock-free and cheap enough to be updated
+ * on the MQTT callback and publisher threads.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace pub_sub {
+
+/** \brief Counter that is shared between threads.
+ *
+ * The counter is split into cache-line padded shards. Each thread adds to
+ * its own shard, so two threads don't fight about the same cache line.
+ * Reading the value sums all shards. The shards are allocated on the first
+ * add, so an unused counter only costs a pointer. This keeps the remote
+ * nodes that a host mirrors small.
+ */
+class StatCounter {
+ public:
+  StatCounter() = default;
+  ~StatCounter();
+  StatCounter(const StatCounter&) = delete;
+  StatCounter& operator=(const StatCounter&) = delete;
+
+  void Add(uint64_t value = 1);
+  [[nodiscard]] uint64_t Value() const;
+  void Reset();
+
+ private:
+  static constexpr size_t kShards = 8;
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value = 0;
+  };
+  using ShardList = std::array<Shard, kShards>;
+  std::atomic<ShardList*> shard_list_ = nullptr;
+
+  [[nodiscard]] ShardList& Shards();
+};
+
+/** \brief HDR-style histogram of time values in nanoseconds.
+ *
+ * The histogram uses a logarithmic scale of buckets where each power of 2
+ * is split into 4 linear sub-buckets. This gives a relative error of
+ * less than 25% over the full range of 1 ns to about 36 minutes. The
+ * buckets are allocated on the first add, so an unused histogram is small.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram() = default;
+  ~LatencyHistogram();
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Add(uint64_t value_ns);
+  void Reset();
+
+  /** \brief Returns the number of allocated bucket bytes. */
+  [[nodiscard]] size_t HeapSize() const;
+
+  [[nodiscard]] uint64_t Count() const { return count_; }
+  [[nodiscard]] uint64_t Min() const;
+  [[nodiscard]] uint64_t Max() const { return max_; }
+  [[nodiscard]] uint64_t Mean() const;
+
+  /** \brief Returns the value at a percentile.
+   *
+   * @param percentile Percentile in the range 0-100.
+   * @return Lowest value (ns) in the bucket that contains the percentile.
+   */
+  [[nodiscard]] uint64_t Percentile(double percentile) const;
+
+ private:
+  static constexpr size_t kSubBits = 2;
+  static constexpr size_t kSubBuckets = 1 << kSubBits;
+  static constexpr size_t kMaxMagnitude = 40; ///< Values are clamped to 2^41 - 1 ns.
+  static constexpr size_t kBuckets = kSubBuckets + (kMaxMagnitude - kSubBits + 1) * kSubBuckets;
+  using BucketList = std::array<std::atomic<uint64_t>, kBuckets>;
+
+  std::atomic<BucketList*> bucket_list_ = nullptr;
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> sum_ = 0;
+  std::atomic<uint64_t> min_ = UINT64_MAX;
+  std::atomic<uint64_t> max_ = 0;
+
+  [[nodiscard]] BucketList& Buckets();
+  [[nodiscard]] static size_t BucketIndex(uint64_t value);
+  [[nodiscard]] static uint64_t BucketValue(size_t index);
+};
+
+/** \brief Measures the time of a scope into a histogram. */
+class ScopedTimer {
+ public:
+  ScopedTimer() = delete;
+  explicit ScopedTimer(LatencyHistogram& histogram,
+                       LatencyHistogram* topic_histogram = nullptr)
+  : histogram_(histogram),
+    topic_histogram_(topic_histogram),
+    start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    const auto stop = std::chrono::steady_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start_);
+    const auto ns = static_cast<uint64_t>(elapsed.count());
+    histogram_.Add(ns);
+    if (topic_histogram_ != nullptr) {
+      topic_histogram_->Add(ns);
+    }
+  }
+
+ private:
+  LatencyHistogram& histogram_;
+  LatencyHistogram* topic_histogram_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/** \brief Statistics for a topic. */
+class TopicStatistics {
+ public:
+  void AddMessage(size_t bytes) {
+    messages_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void AddFailure() { failures_.fetch_add(1, std::memory_order_relaxed); }
+
+  [[nodiscard]] uint64_t Messages() const { return messages_; }
+  [[nodiscard]] uint64_t Bytes() const { return bytes_; }
+  [[nodiscard]] uint64_t Failures() const { return failures_; }
+
+  /** \brief Encode time for published and parse time for received messages.
+   *
+   * The topics that a Sparkplug host mirrors don't measure the parse time.
+   * The host measures it in its client statistics instead.
+   */
+  [[nodiscard]] LatencyHistogram& ProcessTime() { return process_time_; }
+  [[nodiscard]] const LatencyHistogram& ProcessTime() const { return process_time_; }
+
+  void Reset();
+ private:
+  std::atomic<uint64_t> messages_ = 0;
+  std::atomic<uint64_t> bytes_ = 0;
+  std::atomic<uint64_t> failures_ = 0;
+  LatencyHistogram process_time_;
+};
+
+/** \brief Statistics for a client. */
+class ClientStatistics {
+ public:
+  void AddMessageIn(size_t bytes) {
+    messages_in_.Add();
+    bytes_in_.Add(bytes);
+  }
+  void AddMessageOut(size_t bytes) {
+    messages_out_.Add();
+    bytes_out_.Add(bytes);
+  }
+  void AddDroppedMessage() { dropped_messages_.Add(); }
+  void AddPublishFailure() { publish_failures_.Add(); }
+  void AddParseError() { parse_errors_.Add(); }
+  void AddSequenceGap() { sequence_gaps_.Add(); }
+  void AddFailover(uint64_t failover_ns) {
+    failovers_.Add();
+    failover_time_.Add(failover_ns);
+  }
+
+  [[nodiscard]] uint64_t MessagesIn() const { return messages_in_.Value(); }
+  [[nodiscard]] uint64_t BytesIn() const { return bytes_in_.Value(); }
+  [[nodiscard]] uint64_t MessagesOut() const { return messages_out_.Value(); }
+  [[nodiscard]] uint64_t BytesOut() const { return bytes_out_.Value(); }
+
+  /** \brief Number of received messages that was dropped by the topic filter. */
+  [[nodiscard]] uint64_t DroppedMessages() const { return dropped_messages_.Value(); }
+  [[nodiscard]] uint64_t PublishFailures() const { return publish_failures_.Value(); }
+  [[nodiscard]] uint64_t ParseErrors() const { return parse_errors_.Value(); }
+
+  /** \brief Number of received Sparkplug messages with an unexpected sequence number. */
+  [[nodiscard]] uint64_t SequenceGaps() const { return sequence_gaps_.Value(); }
+
+  /** \brief Number of switches to a standby broker session. */
+  [[nodiscard]] uint64_t Failovers() const { return failovers_.Value(); }
+
+  /** \brief Time from a lost connection until the node published its birth on the next broker. */
+  [[nodiscard]] const LatencyHistogram& FailoverTime() const { return failover_time_; }
+
+  [[nodiscard]] LatencyHistogram& ParseTime() { return parse_time_; }
+  [[nodiscard]] const LatencyHistogram& ParseTime() const { return parse_time_; }
+
+  [[nodiscard]] LatencyHistogram& EncodeTime() { return encode_time_; }
+  [[nodiscard]] const LatencyHistogram& EncodeTime() const { return encode_time_; }
+
+  /** \brief Time from the latency probe was set until the message arrived.
+   *
+   * The time includes the encoding, the network and the broker. It is
+   * measured by a host on the remote node objects. The host statistics
+   * holds the values of all its remote nodes.
+   */
+  [[nodiscard]] LatencyHistogram& TransferTime() { return transfer_time_; }
+  [[nodiscard]] const LatencyHistogram& TransferTime() const { return transfer_time_; }
+
+  /** \brief Time from the latency probe was set until the metrics were updated. */
+  [[nodiscard]] LatencyHistogram& IngestTime() { return ingest_time_; }
+  [[nodiscard]] const LatencyHistogram& IngestTime() const { return ingest_time_; }
+
+  void Reset();
+ private:
+  StatCounter messages_in_;
+  StatCounter bytes_in_;
+  StatCounter messages_out_;
+  StatCounter bytes_out_;
+  StatCounter dropped_messages_;
+  StatCounter publish_failures_;
+  StatCounter parse_errors_;
+  StatCounter sequence_gaps_;
+  StatCounter failovers_;
+  LatencyHistogram parse_time_;
+  LatencyHistogram encode_time_;
+  LatencyHistogram transfer_time_;
+  LatencyHistogram ingest_time_;
+  LatencyHistogram failover_time_;
+};
+
+} // pub_sub
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pub_sub {
+
+/** \brief Include and exclude filter on Sparkplug topic names.
+ *
+ * The filter is used to reduce the number of messages that a Sparkplug
+ * host or node needs to handle. A message is accepted if its group, node,
+ * device and message type pass the filter. Each level is accepted if
+ * the include list is empty or the name exists in the include list, and the
+ * name doesn't exist in the exclude list. Note that the names are case
+ * sensitive as MQTT topic names.
+ *
+ * The filter narrows the broker subscriptions when include lists are
+ * defined, otherwise the messages are dropped before they are parsed.
+ * The filter shall be configured before the client is started.
+ */
+class TopicFilter {
+ public:
+  void IncludeGroup(const std::string& group_id);
+  void ExcludeGroup(const std::string& group_id);
+  void IncludeNode(const std::string& node_id);
+  void ExcludeNode(const std::string& node_id);
+  void IncludeDevice(const std::string& device_id);
+  void ExcludeDevice(const std::string& device_id);
+  void IncludeMessageType(const std::string& message_type);
+  void ExcludeMessageType(const std::string& message_type);
+  void Clear();
+
+  [[nodiscard]] bool IsEmpty() const;
+
+  /** \brief Returns true if the include lists narrow the subscriptions. */
+  [[nodiscard]] bool IsNarrowing() const;
+
+  /** \brief Returns true if the filter may drop a part of a node's messages.
+   *
+   * A node's messages share one sequence number. If the device or
+   * message type levels are filtered, the received sequence numbers have
+   * gaps that aren't lost messages.
+   */
+  [[nodiscard]] bool IsPartialNode() const;
+
+  /** \brief Checks a raw topic name without any memory allocation.
+   *
+   * The topic name is expected to be on the form
+   * 'namespace/group/message type/node[/device]' or
+   * 'namespace/STATE/host'.
+   * @param topic_name Topic name.
+   * @return True if the message should be handled.
+   */
+  [[nodiscard]] bool IsAccepted(std::string_view topic_name) const;
+
+  [[nodiscard]] bool IsAccepted(std::string_view group_id,
+                                std::string_view message_type,
+                                std::string_view node_id,
+                                std::string_view device_id) const;
+
+  /** \brief Creates broker subscriptions for a message type.
+   *
+   * Creates one subscription per included group and node. A '+' wildcard
+   * is used for levels without any include names. The message type
+   * may also be a '+' wildcard.
+   * @param prefix Namespace including any '$share/<name>/' prefix.
+   * @param message_type Message type or '+'.
+   * @return List of subscriptions. Empty if the message type is excluded.
+   */
+  [[nodiscard]] std::vector<std::string> MakeSubscriptions(
+      std::string_view prefix, std::string_view message_type) const;
+
+ private:
+  using NameList = std::set<std::string, std::less<>>;
+
+  NameList include_groups_;
+  NameList exclude_groups_;
+  NameList include_nodes_;
+  NameList exclude_nodes_;
+  NameList include_devices_;
+  NameList exclude_devices_;
+  NameList include_message_types_;
+  NameList exclude_message_types_;
+
+  [[nodiscard]] static bool IsLevelAccepted(const NameList& include_list,
+                                            const NameList& exclude_list,
+                                            std::string_view name);
+};
+
+} // pub_sub
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace pub_sub {
+
+class ITopic;
+
+/** \brief Hash indexes of a client's topic list.
+ *
+ * The index makes the topic lookup by name and message type O(1). The
+ * client's topic list still owns the topics. The index keys are views of
+ * the topics' own strings, so the index doesn't allocate any key strings
+ * and a lookup doesn't allocate any memory.
+ *
+ * A topic that is added to the index, reports any rename to the index.
+ * If several topics have the same name or message type, the first topic
+ * in the list is returned, as a linear search would do. Topics without a
+ * name, i.e. a name generated from its levels, are indexed at the first
+ * lookup that needs them.
+ */
+class TopicIndex {
+ public:
+  using TopicList = std::vector<std::unique_ptr<ITopic>>;
+
+  TopicIndex() = delete;
+  TopicIndex(const TopicList& topic_list, std::recursive_mutex& list_mutex);
+
+  TopicIndex(const TopicIndex&) = delete;
+  TopicIndex& operator=(const TopicIndex&) = delete;
+
+  void Add(ITopic& topic); ///< Shall be called after the topic is added to the list.
+  void Remove(ITopic& topic); ///< Shall be called before the topic is removed.
+  void Clear();
+
+  /** \brief Updates the index when a topic is renamed.
+   *
+   * The guard removes the topic keys from the index and adds the new keys
+   * when it goes out of scope. The index is locked meanwhile. The guard
+   * does nothing if the topic isn't indexed.
+   */
+  class RenameGuard {
+   public:
+    explicit RenameGuard(ITopic& topic);
+    ~RenameGuard();
+    RenameGuard(const RenameGuard&) = delete;
+    RenameGuard& operator=(const RenameGuard&) = delete;
+   private:
+    ITopic& topic_;
+    TopicIndex* index_ = nullptr;
+  };
+
+  [[nodiscard]] ITopic* Find(std::string_view topic_name);
+  [[nodiscard]] ITopic* IFind(std::string_view topic_name);
+  [[nodiscard]] ITopic* FindByMessageType(std::string_view message_type) const;
+
+ private:
+  /** \brief Case-insensitive hash (ASCII). */
+  struct IHash {
+    size_t operator()(std::string_view key) const;
+  };
+  /** \brief Case-insensitive compare (ASCII). */
+  struct IEqual {
+    bool operator()(std::string_view key1, std::string_view key2) const;
+  };
+  using NameIndex = std::unordered_map<std::string_view, ITopic*>;
+  using INameIndex = std::unordered_map<std::string_view, ITopic*, IHash, IEqual>;
+
+  const TopicList& topic_list_;
+  std::recursive_mutex& list_mutex_;
+  uint64_t next_order_ = 0;
+
+  NameIndex name_index_;
+  INameIndex iname_index_;
+  INameIndex type_index_;
+  std::unordered_set<ITopic*> unnamed_list_; ///< Topics that are not name indexed.
+
+  static TopicIndex* IndexOf(const ITopic& topic);
+  void IndexKeys(ITopic& topic);
+  void UnindexKeys(ITopic& topic);
+  void IndexUnnamed();
+
+  template <typename Index>
+  static void Insert(Index& index, std::string_view key, ITopic& topic);
+
+  template <typename Index, typename KeyOf>
+  void Erase(Index& index, std::string_view key, const ITopic& topic, KeyOf key_of);
+};
+
+} // pub_sub
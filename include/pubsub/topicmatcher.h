@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pub_sub {
+
+/** \brief Dispatches messages to handlers of MQTT topic filters.
+ *
+ * A handler is registered for a topic filter which may include the '+' and
+ * '#' wildcards. The filters are stored in a tree with one node per topic
+ * level, so matching a topic name takes time proportional to the number of
+ * levels in the name, independent of the number of filters. A message is
+ * dispatched to every matching handler, once per registered filter, without
+ * any memory allocation.
+ *
+ * The handlers are called by the thread that dispatches the message. A
+ * handler must not add or remove handlers.
+ */
+class TopicMatcher {
+ public:
+  using OnMessage = std::function<void(std::string_view topic_name,
+                                       std::span<const uint8_t> body)>;
+
+  TopicMatcher() = default;
+  TopicMatcher(const TopicMatcher&) = delete;
+  TopicMatcher& operator=(const TopicMatcher&) = delete;
+
+  /** \brief Adds a handler for a topic filter.
+   *
+   * @param filter Topic filter e.g. 'plant/+/temperature' or 'plant/#'.
+   * @param on_message Handler that is called for each matching message.
+   * @return Handler identity or 0 if the filter is invalid.
+   */
+  uint64_t AddHandler(const std::string& filter, OnMessage on_message);
+  void RemoveHandler(uint64_t handler_id);
+  void Clear();
+
+  [[nodiscard]] bool IsEmpty() const;
+  [[nodiscard]] size_t Handlers() const;
+
+  /** \brief Calls all handlers with a filter that matches the topic name.
+   *
+   * Note that topic names starting with '$' don't match filters that start
+   * with a wildcard.
+   * @param topic_name Topic name.
+   * @param body Message body.
+   * @return Number of handlers that were called.
+   */
+  size_t Dispatch(std::string_view topic_name, std::span<const uint8_t> body) const;
+
+  /** \brief Returns true if any filter matches the topic name. */
+  [[nodiscard]] bool IsMatch(std::string_view topic_name) const;
+
+  /** \brief Returns true if the filter is a valid MQTT topic filter. */
+  [[nodiscard]] static bool IsValidFilter(std::string_view filter);
+
+ private:
+  struct Handler {
+    uint64_t id = 0;
+    OnMessage on_message;
+  };
+
+  /** \brief One topic level in the filter tree.
+   *
+   * The child map keys are views of the child's own level string.
+   */
+  struct Node {
+    std::string level;
+    Node* parent = nullptr;
+    std::unordered_map<std::string_view, std::unique_ptr<Node>> child_list;
+    std::unique_ptr<Node> plus; ///< '+' child
+    std::vector<Handler> handler_list; ///< Filters that end at this level
+    std::vector<Handler> hash_list;    ///< Filters that end with '#' after this level
+
+    [[nodiscard]] bool IsEmpty() const;
+  };
+
+  struct Location {
+    Node* node = nullptr;
+    bool hash = false;
+  };
+
+  mutable std::mutex matcher_mutex_;
+  Node root_;
+  std::map<uint64_t, Location> location_list_; ///< Handler identity to filter node
+  uint64_t next_id_ = 1;
+
+  template <typename Visitor>
+  static void Match(const Node& node, std::string_view topic_name, size_t position,
+                    bool dollar, Visitor& visitor);
+  void Prune(Node* node);
+};
+
+} // pub_sub
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "loadconfig.h"
+
+#include <iostream>
+#include <string_view>
+
+#include <util/stringutil.h>
+
+using namespace util::string;
+
+namespace {
+
+uint64_t ToUnsigned(const std::string& value, uint64_t default_value) {
+  try {
+    return std::stoull(value);
+  } catch (const std::exception&) {
+    std::cerr << "Invalid number: " << value << std::endl;
+  }
+  return default_value;
+}
+
+double ToDouble(const std::string& value, double default_value) {
+  try {
+    return std::stod(value);
+  } catch (const std::exception&) {
+    std::cerr << "Invalid number: " << value << std::endl;
+  }
+  return default_value;
+}
+
+pub_sub::MetricType ToValueType(const std::string& value) {
+  using pub_sub::MetricType;
+  if (IEquals(value, "float")) {
+    return MetricType::Float;
+  }
+  if (IEquals(value, "int32")) {
+    return MetricType::Int32;
+  }
+  if (IEquals(value, "int64")) {
+    return MetricType::Int64;
+  }
+  if (IEquals(value, "bool")) {
+    return MetricType::Boolean;
+  }
+  if (IEquals(value, "string")) {
+    return MetricType::String;
+  }
+  return MetricType::Double;
+}
+
+} // end namespace
+
+namespace pub_sub::load {
+
+bool LoadConfig::Parse(int argc, char* argv[]) {
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string option = argv[arg] != nullptr ? argv[arg] : "";
+    if (option == "--help" || option == "-h") {
+      help = true;
+      return true;
+    }
+    const auto equal = option.find('=');
+    if (option.substr(0, 2) != "--" || equal == std::string::npos) {
+      std::cerr << "Invalid argument: " << option << std::endl;
+      return false;
+    }
+    const std::string name = option.substr(2, equal - 2);
+    const std::string value = option.substr(equal + 1);
+
+    if (name == "mode") {
+      mode = IEquals(value, "host") ? LoadMode::Host : LoadMode::Node;
+    } else if (name == "broker") {
+      broker = value;
+    } else if (name == "port") {
+      port = static_cast<uint16_t>(ToUnsigned(value, port));
+    } else if (name == "version") {
+      version = value == "3" ? ProtocolVersion::Mqtt311 : ProtocolVersion::Mqtt5;
+    } else if (name == "group") {
+      group = value;
+    } else if (name == "host") {
+      host = value;
+    } else if (name == "nodes") {
+      nodes = ToUnsigned(value, nodes);
+    } else if (name == "devices") {
+      devices = ToUnsigned(value, devices);
+    } else if (name == "metrics") {
+      metrics = ToUnsigned(value, metrics);
+    } else if (name == "rate") {
+      change_rate = ToDouble(value, change_rate);
+    } else if (name == "interval") {
+      publish_interval = ToUnsigned(value, publish_interval);
+    } else if (name == "type") {
+      value_type = ToValueType(value);
+    } else if (name == "size") {
+      value_size = ToUnsigned(value, value_size);
+    } else if (name == "duration") {
+      duration = ToUnsigned(value, duration);
+    } else if (name == "report") {
+      report_interval = ToUnsigned(value, report_interval);
+    } else if (name == "probe") {
+      latency_probe = value != "0" && !IEquals(value, "false");
+    } else {
+      std::cerr << "Unknown argument: " << option << std::endl;
+      return false;
+    }
+  }
+  if (publish_interval == 0) {
+    publish_interval = 1;
+  }
+  if (report_interval == 0) {
+    report_interval = 1;
+  }
+  return true;
+}
+
+std::string LoadConfig::NodeName(size_t index) const {
+  return "LoadNode" + std::to_string(index + 1);
+}
+
+void LoadConfig::Usage() {
+  std::cout << "Usage: pubload [--name=value]..." << std::endl
+    << "  --mode=node|host   Simulate edge nodes or run a host (node)" << std::endl
+    << "  --broker=address   MQTT broker address (127.0.0.1)" << std::endl
+    << "  --port=number      MQTT broker port (1883)" << std::endl
+    << "  --version=3|5      MQTT protocol version (5)" << std::endl
+    << "  --group=name       Sparkplug group (LoadGroup)" << std::endl
+    << "  --host=name        Sparkplug host name (LoadHost)" << std::endl
+    << "  --nodes=N          Number of edge nodes (1)" << std::endl
+    << "  --devices=M        Number of devices per node (10)" << std::endl
+    << "  --metrics=K        Number of metrics per device (100)" << std::endl
+    << "  --rate=Hz          Value changes per second and metric (1.0)" << std::endl
+    << "  --interval=ms      Publish interval (100)" << std::endl
+    << "  --type=name        float|double|int32|int64|bool|string (double)" << std::endl
+    << "  --size=chars       Length of string values (16)" << std::endl
+    << "  --duration=s       Run time (60)" << std::endl
+    << "  --report=s         Report interval (1)" << std::endl
+    << "  --probe=1|0        End-to-end latency probe (1)" << std::endl;
+}
+
+} // pub_sub::load
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Command line options for the load generator.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "pubsub/ipubsubclient.h"
+#include "pubsub/metrictype.h"
+
+namespace pub_sub::load {
+
+enum class LoadMode : int {
+  Node = 0, ///< Simulates a number of edge nodes.
+  Host = 1  ///< Runs a host and measures the ingest.
+};
+
+/** \brief Configuration of a load run.
+ *
+ * The configuration is read from the command line arguments. All arguments
+ * have the form '--name=value'.
+ */
+struct LoadConfig {
+  LoadMode mode = LoadMode::Node;
+  std::string broker = "127.0.0.1";
+  uint16_t port = 1883;
+  ProtocolVersion version = ProtocolVersion::Mqtt5;
+  std::string group = "LoadGroup";
+  std::string host = "LoadHost";
+
+  size_t nodes = 1;   ///< Number of edge nodes.
+  size_t devices = 10; ///< Number of devices per node.
+  size_t metrics = 100; ///< Number of metrics per device.
+  double change_rate = 1.0; ///< Value changes per second and metric.
+  uint64_t publish_interval = 100; ///< Publish interval (ms).
+  MetricType value_type = MetricType::Double;
+  size_t value_size = 16; ///< Number of characters in a string value.
+
+  uint64_t duration = 60; ///< Run time (s).
+  uint64_t report_interval = 1; ///< Report interval (s).
+  bool latency_probe = true;
+  bool help = false; ///< Only show the usage.
+
+  [[nodiscard]] bool Parse(int argc, char* argv[]);
+  [[nodiscard]] std::string NodeName(size_t index) const;
+  static void Usage();
+};
+
+} // pub_sub::load
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "loadnode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "pubsub/pubsubfactory.h"
+
+namespace {
+
+constexpr std::string_view kNamespace = "spBv1.0";
+
+uint64_t NowMs() {
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  return static_cast<uint64_t>(ms.count());
+}
+
+}
+
+namespace pub_sub::load {
+
+LoadNode::LoadNode(const LoadConfig& config, size_t index)
+: config_(config),
+  node_(PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode)) {
+  node_->Broker(config_.broker);
+  node_->Port(config_.port);
+  node_->Version(config_.version);
+  node_->GroupId(config_.group);
+  node_->Name(config_.NodeName(index));
+  node_->LatencyProbe(config_.latency_probe);
+  node_->InService(false);
+
+  device_list_.reserve(config_.devices);
+  for (size_t device = 0; device < config_.devices; ++device) {
+    CreateDevice(device);
+  }
+}
+
+void LoadNode::CreateDevice(size_t index) {
+  LoadDevice load_device;
+  load_device.device = node_->CreateDevice("Device" + std::to_string(index + 1));
+  if (load_device.device == nullptr) {
+    std::cerr << "Failed to create a device. Node: " << node_->Name() << std::endl;
+    return;
+  }
+  auto& device = *load_device.device;
+  device.InService(true);
+
+  auto* topic = device.CreateTopic();
+  if (topic == nullptr) {
+    std::cerr << "Failed to create a DDATA topic. Node: " << node_->Name() << std::endl;
+    return;
+  }
+  std::string topic_name(kNamespace);
+  topic_name.append("/").append(config_.group);
+  topic_name.append("/DDATA/").append(node_->Name());
+  topic_name.append("/").append(device.Name());
+  topic->Topic(topic_name);
+  topic->Namespace(kNamespace.data());
+  topic->GroupId(config_.group);
+  topic->MessageType("DDATA");
+  topic->NodeId(node_->Name());
+  topic->DeviceId(device.Name());
+  topic->Publish(true);
+  topic->Qos(QualityOfService::Qos0);
+  topic->Retained(false);
+  load_device.data_topic = topic;
+
+  // The metrics are defined in the DBIRTH and shared with the DDATA message.
+  load_device.metric_list.reserve(config_.metrics);
+  for (size_t index_metric = 0; index_metric < config_.metrics; ++index_metric) {
+    auto metric = PubSubFactory::CreateMetric("Metric" + std::to_string(index_metric + 1));
+    metric->Type(config_.value_type);
+    ChangeValue(*metric);
+    device.AddMetric(metric);
+    topic->GetPayload().AddMetric(metric);
+    load_device.metric_list.emplace_back(std::move(metric));
+  }
+  device_list_.emplace_back(std::move(load_device));
+}
+
+void LoadNode::ChangeValue(Metric& metric) {
+  const uint64_t value = ++counter_;
+  switch (config_.value_type) {
+    case MetricType::Float:
+      metric.Value(static_cast<float>(value) * 0.5F);
+      break;
+
+    case MetricType::Int32:
+      metric.Value(static_cast<int32_t>(value));
+      break;
+
+    case MetricType::Int64:
+      metric.Value(static_cast<int64_t>(value));
+      break;
+
+    case MetricType::Boolean:
+      metric.Value(!metric.Value<bool>());
+      break;
+
+    case MetricType::String: {
+      // Fixed length string that ends with the counter value.
+      std::string text = std::to_string(value);
+      if (text.size() < config_.value_size) {
+        text.insert(0, config_.value_size - text.size(), '#');
+      }
+      metric.Value(text);
+      break;
+    }
+
+    default:
+      metric.Value(static_cast<double>(value) * 0.5);
+      break;
+  }
+}
+
+bool LoadNode::Start() {
+  bool start = node_->Start();
+  for (auto& load_device : device_list_) {
+    if (load_device.device != nullptr && !load_device.device->Start()) {
+      start = false;
+    }
+  }
+  node_->InService(true);
+  return start;
+}
+
+bool LoadNode::Stop() {
+  node_->InService(false);
+  for (auto& load_device : device_list_) {
+    if (load_device.device != nullptr) {
+      load_device.device->InService(false);
+      load_device.device->Stop();
+    }
+  }
+  return node_->Stop();
+}
+
+bool LoadNode::IsOnline() const {
+  if (!node_->IsOnline()) {
+    return false;
+  }
+  return std::all_of(device_list_.cbegin(), device_list_.cend(),
+                     [] (const LoadDevice& load_device) -> bool {
+    return load_device.device != nullptr && load_device.device->IsOnline();
+  });
+}
+
+void LoadNode::Poll() {
+  const double changes = static_cast<double>(config_.metrics) * config_.change_rate
+      * static_cast<double>(config_.publish_interval) / 1000.0;
+  for (auto& load_device : device_list_) {
+    if (load_device.data_topic == nullptr || load_device.metric_list.empty()) {
+      continue;
+    }
+    if (load_device.device == nullptr || !load_device.device->IsOnline()) {
+      load_device.change_credit = 0; // No backlog while offline
+      continue;
+    }
+    load_device.change_credit += changes;
+    if (load_device.change_credit < 1.0) {
+      continue;
+    }
+    const auto count = std::min(static_cast<size_t>(load_device.change_credit),
+                                load_device.metric_list.size());
+    load_device.change_credit -= static_cast<double>(count);
+    load_device.change_credit = std::min(load_device.change_credit,
+                                         static_cast<double>(load_device.metric_list.size()));
+    for (size_t change = 0; change < count; ++change) {
+      auto& metric = load_device.metric_list[load_device.next_metric];
+      ChangeValue(*metric);
+      load_device.next_metric = (load_device.next_metric + 1) % load_device.metric_list.size();
+    }
+    load_device.data_topic->GetPayload().Timestamp(NowMs());
+    load_device.data_topic->DoPublish();
+  }
+}
+
+} // pub_sub::load
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Simulated Sparkplug edge node.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "pubsub/ipubsubclient.h"
+#include "pubsub/metric.h"
+#include "loadconfig.h"
+
+namespace pub_sub::load {
+
+/** \brief Simulated edge node with devices and metrics.
+ *
+ * The node creates M devices with K metrics each. Each device have a DDATA
+ * topic that shares its metrics with the DBIRTH topic. The Poll() function
+ * changes the metric values according to the change rate and publishes the
+ * DDATA messages of the changed devices.
+ */
+class LoadNode final {
+ public:
+  LoadNode() = delete;
+  LoadNode(const LoadConfig& config, size_t index);
+
+  [[nodiscard]] bool Start();
+  bool Stop();
+
+  /** \brief Changes metric values and publishes DDATA messages.
+   *
+   * The function shall be called each publish interval.
+   */
+  void Poll();
+
+  [[nodiscard]] const IPubSubClient& Node() const { return *node_; }
+  [[nodiscard]] bool IsOnline() const;
+ private:
+  struct LoadDevice {
+    IPubSubClient* device = nullptr;
+    ITopic* data_topic = nullptr;
+    std::vector<std::shared_ptr<Metric>> metric_list;
+    size_t next_metric = 0; ///< Next metric to change (round-robin).
+    double change_credit = 0; ///< Accumulated number of changes.
+  };
+
+  const LoadConfig& config_;
+  std::unique_ptr<IPubSubClient> node_;
+  std::vector<LoadDevice> device_list_;
+  uint64_t counter_ = 0; ///< Base for new values.
+
+  void CreateDevice(size_t index);
+  void ChangeValue(Metric& metric);
+};
+
+} // pub_sub::load
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Sparkplug B load generator.
+ *
+ * In node mode, the application simulates N edge nodes with M devices and
+ * K metrics each. It reports the achieved publish rate, bytes per second
+ * and CPU usage. In host mode, the application runs a Sparkplug host and
+ * reports the ingest rate, lag and sequence gaps.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "pubsub/pubsubfactory.h"
+#include "loadconfig.h"
+#include "loadnode.h"
+
+using namespace pub_sub;
+using namespace pub_sub::load;
+using namespace std::chrono_literals;
+using SteadyClock = std::chrono::steady_clock;
+
+namespace {
+
+/** \brief Returns the process CPU time (user + kernel) in seconds. */
+double CpuTime() {
+#ifdef _WIN32
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
+                       &kernel_time, &user_time)) {
+    return 0.0;
+  }
+  auto to_seconds = [] (const FILETIME& time) -> double {
+    const uint64_t ticks = (static_cast<uint64_t>(time.dwHighDateTime) << 32)
+        | time.dwLowDateTime;
+    return static_cast<double>(ticks) / 1.0E7; // 100 ns ticks
+  };
+  return to_seconds(kernel_time) + to_seconds(user_time);
+#else
+  rusage usage = {};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+  auto to_seconds = [] (const timeval& time) -> double {
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1.0E6;
+  };
+  return to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime);
+#endif
+}
+
+/** \brief Measures rates between two reports. */
+class RateMeter {
+ public:
+  RateMeter()
+  : last_time_(SteadyClock::now()),
+    last_cpu_(CpuTime()) {}
+
+  void Update(uint64_t messages, uint64_t bytes) {
+    const auto now = SteadyClock::now();
+    const double cpu = CpuTime();
+    const std::chrono::duration<double> elapsed = now - last_time_;
+    const double seconds = elapsed.count() > 0.0 ? elapsed.count() : 1.0;
+    message_rate_ = static_cast<double>(messages - last_messages_) / seconds;
+    byte_rate_ = static_cast<double>(bytes - last_bytes_) / seconds;
+    cpu_usage_ = 100.0 * (cpu - last_cpu_) / seconds;
+    last_time_ = now;
+    last_cpu_ = cpu;
+    last_messages_ = messages;
+    last_bytes_ = bytes;
+  }
+
+  [[nodiscard]] double MessageRate() const { return message_rate_; }
+  [[nodiscard]] double ByteRate() const { return byte_rate_; }
+  [[nodiscard]] double CpuUsage() const { return cpu_usage_; } ///< 100% = 1 core.
+ private:
+  SteadyClock::time_point last_time_;
+  double last_cpu_ = 0.0;
+  uint64_t last_messages_ = 0;
+  uint64_t last_bytes_ = 0;
+  double message_rate_ = 0.0;
+  double byte_rate_ = 0.0;
+  double cpu_usage_ = 0.0;
+};
+
+double ToMicroseconds(uint64_t ns) {
+  return static_cast<double>(ns) / 1000.0;
+}
+
+int RunNodes(const LoadConfig& config) {
+  std::vector<std::unique_ptr<LoadNode>> node_list;
+  node_list.reserve(config.nodes);
+  for (size_t index = 0; index < config.nodes; ++index) {
+    node_list.emplace_back(std::make_unique<LoadNode>(config, index));
+  }
+
+  for (auto& node : node_list) {
+    if (!node->Start()) {
+      std::cerr << "Failed to start the node: " << node->Node().Name() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (size_t online = 0; online < 1000; ++online) {
+    if (std::all_of(node_list.cbegin(), node_list.cend(),
+                    [] (const auto& node) -> bool { return node->IsOnline(); })) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  for (const auto& node : node_list) {
+    if (!node->IsOnline()) {
+      std::cerr << "The node is not online: " << node->Node().Name() << std::endl;
+    }
+  }
+
+  // Each node is polled by its own thread.
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> thread_list;
+  thread_list.reserve(node_list.size());
+  for (auto& node : node_list) {
+    thread_list.emplace_back([&config, &stop, load_node = node.get()] () {
+      const auto interval = std::chrono::milliseconds(config.publish_interval);
+      auto next = SteadyClock::now();
+      while (!stop) {
+        load_node->Poll();
+        next += interval;
+        std::this_thread::sleep_until(next);
+      }
+    });
+  }
+
+  std::printf("%8s %12s %14s %10s %8s %8s\n",
+              "Time[s]", "Publish[/s]", "Bytes[/s]", "Failures", "Queue", "CPU[%]");
+  RateMeter meter;
+  const auto start = SteadyClock::now();
+  const auto report_interval = std::chrono::seconds(config.report_interval);
+  auto next_report = start + report_interval;
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  while (SteadyClock::now() - start < std::chrono::seconds(config.duration)) {
+    std::this_thread::sleep_until(next_report);
+    next_report += report_interval;
+
+    messages = 0;
+    bytes = 0;
+    uint64_t failures = 0;
+    size_t queue = 0;
+    for (const auto& node : node_list) {
+      const auto& statistics = node->Node().Statistics();
+      messages += statistics.MessagesOut();
+      bytes += statistics.BytesOut();
+      failures += statistics.PublishFailures();
+      queue += node->Node().QueueDepth();
+    }
+    meter.Update(messages, bytes);
+    const std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+    std::printf("%8.1f %12.0f %14.0f %10llu %8zu %8.1f\n",
+                elapsed.count(), meter.MessageRate(), meter.ByteRate(),
+                static_cast<unsigned long long>(failures), queue, meter.CpuUsage());
+  }
+
+  stop = true;
+  for (auto& thread : thread_list) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+  std::printf("Total: %llu messages, %llu bytes, %.0f messages/s, %.0f bytes/s\n",
+              static_cast<unsigned long long>(messages),
+              static_cast<unsigned long long>(bytes),
+              static_cast<double>(messages) / elapsed.count(),
+              static_cast<double>(bytes) / elapsed.count());
+
+  for (auto& node : node_list) {
+    node->Stop();
+  }
+  return EXIT_SUCCESS;
+}
+
+int RunHost(const LoadConfig& config) {
+  auto host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+  if (!host) {
+    std::cerr << "Failed to create the host." << std::endl;
+    return EXIT_FAILURE;
+  }
+  host->Broker(config.broker);
+  host->Port(config.port);
+  host->Version(config.version);
+  host->Name(config.host);
+  host->LatencyProbe(config.latency_probe);
+  host->InService(true);
+  if (!host->Start()) {
+    std::cerr << "Failed to start the host." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::printf("%8s %12s %14s %12s %12s %8s %8s %8s\n",
+              "Time[s]", "Ingest[/s]", "Bytes[/s]", "Lag P50[us]", "Lag P99[us]",
+              "Gaps", "Errors", "CPU[%]");
+  const auto& statistics = host->Statistics();
+  RateMeter meter;
+  const auto start = SteadyClock::now();
+  const auto report_interval = std::chrono::seconds(config.report_interval);
+  auto next_report = start + report_interval;
+  while (SteadyClock::now() - start < std::chrono::seconds(config.duration)) {
+    std::this_thread::sleep_until(next_report);
+    next_report += report_interval;
+
+    meter.Update(statistics.MessagesIn(), statistics.BytesIn());
+    const std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+    const auto& lag = statistics.IngestTime();
+    std::printf("%8.1f %12.0f %14.0f %12.1f %12.1f %8llu %8llu %8.1f\n",
+                elapsed.count(), meter.MessageRate(), meter.ByteRate(),
+                ToMicroseconds(lag.Percentile(50)), ToMicroseconds(lag.Percentile(99)),
+                static_cast<unsigned long long>(statistics.SequenceGaps()),
+                static_cast<unsigned long long>(statistics.ParseErrors()),
+                meter.CpuUsage());
+  }
+
+  const auto& lag = statistics.IngestTime();
+  std::printf("Total: %llu messages, %llu bytes, %llu gaps, lag mean/max %.1f/%.1f us\n",
+              static_cast<unsigned long long>(statistics.MessagesIn()),
+              static_cast<unsigned long long>(statistics.BytesIn()),
+              static_cast<unsigned long long>(statistics.SequenceGaps()),
+              ToMicroseconds(lag.Mean()), ToMicroseconds(lag.Max()));
+
+  host->InService(false);
+  host->Stop();
+  return EXIT_SUCCESS;
+}
+
+} // end namespace
+
+int main(int argc, char* argv[]) {
+  LoadConfig config;
+  if (!config.Parse(argc, argv)) {
+    LoadConfig::Usage();
+    return EXIT_FAILURE;
+  }
+  if (config.help) {
+    LoadConfig::Usage();
+    return EXIT_SUCCESS;
+  }
+  return config.mode == LoadMode::Host ? RunHost(config) : RunNodes(config);
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/aliastable.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "util/logstream.h"
+
+using namespace util::log;
+
+namespace pub_sub {
+
+bool AliasTable::Load(const std::string& filename) {
+  std::scoped_lock lock(table_mutex_);
+  filename_ = filename;
+  key_list_.clear();
+  alias_list_.clear();
+  next_alias_ = 1;
+  modified_ = false;
+
+  try {
+    if (filename_.empty() || !std::filesystem::exists(filename_)) {
+      return true;
+    }
+    std::ifstream file(filename_);
+    if (!file.is_open()) {
+      LOG_ERROR() << "Failed to open the alias file. File: " << filename_;
+      return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      const auto separator = line.find(';');
+      if (separator == std::string::npos || separator + 1 >= line.size()) {
+        continue;
+      }
+      const auto alias = static_cast<uint64_t>(std::stoull(line.substr(0, separator)));
+      if (alias == 0 || alias_list_.contains(alias)) {
+        continue;
+      }
+      auto key = line.substr(separator + 1);
+      if (!key_list_.emplace(key, alias).second) {
+        continue;
+      }
+      alias_list_.emplace(alias, std::move(key));
+      next_alias_ = std::max(next_alias_, alias + 1);
+    }
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to read the alias file. Error: " << err.what()
+      << ", File: " << filename_;
+    return false;
+  }
+  return true;
+}
+
+bool AliasTable::Save() {
+  std::scoped_lock lock(table_mutex_);
+  if (!modified_ || filename_.empty()) {
+    return true;
+  }
+  try {
+    // Write to a temporary file, so a crash never leaves a half-written table.
+    const std::string temp_file = filename_ + ".tmp";
+    {
+      std::ofstream file(temp_file, std::ios::out | std::ios::trunc);
+      if (!file.is_open()) {
+        LOG_ERROR() << "Failed to create the alias file. File: " << temp_file;
+        return false;
+      }
+      for (const auto& [key, alias] : key_list_) {
+        file << alias << ';' << key << '\n';
+      }
+    }
+    std::filesystem::rename(temp_file, filename_);
+    modified_ = false;
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to save the alias file. Error: " << err.what()
+      << ", File: " << filename_;
+    return false;
+  }
+  return true;
+}
+
+std::string AliasTable::Filename() const {
+  std::scoped_lock lock(table_mutex_);
+  return filename_;
+}
+
+bool AliasTable::IsModified() const {
+  std::scoped_lock lock(table_mutex_);
+  return modified_;
+}
+
+size_t AliasTable::Size() const {
+  std::scoped_lock lock(table_mutex_);
+  return key_list_.size();
+}
+
+uint64_t AliasTable::NextAlias() const {
+  std::scoped_lock lock(table_mutex_);
+  return next_alias_;
+}
+
+uint64_t AliasTable::Alias(const std::string& key) {
+  std::scoped_lock lock(table_mutex_);
+  if (const auto itr = key_list_.find(key); itr != key_list_.cend()) {
+    return itr->second;
+  }
+  const uint64_t alias = next_alias_++;
+  key_list_.emplace(key, alias);
+  alias_list_.emplace(alias, key);
+  modified_ = true;
+  return alias;
+}
+
+bool AliasTable::Alias(const std::string& key, uint64_t alias) {
+  if (alias == 0) {
+    return false;
+  }
+  std::scoped_lock lock(table_mutex_);
+  if (const auto owner = alias_list_.find(alias); owner != alias_list_.cend()) {
+    return util::string::IEquals(owner->second, key);
+  }
+  auto itr = key_list_.find(key);
+  if (itr == key_list_.end()) {
+    key_list_.emplace(key, alias);
+  } else {
+    alias_list_.erase(itr->second);
+    itr->second = alias;
+  }
+  alias_list_.emplace(alias, key);
+  modified_ = true;
+  next_alias_ = std::max(next_alias_, alias + 1);
+  return true;
+}
+
+uint64_t AliasTable::Find(const std::string& key) const {
+  std::scoped_lock lock(table_mutex_);
+  const auto itr = key_list_.find(key);
+  return itr == key_list_.cend() ? 0 : itr->second;
+}
+
+std::string AliasTable::MakeKey(const std::string& device_name,
+                                const std::string& metric_name) {
+  // The device name cannot include a '/', so the first '/' ends the device name.
+  std::string key;
+  key.reserve(device_name.size() + metric_name.size() + 1);
+  key.append(device_name).append(1, '/').append(metric_name);
+  return key;
+}
+
+} // pub_sub
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/changenotifier.h"
+
+#include <algorithm>
+
+#include "pubsub/outboundqueue.h"
+#include "util/logstream.h"
+
+using namespace util::log;
+
+namespace pub_sub {
+
+ChangeNotifier::~ChangeNotifier() {
+  Stop();
+}
+
+bool ChangeNotifier::Start(OnChange on_change) {
+  Stop();
+  if (!on_change) {
+    LOG_ERROR() << "A change notifier needs a callback.";
+    return false;
+  }
+  on_change_ = std::move(on_change);
+  active_ = true;
+  if (!executor_) {
+    work_thread_ = std::thread(&ChangeNotifier::WorkTask, this);
+  }
+  return true;
+}
+
+void ChangeNotifier::Stop() {
+  {
+    std::scoped_lock lock(queue_mutex_);
+    active_ = false;
+  }
+  queue_event_.notify_all();
+  space_event_.notify_all();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+
+  // Wait for any executor task to finish. The task ends directly when
+  // the notifier is inactive.
+  std::unique_lock lock(queue_mutex_);
+  space_event_.wait(lock, [&] () -> bool {
+    return !scheduled_ && !delivering_;
+  });
+  queue_.clear();
+}
+
+void ChangeNotifier::Notify(ChangeSet&& change_set) {
+  if (!active_ || change_set.metric_list.empty()) {
+    return;
+  }
+  bool schedule = false;
+  {
+    std::unique_lock lock(queue_mutex_);
+    if (queue_.size() >= max_queue_size_) {
+      auto policy = policy_.load();
+      if (policy == ChangePolicy::Block && OutboundQueue::IsNonBlockingThread()) {
+        // The MQTT I/O shall not wait on a slow consumer.
+        policy = ChangePolicy::Conflate;
+      }
+      switch (policy) {
+        case ChangePolicy::Drop:
+          ++dropped_;
+          return;
+
+        case ChangePolicy::Conflate: {
+          auto itr = std::find_if(queue_.begin(), queue_.end(),
+                                  [&] (const ChangeSet& queued) -> bool {
+            return queued.topic_name == change_set.topic_name;
+          });
+          if (itr != queue_.end()) {
+            Merge(*itr, change_set);
+            ++conflated_;
+            return;
+          }
+          queue_.pop_front();
+          ++dropped_;
+          break;
+        }
+
+        case ChangePolicy::Block:
+        default:
+          space_event_.wait(lock, [&] () -> bool {
+            return !active_ || queue_.size() < max_queue_size_;
+          });
+          if (!active_) {
+            return;
+          }
+          break;
+      }
+    }
+    queue_.push_back(std::move(change_set));
+    if (executor_ && !scheduled_) {
+      scheduled_ = true;
+      schedule = true;
+    }
+  }
+  if (schedule) {
+    executor_([this] () { DeliverQueue(); });
+  } else {
+    queue_event_.notify_one();
+  }
+}
+
+size_t ChangeNotifier::QueueDepth() const {
+  std::scoped_lock lock(queue_mutex_);
+  return queue_.size();
+}
+
+void ChangeNotifier::Merge(ChangeSet& dest, ChangeSet& source) {
+  // The metrics in one change set are unique.
+  auto& dest_list = dest.metric_list;
+  std::sort(dest_list.begin(), dest_list.end());
+  const auto dest_end = static_cast<std::ptrdiff_t>(dest_list.size());
+  for (auto& metric : source.metric_list) {
+    if (!std::binary_search(dest_list.begin(), dest_list.begin() + dest_end, metric)) {
+      dest_list.push_back(std::move(metric));
+    }
+  }
+  dest.timestamp = std::max(dest.timestamp, source.timestamp);
+}
+
+void ChangeNotifier::DeliverQueue() {
+  std::unique_lock lock(queue_mutex_);
+  while (active_ && !queue_.empty()) {
+    ChangeSet change_set = std::move(queue_.front());
+    queue_.pop_front();
+    delivering_ = true;
+    lock.unlock();
+    space_event_.notify_all();
+
+    on_change_(change_set);
+    ++delivered_;
+
+    lock.lock();
+    delivering_ = false;
+  }
+  scheduled_ = false;
+  lock.unlock();
+  space_event_.notify_all();
+}
+
+void ChangeNotifier::WorkTask() {
+  std::unique_lock lock(queue_mutex_);
+  while (true) {
+    queue_event_.wait(lock, [&] () -> bool {
+      return !active_ || !queue_.empty();
+    });
+    if (!active_) {
+      break;
+    }
+    ChangeSet change_set = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    space_event_.notify_all();
+
+    on_change_(change_set);
+    ++delivered_;
+
+    lock.lock();
+  }
+}
+
+} // pub_sub
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/changestream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "sparkplughelper.h"
+
+namespace {
+
+bool IsPattern(std::string_view name) {
+  return name.find_first_of("*?") != std::string_view::npos;
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+ChangeStream::~ChangeStream() {
+  {
+    std::scoped_lock lock(stream_mutex_);
+    stop_thread_ = true;
+  }
+  stream_event_.notify_all();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+}
+
+bool ChangeStream::IsMatch(std::string_view pattern, std::string_view name) {
+  // Iterative glob match. The last '*' is the only backtrack point.
+  size_t pattern_index = 0;
+  size_t name_index = 0;
+  size_t star_index = std::string_view::npos;
+  size_t star_name = 0;
+  while (name_index < name.size()) {
+    if (pattern_index < pattern.size()
+        && (pattern[pattern_index] == '?' || pattern[pattern_index] == name[name_index])) {
+      ++pattern_index;
+      ++name_index;
+    } else if (pattern_index < pattern.size() && pattern[pattern_index] == '*') {
+      star_index = pattern_index++;
+      star_name = name_index;
+    } else if (star_index != std::string_view::npos) {
+      pattern_index = star_index + 1;
+      name_index = ++star_name;
+    } else {
+      return false;
+    }
+  }
+  while (pattern_index < pattern.size() && pattern[pattern_index] == '*') {
+    ++pattern_index;
+  }
+  return pattern_index == pattern.size();
+}
+
+bool ChangeStream::Subscription::IsSelected(const std::shared_ptr<Metric>& metric) {
+  const auto alias = metric->Alias();
+  if (alias != 0 && alias_list.contains(alias)) {
+    return true;
+  }
+  // The name match is cached per name, so pattern matching is done once
+  // per metric name.
+  auto name = metric->Name();
+  if (const auto itr = selected_list.find(name); itr != selected_list.cend()) {
+    return itr->second;
+  }
+  const bool selected = name_list.contains(name)
+      || std::any_of(pattern_list.cbegin(), pattern_list.cend(),
+                     [&] (const std::string& pattern) -> bool {
+    return IsMatch(pattern, name);
+  });
+  selected_list.emplace(std::move(name), selected);
+  return selected;
+}
+
+uint64_t ChangeStream::Subscribe(MetricSelection selection, uint64_t interval_ms,
+                                 OnUpdate on_update) {
+  if (!on_update) {
+    return 0;
+  }
+  auto subscription = std::make_shared<Subscription>();
+  for (auto& name : selection.name_list) {
+    if (IsPattern(name)) {
+      subscription->pattern_list.emplace_back(std::move(name));
+    } else {
+      subscription->name_list.emplace(std::move(name));
+    }
+  }
+  subscription->alias_list.insert(selection.alias_list.cbegin(), selection.alias_list.cend());
+  subscription->interval_ms = interval_ms;
+  subscription->on_update = std::move(on_update);
+
+  std::scoped_lock lock(stream_mutex_);
+  subscription->id = next_id_++;
+  subscription_list_.emplace(subscription->id, subscription);
+  subscriptions_ = subscription_list_.size();
+  if (!work_thread_.joinable()) {
+    stop_thread_ = false;
+    work_thread_ = std::thread(&ChangeStream::WorkTask, this);
+  }
+  return subscription->id;
+}
+
+void ChangeStream::Unsubscribe(uint64_t subscription_id) {
+  std::scoped_lock lock(stream_mutex_);
+  subscription_list_.erase(subscription_id);
+  subscriptions_ = subscription_list_.size();
+}
+
+void ChangeStream::Update(const std::vector<std::shared_ptr<Metric>>& metric_list) {
+  if (IsEmpty()) {
+    return;
+  }
+  bool notify = false;
+  {
+    std::scoped_lock lock(stream_mutex_);
+    for (auto& [id, subscription] : subscription_list_) {
+      for (const auto& metric : metric_list) {
+        if (!metric || !subscription->IsSelected(metric)) {
+          continue;
+        }
+        if (subscription->pending_set.insert(metric.get()).second) {
+          notify |= subscription->pending_list.empty();
+          subscription->pending_list.push_back(metric);
+        }
+      }
+    }
+  }
+  if (notify) {
+    stream_event_.notify_one();
+  }
+}
+
+void ChangeStream::WorkTask() {
+  std::unique_lock lock(stream_mutex_);
+  while (!stop_thread_) {
+    const auto now = SparkplugHelper::NowMs();
+    uint64_t next_wake = std::numeric_limits<uint64_t>::max();
+    std::shared_ptr<Subscription> due;
+    for (auto& [id, subscription] : subscription_list_) {
+      if (subscription->pending_list.empty()) {
+        continue;
+      }
+      if (subscription->next_delivery <= now) {
+        due = subscription;
+        break;
+      }
+      next_wake = std::min(next_wake, subscription->next_delivery);
+    }
+
+    if (due) {
+      // The pending list takes over the capacity of the last delivery.
+      due->delivery_list.swap(due->pending_list);
+      due->pending_set.clear();
+      due->next_delivery = now + due->interval_ms;
+      lock.unlock();
+      due->on_update(due->delivery_list);
+      due->delivery_list.clear();
+      lock.lock();
+      continue;
+    }
+
+    if (next_wake == std::numeric_limits<uint64_t>::max()) {
+      stream_event_.wait(lock);
+    } else {
+      stream_event_.wait_for(lock, std::chrono::milliseconds(next_wake - now));
+    }
+  }
+}
+
+} // pub_sub
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "inprocessbus.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::string_view kSharePrefix = "$share/";
+
+/** \brief Returns the filter part of a '$share/<group>/<filter>' subscription. */
+std::string_view ShareFilter(std::string_view filter) {
+  const auto group_end = filter.find('/', kSharePrefix.size());
+  return group_end == std::string_view::npos ? std::string_view() : filter.substr(group_end + 1);
+}
+
+bool IsShared(std::string_view filter) {
+  return filter.substr(0, kSharePrefix.size()) == kSharePrefix;
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+InProcessBus& InProcessBus::Instance() {
+  static InProcessBus instance;
+  return instance;
+}
+
+InProcessBus::InProcessBus() {
+  work_thread_ = std::thread(&InProcessBus::WorkTask, this);
+}
+
+InProcessBus::~InProcessBus() {
+  stop_thread_ = true;
+  bus_event_.notify_one();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+}
+
+InProcessBus::Connection* InProcessBus::GetConnection(const void* owner) {
+  auto itr = std::find_if(connection_list_.begin(), connection_list_.end(),
+                          [&] (const Connection& connection) -> bool {
+    return connection.owner == owner;
+  });
+  return itr == connection_list_.end() ? nullptr : &(*itr);
+}
+
+const InProcessBus::Connection* InProcessBus::GetConnection(const void* owner) const {
+  auto itr = std::find_if(connection_list_.cbegin(), connection_list_.cend(),
+                          [&] (const Connection& connection) -> bool {
+    return connection.owner == owner;
+  });
+  return itr == connection_list_.cend() ? nullptr : &(*itr);
+}
+
+void InProcessBus::Connect(const void* owner, BusCallback on_message,
+                           const std::string& will_topic, BusBuffer will_body,
+                           bool will_retained) {
+  if (owner == nullptr) {
+    return;
+  }
+  Disconnect(owner, false); // A new connection replaces the old
+
+  Connection connection;
+  connection.owner = owner;
+  connection.on_message = std::move(on_message);
+  connection.will_topic = will_topic;
+  connection.will_body = std::move(will_body);
+  connection.will_retained = will_retained;
+
+  std::scoped_lock lock(bus_mutex_);
+  connection_list_.emplace_back(std::move(connection));
+}
+
+void InProcessBus::Disconnect(const void* owner, bool send_will) {
+  {
+    std::unique_lock lock(bus_mutex_);
+    auto itr = std::find_if(connection_list_.begin(), connection_list_.end(),
+                            [&] (const Connection& connection) -> bool {
+      return connection.owner == owner;
+    });
+    if (itr == connection_list_.end()) {
+      return;
+    }
+    const Connection connection = std::move(*itr);
+    connection_list_.erase(itr);
+    std::erase_if(delivery_queue_, [&] (const Delivery& delivery) -> bool {
+      return delivery.owner == owner;
+    });
+
+    if (send_will && !connection.will_topic.empty()) {
+      PublishLocked(connection.will_topic, connection.will_body, connection.will_retained);
+    }
+
+    // Wait for any ongoing delivery, unless the disconnect is called by the
+    // receiving client itself.
+    if (std::this_thread::get_id() != work_thread_.get_id()) {
+      delivered_event_.wait(lock, [&] () -> bool {
+        return active_owner_ != owner;
+      });
+    }
+  }
+  bus_event_.notify_one();
+}
+
+bool InProcessBus::IsConnected(const void* owner) const {
+  std::scoped_lock lock(bus_mutex_);
+  return GetConnection(owner) != nullptr;
+}
+
+bool InProcessBus::Subscribe(const void* owner, const std::string& filter) {
+  if (filter.empty()) {
+    return false;
+  }
+  {
+    std::scoped_lock lock(bus_mutex_);
+    auto* connection = GetConnection(owner);
+    if (connection == nullptr) {
+      return false;
+    }
+    auto& filter_list = connection->filter_list;
+    if (std::find(filter_list.cbegin(), filter_list.cend(), filter) != filter_list.cend()) {
+      return true;
+    }
+    filter_list.emplace_back(filter);
+
+    // Send any retained messages. Note that shared subscriptions doesn't
+    // receive retained messages.
+    if (!IsShared(filter)) {
+      for (const auto& [topic_name, body] : retained_list_) {
+        if (IsMatch(filter, topic_name)) {
+          delivery_queue_.push_back({owner, topic_name, body, true});
+        }
+      }
+    }
+  }
+  bus_event_.notify_one();
+  return true;
+}
+
+void InProcessBus::Unsubscribe(const void* owner, const std::string& filter) {
+  std::scoped_lock lock(bus_mutex_);
+  auto* connection = GetConnection(owner);
+  if (connection != nullptr) {
+    std::erase(connection->filter_list, filter);
+  }
+}
+
+bool InProcessBus::Publish(const std::string& topic_name, const BusBuffer& body,
+                           bool retained) {
+  if (topic_name.empty() || topic_name.find_first_of("+#") != std::string::npos) {
+    return false;
+  }
+  {
+    std::scoped_lock lock(bus_mutex_);
+    PublishLocked(topic_name, body, retained);
+  }
+  bus_event_.notify_one();
+  return true;
+}
+
+void InProcessBus::PublishLocked(const std::string& topic_name, const BusBuffer& body,
+                                 bool retained) {
+  if (retained) {
+    if (body && !body->empty()) {
+      retained_list_[topic_name] = body;
+    } else {
+      retained_list_.erase(topic_name);
+    }
+  }
+
+  // A shared subscription delivers the message to one of the subscribers.
+  std::map<std::string, std::vector<const void*>> share_list;
+  for (const auto& connection : connection_list_) {
+    bool deliver = false;
+    for (const auto& filter : connection.filter_list) {
+      if (IsShared(filter)) {
+        if (IsMatch(ShareFilter(filter), topic_name)) {
+          share_list[filter].push_back(connection.owner);
+        }
+      } else if (!deliver && IsMatch(filter, topic_name)) {
+        deliver = true;
+      }
+    }
+    if (deliver) {
+      delivery_queue_.push_back({connection.owner, topic_name, body, false});
+    }
+  }
+
+  for (const auto& [filter, owner_list] : share_list) {
+    auto& counter = share_counter_list_[filter];
+    delivery_queue_.push_back({owner_list[counter++ % owner_list.size()],
+                               topic_name, body, false});
+  }
+}
+
+size_t InProcessBus::QueueDepth(const void* owner) const {
+  std::scoped_lock lock(bus_mutex_);
+  return static_cast<size_t>(std::count_if(delivery_queue_.cbegin(), delivery_queue_.cend(),
+                                           [&] (const Delivery& delivery) -> bool {
+    return delivery.owner == owner;
+  }));
+}
+
+bool InProcessBus::IsMatch(std::string_view filter, std::string_view topic_name) {
+  if (filter.empty() || topic_name.empty()) {
+    return false;
+  }
+  if (topic_name.front() == '$' && (filter.front() == '+' || filter.front() == '#')) {
+    return false;
+  }
+  while (true) {
+    const auto filter_end = filter.find('/');
+    const auto filter_level = filter.substr(0, filter_end);
+    if (filter_level == "#") {
+      return true;
+    }
+    const auto topic_end = topic_name.find('/');
+    const auto topic_level = topic_name.substr(0, topic_end);
+    if (filter_level != "+" && filter_level != topic_level) {
+      return false;
+    }
+    if (filter_end == std::string_view::npos || topic_end == std::string_view::npos) {
+      if (filter_end == std::string_view::npos && topic_end == std::string_view::npos) {
+        return true;
+      }
+      // The 'a/#' filter also matches the parent 'a' topic.
+      return topic_end == std::string_view::npos && filter.substr(filter_end + 1) == "#";
+    }
+    filter.remove_prefix(filter_end + 1);
+    topic_name.remove_prefix(topic_end + 1);
+  }
+}
+
+void InProcessBus::WorkTask() {
+  std::unique_lock lock(bus_mutex_);
+  while (!stop_thread_) {
+    bus_event_.wait_for(lock, 100ms, [&] () -> bool {
+      return stop_thread_ || !delivery_queue_.empty();
+    });
+    while (!stop_thread_ && !delivery_queue_.empty()) {
+      Delivery delivery = std::move(delivery_queue_.front());
+      delivery_queue_.pop_front();
+      const auto* connection = GetConnection(delivery.owner);
+      if (connection == nullptr || !connection->on_message) {
+        continue;
+      }
+      // The callback is called without the lock, so it may publish
+      // or subscribe. The disconnect waits for the active owner.
+      BusCallback on_message = connection->on_message;
+      active_owner_ = delivery.owner;
+      lock.unlock();
+      on_message(delivery.topic, delivery.body, delivery.retained);
+      lock.lock();
+      active_owner_ = nullptr;
+      delivered_event_.notify_all();
+    }
+  }
+}
+
+} // pub_sub
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief In-process message bus that replaces the MQTT broker.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace pub_sub {
+
+/** \brief Immutable message body that is shared by all receivers. */
+using BusBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+/** \brief Callback that receives a message (topic name, body, retained). */
+using BusCallback = std::function<void(const std::string&, const BusBuffer&, bool)>;
+
+/** \brief Message bus for clients in the same process.
+ *
+ * The bus is used by clients with the in-process transport layer. It has the
+ * same semantics as an MQTT broker regarding wildcard subscriptions,
+ * shared subscriptions ('$share/'), retained messages and will messages,
+ * but the messages are never copied or sent over a network. A published
+ * body is shared by all receivers.
+ *
+ * The messages are delivered in order by a single worker thread, in the
+ * same way as the MQTT library delivers messages on its callback thread.
+ */
+class InProcessBus final {
+ public:
+  static InProcessBus& Instance();
+
+  InProcessBus(const InProcessBus&) = delete;
+  InProcessBus& operator=(const InProcessBus&) = delete;
+
+  /** \brief Connects a client to the bus.
+   *
+   * @param owner Unique client identity, typically the client object.
+   * @param on_message Callback for received messages.
+   * @param will_topic Will topic. It's sent if the client is lost.
+   * @param will_body Will message.
+   * @param will_retained True if the will message is retained.
+   */
+  void Connect(const void* owner, BusCallback on_message,
+               const std::string& will_topic = {}, BusBuffer will_body = {},
+               bool will_retained = false);
+
+  /** \brief Disconnects a client.
+   *
+   * The function waits until any ongoing delivery to the client is done,
+   * so the client may be deleted after the call.
+   * @param owner Client identity.
+   * @param send_will True if the will message should be sent (connection lost).
+   */
+  void Disconnect(const void* owner, bool send_will);
+  [[nodiscard]] bool IsConnected(const void* owner) const;
+
+  bool Subscribe(const void* owner, const std::string& filter);
+  void Unsubscribe(const void* owner, const std::string& filter);
+
+  /** \brief Publishes a message to all matching subscriptions.
+   *
+   * @param topic_name Topic name. Wildcards are not allowed.
+   * @param body Message body.
+   * @param retained True if the message should be retained. An empty
+   * retained message deletes the retained message.
+   * @return True if the message was accepted.
+   */
+  bool Publish(const std::string& topic_name, const BusBuffer& body, bool retained);
+
+  /** \brief Number of messages waiting for delivery to a client. */
+  [[nodiscard]] size_t QueueDepth(const void* owner) const;
+
+  /** \brief Returns true if a topic name matches an MQTT topic filter.
+   *
+   * The filter may include the '+' and '#' wildcards. Note that topics
+   * starting with '$' don't match filters starting with a wildcard.
+   * @param filter Topic filter without any '$share/' prefix.
+   * @param topic_name Topic name.
+   * @return True if the topic matches the filter.
+   */
+  [[nodiscard]] static bool IsMatch(std::string_view filter, std::string_view topic_name);
+
+ private:
+  struct Connection {
+    const void* owner = nullptr;
+    BusCallback on_message;
+    std::vector<std::string> filter_list;
+    std::string will_topic;
+    BusBuffer will_body;
+    bool will_retained = false;
+  };
+
+  struct Delivery {
+    const void* owner = nullptr;
+    std::string topic;
+    BusBuffer body;
+    bool retained = false;
+  };
+
+  mutable std::mutex bus_mutex_;
+  std::vector<Connection> connection_list_;
+  std::map<std::string, BusBuffer> retained_list_;
+  std::map<std::string, size_t> share_counter_list_; ///< Round-robin counters per share group
+  std::deque<Delivery> delivery_queue_;
+  const void* active_owner_ = nullptr; ///< Client that is receiving a message.
+
+  std::atomic<bool> stop_thread_ = false;
+  std::condition_variable bus_event_;
+  std::condition_variable delivered_event_;
+  std::thread work_thread_;
+
+  InProcessBus();
+  ~InProcessBus();
+
+  void WorkTask();
+  void PublishLocked(const std::string& topic_name, const BusBuffer& body, bool retained);
+  [[nodiscard]] Connection* GetConnection(const void* owner);
+  [[nodiscard]] const Connection* GetConnection(const void* owner) const;
+};
+
+} // pub_sub
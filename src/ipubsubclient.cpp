@@ -6,7 +6,9 @@
 #include "pubsub/ipubsubclient.h"
 
 #include <algorithm>
+#include <charconv>
 #include <filesystem>
+#include <sstream>
 
 #include <util/ihwinfo.h>
 #include <util/ixmlfile.h>
@@ -35,6 +37,9 @@ std::string_view TransportToString(TransportLayer transport) {
     case TransportLayer::MqttWebSocketTls:
       return "MqttWebSocketTls";
 
+    case TransportLayer::InProcess:
+      return "InProcess";
+
     case TransportLayer::MqttTcp:
     default:
       break;
@@ -52,6 +57,9 @@ TransportLayer TransportFromString(const std::string& transport) {
   if ( IEquals(transport, "MqttWebSocketTls") ) {
     return TransportLayer::MqttWebSocketTls;
   }
+  if ( IEquals(transport, "InProcess") ) {
+    return TransportLayer::InProcess;
+  }
   return TransportLayer::MqttTcp;
 }
 
@@ -79,6 +87,43 @@ ProtocolVersion VersionFromString(const std::string& version)  {
   return ProtocolVersion::Mqtt311;
 }
 
+/** \brief Formats the standby brokers as 'broker:port;broker:port'. */
+std::string StandbyToString(const std::vector<BrokerAddress>& standby_list) {
+  std::ostringstream text;
+  for (const auto& address : standby_list) {
+    if (text.tellp() > 0) {
+      text << ";";
+    }
+    text << address.broker << ":" << address.port;
+  }
+  return text.str();
+}
+
+std::vector<BrokerAddress> StandbyFromString(const std::string& text) {
+  std::vector<BrokerAddress> standby_list;
+  size_t start = 0;
+  while (start < text.size()) {
+    auto end = text.find(';', start);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string_view item(text.data() + start, end - start);
+    start = end + 1;
+
+    BrokerAddress address;
+    const auto colon = item.rfind(':');
+    address.broker = std::string(item.substr(0, colon));
+    if (colon != std::string_view::npos) {
+      const auto port = item.substr(colon + 1);
+      std::from_chars(port.data(), port.data() + port.size(), address.port);
+    }
+    if (!address.broker.empty()) {
+      standby_list.push_back(address);
+    }
+  }
+  return standby_list;
+}
+
 }
 
 namespace pub_sub {
@@ -91,41 +136,96 @@ IPubSubClient::IPubSubClient()
 
 }
 
-ITopic *IPubSubClient::GetTopic(const std::string &topic_name) {
-  std::scoped_lock list_lock(topic_mutex_);
+void IPubSubClient::AddStandbyBroker(const std::string& address, uint16_t port) {
+  standby_list_.push_back({address, port});
+}
 
-  auto itr = std::ranges::find_if(topic_list_,[&] (const auto& topic) {
-    return topic && topic_name == topic->Topic();
-  });
-  return itr == topic_list_.end() ? nullptr : itr->get();
+ITopic *IPubSubClient::GetTopic(const std::string &topic_name) {
+  return topic_index_.Find(topic_name);
 }
 
 ITopic *IPubSubClient::GetITopic(const std::string &topic_name) {
-  std::scoped_lock list_lock(topic_mutex_);
-  auto itr = std::ranges::find_if(topic_list_,[&] (const auto& topic) {
-    return topic && IEquals(topic_name,topic->Topic());
-  });
-  return itr == topic_list_.end() ? nullptr : itr->get();
+  return topic_index_.IFind(topic_name);
 }
 
 ITopic *IPubSubClient::GetTopicByMessageType(const std::string &message_type) {
-  std::scoped_lock list_lock(topic_mutex_);
-  auto itr = std::ranges::find_if(topic_list_,[&] (const auto& topic) {
-    return topic && IEquals(message_type,topic->MessageType());
-  });
-  return itr == topic_list_.end() ? nullptr : itr->get();
-
+  return topic_index_.FindByMessageType(message_type);
 }
+
 void IPubSubClient::DeleteTopic(const std::string &topic_name) {
   std::scoped_lock list_lock(topic_mutex_);
-  auto itr = std::ranges::find_if(topic_list_,[&] (const auto& topic) {
-    return topic && IEquals(topic_name,topic->Topic());
+  auto* topic = topic_index_.IFind(topic_name);
+  if (topic == nullptr) {
+    return;
+  }
+  topic_index_.Remove(*topic);
+  auto itr = std::ranges::find_if(topic_list_,[&] (const auto& item) {
+    return item.get() == topic;
   });
   if (itr != topic_list_.end()) {
     topic_list_.erase(itr);
   }
 }
 
+ITopic *IPubSubClient::AddTopic(std::unique_ptr<ITopic> topic) {
+  if (!topic) {
+    return nullptr;
+  }
+  std::scoped_lock list_lock(topic_mutex_);
+  auto* new_topic = topic_list_.emplace_back(std::move(topic)).get();
+  topic_index_.Add(*new_topic);
+  return new_topic;
+}
+
+void IPubSubClient::ClearTopics() {
+  std::scoped_lock list_lock(topic_mutex_);
+  topic_index_.Clear();
+  topic_list_.clear();
+}
+
+uint64_t IPubSubClient::SubscribeMetrics(MetricSelection selection, uint64_t interval_ms,
+                                         ChangeStream::OnUpdate on_update) {
+  return change_stream_.Subscribe(std::move(selection), interval_ms, std::move(on_update));
+}
+
+void IPubSubClient::UnsubscribeMetrics(uint64_t subscription_id) {
+  change_stream_.Unsubscribe(subscription_id);
+}
+
+bool IPubSubClient::HasChangeListeners() const {
+  return change_notifier_.IsActive() || !change_stream_.IsEmpty() || recorder_.IsActive();
+}
+
+void IPubSubClient::NotifyChanges(ITopic& topic) {
+  if (!HasChangeListeners()) {
+    return;
+  }
+  NotifyChanges(topic, topic.GetPayload().ParsedMetrics());
+}
+
+void IPubSubClient::NotifyChanges(ITopic& topic,
+                                  const std::vector<std::shared_ptr<Metric>>& metric_list) {
+  if (!HasChangeListeners()) {
+    return;
+  }
+  // The parser hands over the metrics it updated. The updated flags are left
+  // as is, as they belong to the publisher side.
+  ChangeSet change_set;
+  change_set.timestamp = topic.GetPayload().Timestamp();
+  change_set.metric_list = metric_list;
+  if (change_set.metric_list.empty()) {
+    return;
+  }
+  if (recorder_.IsActive()) {
+    recorder_.Record(topic.GroupId(), topic.NodeId(), topic.DeviceId(), change_set.metric_list);
+  }
+  change_stream_.Update(change_set.metric_list);
+  if (change_notifier_.IsActive()) {
+    change_set.topic_name = topic.Topic();
+    change_notifier_.Notify(std::move(change_set));
+  }
+}
+
 void IPubSubClient::AddSubscription(std::string topic_name) {
   const bool exist = std::any_of(subscription_list_.cbegin(), subscription_list_.cend(),
                                  [&] (const std::string& topic)->bool {
@@ -168,6 +268,54 @@ int64_t IPubSubClient::ScanRate() const {
   return scan_rate_;
 }
 
+uint64_t IPubSubClient::DroppedTraces() const {
+  return 0;
+}
+
+size_t IPubSubClient::QueueDepth() const {
+  return 0;
+}
+
+std::vector<std::shared_ptr<Metric>> IPubSubClient::AddMetrics(
+    std::span<const MetricDescriptor> descriptor_list) {
+  std::vector<std::shared_ptr<Metric>> metric_list;
+  metric_list.reserve(descriptor_list.size());
+  for (const auto& descriptor : descriptor_list) {
+    auto metric = std::make_shared<Metric>(descriptor.name);
+    metric->Type(descriptor.type);
+    if (!descriptor.unit.empty()) {
+      metric->Unit(descriptor.unit);
+    }
+    metric->IsReadWrite(descriptor.read_only);
+    metric->Alias(descriptor.alias);
+    for (const auto& property : descriptor.property_list) {
+      metric->AddProperty(property);
+    }
+    AddMetric(metric);
+    metric_list.push_back(std::move(metric));
+  }
+  return metric_list;
+}
+
+void IPubSubClient::InjectMessage(const std::string&, const void*, size_t, bool) {
+}
+
+const IPubSubClient* IPubSubClient::GetRemoteNode(const std::string&,
+                                                  const std::string&) const {
+  return nullptr;
+}
+
+size_t IPubSubClient::MemoryUsage() const {
+  std::scoped_lock list_lock(topic_mutex_);
+  size_t bytes = 0;
+  for (const auto& topic : topic_list_) {
+    if (topic) {
+      bytes += topic->MemoryUsage();
+    }
+  }
+  return bytes;
+}
+
 IPubSubClient *IPubSubClient::CreateDevice(const std::string &) {
   return nullptr;
 }
@@ -211,12 +359,33 @@ void IPubSubClient::PublishTopics() {
   }
 }
 
+uint16_t IPubSubClient::NextTopicAlias() {
+  const uint16_t max_alias = topic_alias_max_;
+  uint16_t alias = last_topic_alias_;
+  do {
+    if (alias >= max_alias) {
+      return 0; // All aliases are in use. Send the full topic name instead.
+    }
+  } while (!last_topic_alias_.compare_exchange_weak(alias, alias + 1));
+  return alias + 1;
+}
+
+void IPubSubClient::ResetTopicAliases(uint16_t alias_maximum) {
+  topic_alias_max_ = alias_maximum;
+  last_topic_alias_ = 0;
+  ++topic_alias_session_;
+}
+
 void IPubSubClient::WriteGeneralXml(IXmlNode &general) const {
   general.SetProperty("Name", name_);
   general.SetProperty("GroupId", group_);
   general.SetProperty("Transport", TransportToString(transport_));
   general.SetProperty("Broker", broker_);
   general.SetProperty("Port", port_);
+  general.SetProperty("StandbyBrokers", StandbyToString(standby_list_));
+  general.SetProperty("HotStandby", hot_standby_);
+  general.SetProperty("ReconnectDelayMin", reconnect_delay_min_);
+  general.SetProperty("ReconnectDelayMax", reconnect_delay_max_);
   general.SetProperty("ProtocolVersion", VersionToString(version_));
   general.SetProperty("HardwareMake", hardware_make_);
   general.SetProperty("HardwareModel", hardware_model_);
@@ -224,6 +393,9 @@ void IPubSubClient::WriteGeneralXml(IXmlNode &general) const {
   general.SetProperty("OsVersion", os_version_);
   general.SetProperty("ScanRate", scan_rate_);
   general.SetProperty("WaitOnHostOnline", wait_on_host_online_);
+  general.SetProperty("ShareName", share_name_);
+  general.SetProperty("AliasFile", alias_file_);
+  general.SetProperty("LocalEndpoint", local_endpoint_);
   general.SetProperty("Username", username_);
   general.SetProperty("Password", password_);
 }
@@ -245,6 +417,18 @@ void IPubSubClient::ReadGeneralXml(const IXmlNode &general) {
   if (general.ExistProperty("Port")) {
     Port(general.Property<uint16_t>("Port"));
   }
+  if (general.ExistProperty("StandbyBrokers")) {
+    standby_list_ = StandbyFromString(general.Property<std::string>("StandbyBrokers"));
+  }
+  if (general.ExistProperty("HotStandby")) {
+    HotStandby(general.Property<bool>("HotStandby"));
+  }
+  if (general.ExistProperty("ReconnectDelayMin")) {
+    reconnect_delay_min_ = general.Property<uint64_t>("ReconnectDelayMin");
+  }
+  if (general.ExistProperty("ReconnectDelayMax")) {
+    reconnect_delay_max_ = general.Property<uint64_t>("ReconnectDelayMax");
+  }
   if (general.ExistProperty("ProtocolVersion")) {
     const auto version = general.Property<std::string>("ProtocolVersion");
     Version(VersionFromString(version));
@@ -267,6 +451,15 @@ void IPubSubClient::ReadGeneralXml(const IXmlNode &general) {
   if (general.ExistProperty("WaitOnHostOnline")) {
     WaitOnHostOnline(general.Property<bool>("WaitOnHostOnline"));
   }
+  if (general.ExistProperty("ShareName")) {
+    ShareName(general.Property<std::string>("ShareName"));
+  }
+  if (general.ExistProperty("AliasFile")) {
+    AliasFile(general.Property<std::string>("AliasFile"));
+  }
+  if (general.ExistProperty("LocalEndpoint")) {
+    LocalEndpoint(general.Property<std::string>("LocalEndpoint"));
+  }
   if (general.ExistProperty("Username")) {
     username_ = general.Property<std::string>("Username");
   }
@@ -6,13 +6,20 @@
 #include "util/stringutil.h"
 #include "util/timestamp.h"
 #include "pubsub/itopic.h"
+#include "pubsub/ipubsubclient.h"
+#include "pubsub/topicindex.h"
+#include "sparkplughelper.h"
 namespace {
 constexpr std::string_view kSparkplugNamespace = "spBv1.0";
 }
 namespace pub_sub {
 
 void ITopic::Topic(const std::string &topic) {
+  TopicIndex::RenameGuard rename(*this);
   topic_ = topic;
+  topic_alias_ = 0; // A new topic name needs a new alias
+  topic_alias_sent_ = false;
+  topic_alias_pending_ = false;
 
   size_t level = 0;
   std::ostringstream temp;
@@ -38,6 +45,11 @@ void ITopic::Topic(const std::string &topic) {
   }
 }
 
+void ITopic::MessageType(const std::string& message_type) {
+  TopicIndex::RenameGuard rename(*this);
+  message_type_ = message_type;
+}
+
 const std::string &ITopic::Topic() const {
   if (topic_.empty()) {
 
@@ -133,6 +145,17 @@ std::shared_ptr<Metric> ITopic::GetMetric(const std::string &name) const {
   return payload_.GetMetric(name);
 }
 
+DeliveryFuture ITopic::PublishAsync() {
+  auto delivery = std::make_shared<DeliveryPromise>();
+  DeliveryFuture future = delivery->get_future().share();
+  DoPublish(std::move(delivery));
+  return future;
+}
+
+bool ITopic::SendBody(std::vector<uint8_t>&, int&) {
+  return false;
+}
+
 void ITopic::SetAllMetricsInvalid() {
   auto& payload = GetPayload();
   std::scoped_lock lock(topic_mutex_);
@@ -143,4 +166,52 @@ void ITopic::SetAllMetricsInvalid() {
   }
 }
 
+size_t ITopic::MemoryUsage() const {
+  size_t bytes = 0;
+  {
+    std::scoped_lock lock(topic_mutex_);
+    bytes += sizeof(*this) - sizeof(Payload);
+    bytes += SparkplugHelper::StringHeapSize(content_type_);
+    bytes += SparkplugHelper::StringHeapSize(topic_);
+    bytes += SparkplugHelper::StringHeapSize(name_space_);
+    bytes += SparkplugHelper::StringHeapSize(group_id_);
+    bytes += SparkplugHelper::StringHeapSize(message_type_);
+    bytes += SparkplugHelper::StringHeapSize(node_id_);
+    bytes += SparkplugHelper::StringHeapSize(device_id_);
+  }
+  bytes += statistics_.ProcessTime().HeapSize();
+  bytes += payload_.MemoryUsage();
+  return bytes;
+}
+
+uint16_t ITopic::GetTopicAlias(IPubSubClient &client, bool &send_name) {
+  send_name = true;
+  if (client.Version() != ProtocolVersion::Mqtt5 || qos_ != QualityOfService::Qos0) {
+    return 0;
+  }
+
+  const auto session = client.TopicAliasSession();
+  if (topic_alias_ == 0 || topic_alias_session_ != session) {
+    topic_alias_sent_ = false;
+    topic_alias_pending_ = false;
+    topic_alias_session_ = session;
+    topic_alias_ = client.NextTopicAlias();
+  }
+  const uint16_t alias = topic_alias_;
+  if (alias == 0) {
+    return 0;
+  }
+  send_name = !topic_alias_sent_;
+  if (send_name) {
+    topic_alias_pending_ = true;
+  }
+  return alias;
+}
+
+void ITopic::ConfirmTopicAlias() {
+  if (topic_alias_pending_.exchange(false)) {
+    topic_alias_sent_ = true;
+  }
+}
+
 } // end namespace util::mqtt
\ No newline at end of file
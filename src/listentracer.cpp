@@ -0,0 +1,192 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "listentracer.h"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+#include "payloadhelper.h"
+#include "sparkplughelper.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::string_view kStateLevel = "/STATE/";
+
+}
+
+namespace pub_sub {
+
+ListenTracer::ListenTracer(util::log::IListen* listen)
+: listen_(listen) {
+  for (size_t index = 0; index < ring_.size(); ++index) {
+    ring_[index].sequence = index;
+  }
+}
+
+ListenTracer::~ListenTracer() {
+  Stop();
+}
+
+void ListenTracer::SampleRate(uint32_t sample_rate) {
+  sample_rate_ = sample_rate > 0 ? sample_rate : 1;
+}
+
+void ListenTracer::Start() {
+  if (work_thread_.joinable()) {
+    return;
+  }
+  stop_thread_ = false;
+  work_thread_ = std::thread(&ListenTracer::TraceTask, this);
+}
+
+void ListenTracer::Stop() {
+  stop_thread_ = true;
+  {
+    std::scoped_lock lock(trace_mutex_);
+  }
+  trace_event_.notify_one();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+}
+
+bool ListenTracer::IsSampled(std::string_view topic_name) {
+  const uint32_t sample_rate = sample_rate_;
+  if (sample_rate <= 1) {
+    return true;
+  }
+  // Topics that share a counter slot share the sample rate. This is
+  // acceptable as the sampling is only used to reduce the trace load.
+  const size_t slot = std::hash<std::string_view>{}(topic_name) % kSampleSlots;
+  return sample_counters_[slot].fetch_add(1, std::memory_order_relaxed) % sample_rate == 0;
+}
+
+void ListenTracer::Trace(bool outbound, std::string_view topic_name,
+                         const void* payload, size_t payload_size) {
+  if (stop_thread_ || !IsSampled(topic_name)) {
+    return;
+  }
+
+  // Reserve a slot in the ring buffer.
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  TraceEntry* entry = nullptr;
+  while (entry == nullptr) {
+    auto& slot = ring_[pos & (kRingSize - 1)];
+    const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        entry = &slot;
+      }
+    } else if (sequence < pos) {
+      ++dropped_traces_; // The ring buffer is full
+      return;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // The slot buffers keep their capacity, so normally no memory is allocated.
+  entry->timestamp = SparkplugHelper::NowMs();
+  entry->outbound = outbound;
+  entry->topic.assign(topic_name);
+  const auto* data = static_cast<const uint8_t*>(payload);
+  if (data != nullptr) {
+    entry->body.assign(data, data + payload_size);
+  } else {
+    entry->body.clear();
+  }
+  entry->sequence.store(pos + 1, std::memory_order_release);
+
+  // Wake up the worker thread if it has handled all earlier traces. The
+  // fence pairs with the fence in IsEmpty(), so either the worker finds
+  // this trace or this thread finds the worker waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (dequeue_pos_.load(std::memory_order_relaxed) == pos) {
+    {
+      std::scoped_lock lock(trace_mutex_);
+    }
+    trace_event_.notify_one();
+  }
+}
+
+bool ListenTracer::IsEmpty() const {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  const auto& slot = ring_[pos & (kRingSize - 1)];
+  return slot.sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+bool ListenTracer::Pop(TraceEntry& entry) {
+  const size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  auto& slot = ring_[pos & (kRingSize - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+    return false; // Empty
+  }
+  // Swap the buffers so the slot can be released before formatting.
+  entry.timestamp = slot.timestamp;
+  entry.outbound = slot.outbound;
+  std::swap(entry.topic, slot.topic);
+  std::swap(entry.body, slot.body);
+  slot.sequence.store(pos + kRingSize, std::memory_order_release);
+  dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+  return true;
+}
+
+void ListenTracer::TraceTask() {
+  TraceEntry entry;
+  while (!stop_thread_) {
+    while (Pop(entry)) {
+      FormatTrace(entry);
+    }
+
+    const uint64_t dropped = dropped_traces_;
+    if (dropped != reported_drops_ && listen_ != nullptr && listen_->IsActive()) {
+      listen_->ListenText("Dropped Traces: %llu",
+                          static_cast<unsigned long long>(dropped - reported_drops_));
+      reported_drops_ = dropped;
+    }
+
+    std::unique_lock lock(trace_mutex_);
+    trace_event_.wait_for(lock, 100ms, [&] () -> bool {
+      return stop_thread_ || !IsEmpty();
+    });
+  }
+  // Empty the ring buffer
+  while (Pop(entry)) {
+    FormatTrace(entry);
+  }
+}
+
+void ListenTracer::FormatTrace(TraceEntry& entry) {
+  ++handled_traces_;
+  if (listen_ == nullptr || !listen_->IsActive()) {
+    return;
+  }
+  const char* direction = entry.outbound ? "Publish" : "Message";
+  Payload payload;
+  std::swap(payload.Body(), entry.body);
+  try {
+    if (entry.topic.find(kStateLevel) != std::string::npos) {
+      // Payload is JSON
+      listen_->ListenText("%s Topic: %s\n%s", direction, entry.topic.c_str(),
+                          payload.BodyToString().c_str());
+    } else {
+      // Payload is protobuf
+      PayloadHelper helper(payload);
+      listen_->ListenText("%s Topic: %s\n%s", direction, entry.topic.c_str(),
+                          helper.DebugProtobuf().c_str());
+    }
+  } catch (const std::exception& err) {
+    listen_->ListenText("%s Topic: %s Parse Error: %s", direction,
+                        entry.topic.c_str(), err.what());
+  }
+  std::swap(payload.Body(), entry.body); // Keep the buffer capacity
+}
+
+} // pub_sub
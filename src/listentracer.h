@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Asynchronous trace of MQTT messages to a listen window.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <util/ilisten.h>
+
+namespace pub_sub {
+
+/** \brief Traces MQTT messages on a background thread.
+ *
+ * The tracer copies the topic name and the raw payload bytes into a
+ * fixed-size ring buffer. A background thread formats the messages and
+ * sends them to the listen object. This means that the formatting, i.e.
+ * the protobuf parsing, is done outside the MQTT callback and publisher
+ * threads.
+ *
+ * The ring buffer is lock-free. If it is full, the trace is dropped and the
+ * dropped counter is stepped. The sample rate defines that only every n-th
+ * message per topic is traced. The thread is woken up when a trace is added
+ * to an empty ring buffer.
+ */
+class ListenTracer final {
+ public:
+  ListenTracer() = delete;
+  explicit ListenTracer(util::log::IListen* listen);
+  ~ListenTracer();
+
+  void SampleRate(uint32_t sample_rate);
+  [[nodiscard]] uint32_t SampleRate() const { return sample_rate_; }
+
+  [[nodiscard]] uint64_t DroppedTraces() const { return dropped_traces_; }
+  [[nodiscard]] uint64_t HandledTraces() const { return handled_traces_; }
+
+  void Start();
+  void Stop();
+
+  /** \brief Adds a message to the trace ring buffer.
+   *
+   * @param outbound True if the message is published, false if received.
+   * @param topic_name Topic name.
+   * @param payload Pointer to the payload bytes.
+   * @param payload_size Number of payload bytes.
+   */
+  void Trace(bool outbound, std::string_view topic_name,
+             const void* payload, size_t payload_size);
+
+ private:
+  struct TraceEntry {
+    std::atomic<size_t> sequence = 0;
+    uint64_t timestamp = 0; ///< Time in ms since 1970.
+    bool outbound = false;
+    std::string topic;
+    std::vector<uint8_t> body;
+  };
+
+  static constexpr size_t kRingSize = 256; ///< Must be a power of 2.
+  static constexpr size_t kSampleSlots = 256; ///< Number of sample counters.
+
+  util::log::IListen* listen_ = nullptr;
+  std::array<TraceEntry, kRingSize> ring_;
+  std::atomic<size_t> enqueue_pos_ = 0;
+  std::atomic<size_t> dequeue_pos_ = 0;
+
+  std::atomic<uint32_t> sample_rate_ = 1; ///< Trace every n-th message per topic.
+  std::array<std::atomic<uint32_t>, kSampleSlots> sample_counters_ = {};
+
+  std::atomic<uint64_t> dropped_traces_ = 0;
+  std::atomic<uint64_t> handled_traces_ = 0;
+  uint64_t reported_drops_ = 0; ///< Only used by the worker thread.
+
+  std::atomic<bool> stop_thread_ = true;
+  std::thread work_thread_;
+  std::condition_variable trace_event_;
+  std::mutex trace_mutex_;
+
+  bool IsSampled(std::string_view topic_name);
+  bool IsEmpty() const;
+  bool Pop(TraceEntry& entry);
+  void TraceTask();
+  void FormatTrace(TraceEntry& entry);
+};
+
+} // pub_sub
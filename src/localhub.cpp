@@ -0,0 +1,316 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "localhub.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "util/logstream.h"
+
+using namespace util::log;
+
+namespace {
+
+constexpr int kPollTimeout = 100; ///< Poll timeout in ms
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+void WriteUint32(std::vector<uint8_t>& dest, uint32_t value) {
+  dest.push_back(static_cast<uint8_t>(value >> 24));
+  dest.push_back(static_cast<uint8_t>(value >> 16));
+  dest.push_back(static_cast<uint8_t>(value >> 8));
+  dest.push_back(static_cast<uint8_t>(value));
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+LocalHub::~LocalHub() {
+  Stop();
+}
+
+LocalHub::FramePtr LocalHub::MakeFrame(const std::string& topic_name, const BusBuffer& body) {
+  auto frame = std::make_shared<Frame>();
+  const auto body_size = body ? body->size() : 0;
+  frame->header.reserve(8 + topic_name.size());
+  WriteUint32(frame->header, static_cast<uint32_t>(topic_name.size()));
+  WriteUint32(frame->header, static_cast<uint32_t>(body_size));
+  frame->header.insert(frame->header.end(), topic_name.cbegin(), topic_name.cend());
+  frame->body = body;
+  return frame;
+}
+
+void LocalHub::Publish(const std::string& topic_name, const BusBuffer& body, bool retained) {
+  if (!IsStarted()) {
+    return;
+  }
+  const auto frame = MakeFrame(topic_name, body);
+  {
+    std::scoped_lock lock(hub_mutex_);
+    if (retained) {
+      if (body && !body->empty()) {
+        retained_list_[topic_name] = frame;
+      } else {
+        retained_list_.erase(topic_name);
+      }
+    }
+    for (auto& consumer : consumer_list_) {
+      if (consumer.queue.size() >= kMaxQueueSize) {
+        ++dropped_messages_;
+        continue;
+      }
+      consumer.queue.push_back(frame);
+    }
+  }
+  WakeUp();
+}
+
+void LocalHub::ClearRetained() {
+  std::scoped_lock lock(hub_mutex_);
+  retained_list_.clear();
+}
+
+void LocalHub::ClearRetained(const std::string& topic_name) {
+  std::scoped_lock lock(hub_mutex_);
+  retained_list_.erase(topic_name);
+}
+
+size_t LocalHub::Consumers() const {
+  std::scoped_lock lock(hub_mutex_);
+  return consumer_list_.size();
+}
+
+#ifndef _WIN32
+
+bool LocalHub::Start(const std::string& endpoint) {
+  Stop();
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR() << "Invalid local hub endpoint. Endpoint: " << endpoint;
+    return false;
+  }
+  std::strncpy(address.sun_path, endpoint.c_str(), sizeof(address.sun_path) - 1);
+  ::unlink(endpoint.c_str()); // Remove any old socket file
+
+  listen_socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_socket_ < 0) {
+    LOG_ERROR() << "Failed to create the local hub socket. Error: " << std::strerror(errno);
+    return false;
+  }
+  if (::bind(listen_socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+      || ::listen(listen_socket_, 16) != 0
+      || ::pipe(wake_pipe_.data()) != 0) {
+    LOG_ERROR() << "Failed to listen on the local hub. Endpoint: " << endpoint
+                << ", Error: " << std::strerror(errno);
+    Stop();
+    return false;
+  }
+  ::fcntl(listen_socket_, F_SETFL, O_NONBLOCK);
+  ::fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+  ::fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+  endpoint_ = endpoint;
+
+  stop_thread_ = false;
+  work_thread_ = std::thread(&LocalHub::WorkTask, this);
+  return true;
+}
+
+void LocalHub::Stop() {
+  stop_thread_ = true;
+  WakeUp();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+  {
+    std::scoped_lock lock(hub_mutex_);
+    for (auto& consumer : consumer_list_) {
+      ::close(consumer.socket);
+    }
+    consumer_list_.clear();
+    retained_list_.clear();
+  }
+  for (auto& pipe_end : wake_pipe_) {
+    if (pipe_end >= 0) {
+      ::close(pipe_end);
+      pipe_end = -1;
+    }
+  }
+  if (listen_socket_ >= 0) {
+    ::close(listen_socket_);
+    listen_socket_ = -1;
+  }
+  if (!endpoint_.empty()) {
+    ::unlink(endpoint_.c_str());
+    endpoint_.clear();
+  }
+}
+
+void LocalHub::WakeUp() const {
+  if (wake_pipe_[1] >= 0) {
+    const char wake = 0;
+    [[maybe_unused]] const auto written = ::write(wake_pipe_[1], &wake, 1);
+  }
+}
+
+void LocalHub::AcceptConsumer() {
+  const int socket = ::accept(listen_socket_, nullptr, nullptr);
+  if (socket < 0) {
+    return;
+  }
+  ::fcntl(socket, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+  const int no_sigpipe = 1;
+  ::setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+  // A new consumer starts with the retained (BIRTH) messages.
+  Consumer consumer;
+  consumer.socket = socket;
+  std::scoped_lock lock(hub_mutex_);
+  for (const auto& [topic_name, frame] : retained_list_) {
+    consumer.queue.push_back(frame);
+  }
+  consumer_list_.emplace_back(std::move(consumer));
+}
+
+bool LocalHub::SendQueue(Consumer& consumer) {
+  while (!consumer.queue.empty()) {
+    const auto& frame = *consumer.queue.front();
+    const size_t header_size = frame.header.size();
+    const size_t body_size = frame.body ? frame.body->size() : 0;
+
+    std::array<iovec, 2> io_list = {};
+    size_t nof_io = 0;
+    if (consumer.offset < header_size) {
+      io_list[nof_io].iov_base = const_cast<uint8_t*>(frame.header.data() + consumer.offset);
+      io_list[nof_io].iov_len = header_size - consumer.offset;
+      ++nof_io;
+    }
+    if (body_size > 0) {
+      const size_t body_offset = consumer.offset > header_size ? consumer.offset - header_size : 0;
+      io_list[nof_io].iov_base = const_cast<uint8_t*>(frame.body->data() + body_offset);
+      io_list[nof_io].iov_len = body_size - body_offset;
+      ++nof_io;
+    }
+
+    msghdr message = {};
+    message.msg_iov = io_list.data();
+    message.msg_iovlen = nof_io;
+    const auto sent = ::sendmsg(consumer.socket, &message, kSendFlags);
+    if (sent < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    consumer.offset += static_cast<size_t>(sent);
+    if (consumer.offset < header_size + body_size) {
+      return true; // The socket buffer is full
+    }
+    consumer.offset = 0;
+    consumer.queue.pop_front();
+  }
+  return true;
+}
+
+void LocalHub::WorkTask() {
+  std::vector<pollfd> poll_list;
+  while (!stop_thread_) {
+    poll_list.clear();
+    poll_list.push_back({wake_pipe_[0], POLLIN, 0});
+    poll_list.push_back({listen_socket_, POLLIN, 0});
+    {
+      std::scoped_lock lock(hub_mutex_);
+      for (const auto& consumer : consumer_list_) {
+        const short events = consumer.queue.empty() ? POLLIN : POLLIN | POLLOUT;
+        poll_list.push_back({consumer.socket, events, 0});
+      }
+    }
+    if (::poll(poll_list.data(), poll_list.size(), kPollTimeout) <= 0) {
+      continue;
+    }
+
+    if ((poll_list[0].revents & POLLIN) != 0) {
+      std::array<char, 64> drain = {};
+      while (::read(wake_pipe_[0], drain.data(), drain.size()) > 0) {
+      }
+    }
+
+    // Only the worker thread adds and removes consumers, so the index into
+    // the poll list is valid.
+    {
+      std::scoped_lock lock(hub_mutex_);
+      for (size_t index = 2; index < poll_list.size(); ++index) {
+        auto& consumer = consumer_list_[index - 2];
+        const auto revents = poll_list[index].revents;
+        bool closed = (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+        if (!closed && (revents & POLLIN) != 0) {
+          // Consumers doesn't send anything. Read to detect a close.
+          std::array<char, 256> ignore = {};
+          closed = ::recv(consumer.socket, ignore.data(), ignore.size(), 0) == 0;
+        }
+        if (!closed && (revents & POLLOUT) != 0) {
+          closed = !SendQueue(consumer);
+        }
+        if (closed) {
+          ::close(consumer.socket);
+          consumer.socket = -1;
+        }
+      }
+      std::erase_if(consumer_list_, [] (const Consumer& consumer) -> bool {
+        return consumer.socket < 0;
+      });
+    }
+
+    if ((poll_list[1].revents & POLLIN) != 0) {
+      AcceptConsumer();
+    }
+  }
+}
+
+#else
+
+bool LocalHub::Start(const std::string& endpoint) {
+  LOG_ERROR() << "The local hub is not supported on Windows. Endpoint: " << endpoint;
+  return false;
+}
+
+void LocalHub::Stop() {
+  stop_thread_ = true;
+  std::scoped_lock lock(hub_mutex_);
+  consumer_list_.clear();
+  retained_list_.clear();
+}
+
+void LocalHub::WakeUp() const {
+}
+
+void LocalHub::AcceptConsumer() {
+}
+
+bool LocalHub::SendQueue(Consumer&) {
+  return false;
+}
+
+void LocalHub::WorkTask() {
+}
+
+#endif
+
+} // pub_sub
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+/** \file
+ * \brief Local fan-out of published messages over a Unix domain socket.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inprocessbus.h"
+
+namespace pub_sub {
+
+/** \brief Sends a node's published messages to local consumers.
+ *
+ * The hub listens on a Unix domain socket. Each connected consumer
+ * receives the already encoded messages that the node publishes, so
+ * co-located applications don't need to subscribe through the broker.
+ * A message is sent as a frame: topic length (uint32), body length
+ * (uint32), both big-endian, followed by the topic name and the body.
+ * See LocalSubscriber for the consumer side.
+ *
+ * Retained messages (the BIRTH messages) are sent to a consumer when it
+ * connects. A consumer that doesn't keep up, loses messages when its
+ * queue is full.
+ */
+class LocalHub final {
+ public:
+  LocalHub() = default;
+  ~LocalHub();
+
+  LocalHub(const LocalHub&) = delete;
+  LocalHub& operator=(const LocalHub&) = delete;
+
+  /** \brief Starts listening on the socket path.
+   *
+   * Any existing file with the same path is removed.
+   * @param endpoint Socket file path.
+   * @return True if the hub is listening.
+   */
+  bool Start(const std::string& endpoint);
+  void Stop();
+  [[nodiscard]] bool IsStarted() const { return listen_socket_ >= 0; }
+
+  /** \brief Queues a message to all consumers.
+   *
+   * @param topic_name Topic name.
+   * @param body Encoded message body. The body is shared, not copied.
+   * @param retained True if the message also should be sent to new
+   * consumers. An empty retained body deletes the retained message.
+   */
+  void Publish(const std::string& topic_name, const BusBuffer& body, bool retained);
+
+  /** \brief Deletes all retained messages. */
+  void ClearRetained();
+
+  /** \brief Deletes a retained message without sending anything to the consumers.
+   *
+   * @param topic_name Topic name of the retained message.
+   */
+  void ClearRetained(const std::string& topic_name);
+
+  [[nodiscard]] size_t Consumers() const;
+  [[nodiscard]] uint64_t DroppedMessages() const { return dropped_messages_; }
+
+ private:
+  /** \brief Frame header and topic name followed by the shared body. */
+  struct Frame {
+    std::vector<uint8_t> header;
+    BusBuffer body;
+  };
+  using FramePtr = std::shared_ptr<const Frame>;
+
+  struct Consumer {
+    int socket = -1;
+    std::deque<FramePtr> queue;
+    size_t offset = 0; ///< Bytes sent of the first frame in the queue.
+  };
+
+  static constexpr size_t kMaxQueueSize = 10'000; ///< Max frames per consumer.
+
+  std::string endpoint_;
+  std::atomic<int> listen_socket_ = -1;
+  std::array<int, 2> wake_pipe_ = {-1, -1}; ///< Wakes up the poll.
+
+  mutable std::mutex hub_mutex_;
+  std::vector<Consumer> consumer_list_;
+  std::map<std::string, FramePtr> retained_list_;
+  std::atomic<uint64_t> dropped_messages_ = 0;
+
+  std::atomic<bool> stop_thread_ = true;
+  std::thread work_thread_;
+
+  static FramePtr MakeFrame(const std::string& topic_name, const BusBuffer& body);
+  void WakeUp() const;
+  void WorkTask();
+  void AcceptConsumer();
+  static bool SendQueue(Consumer& consumer);
+};
+
+} // pub_sub
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/localsubscriber.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "util/logstream.h"
+
+using namespace util::log;
+
+namespace {
+
+constexpr int kPollTimeout = 100; ///< Poll timeout in ms
+constexpr size_t kHeaderSize = 8; ///< Topic and body length
+
+uint32_t ReadUint32(const uint8_t* source) {
+  return (static_cast<uint32_t>(source[0]) << 24) | (static_cast<uint32_t>(source[1]) << 16)
+      | (static_cast<uint32_t>(source[2]) << 8) | static_cast<uint32_t>(source[3]);
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+LocalSubscriber::~LocalSubscriber() {
+  Disconnect();
+}
+
+#ifndef _WIN32
+
+bool LocalSubscriber::Connect(const std::string& endpoint, OnMessage on_message) {
+  Disconnect();
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR() << "Invalid local endpoint. Endpoint: " << endpoint;
+    return false;
+  }
+  std::strncpy(address.sun_path, endpoint.c_str(), sizeof(address.sun_path) - 1);
+
+  const int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket < 0) {
+    LOG_ERROR() << "Failed to create the local socket. Error: " << std::strerror(errno);
+    return false;
+  }
+  if (::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    LOG_ERROR() << "Failed to connect to the local endpoint. Endpoint: " << endpoint
+                << ", Error: " << std::strerror(errno);
+    ::close(socket);
+    return false;
+  }
+  socket_ = socket;
+  closed_ = false;
+  on_message_ = std::move(on_message);
+  stop_thread_ = false;
+  work_thread_ = std::thread(&LocalSubscriber::WorkTask, this);
+  return true;
+}
+
+void LocalSubscriber::Disconnect() {
+  stop_thread_ = true;
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+  if (socket_ >= 0) {
+    ::close(socket_);
+    socket_ = -1;
+  }
+}
+
+void LocalSubscriber::WorkTask() {
+  std::vector<uint8_t> buffer;
+  std::array<uint8_t, 64 * 1024> chunk = {};
+  std::string topic_name;
+  std::vector<uint8_t> body;
+
+  while (!stop_thread_ && !closed_) {
+    pollfd poll_socket = {socket_, POLLIN, 0};
+    if (::poll(&poll_socket, 1, kPollTimeout) <= 0) {
+      continue;
+    }
+    const auto bytes = ::recv(socket_, chunk.data(), chunk.size(), 0);
+    if (bytes <= 0) {
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      closed_ = true;
+      break;
+    }
+    buffer.insert(buffer.end(), chunk.cbegin(), chunk.cbegin() + bytes);
+
+    // Handle all complete frames in the buffer
+    size_t offset = 0;
+    while (buffer.size() - offset >= kHeaderSize) {
+      const size_t topic_size = ReadUint32(buffer.data() + offset);
+      const size_t body_size = ReadUint32(buffer.data() + offset + 4);
+      const size_t frame_size = kHeaderSize + topic_size + body_size;
+      if (buffer.size() - offset < frame_size) {
+        break;
+      }
+      const auto* frame = buffer.data() + offset + kHeaderSize;
+      topic_name.assign(reinterpret_cast<const char*>(frame), topic_size);
+      body.assign(frame + topic_size, frame + topic_size + body_size);
+      offset += frame_size;
+      ++messages_;
+      if (on_message_) {
+        on_message_(topic_name, body);
+      }
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(offset));
+  }
+}
+
+#else
+
+bool LocalSubscriber::Connect(const std::string& endpoint, OnMessage) {
+  LOG_ERROR() << "The local subscriber is not supported on Windows. Endpoint: " << endpoint;
+  return false;
+}
+
+void LocalSubscriber::Disconnect() {
+}
+
+void LocalSubscriber::WorkTask() {
+}
+
+#endif
+
+} // pub_sub
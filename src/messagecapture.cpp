@@ -0,0 +1,275 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/messagecapture.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "util/logstream.h"
+#include "pubsub/ipubsubclient.h"
+#include "sparkplughelper.h"
+#include "inprocessbus.h"
+
+using namespace util::log;
+using namespace std::chrono_literals;
+using namespace boost::interprocess;
+
+namespace {
+
+constexpr std::string_view kCaptureHeader = "PUBCAP01";
+/** \brief Record header: arrival time (8), topic size (4), payload size (4), flags (1). */
+constexpr size_t kRecordHeaderSize = 17;
+constexpr uint8_t kRetainedFlag = 0x01;
+
+void PutLittleEndian(uint8_t* dest, uint64_t value, size_t size) {
+  for (size_t index = 0; index < size; ++index) {
+    dest[index] = static_cast<uint8_t>(value >> (index * 8));
+  }
+}
+
+uint64_t GetLittleEndian(const uint8_t* source, size_t size) {
+  uint64_t value = 0;
+  for (size_t index = 0; index < size; ++index) {
+    value |= static_cast<uint64_t>(source[index]) << (index * 8);
+  }
+  return value;
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+MessageCapture::~MessageCapture() {
+  Stop();
+}
+
+bool MessageCapture::Start(const std::string& filename) {
+  Stop();
+  filename_ = filename;
+  file_.open(filename_, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!file_.is_open()) {
+    LOG_ERROR() << "Failed to create the capture file. File: " << filename_;
+    return false;
+  }
+  file_.write(kCaptureHeader.data(), static_cast<std::streamsize>(kCaptureHeader.size()));
+  {
+    std::scoped_lock lock(ring_mutex_);
+    ring_.resize(std::max(ring_size_, kRecordHeaderSize));
+    read_pos_ = 0;
+    write_pos_ = 0;
+  }
+  active_ = true;
+  work_thread_ = std::thread(&MessageCapture::WorkTask, this);
+  return true;
+}
+
+void MessageCapture::Stop() {
+  {
+    std::scoped_lock lock(ring_mutex_);
+    active_ = false;
+  }
+  ring_event_.notify_all();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+void MessageCapture::Capture(std::string_view topic_name, const void* payload,
+                             size_t payload_size, bool retained) {
+  if (!active_) {
+    return;
+  }
+  if (payload == nullptr) {
+    payload_size = 0;
+  }
+  std::array<uint8_t, kRecordHeaderSize> header = {};
+  PutLittleEndian(header.data(), SparkplugHelper::NowNs(), 8);
+  PutLittleEndian(header.data() + 8, topic_name.size(), 4);
+  PutLittleEndian(header.data() + 12, payload_size, 4);
+  header[16] = retained ? kRetainedFlag : 0;
+  const size_t record_size = header.size() + topic_name.size() + payload_size;
+
+  bool wake_up = false;
+  {
+    std::scoped_lock lock(ring_mutex_);
+    if (!active_) {
+      return;
+    }
+    if (write_pos_ - read_pos_ + record_size > ring_.size()) {
+      ++dropped_;
+      return;
+    }
+    WriteRing(header.data(), header.size());
+    WriteRing(topic_name.data(), topic_name.size());
+    WriteRing(payload, payload_size);
+    // Wake the writer before the ring is full.
+    wake_up = write_pos_ - read_pos_ >= ring_.size() / 2;
+  }
+  ++captured_;
+  if (wake_up) {
+    ring_event_.notify_one();
+  }
+}
+
+void MessageCapture::WriteRing(const void* data, size_t size) {
+  const auto* source = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    const size_t offset = write_pos_ % ring_.size();
+    const size_t bytes = std::min(size, ring_.size() - offset);
+    std::memcpy(ring_.data() + offset, source, bytes);
+    source += bytes;
+    size -= bytes;
+    write_pos_ += bytes;
+  }
+}
+
+void MessageCapture::WorkTask() {
+  while (active_) {
+    {
+      std::unique_lock lock(ring_mutex_);
+      ring_event_.wait_for(lock, 100ms, [&] () -> bool {
+        return !active_ || write_pos_ - read_pos_ >= ring_.size() / 2;
+      });
+    }
+    SaveRing();
+  }
+  SaveRing();
+  file_.flush();
+}
+
+void MessageCapture::SaveRing() {
+  size_t read_pos = 0;
+  size_t write_pos = 0;
+  {
+    std::scoped_lock lock(ring_mutex_);
+    read_pos = read_pos_;
+    write_pos = write_pos_;
+  }
+  // The producers never write into the unread part, so the file is
+  // written without holding the lock.
+  while (read_pos < write_pos) {
+    const size_t offset = read_pos % ring_.size();
+    const size_t bytes = std::min(write_pos - read_pos, ring_.size() - offset);
+    file_.write(reinterpret_cast<const char*>(ring_.data() + offset),
+                static_cast<std::streamsize>(bytes));
+    read_pos += bytes;
+  }
+  std::scoped_lock lock(ring_mutex_);
+  read_pos_ = read_pos;
+}
+
+struct MessageReplay::Mapping {
+  file_mapping file;
+  mapped_region region;
+};
+
+MessageReplay::MessageReplay() = default;
+
+MessageReplay::~MessageReplay() {
+  Close();
+}
+
+bool MessageReplay::Open(const std::string& filename) {
+  Close();
+  try {
+    auto mapping = std::make_unique<Mapping>();
+    mapping->file = file_mapping(filename.c_str(), read_only);
+    mapping->region = mapped_region(mapping->file, read_only);
+    const auto* data = static_cast<const uint8_t*>(mapping->region.get_address());
+    const size_t size = mapping->region.get_size();
+    if (size < kCaptureHeader.size() ||
+        std::memcmp(data, kCaptureHeader.data(), kCaptureHeader.size()) != 0) {
+      LOG_ERROR() << "Invalid capture file. File: " << filename;
+      return false;
+    }
+
+    size_t pos = kCaptureHeader.size();
+    while (pos + kRecordHeaderSize <= size) {
+      const auto* record = data + pos;
+      const auto topic_size = static_cast<size_t>(GetLittleEndian(record + 8, 4));
+      const auto payload_size = static_cast<size_t>(GetLittleEndian(record + 12, 4));
+      if (pos + kRecordHeaderSize + topic_size + payload_size > size) {
+        break; // The last record is not complete
+      }
+      auto& message = message_list_.emplace_back();
+      message.arrival_time = GetLittleEndian(record, 8);
+      message.retained = (record[16] & kRetainedFlag) != 0;
+      message.topic_name = std::string_view(
+          reinterpret_cast<const char*>(record + kRecordHeaderSize), topic_size);
+      message.payload = std::span<const uint8_t>(
+          record + kRecordHeaderSize + topic_size, payload_size);
+      pos += kRecordHeaderSize + topic_size + payload_size;
+    }
+    mapping_ = std::move(mapping);
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to open the capture file. Error: " << err.what()
+      << ", File: " << filename;
+    message_list_.clear();
+    return false;
+  }
+  return true;
+}
+
+void MessageReplay::Close() {
+  message_list_.clear();
+  mapping_.reset();
+}
+
+bool MessageReplay::IsOpen() const {
+  return static_cast<bool>(mapping_);
+}
+
+size_t MessageReplay::Replay(const OnMessage& on_message) {
+  abort_ = false;
+  if (!on_message || message_list_.empty()) {
+    return 0;
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  const uint64_t first_arrival = message_list_.front().arrival_time;
+  const double speed = speed_;
+  size_t count = 0;
+  for (const auto& message : message_list_) {
+    if (abort_) {
+      break;
+    }
+    if (speed > 0.0 && message.arrival_time > first_arrival) {
+      const auto offset = static_cast<double>(message.arrival_time - first_arrival) / speed;
+      std::this_thread::sleep_until(start_time +
+          std::chrono::nanoseconds(static_cast<int64_t>(offset)));
+    }
+    on_message(message);
+    ++count;
+  }
+  return count;
+}
+
+size_t MessageReplay::Replay(IPubSubClient& client) {
+  std::string topic_name;
+  return Replay([&] (const CapturedMessage& message) {
+    topic_name.assign(message.topic_name);
+    client.InjectMessage(topic_name, message.payload.data(), message.payload.size(),
+                         message.retained);
+  });
+}
+
+size_t MessageReplay::ReplayToBus() {
+  auto& bus = InProcessBus::Instance();
+  return Replay([&] (const CapturedMessage& message) {
+    auto body = std::make_shared<const std::vector<uint8_t>>(message.payload.begin(),
+                                                             message.payload.end());
+    bus.Publish(std::string(message.topic_name), body, message.retained);
+  });
+}
+
+} // pub_sub
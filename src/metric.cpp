@@ -8,33 +8,70 @@
 
 #include <util/stringutil.h>
 
+#include <algorithm>
+#include <array>
 #include <utility>
 
 #include "sparkplug_b.pb.h"
 #include "payloadhelper.h"
+#include "sparkplughelper.h"
 
 using namespace org::eclipse::tahu::protobuf;
 
+namespace {
+
+const pub_sub::MetricPropertyList kEmptyPropertyList;
+
+} // end namespace
+
 namespace pub_sub {
 
+struct Metric::ColdData {
+  std::unique_ptr<MetricPropertyList> own_list; ///< Properties that the caller may change.
+  std::unique_ptr<MetricMetadata> meta_data;
+  MetricCallback on_message;
+};
+
+Metric::Metric() = default;
 
 Metric::Metric(std::string  name)
-  : name_(std::move(name)) {
+  : name_(name) {
 
 }
 Metric::Metric(const std::string_view& name)
-    : name_(name.data()) {
+    : name_(name) {
+
+}
+
+Metric::~Metric() = default;
 
+std::recursive_mutex& Metric::Mutex() const {
+  // The pool is never destroyed, so metrics may be deleted at exit.
+  static auto* lock_pool = new std::array<std::recursive_mutex, 256>;
+  const auto address = reinterpret_cast<uintptr_t>(this);
+  return (*lock_pool)[((address >> 4) ^ (address >> 12)) % lock_pool->size()];
+}
+
+Metric::ColdData& Metric::Cold() {
+  if (!cold_) {
+    cold_ = std::make_unique<ColdData>();
+  }
+  return *cold_;
+}
+
+MetricPropertyList* Metric::OwnList() const {
+  return cold_ ? cold_->own_list.get() : nullptr;
 }
 
 void Metric::Name(std::string name) {
-  std::scoped_lock lock(metric_mutex_);
-  name_ = std::move(name);
+  std::scoped_lock lock(Mutex());
+  name_ = name;
+  ++definition_version_;
 }
 
 std::string Metric::Name() const {
-  std::scoped_lock lock(metric_mutex_);
-  return name_;
+  std::scoped_lock lock(Mutex());
+  return name_.Str();
 }
 
 /** @brief In MQTT the value are sent as string value. Sometimes the value is appended with
@@ -47,13 +84,12 @@ std::string Metric::Name() const {
 template<>
 void Metric::Value(std::string value) {
   // Note: Special handling for MQTT if the value is appended with unit.
-  const auto type = static_cast<uint32_t>(datatype_);
+  const auto type = static_cast<uint32_t>(datatype_.load());
   if (type > static_cast<uint32_t>(MetricType::Unknown) && type <= static_cast<uint32_t>(MetricType::Double)) {
     // Check for an optional unit string
     const auto space = value.find_first_of(' ');
     if (space != std::string::npos) {
-      auto exist = property_list_.find("unit");
-      if (exist == property_list_.cend()) {
+      if (std::as_const(*this).GetProperty("unit") == nullptr) {
         Unit(value.substr(space + 1));
       }
       value = value.substr(0, space);
@@ -62,9 +98,9 @@ void Metric::Value(std::string value) {
 
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    updated = value != value_;
-    value_ = std::move(value);
+    std::scoped_lock lock(Mutex());
+    updated = !(value_ == value);
+    value_ = value;
   }
   IsValid(true);
   if (updated) {
@@ -76,8 +112,8 @@ template<>
 void Metric::Value(std::string_view value) {
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    updated = value_ != value;
+    std::scoped_lock lock(Mutex());
+    updated = !(value_ == value);
     value_ = value;
   }
   IsValid(true);
@@ -90,11 +126,11 @@ template<>
 void Metric::Value(const char* value) {
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    if (value == nullptr && !value_.empty()) {
+    std::scoped_lock lock(Mutex());
+    if (value == nullptr && !value_.Empty()) {
       updated = true;
-      value_.clear();
-    } else if (value != nullptr && value_ != value) {
+      value_.Clear();
+    } else if (value != nullptr && !(value_ == value)) {
       updated = true;
       value_ = value;
     }
@@ -109,10 +145,10 @@ template<>
 void Metric::Value(bool value) {
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    const std::string old_value = value_;
-    value_ = value ? "1" : "0";
-    updated = old_value != value_;
+    std::scoped_lock lock(Mutex());
+    const std::string_view text = value ? "1" : "0";
+    updated = !(value_ == text);
+    value_ = text;
   }
   IsValid(true);
   if (updated) {
@@ -124,14 +160,14 @@ template<>
 void Metric::Value(float value) {
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    const std::string old_value = value_;
-    value_ = util::string::FloatToString(value);
-    const auto pos = value_.find(',');
+    std::scoped_lock lock(Mutex());
+    std::string text = util::string::FloatToString(value);
+    const auto pos = text.find(',');
     if (pos != std::string::npos) {
-      value_.replace(pos, 1, ".");
+      text.replace(pos, 1, ".");
     }
-    updated = old_value != value_;
+    updated = !(value_ == text);
+    value_ = text;
   }
   IsValid(true);
   if (updated) {
@@ -143,14 +179,14 @@ template<>
 void Metric::Value(double value) {
   bool updated = false;
   {
-    std::scoped_lock lock(metric_mutex_);
-    const std::string old_value = value_;
-    value_ = util::string::DoubleToString(value);
-    const auto pos = value_.find(',');
+    std::scoped_lock lock(Mutex());
+    std::string text = util::string::DoubleToString(value);
+    const auto pos = text.find(',');
     if (pos != std::string::npos) {
-      value_.replace(pos, 1, ".");
+      text.replace(pos, 1, ".");
     }
-    updated = old_value != value_;
+    updated = !(value_ == text);
+    value_ = text;
   }
   IsValid(true);
   if (updated) {
@@ -160,16 +196,21 @@ void Metric::Value(double value) {
 
 template<>
 std::string Metric::Value() const {
-  std::scoped_lock lock(metric_mutex_);
+  std::scoped_lock lock(Mutex());
+  return value_.Str();
+}
+
+SmallString Metric::ValueText() const {
+  std::scoped_lock lock(Mutex());
   return value_;
 }
 
 template<>
 int8_t Metric::Value() const {
   int8_t temp = 0;
-  std::scoped_lock lock(metric_mutex_);
+  std::scoped_lock lock(Mutex());
   try {
-    temp = static_cast< int8_t>(std::stoi(value_));
+    temp = static_cast< int8_t>(std::stoi(value_.Str()));
   } catch (const std::exception&) {
 
   }
@@ -179,9 +220,9 @@ int8_t Metric::Value() const {
 template<>
 uint8_t Metric::Value() const {
   uint8_t temp = 0;
-  std::scoped_lock lock(metric_mutex_);
+  std::scoped_lock lock(Mutex());
   try {
-    temp = static_cast< uint8_t>(std::stoul(value_));
+    temp = static_cast< uint8_t>(std::stoul(value_.Str()));
   } catch (const std::exception&) {
 
   }
@@ -190,11 +231,11 @@ uint8_t Metric::Value() const {
 
 template<>
 bool Metric::Value() const {
-  std::scoped_lock lock(metric_mutex_);
-  if (value_.empty()) {
+  std::scoped_lock lock(Mutex());
+  if (value_.Empty()) {
     return false;
   }
-  switch (value_[0]) {
+  switch (value_.View()[0]) {
     case 'Y':
     case 'y':
     case 'T':
@@ -226,71 +267,142 @@ std::string Metric::DebugString() const {
   PayloadHelper helper(payload);
   helper.WriteAllMetrics(true);
   {
-    std::scoped_lock lock(metric_mutex_);
+    std::scoped_lock lock(Mutex());
     helper.WriteMetric(*this, metric);
   }
   return metric.DebugString();
 }
 
 void Metric::AddProperty(const MetricProperty &property) {
-  std::scoped_lock lock(metric_mutex_);
-  auto exist = property_list_.find(property.Key());
-  if (exist == property_list_.end()) {
-    property_list_.emplace(property.Key(),property);
+  std::scoped_lock lock(Mutex());
+  if (auto* own_list = OwnList(); own_list != nullptr) {
+    own_list->insert_or_assign(property.Key(), property);
   } else {
-    exist->second = property;
+    auto property_list = property_set_ ? property_set_->Properties() : MetricPropertyList();
+    property_list.insert_or_assign(property.Key(), property);
+    property_set_ = PropertySet::Intern(std::move(property_list));
   }
+  ++definition_version_;
 }
+
 MetricProperty* Metric::CreateProperty(const std::string& key) {
-  std::scoped_lock lock(metric_mutex_);
-  if (const auto exist = property_list_.find(key);
-      exist == property_list_.cend()) {
+  std::scoped_lock lock(Mutex());
+  auto& property_list = OwnProperties();
+  if (const auto exist = property_list.find(key);
+      exist == property_list.cend()) {
     MetricProperty temp;
     temp.Key(key);
-    property_list_.emplace(key, temp);
+    property_list.emplace(key, temp);
   }
   return GetProperty(key);
 }
 
 MetricProperty *Metric::GetProperty(const std::string &key) {
-  std::scoped_lock lock(metric_mutex_);
-  if (auto exist = property_list_.find(key);
-      exist != property_list_.end()) {
+  std::scoped_lock lock(Mutex());
+  if (std::as_const(*this).GetProperty(key) == nullptr) {
+    return nullptr; // Keep sharing the properties if the key doesn't exist
+  }
+  auto& property_list = OwnProperties();
+  if (auto exist = property_list.find(key);
+      exist != property_list.end()) {
+    ++definition_version_; // The caller may change the property
     return &exist->second;
   }
   return nullptr;
 }
 
 const MetricProperty *Metric::GetProperty(const std::string &key) const {
-  std::scoped_lock lock(metric_mutex_);
-  if (const auto exist = property_list_.find(key);
-      exist != property_list_.cend()) {
+  std::scoped_lock lock(Mutex());
+  const auto& property_list = Properties();
+  if (const auto exist = property_list.find(key);
+      exist != property_list.cend()) {
     return &exist->second;
   }
   return nullptr;
 }
 
+const MetricPropertyList& Metric::Properties() const {
+  std::scoped_lock lock(Mutex());
+  if (const auto* own_list = OwnList(); own_list != nullptr) {
+    return *own_list;
+  }
+  return property_set_ ? property_set_->Properties() : kEmptyPropertyList;
+}
+
+void Metric::Properties(std::shared_ptr<const PropertySet> property_set) {
+  std::scoped_lock lock(Mutex());
+  if (cold_) {
+    cold_->own_list.reset();
+  }
+  property_set_ = std::move(property_set);
+  ++definition_version_;
+}
+
+std::shared_ptr<const PropertySet> Metric::SharedProperties() const {
+  std::scoped_lock lock(Mutex());
+  return property_set_;
+}
+
+void Metric::UpdateProperties(const MetricPropertyList& property_list) {
+  std::scoped_lock lock(Mutex());
+  if (auto* own_list = OwnList(); own_list != nullptr) {
+    // Keep the existing nodes, so property pointers remain valid.
+    for (const auto& [key, property] : property_list) {
+      own_list->insert_or_assign(key, property);
+    }
+  } else {
+    auto new_list = property_set_ ? property_set_->Properties() : MetricPropertyList();
+    for (const auto& [key, property] : property_list) {
+      new_list.insert_or_assign(key, property);
+    }
+    property_set_ = PropertySet::Intern(std::move(new_list));
+  }
+  ++definition_version_;
+}
+
+void Metric::InternProperties() {
+  std::scoped_lock lock(Mutex());
+  if (auto* own_list = OwnList(); own_list != nullptr) {
+    property_set_ = PropertySet::Intern(std::move(*own_list));
+    cold_->own_list.reset();
+  }
+}
+
+MetricPropertyList& Metric::OwnProperties() {
+  auto& cold = Cold();
+  if (!cold.own_list) {
+    cold.own_list = std::make_unique<MetricPropertyList>(
+        property_set_ ? property_set_->Properties() : MetricPropertyList());
+    property_set_.reset();
+  }
+  return *cold.own_list;
+}
+
 void Metric::DeleteProperty(const std::string &key) {
-  std::scoped_lock lock(metric_mutex_);
-  auto itr = property_list_.find(key);
-  if (itr != property_list_.end()) {
-    property_list_.erase(itr);
+  std::scoped_lock lock(Mutex());
+  if (auto* own_list = OwnList(); own_list != nullptr) {
+    if (own_list->erase(key) > 0) {
+      ++definition_version_;
+    }
+  } else if (property_set_ && property_set_->GetProperty(key) != nullptr) {
+    auto property_list = property_set_->Properties();
+    property_list.erase(key);
+    property_set_ = PropertySet::Intern(std::move(property_list));
+    ++definition_version_;
   }
 }
 
 void Metric::Unit(const std::string &name) {
   MetricProperty prop("unit", name);
-  std::scoped_lock lock(metric_mutex_);
+  std::scoped_lock lock(Mutex());
   AddProperty(prop);
 }
 
 std::string Metric::Unit() const {
-  std::scoped_lock lock(metric_mutex_);
-  if (const auto exist = property_list_.find("unit");
-      exist != property_list_.cend() ) {
-    const auto& prop = exist->second;
+  std::scoped_lock lock(Mutex());
+  if (const auto* prop = GetProperty("unit"); prop != nullptr) {
     try {
-      return prop.Value<std::string>();
+      return prop->Value<std::string>();
     } catch (const std::exception&) {
       return {};
     }
@@ -301,7 +413,7 @@ std::string Metric::Unit() const {
 std::string Metric::GetMqttString() const {
   const auto unit = Unit();
   std::ostringstream text;
-  if (!is_null_) {
+  if (!IsNull()) {
     text << Value<std::string>();
     if (!unit.empty()) {
       text << " " << unit;
@@ -310,28 +422,72 @@ std::string Metric::GetMqttString() const {
   return text.str();
 }
 
+void Metric::SetOnMessage(MetricCallback on_message) {
+  std::scoped_lock lock(Mutex());
+  Cold().on_message = std::move(on_message);
+}
+
 void Metric::FireOnMessage() {
-  if (on_message_) {
-    on_message_(*this);
+  MetricCallback on_message;
+  {
+    std::scoped_lock lock(Mutex());
+    if (cold_) {
+      on_message = cold_->on_message;
+    }
+  }
+  if (on_message) {
+    on_message(*this);
   }
 }
 
 MetricMetadata *Metric::CreateMetaData() {
-  std::scoped_lock lock(metric_mutex_);
-  if (!meta_data_) {
-    meta_data_ = std::make_unique<MetricMetadata>();
+  std::scoped_lock lock(Mutex());
+  auto& cold = Cold();
+  if (!cold.meta_data) {
+    cold.meta_data = std::make_unique<MetricMetadata>();
   }
-  return meta_data_.get();
+  return cold.meta_data.get();
 }
 
 MetricMetadata *Metric::GetMetaData() {
-  std::scoped_lock lock(metric_mutex_);
-  return meta_data_.get();
+  std::scoped_lock lock(Mutex());
+  return cold_ ? cold_->meta_data.get() : nullptr;
 }
 
 const MetricMetadata *Metric::GetMetaData() const {
-  std::scoped_lock lock(metric_mutex_);
-  return meta_data_.get();
+  std::scoped_lock lock(Mutex());
+  return cold_ ? cold_->meta_data.get() : nullptr;
+}
+
+size_t Metric::MemoryUsage() const {
+  std::scoped_lock lock(Mutex());
+  size_t bytes = sizeof(Metric);
+  bytes += name_.HeapSize();
+  bytes += value_.HeapSize();
+  if (cold_) {
+    bytes += sizeof(ColdData);
+  }
+  if (const auto* own_list = OwnList(); own_list != nullptr) {
+    bytes += sizeof(MetricPropertyList);
+    for (const auto& [key, property] : *own_list) {
+      bytes += 4 * sizeof(void*); // Map node overhead
+      bytes += SparkplugHelper::StringHeapSize(key);
+      bytes += property.MemoryUsage();
+    }
+  } else if (property_set_) {
+    // The shared set is split between the metrics that use it.
+    const auto users = static_cast<size_t>(std::max(property_set_.use_count(), 1L));
+    bytes += property_set_->MemoryUsage() / users;
+  }
+  if (const auto* meta_data = GetMetaData(); meta_data != nullptr) {
+    bytes += sizeof(MetricMetadata);
+    bytes += SparkplugHelper::StringHeapSize(meta_data->ContentType());
+    bytes += SparkplugHelper::StringHeapSize(meta_data->FileName());
+    bytes += SparkplugHelper::StringHeapSize(meta_data->FileType());
+    bytes += SparkplugHelper::StringHeapSize(meta_data->Md5());
+    bytes += SparkplugHelper::StringHeapSize(meta_data->Description());
+  }
+  return bytes;
 }
 
 
@@ -5,6 +5,7 @@
 #include <utility>
 
 #include "pubsub/metricproperty.h"
+#include "sparkplughelper.h"
 
 namespace pub_sub {
 
@@ -93,6 +94,23 @@ int8_t MetricProperty::Value() const {
   return temp;
 }
 
+size_t MetricProperty::MemoryUsage() const {
+  std::scoped_lock lock(property_mutex_);
+  size_t bytes = sizeof(MetricProperty);
+  bytes += SparkplugHelper::StringHeapSize(key_);
+  bytes += SparkplugHelper::StringHeapSize(value_);
+  bytes += (prop_array_.capacity() - prop_array_.size()) * sizeof(MetricPropertyList);
+  for (const auto& property_list : prop_array_) {
+    bytes += sizeof(MetricPropertyList);
+    for (const auto& [key, property] : property_list) {
+      bytes += 4 * sizeof(void*); // Map node overhead
+      bytes += SparkplugHelper::StringHeapSize(key);
+      bytes += property.MemoryUsage();
+    }
+  }
+  return bytes;
+}
+
 template<>
 std::string MetricProperty::Value() const {
   std::scoped_lock lock(property_mutex_);
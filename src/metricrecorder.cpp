@@ -0,0 +1,794 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/metricrecorder.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "util/logstream.h"
+#include "sparkplughelper.h"
+
+using namespace util::log;
+using namespace std::chrono_literals;
+using namespace boost::interprocess;
+
+namespace {
+
+constexpr std::string_view kSegmentHeader = "PUBSEG01";
+constexpr std::string_view kSegmentPrefix = "segment_";
+constexpr std::string_view kSegmentExtension = ".seg";
+constexpr uint32_t kChunkMagic = 0x4B4E4843; // "CHNK"
+
+/** \brief Defines how the value column is encoded. */
+enum class ColumnType : uint8_t {
+  Integer = 0, ///< Delta encoded integers.
+  Float,       ///< XOR encoded floating point values.
+  Text         ///< Length and text.
+};
+
+ColumnType ToColumnType(pub_sub::MetricType type) {
+  using pub_sub::MetricType;
+  switch (type) {
+    case MetricType::Int8:
+    case MetricType::Int16:
+    case MetricType::Int32:
+    case MetricType::Int64:
+    case MetricType::UInt8:
+    case MetricType::UInt16:
+    case MetricType::UInt32:
+    case MetricType::UInt64:
+    case MetricType::Boolean:
+    case MetricType::DateTime:
+      return ColumnType::Integer;
+
+    case MetricType::Float:
+    case MetricType::Double:
+      return ColumnType::Float;
+
+    default:
+      break;
+  }
+  return ColumnType::Text;
+}
+
+/** \brief Converts a value text to a number.
+ *
+ * Leading spaces are skipped and trailing text, e.g. a unit, is ignored.
+ * An invalid text returns 0.
+ */
+template <typename T>
+T ParseNumber(std::string_view text) {
+  const auto first = text.find_first_not_of(" \t");
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  text.remove_prefix(first);
+  if (text.front() == '+') {
+    text.remove_prefix(1);
+  }
+  T value = {};
+  std::from_chars(text.data(), text.data() + text.size(), value);
+  return value;
+}
+
+/** \brief Converts a value text to a boolean the same way as Metric::Value<bool>(). */
+bool ParseBoolean(std::string_view text) {
+  if (text.empty()) {
+    return false;
+  }
+  switch (text.front()) {
+    case 'Y':
+    case 'y':
+    case 'T':
+    case 't':
+    case '1':
+      return true;
+
+    default:
+      break;
+  }
+  return false;
+}
+
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void PutVarint(std::vector<uint8_t>& dest, uint64_t value) {
+  while (value >= 0x80) {
+    dest.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  dest.push_back(static_cast<uint8_t>(value));
+}
+
+void PutFixed32(std::vector<uint8_t>& dest, uint32_t value) {
+  for (size_t index = 0; index < 4; ++index) {
+    dest.push_back(static_cast<uint8_t>(value >> (index * 8)));
+  }
+}
+
+void PutBytes(std::vector<uint8_t>& dest, const void* data, size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  dest.insert(dest.end(), bytes, bytes + size);
+}
+
+/** \brief Bounds checked reading of a memory buffer. */
+class ByteReader {
+ public:
+  ByteReader(const uint8_t* data, size_t size)
+  : data_(data), size_(size) {}
+
+  [[nodiscard]] bool IsOk() const { return ok_; }
+  [[nodiscard]] size_t Position() const { return pos_; }
+  [[nodiscard]] size_t Remaining() const { return ok_ ? size_ - pos_ : 0; }
+  [[nodiscard]] const uint8_t* Current() const { return data_ + pos_; }
+
+  uint64_t Varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && pos_ < size_; shift += 7) {
+      const auto byte = data_[pos_++];
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  uint32_t Fixed32() {
+    uint32_t value = 0;
+    if (Remaining() < 4) {
+      ok_ = false;
+      return 0;
+    }
+    for (size_t index = 0; index < 4; ++index) {
+      value |= static_cast<uint32_t>(data_[pos_++]) << (index * 8);
+    }
+    return value;
+  }
+
+  uint8_t Byte() {
+    if (Remaining() < 1) {
+      ok_ = false;
+      return 0;
+    }
+    return data_[pos_++];
+  }
+
+  void Skip(size_t size) {
+    if (Remaining() < size) {
+      ok_ = false;
+      return;
+    }
+    pos_ += size;
+  }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+/** \brief Header of a chunk in a segment file. */
+struct ChunkHeader {
+  std::string_view series_key;
+  uint64_t alias = 0;
+  pub_sub::MetricType type = pub_sub::MetricType::Unknown;
+  size_t count = 0;
+  uint64_t min_time = 0;
+  uint64_t max_time = 0;
+  size_t time_bytes = 0;
+  size_t quality_bytes = 0;
+  size_t value_bytes = 0;
+};
+
+bool ReadChunkHeader(ByteReader& reader, ChunkHeader& header) {
+  const auto key_size = static_cast<size_t>(reader.Varint());
+  if (reader.Remaining() < key_size) {
+    return false;
+  }
+  header.series_key = std::string_view(reinterpret_cast<const char*>(reader.Current()),
+                                       key_size);
+  reader.Skip(key_size);
+  header.alias = reader.Varint();
+  header.type = static_cast<pub_sub::MetricType>(reader.Varint());
+  header.count = static_cast<size_t>(reader.Varint());
+  header.min_time = reader.Varint();
+  header.max_time = header.min_time + reader.Varint();
+  header.time_bytes = static_cast<size_t>(reader.Varint());
+  header.quality_bytes = static_cast<size_t>(reader.Varint());
+  header.value_bytes = static_cast<size_t>(reader.Varint());
+  return reader.IsOk() &&
+      reader.Remaining() >= header.time_bytes + header.quality_bytes + header.value_bytes;
+}
+
+void EncodeTimes(const std::vector<pub_sub::RecordedSample>& sample_list,
+                 std::vector<uint8_t>& dest) {
+  // Delta-of-delta. A fixed rate gives one byte per value.
+  int64_t last_time = 0;
+  int64_t last_delta = 0;
+  for (size_t index = 0; index < sample_list.size(); ++index) {
+    const auto time = static_cast<int64_t>(sample_list[index].timestamp);
+    if (index == 0) {
+      PutVarint(dest, static_cast<uint64_t>(time));
+    } else {
+      const int64_t delta = time - last_time;
+      PutVarint(dest, ZigZag(delta - last_delta));
+      last_delta = delta;
+    }
+    last_time = time;
+  }
+}
+
+bool DecodeTimes(ByteReader& reader, std::vector<pub_sub::RecordedSample>& sample_list) {
+  int64_t last_time = 0;
+  int64_t last_delta = 0;
+  for (size_t index = 0; index < sample_list.size(); ++index) {
+    if (index == 0) {
+      last_time = static_cast<int64_t>(reader.Varint());
+    } else {
+      last_delta += UnZigZag(reader.Varint());
+      last_time += last_delta;
+    }
+    sample_list[index].timestamp = static_cast<uint64_t>(last_time);
+  }
+  return reader.IsOk();
+}
+
+void EncodeQualities(const std::vector<pub_sub::RecordedSample>& sample_list,
+                     std::vector<uint8_t>& dest) {
+  // Run-length encoded.
+  size_t index = 0;
+  while (index < sample_list.size()) {
+    const auto quality = sample_list[index].quality;
+    size_t run = 1;
+    while (index + run < sample_list.size() && sample_list[index + run].quality == quality) {
+      ++run;
+    }
+    PutVarint(dest, run);
+    dest.push_back(static_cast<uint8_t>(quality));
+    index += run;
+  }
+}
+
+bool DecodeQualities(ByteReader& reader, std::vector<pub_sub::RecordedSample>& sample_list) {
+  size_t index = 0;
+  while (index < sample_list.size() && reader.IsOk()) {
+    const auto run = static_cast<size_t>(reader.Varint());
+    const auto quality = static_cast<pub_sub::SampleQuality>(reader.Byte());
+    if (run == 0 || index + run > sample_list.size()) {
+      return false;
+    }
+    for (size_t count = 0; count < run; ++count) {
+      sample_list[index++].quality = quality;
+    }
+  }
+  return reader.IsOk();
+}
+
+void EncodeValues(ColumnType column_type,
+                  const std::vector<pub_sub::RecordedSample>& sample_list,
+                  std::vector<uint8_t>& dest) {
+  switch (column_type) {
+    case ColumnType::Integer: {
+      int64_t last_value = 0;
+      for (const auto& sample : sample_list) {
+        PutVarint(dest, ZigZag(sample.int_value - last_value));
+        last_value = sample.int_value;
+      }
+      break;
+    }
+
+    case ColumnType::Float: {
+      // XOR against the previous value. Only the non-zero middle bytes are
+      // stored, an unchanged value uses one byte.
+      uint64_t last_bits = 0;
+      for (const auto& sample : sample_list) {
+        const auto bits = std::bit_cast<uint64_t>(sample.float_value);
+        const uint64_t xor_bits = bits ^ last_bits;
+        last_bits = bits;
+        if (xor_bits == 0) {
+          dest.push_back(0);
+          continue;
+        }
+        const auto leading = static_cast<uint8_t>(std::countl_zero(xor_bits) / 8);
+        const auto trailing = static_cast<uint8_t>(std::countr_zero(xor_bits) / 8);
+        dest.push_back(static_cast<uint8_t>(0x80 | (leading << 3) | trailing));
+        const uint64_t middle = xor_bits >> (trailing * 8);
+        for (int byte = 0; byte < 8 - leading - trailing; ++byte) {
+          dest.push_back(static_cast<uint8_t>(middle >> (byte * 8)));
+        }
+      }
+      break;
+    }
+
+    case ColumnType::Text:
+    default:
+      for (const auto& sample : sample_list) {
+        PutVarint(dest, sample.text_value.size());
+        PutBytes(dest, sample.text_value.data(), sample.text_value.size());
+      }
+      break;
+  }
+}
+
+bool DecodeValues(ColumnType column_type, ByteReader& reader,
+                  std::vector<pub_sub::RecordedSample>& sample_list) {
+  switch (column_type) {
+    case ColumnType::Integer: {
+      int64_t last_value = 0;
+      for (auto& sample : sample_list) {
+        last_value += UnZigZag(reader.Varint());
+        sample.int_value = last_value;
+      }
+      break;
+    }
+
+    case ColumnType::Float: {
+      uint64_t last_bits = 0;
+      for (auto& sample : sample_list) {
+        const auto control = reader.Byte();
+        if (control != 0) {
+          const int leading = (control >> 3) & 0x07;
+          const int trailing = control & 0x07;
+          uint64_t middle = 0;
+          for (int byte = 0; byte < 8 - leading - trailing; ++byte) {
+            middle |= static_cast<uint64_t>(reader.Byte()) << (byte * 8);
+          }
+          last_bits ^= middle << (trailing * 8);
+        }
+        sample.float_value = std::bit_cast<double>(last_bits);
+      }
+      break;
+    }
+
+    case ColumnType::Text:
+    default:
+      for (auto& sample : sample_list) {
+        const auto size = static_cast<size_t>(reader.Varint());
+        if (reader.Remaining() < size) {
+          return false;
+        }
+        sample.text_value.assign(reinterpret_cast<const char*>(reader.Current()), size);
+        reader.Skip(size);
+      }
+      break;
+  }
+  return reader.IsOk();
+}
+
+/** \brief Calls the function for each chunk in a segment file.
+ *
+ * A chunk that is partly written is ignored.
+ */
+template <typename Function>
+void ForEachChunk(const std::string& filename, Function&& function) {
+  try {
+    const file_mapping file(filename.c_str(), read_only);
+    const mapped_region region(file, read_only);
+    const auto* data = static_cast<const uint8_t*>(region.get_address());
+    const auto size = region.get_size();
+    if (size < kSegmentHeader.size() ||
+        std::memcmp(data, kSegmentHeader.data(), kSegmentHeader.size()) != 0) {
+      LOG_ERROR() << "Invalid segment file. File: " << filename;
+      return;
+    }
+    ByteReader reader(data + kSegmentHeader.size(), size - kSegmentHeader.size());
+    while (reader.Remaining() > 0) {
+      const auto magic = reader.Fixed32();
+      const auto chunk_size = reader.Fixed32();
+      if (!reader.IsOk() || magic != kChunkMagic || reader.Remaining() < chunk_size) {
+        break;
+      }
+      ByteReader chunk(reader.Current(), chunk_size);
+      reader.Skip(chunk_size);
+      ChunkHeader header;
+      if (!ReadChunkHeader(chunk, header)) {
+        break;
+      }
+      function(header, chunk);
+    }
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to read segment file. Error: " << err.what()
+      << ", File: " << filename;
+  }
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+MetricRecorder::~MetricRecorder() {
+  Stop();
+}
+
+bool MetricRecorder::Start() {
+  Stop();
+  if (directory_.empty()) {
+    LOG_ERROR() << "A recorder needs a directory.";
+    return false;
+  }
+  try {
+    std::filesystem::create_directories(directory_);
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to create the recorder directory. Error: " << err.what()
+      << ", Directory: " << directory_;
+    return false;
+  }
+
+  // Never append to an existing segment. It may belong to a crashed recorder.
+  segment_index_ = 0;
+  for (const auto& filename : SegmentFiles()) {
+    const auto stem = std::filesystem::path(filename).stem().string();
+    try {
+      const auto index = static_cast<uint64_t>(std::stoull(stem.substr(kSegmentPrefix.size())));
+      segment_index_ = std::max(segment_index_, index);
+    } catch (const std::exception& ) {
+    }
+  }
+  if (!NewSegment()) {
+    return false;
+  }
+
+  {
+    std::scoped_lock lock(queue_mutex_);
+    flush_request_ = 0;
+    flush_done_ = 0;
+  }
+  active_ = true;
+  work_thread_ = std::thread(&MetricRecorder::WorkTask, this);
+  return true;
+}
+
+void MetricRecorder::Stop() {
+  {
+    std::scoped_lock lock(queue_mutex_);
+    active_ = false;
+  }
+  queue_event_.notify_all();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+  flush_event_.notify_all();
+  if (segment_file_.is_open()) {
+    segment_file_.close();
+  }
+}
+
+void MetricRecorder::Record(const std::string& group_id, const std::string& node_id,
+                            const std::string& device_id,
+                            const std::vector<std::shared_ptr<Metric>>& metric_list) {
+  if (!active_ || metric_list.empty()) {
+    return;
+  }
+  const auto now = SparkplugHelper::NowMs();
+  // One key prefix per message. The series keys are built by the writer thread.
+  const auto key_prefix = std::make_shared<const std::string>(
+      MakeSeriesKey(group_id, node_id, device_id, {}));
+  std::vector<QueueEntry> entry_list;
+  entry_list.reserve(metric_list.size());
+  for (const auto& metric : metric_list) {
+    if (!metric) {
+      continue;
+    }
+    auto& entry = entry_list.emplace_back();
+    entry.key_prefix = key_prefix;
+    entry.metric = metric;
+    entry.alias = metric->Alias();
+    entry.type = metric->Type();
+    entry.timestamp = metric->Timestamp() > 0 ? metric->Timestamp() : now;
+    if (metric->IsNull()) {
+      entry.quality = SampleQuality::Null;
+      continue;
+    }
+    entry.quality = metric->IsValid() ? SampleQuality::Good : SampleQuality::Invalid;
+    entry.value = metric->ValueText();
+  }
+
+  bool wake_up = false;
+  {
+    std::scoped_lock lock(queue_mutex_);
+    for (auto& entry : entry_list) {
+      if (queue_.size() >= max_queue_size_) {
+        ++dropped_;
+        continue;
+      }
+      queue_.push_back(std::move(entry));
+      ++recorded_;
+    }
+    // Wake the writer before the queue is full.
+    wake_up = queue_.size() >= max_queue_size_ / 2;
+  }
+  if (wake_up) {
+    queue_event_.notify_one();
+  }
+}
+
+void MetricRecorder::Flush() {
+  std::unique_lock lock(queue_mutex_);
+  if (!active_) {
+    return;
+  }
+  const auto request = ++flush_request_;
+  queue_event_.notify_one();
+  flush_event_.wait(lock, [&] () -> bool {
+    return !active_ || flush_done_ >= request;
+  });
+}
+
+std::string MetricRecorder::MakeSeriesKey(std::string_view group_id,
+                                          std::string_view node_id,
+                                          std::string_view device_id,
+                                          std::string_view metric_name) {
+  std::string key;
+  key.reserve(group_id.size() + node_id.size() + device_id.size() + metric_name.size() + 3);
+  key.append(group_id).append("/").append(node_id).append("/")
+    .append(device_id).append("/").append(metric_name);
+  return key;
+}
+
+std::vector<std::string> MetricRecorder::SeriesKeys() const {
+  std::vector<std::string> key_list;
+  for (const auto& filename : SegmentFiles()) {
+    ForEachChunk(filename, [&] (const ChunkHeader& header, ByteReader&) {
+      key_list.emplace_back(header.series_key);
+    });
+  }
+  std::sort(key_list.begin(), key_list.end());
+  key_list.erase(std::unique(key_list.begin(), key_list.end()), key_list.end());
+  return key_list;
+}
+
+std::vector<RecordedSample> MetricRecorder::Query(std::string_view series_key,
+                                                  uint64_t from_time,
+                                                  uint64_t to_time) const {
+  std::vector<RecordedSample> result;
+  std::vector<RecordedSample> sample_list;
+  for (const auto& filename : SegmentFiles()) {
+    ForEachChunk(filename, [&] (const ChunkHeader& header, ByteReader& reader) {
+      if (header.series_key != series_key || header.max_time < from_time ||
+          header.min_time > to_time) {
+        return;
+      }
+      sample_list.clear();
+      sample_list.resize(header.count);
+      ByteReader time_reader(reader.Current(), header.time_bytes);
+      reader.Skip(header.time_bytes);
+      ByteReader quality_reader(reader.Current(), header.quality_bytes);
+      reader.Skip(header.quality_bytes);
+      ByteReader value_reader(reader.Current(), header.value_bytes);
+      if (!DecodeTimes(time_reader, sample_list) ||
+          !DecodeQualities(quality_reader, sample_list) ||
+          !DecodeValues(ToColumnType(header.type), value_reader, sample_list)) {
+        LOG_ERROR() << "Invalid chunk in segment file. Series: " << series_key
+          << ", File: " << filename;
+        return;
+      }
+      for (auto& sample : sample_list) {
+        if (sample.timestamp >= from_time && sample.timestamp <= to_time) {
+          result.push_back(std::move(sample));
+        }
+      }
+    });
+  }
+  std::stable_sort(result.begin(), result.end(),
+                   [] (const RecordedSample& sample1, const RecordedSample& sample2) -> bool {
+    return sample1.timestamp < sample2.timestamp;
+  });
+  return result;
+}
+
+void MetricRecorder::WorkTask() {
+  std::deque<QueueEntry> entry_list;
+  while (true) {
+    uint64_t flush_request = 0;
+    bool stop = false;
+    {
+      std::unique_lock lock(queue_mutex_);
+      queue_event_.wait_for(lock, 100ms, [&] () -> bool {
+        return !active_ || flush_request_ != flush_done_ ||
+            queue_.size() >= max_queue_size_ / 2;
+      });
+      entry_list.swap(queue_);
+      flush_request = flush_request_;
+      stop = !active_;
+    }
+
+    for (auto& entry : entry_list) {
+      AddToChunk(entry);
+    }
+    entry_list.clear();
+
+    const bool flush_all = stop || flush_request != flush_done_;
+    const auto now = SparkplugHelper::NowMs();
+    for (auto& [series_key, chunk] : chunk_list_) {
+      if (!chunk.sample_list.empty() &&
+          (flush_all || now >= chunk.first_time + flush_interval_)) {
+        WriteChunk(series_key, chunk);
+      }
+    }
+    if (segment_file_.is_open()) {
+      segment_file_.flush();
+    }
+
+    {
+      std::scoped_lock lock(queue_mutex_);
+      flush_done_ = flush_request;
+    }
+    flush_event_.notify_all();
+    if (stop) {
+      break;
+    }
+  }
+  chunk_list_.clear();
+}
+
+void MetricRecorder::AddToChunk(QueueEntry& entry) {
+  if (!entry.key_prefix || !entry.metric) {
+    return;
+  }
+  series_key_.assign(*entry.key_prefix).append(entry.metric->Name());
+  auto itr = chunk_list_.find(series_key_);
+  if (itr == chunk_list_.end()) {
+    itr = chunk_list_.emplace(series_key_, Chunk()).first;
+  }
+  const auto& series_key = itr->first;
+  auto& chunk = itr->second;
+  if (!chunk.sample_list.empty() &&
+      (chunk.alias != entry.alias || ToColumnType(chunk.type) != ToColumnType(entry.type))) {
+    // A new birth may change the alias or data type.
+    WriteChunk(series_key, chunk);
+  }
+  if (chunk.sample_list.empty()) {
+    chunk.alias = entry.alias;
+    chunk.type = entry.type;
+    chunk.first_time = SparkplugHelper::NowMs();
+    chunk.sample_list.reserve(chunk_size_);
+  }
+  auto& sample = chunk.sample_list.emplace_back();
+  sample.timestamp = entry.timestamp;
+  sample.quality = entry.quality;
+  if (sample.quality != SampleQuality::Null) {
+    const auto text = entry.value.View();
+    switch (ToColumnType(entry.type)) {
+      case ColumnType::Integer:
+        if (entry.type == MetricType::UInt64) {
+          sample.int_value = static_cast<int64_t>(ParseNumber<uint64_t>(text));
+        } else if (entry.type == MetricType::Boolean) {
+          sample.int_value = ParseBoolean(text) ? 1 : 0;
+        } else {
+          sample.int_value = ParseNumber<int64_t>(text);
+        }
+        break;
+
+      case ColumnType::Float:
+        sample.float_value = ParseNumber<double>(text);
+        break;
+
+      case ColumnType::Text:
+      default:
+        sample.text_value = text;
+        break;
+    }
+  }
+  if (chunk.sample_list.size() >= chunk_size_) {
+    WriteChunk(series_key, chunk);
+  }
+}
+
+void MetricRecorder::WriteChunk(const std::string& series_key, Chunk& chunk) {
+  const auto& sample_list = chunk.sample_list;
+  if (sample_list.empty()) {
+    return;
+  }
+  const auto [min_itr, max_itr] = std::minmax_element(sample_list.cbegin(), sample_list.cend(),
+      [] (const RecordedSample& sample1, const RecordedSample& sample2) -> bool {
+    return sample1.timestamp < sample2.timestamp;
+  });
+
+  std::vector<uint8_t> time_column;
+  std::vector<uint8_t> quality_column;
+  std::vector<uint8_t> value_column;
+  EncodeTimes(sample_list, time_column);
+  EncodeQualities(sample_list, quality_column);
+  EncodeValues(ToColumnType(chunk.type), sample_list, value_column);
+
+  std::vector<uint8_t> body;
+  body.reserve(series_key.size() + 64 + time_column.size() + quality_column.size()
+                 + value_column.size());
+  PutVarint(body, series_key.size());
+  PutBytes(body, series_key.data(), series_key.size());
+  PutVarint(body, chunk.alias);
+  PutVarint(body, static_cast<uint64_t>(chunk.type));
+  PutVarint(body, sample_list.size());
+  PutVarint(body, min_itr->timestamp);
+  PutVarint(body, max_itr->timestamp - min_itr->timestamp);
+  PutVarint(body, time_column.size());
+  PutVarint(body, quality_column.size());
+  PutVarint(body, value_column.size());
+  PutBytes(body, time_column.data(), time_column.size());
+  PutBytes(body, quality_column.data(), quality_column.size());
+  PutBytes(body, value_column.data(), value_column.size());
+
+  std::vector<uint8_t> block;
+  block.reserve(body.size() + 8);
+  PutFixed32(block, kChunkMagic);
+  PutFixed32(block, static_cast<uint32_t>(body.size()));
+  PutBytes(block, body.data(), body.size());
+
+  const auto count = sample_list.size();
+  chunk.sample_list.clear();
+  if (segment_size_ > kSegmentHeader.size() &&
+      segment_size_ + block.size() > max_segment_size_) {
+    NewSegment();
+  }
+  if (!segment_file_.is_open()) {
+    dropped_ += count;
+    return;
+  }
+  segment_file_.write(reinterpret_cast<const char*>(block.data()),
+                      static_cast<std::streamsize>(block.size()));
+  segment_size_ += block.size();
+}
+
+bool MetricRecorder::NewSegment() {
+  if (segment_file_.is_open()) {
+    segment_file_.close();
+  }
+  std::ostringstream name;
+  name << kSegmentPrefix << std::setw(6) << std::setfill('0') << ++segment_index_
+       << kSegmentExtension;
+  const auto filename = (std::filesystem::path(directory_) / name.str()).string();
+  segment_file_.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!segment_file_.is_open()) {
+    LOG_ERROR() << "Failed to create a segment file. File: " << filename;
+    return false;
+  }
+  segment_file_.write(kSegmentHeader.data(),
+                      static_cast<std::streamsize>(kSegmentHeader.size()));
+  segment_file_.flush();
+  segment_size_ = kSegmentHeader.size();
+  return true;
+}
+
+std::vector<std::string> MetricRecorder::SegmentFiles() const {
+  std::vector<std::string> file_list;
+  try {
+    if (directory_.empty() || !std::filesystem::exists(directory_)) {
+      return file_list;
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+      const auto& path = entry.path();
+      if (entry.is_regular_file() && path.extension() == kSegmentExtension &&
+          path.stem().string().starts_with(kSegmentPrefix)) {
+        file_list.push_back(path.string());
+      }
+    }
+  } catch (const std::exception& err) {
+    LOG_ERROR() << "Failed to list the segment files. Error: " << err.what()
+      << ", Directory: " << directory_;
+  }
+  std::sort(file_list.begin(), file_list.end());
+  return file_list;
+}
+
+} // pub_sub
@@ -4,8 +4,13 @@
  */
 #include "mqttclient.h"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cstring>
 #include <functional>
+#include <span>
+#include <string_view>
 
 
 #include <util/logstream.h>
@@ -21,6 +26,128 @@ using namespace util::log;
 
 namespace {
 
+std::string_view Trim(std::string_view text) {
+  constexpr std::string_view kSpaces = " \t\r\n";
+  const auto first = text.find_first_not_of(kSpaces);
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  const auto last = text.find_last_not_of(kSpaces);
+  return text.substr(first, last - first + 1);
+}
+
+template <typename T>
+bool IsNumber(std::string_view text) {
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+  }
+  T value = {};
+  const auto* last = text.data() + text.size();
+  const auto [ptr, error] = std::from_chars(text.data(), last, value);
+  return error == std::errc() && ptr == last;
+}
+
+/** \brief Sets a metric value from an MQTT text payload.
+ *
+ * Numbers are validated directly on the payload bytes. A number may be
+ * followed by a unit, e.g. '23.4 C'. The metric value is assigned into the
+ * metric's existing string, so normally no memory is allocated.
+ * @return False if the text doesn't match the metric type.
+ */
+bool DecodeText(pub_sub::Metric& metric, std::string_view text) {
+  using pub_sub::MetricType;
+  const auto type = metric.Type();
+  if (type < MetricType::Int8 || type > MetricType::Boolean) {
+    metric.Value(text);
+    return true;
+  }
+
+  text = Trim(text);
+  std::string_view number = text;
+  if (const auto space = text.find(' '); space != std::string_view::npos) {
+    number = text.substr(0, space);
+    if (metric.Unit().empty()) {
+      metric.Unit(std::string(Trim(text.substr(space + 1))));
+    }
+  }
+
+  bool valid = false;
+  switch (type) {
+    case MetricType::Int8:
+    case MetricType::Int16:
+    case MetricType::Int32:
+    case MetricType::Int64:
+      valid = IsNumber<int64_t>(number);
+      break;
+
+    case MetricType::UInt8:
+    case MetricType::UInt16:
+    case MetricType::UInt32:
+    case MetricType::UInt64:
+      valid = IsNumber<uint64_t>(number);
+      break;
+
+    case MetricType::Float:
+    case MetricType::Double:
+      valid = IsNumber<double>(number);
+      break;
+
+    case MetricType::Boolean:
+      if (number == "1" || number == "true" || number == "True" || number == "TRUE") {
+        number = "1";
+        valid = true;
+      } else if (number == "0" || number == "false" || number == "False" || number == "FALSE") {
+        number = "0";
+        valid = true;
+      }
+      break;
+
+    default:
+      break;
+  }
+  if (!valid) {
+    metric.IsValid(false);
+    return false;
+  }
+  if (!number.empty() && number.front() == '+') {
+    number.remove_prefix(1);
+  }
+  metric.Value(number);
+  return true;
+}
+
+/** \brief Selects the metric type of a new MQTT text topic.
+ *
+ * The content type may define the type as a parameter,
+ * e.g. 'text/plain; type=double'. Otherwise the type is guessed from the
+ * first value. A number that may be followed by a unit, becomes a double.
+ */
+pub_sub::MetricType InferTextType(std::string_view content_type, std::string_view text) {
+  using pub_sub::MetricType;
+  if (const auto param = content_type.find("type="); param != std::string_view::npos) {
+    auto type = Trim(content_type.substr(param + 5));
+    type = type.substr(0, type.find(';'));
+    if (type == "bool" || type == "boolean") {
+      return MetricType::Boolean;
+    }
+    if (type == "int" || type == "integer") {
+      return MetricType::Int64;
+    }
+    if (type == "float" || type == "double" || type == "number") {
+      return MetricType::Double;
+    }
+    return MetricType::String;
+  }
+
+  text = Trim(text);
+  if (text == "true" || text == "True" || text == "TRUE" ||
+      text == "false" || text == "False" || text == "FALSE") {
+    return MetricType::Boolean;
+  }
+  const auto number = text.substr(0, text.find(' '));
+  return IsNumber<double>(number) ? MetricType::Double : MetricType::String;
+}
+
 } // end namespace
 
 namespace pub_sub {
@@ -46,10 +173,7 @@ MqttClient::~MqttClient() {
 ITopic *MqttClient::CreateTopic() {
 
   auto topic = std::make_unique<MqttTopic>(*this);
-  std::scoped_lock list_lock(topic_mutex_);
-
-  topic_list_.emplace_back(std::move(topic));
-  return topic_list_.back().get();
+  return AddTopic(std::move(topic));
 }
 
 
@@ -86,7 +210,17 @@ ITopic *MqttClient::AddMetric(const std::shared_ptr<Metric>& metric) {
 }
 
 bool MqttClient::IsConnected() const {
-  return handle_ != nullptr && MQTTAsync_isConnected(handle_);
+  const MQTTAsync handle = handle_;
+  return handle != nullptr && MQTTAsync_isConnected(handle);
+}
+
+void MqttClient::DestroyHandle() {
+  // The outbound queue's thread may send with the handle.
+  auto send_lock = outbound_.LockSend();
+  if (MQTTAsync handle = handle_.exchange(nullptr); handle != nullptr) {
+    MQTTAsync_destroy(&handle);
+    outbound_.Reset();
+  }
 }
 
 bool MqttClient::Start() {
@@ -99,6 +233,7 @@ bool MqttClient::Start() {
 
   ResetConnectionLost();
   client_timer_ = 0;
+  outbound_.Start();
   stop_client_task_ = false;
   work_thread_ = std::thread(&MqttClient::ClientTask, this);
 
@@ -136,10 +271,12 @@ bool MqttClient::CreateClient() {
 
   MQTTAsync_createOptions create_options = MQTTAsync_createOptions_initializer5;
 
-  const auto create = MQTTAsync_createWithOptions(&handle_, connect_string.str().c_str(),
+  MQTTAsync handle = nullptr;
+  const auto create = MQTTAsync_createWithOptions(&handle, connect_string.str().c_str(),
                                        Name().c_str(),
                                  MQTTCLIENT_PERSISTENCE_NONE, nullptr,
                                  Version() == ProtocolVersion::Mqtt5 ? &create_options : nullptr);
+  handle_ = handle;
   if (create != MQTTASYNC_SUCCESS) {
     std::ostringstream err;
     err << "Failed to create the MQTT handle.";
@@ -262,10 +399,8 @@ bool MqttClient::Stop() {
   if (work_thread_.joinable()) {
     work_thread_.join();
   }
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  outbound_.Stop();
+  DestroyHandle();
 
   return true;
 
@@ -288,6 +423,20 @@ void MqttClient::Message(const std::string& topic_name, const MQTTAsync_message&
   if (topic_name.empty()) {
     return;
   }
+  if (capture_.IsActive()) {
+    capture_.Capture(topic_name, message.payload,
+                     message.payloadlen > 0 ? static_cast<size_t>(message.payloadlen) : 0,
+                     message.retained != 0);
+  }
+  if (!matcher_.IsEmpty()) {
+    const std::span<const uint8_t> body(static_cast<const uint8_t*>(message.payload),
+                                        message.payload != nullptr ? message.payloadlen : 0);
+    if (matcher_.Dispatch(topic_name, body) > 0) {
+      statistics_.AddMessageIn(static_cast<size_t>(message.payloadlen));
+      ResetConnectionLost();
+      return;
+    }
+  }
   auto* topic = GetTopic(topic_name);
   if (topic == nullptr) {
     // The topic and its value do not exist. Create a topic and a metric for this topic
@@ -296,13 +445,24 @@ void MqttClient::Message(const std::string& topic_name, const MQTTAsync_message&
     if (topic != nullptr) {
       topic->Topic(topic_name);
       topic->Publish(false);
+      // The MQTT 5 content type defines how the payload is decoded.
+      auto* content_type = MQTTProperties_getProperty(
+          const_cast<MQTTProperties*>(&message.properties), MQTTPROPERTY_CODE_CONTENT_TYPE);
+      if (content_type != nullptr && content_type->value.data.data != nullptr) {
+        topic->ContentType(std::string(content_type->value.data.data,
+                                       static_cast<size_t>(content_type->value.data.len)));
+      }
     }
   }
   if (topic == nullptr) {
     LOG_ERROR() << "Failed to create topic. Topic: " << topic_name;
     return;
   }
+  statistics_.AddMessageIn(static_cast<size_t>(message.payloadlen));
+  topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
+  ScopedTimer parse_timer(statistics_.ParseTime(), &topic->Statistics().ProcessTime());
 
+  // The body keeps its capacity between messages.
   auto& payload = topic->GetPayload();
   auto& body = payload.Body();
   try {
@@ -311,20 +471,45 @@ void MqttClient::Message(const std::string& topic_name, const MQTTAsync_message&
       std::memcpy(body.data(), message.payload, message.payloadlen);
     }
   } catch(const std::exception& err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse payload. Topic: " << topic_name << ", Error: " << err.what();
     return;
   }
 
-  auto metric = payload.GetMetric(topic_name);
-  if (!metric) {
-    metric = std::make_shared<Metric>(topic_name);
-    metric->Timestamp(SparkplugHelper::NowMs());
-    metric->Type(MetricType::String);
-  }
-
   payload.Timestamp(SparkplugHelper::NowMs(), true);
-  metric->Value(payload.BodyToString());
-  metric->FireOnMessage();
+  if (topic->IsJson() || topic->IsProtobuf()) {
+    if (topic->IsJson()) {
+      payload.ParseSparkplugJson(true);
+    } else {
+      payload.ParseSparkplugProtobuf(true);
+    }
+    const auto metric_list = payload.ParsedMetrics();
+    for (const auto& metric : metric_list) {
+      metric->FireOnMessage();
+    }
+    NotifyChanges(*topic, metric_list);
+  } else {
+    // Text payload. The value is stored in a metric with the topic name.
+    const auto* text = reinterpret_cast<const char*>(body.data());
+    const std::string_view value(text, std::find(text, text + body.size(), '\0') - text);
+    auto metric = payload.GetMetric(topic_name);
+    if (!metric) {
+      metric = payload.CreateMetric(topic_name);
+      if (metric) {
+        metric->Type(InferTextType(topic->ContentType(), value));
+        metric->Timestamp(SparkplugHelper::NowMs());
+      }
+    }
+    if (metric) {
+      if (!DecodeText(*metric, value)) {
+        statistics_.AddParseError();
+      }
+      metric->FireOnMessage();
+      if (HasChangeListeners()) {
+        NotifyChanges(*topic, {metric});
+      }
+    }
+  }
 
   ResetConnectionLost();
   topic->Qos(static_cast<QualityOfService>(message.qos));
@@ -336,6 +521,38 @@ void MqttClient::Message(const std::string& topic_name, const MQTTAsync_message&
   }
 }
 
+void MqttClient::InjectMessage(const std::string& topic_name, const void* payload,
+                               size_t payload_size, bool retained) {
+  MQTTAsync_message message = MQTTAsync_message_initializer;
+  if (payload != nullptr && payload_size > 0) {
+    message.payload = const_cast<void*>(payload);
+    message.payloadlen = static_cast<int>(payload_size);
+  }
+  message.retained = retained ? 1 : 0;
+  Message(topic_name, message);
+}
+
+size_t MqttClient::QueueDepth() const {
+  // Messages in the outbound queue are not yet handed over to the MQTT library.
+  const size_t queued = outbound_.QueueDepth();
+  const MQTTAsync handle = handle_;
+  if (handle == nullptr) {
+    return queued;
+  }
+  MQTTAsync_token* token_list = nullptr;
+  const int pending = MQTTAsync_getPendingTokens(handle, &token_list);
+  size_t count = 0;
+  if (pending == MQTTASYNC_SUCCESS && token_list != nullptr) {
+    while (token_list[count] != -1) {
+      ++count;
+    }
+  }
+  if (token_list != nullptr) {
+    MQTTAsync_free(token_list);
+  }
+  return queued + count;
+}
+
 void MqttClient::DeliveryComplete(MQTTAsync_token ) {
   ResetConnectionLost();
 }
@@ -365,6 +582,7 @@ void MqttClient::Connect(const MQTTAsync_successData& response) {
 
   }
   const int session_present = connect.sessionPresent;
+  ResetTopicAliases(0);
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("Connected: Server: %s, Version: %d, Session: %d",
                                 server_url.c_str(), version, session_present);
@@ -419,6 +637,12 @@ void MqttClient::Connect5(const MQTTAsync_successData5& response) {
 
   }
   const int session_present = connect.sessionPresent;
+
+  // Topic aliases are only valid within this network connection.
+  auto& properties = const_cast<MQTTProperties&>(response.properties);
+  const int alias_max = MQTTProperties_hasProperty(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) ?
+      MQTTProperties_getNumericValue(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) : 0;
+  ResetTopicAliases(alias_max > 0 ? static_cast<uint16_t>(alias_max) : 0);
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("Connected: Server: %s, Version: %d, Session: %d",
                         server_url.c_str(), version, session_present);
@@ -541,6 +765,7 @@ void MqttClient::OnConnectionLost(void *context, char *cause) {
 
 int MqttClient::OnMessageArrived(void* context, char* topic_name, int topicLen, MQTTAsync_message* message) {
   auto *client = reinterpret_cast<MqttClient *>(context);
+  OutboundQueue::NonBlockingThread(); // Publishing shall not delay the acknowledges
   const std::string topic_id = topic_name != nullptr && topicLen > 0 ? topic_name : "";
 
   if (client != nullptr && message != nullptr && !topic_id.empty()) {
@@ -642,12 +867,10 @@ bool MqttClient::IsOffline() const {
 }
 
 void MqttClient::ClientTask() {
+  OutboundQueue::NonBlockingThread();
   client_timer_ = 0;
   client_state_ = ClientState::Idle;
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  DestroyHandle();
 
   while (!stop_client_task_) {
     std::unique_lock client_lock(client_mutex_);
@@ -702,11 +925,7 @@ void MqttClient::ClientTask() {
     }
   }
 
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
-
+  DestroyHandle();
 }
 
 void MqttClient::StartSubscription() {
@@ -740,10 +959,7 @@ void MqttClient::DoIdle() {
   const bool timeout = now >= client_timer_;
 
   // Destroy any previously created context/handle.
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  DestroyHandle();
 
   // Check the retry timeout first (10s)
   // Check if in service
@@ -27,6 +27,9 @@ class MqttClient : public IPubSubClient {
   bool Stop() override;
 
   [[nodiscard]] bool IsConnected() const override;
+  [[nodiscard]] size_t QueueDepth() const override;
+  void InjectMessage(const std::string& topic_name, const void* payload,
+                     size_t payload_size, bool retained) override;
 
   [[nodiscard]] ITopic* CreateTopic() override;
   [[nodiscard]] ITopic* AddMetric(const std::shared_ptr<Metric>& value) override;
@@ -42,7 +45,7 @@ class MqttClient : public IPubSubClient {
   [[nodiscard]] bool IsOffline() const override;
 
  private:
-  MQTTAsync handle_ = nullptr;
+  std::atomic<MQTTAsync> handle_ = nullptr; ///< Read by the outbound queue's thread.
   std::unique_ptr<util::log::IListen> listen_;
   std::condition_variable client_event_; ///< Can be used to speed up the scanning of the thread
   std::mutex client_mutex_; ///< Used to wait for events
@@ -79,6 +82,7 @@ class MqttClient : public IPubSubClient {
 
   void ClientTask();
   bool CreateClient();
+  void DestroyHandle();
 
   void ConnectionLost(const std::string& cause);
   void Message(const std::string& topic_name, const MQTTAsync_message& message);
@@ -14,19 +14,30 @@ MqttTopic::MqttTopic(MqttClient &parent)
 : parent_(parent) {
 }
 
-void MqttTopic::DoPublish() {
+MqttTopic::~MqttTopic() {
+  parent_.Outbound().Discard(*this);
+}
+
+void MqttTopic::DoPublish(std::shared_ptr<DeliveryPromise> delivery) {
   if (!Publish()) {
+    if (delivery) {
+      delivery->set_value({});
+    }
     return;
   }
   // Generate the payload
   auto& payload = GetPayload();
+  auto& statistics = parent_.Statistics();
   // Fill the body with MQTT
-  if (IsJson()) {
-    payload.GenerateJson();
-  } else if (IsProtobuf()) {
-    payload.GenerateProtobuf();
-  } else {
-    payload.GenerateText();
+  {
+    ScopedTimer encode_timer(statistics.EncodeTime(), &Statistics().ProcessTime());
+    if (IsJson()) {
+      payload.GenerateJson();
+    } else if (IsProtobuf()) {
+      payload.GenerateProtobuf();
+    } else {
+      payload.GenerateText();
+    }
   }
 
  // lrv_ = PayloadBody<std::vector<uint8_t>>();
@@ -36,7 +47,11 @@ void MqttTopic::DoPublish() {
     listen.ListenText("Publish: %s: %s", Topic().c_str(), text.c_str());
   }
 
-  auto& body = payload.Body();
+  parent_.Outbound().Publish(*this, payload.Body(), false, std::move(delivery));
+}
+
+bool MqttTopic::SendBody(std::vector<uint8_t>& body, int& token) {
+  auto& statistics = parent_.Statistics();
   MQTTAsync_message  message = MQTTAsync_message_initializer;
   message.payload = body.data();
   message.payloadlen = static_cast<int>(body.size());
@@ -45,30 +60,69 @@ void MqttTopic::DoPublish() {
 
   MQTTAsync_responseOptions options = MQTTAsync_responseOptions_initializer;
   if (parent_.Version() == ProtocolVersion::Mqtt5) {
+    options.onSuccess5 = OnSend5;
     options.onFailure5 = OnSendFailure5;
   } else {
+    options.onSuccess = OnSend;
     options.onFailure = OnSendFailure;
   }
   options.context = this;
 
-  const auto send = MQTTAsync_sendMessage(parent_.Handle(), Topic().c_str(), &message, &options );
-  if (send != MQTTASYNC_SUCCESS) {
-    SetAllMetricsInvalid();
-    std::ostringstream err;
-    err << "Failed to publish to the MQTT broker.";
-    const auto* cause = MQTTAsync_strerror(send);
-    if (cause != nullptr && strlen(cause) > 0) {
-      err << "Error: " << cause;
-    }
-    LOG_ERROR() << err.str();
+  // Replace the topic name with a topic alias after the first publish
+  bool send_name = true;
+  const uint16_t alias = GetTopicAlias(parent_, send_name);
+  if (alias > 0) {
+    MQTTProperty property;
+    property.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+    property.value.integer2 = alias;
+    MQTTProperties_add(&message.properties, &property);
+  }
+  const char* topic_name = send_name ? Topic().c_str() : "";
+
+  const auto send = MQTTAsync_sendMessage(parent_.Handle(), topic_name, &message, &options );
+  MQTTProperties_free(&message.properties);
+  token = options.token;
+  if (send == MQTTASYNC_SUCCESS) {
+    statistics.AddMessageOut(body.size());
+    Statistics().AddMessage(body.size());
+    return true;
   }
+  statistics.AddPublishFailure();
+  Statistics().AddFailure();
+  SetAllMetricsInvalid();
+  std::ostringstream err;
+  err << "Failed to publish to the MQTT broker.";
+  const auto* cause = MQTTAsync_strerror(send);
+  if (cause != nullptr && strlen(cause) > 0) {
+    err << "Error: " << cause;
+  }
+  LOG_ERROR() << err.str();
+  return false;
+}
+
+void MqttTopic::OnSend(void *context, MQTTAsync_successData *response) {
+  auto *topic = reinterpret_cast<MqttTopic *>(context);
+  if (topic != nullptr ) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, true);
+    topic->ConfirmTopicAlias();
+  }
+}
 
+void MqttTopic::OnSend5(void *context, MQTTAsync_successData5 *response) {
+  auto *topic = reinterpret_cast<MqttTopic *>(context);
+  if (topic != nullptr ) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, true);
+    topic->ConfirmTopicAlias();
+  }
 }
 
 void MqttTopic::OnSendFailure(void *context, MQTTAsync_failureData *response) {
   auto *topic = reinterpret_cast<MqttTopic *>(context);
   if (topic != nullptr ) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, false);
     topic->SetAllMetricsInvalid();
+    topic->parent_.Statistics().AddPublishFailure();
+    topic->Statistics().AddFailure();
 
     auto& listen = topic->parent_.Listen();
     if (listen.IsActive() && response != nullptr) {
@@ -82,7 +136,10 @@ void MqttTopic::OnSendFailure(void *context, MQTTAsync_failureData *response) {
 void MqttTopic::OnSendFailure5(void *context, MQTTAsync_failureData5 *response) {
   auto *topic = reinterpret_cast<MqttTopic *>(context);
   if (topic != nullptr ) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, false);
     topic->SetAllMetricsInvalid();
+    topic->parent_.Statistics().AddPublishFailure();
+    topic->Statistics().AddFailure();
 
     auto& listen = topic->parent_.Listen();
     if (listen.IsActive() && response != nullptr) {
@@ -16,13 +16,18 @@ class MqttTopic : public ITopic {
  public:
   explicit MqttTopic(MqttClient& parent);
   MqttTopic() = delete;
-  void DoPublish() override;
+  ~MqttTopic() override;
+  using ITopic::DoPublish;
+  void DoPublish(std::shared_ptr<DeliveryPromise> delivery) override;
+  bool SendBody(std::vector<uint8_t>& body, int& token) override;
 
  protected:
 
  private:
   MqttClient& parent_;
 
+  static void OnSend(void *context, MQTTAsync_successData *response);
+  static void OnSend5(void *context, MQTTAsync_successData5 *response);
   static void OnSendFailure(void *context, MQTTAsync_failureData *response);
   static void OnSendFailure5(void *context, MQTTAsync_failureData5 *response);
 
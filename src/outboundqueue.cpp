@@ -0,0 +1,350 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/outboundqueue.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "pubsub/itopic.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+thread_local bool non_blocking_thread = false;
+
+uint64_t SteadyNs() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+OutboundQueue::~OutboundQueue() {
+  Stop();
+}
+
+bool OutboundQueue::Start() {
+  Stop();
+  active_ = true;
+  work_thread_ = std::thread(&OutboundQueue::WorkTask, this);
+  return true;
+}
+
+void OutboundQueue::Stop() {
+  {
+    std::scoped_lock lock(queue_mutex_);
+    active_ = false;
+  }
+  queue_event_.notify_all();
+  space_event_.notify_all();
+  if (work_thread_.joinable()) {
+    work_thread_.join();
+  }
+  std::scoped_lock lock(queue_mutex_);
+  FailAll();
+}
+
+void OutboundQueue::NonBlockingThread() {
+  non_blocking_thread = true;
+}
+
+bool OutboundQueue::IsNonBlockingThread() {
+  return non_blocking_thread;
+}
+
+bool OutboundQueue::Publish(ITopic& topic, std::vector<uint8_t>& body, bool keep,
+                            std::shared_ptr<DeliveryPromise> delivery) {
+  if (!active_) {
+    std::scoped_lock send_lock(send_mutex_);
+    int token = 0;
+    const bool sent = topic.SendBody(body, token);
+    if (delivery) {
+      delivery->set_value({token, sent, 0});
+    }
+    return sent;
+  }
+  {
+    // Send directly if nothing is waiting. No copy of the body is made.
+    std::scoped_lock send_lock(send_mutex_);
+    std::unique_lock lock(queue_mutex_);
+    if (queue_.empty() && in_flight_ < window_) {
+      ++in_flight_;
+      lock.unlock();
+      return Send(topic, body, std::move(delivery));
+    }
+  }
+
+  auto policy = topic.Policy();
+  if (policy == PublishPolicy::Block && non_blocking_thread) {
+    policy = PublishPolicy::DropOldest;
+  }
+  std::unique_lock lock(queue_mutex_);
+  if (!keep && policy == PublishPolicy::Conflate && topic.IsConflatable()) {
+    auto itr = std::find_if(queue_.begin(), queue_.end(), [&] (const Message& queued) -> bool {
+      return queued.topic == &topic && !queued.keep;
+    });
+    if (itr != queue_.end()) {
+      // The replaced message is never sent.
+      if (itr->delivery) {
+        itr->delivery->set_value({});
+      }
+      queue_bytes_ -= itr->body.size();
+      itr->body = body;
+      itr->delivery = std::move(delivery);
+      queue_bytes_ += body.size();
+      ++conflated_;
+      return true;
+    }
+  }
+
+  Message message = {&topic, body, keep, std::move(delivery)};
+  if (!keep && !queue_.empty() && queue_bytes_ + body.size() > byte_limit_) {
+    switch (policy) {
+      case PublishPolicy::DropOldest:
+      case PublishPolicy::Conflate:
+        DropOldest(body.size());
+        if (!queue_.empty() && queue_bytes_ + body.size() > byte_limit_) {
+          // Only kept messages are queued. Drop the new message instead.
+          Drop(message);
+          return false;
+        }
+        break;
+
+      case PublishPolicy::Block:
+      default: {
+        const bool space = space_event_.wait_for(lock,
+                                                 std::chrono::milliseconds(block_timeout_.load()),
+                                                 [&] () -> bool {
+          return !active_ || queue_.empty() || queue_bytes_ + body.size() <= byte_limit_;
+        });
+        if (!space || !active_) {
+          Drop(message);
+          return false;
+        }
+        break;
+      }
+    }
+  }
+  queue_bytes_ += message.body.size();
+  queue_.push_back(std::move(message));
+  lock.unlock();
+  queue_event_.notify_one();
+  return true;
+}
+
+void OutboundQueue::DropOldest(size_t bytes) {
+  auto itr = queue_.begin();
+  while (itr != queue_.end() && queue_bytes_ + bytes > byte_limit_) {
+    if (itr->keep) {
+      ++itr;
+      continue;
+    }
+    queue_bytes_ -= itr->body.size();
+    Drop(*itr);
+    itr = queue_.erase(itr);
+  }
+}
+
+void OutboundQueue::Drop(Message& message) {
+  ++dropped_;
+  if (message.delivery) {
+    message.delivery->set_value({});
+    message.delivery.reset();
+  }
+}
+
+void OutboundQueue::FailAll() {
+  for (auto& message : queue_) {
+    Drop(message);
+  }
+  queue_.clear();
+  queue_bytes_ = 0;
+  for (auto& [token, pending] : pending_list_) {
+    if (pending.delivery) {
+      pending.delivery->set_value({token, false, 0});
+    }
+  }
+  pending_list_.clear();
+  done_list_.clear();
+  in_flight_ = 0;
+  unknown_done_ = 0;
+}
+
+void OutboundQueue::Complete(int token, bool delivered) {
+  if (!active_) {
+    return;
+  }
+  const uint64_t done_time = SteadyNs();
+  bool wake;
+  {
+    std::scoped_lock lock(queue_mutex_);
+    wake = done_list_.empty();
+    done_list_.push_back({token, delivered, done_time});
+  }
+  if (wake) {
+    queue_event_.notify_one();
+  }
+}
+
+void OutboundQueue::Reset() {
+  {
+    std::scoped_lock lock(queue_mutex_);
+    FailAll();
+  }
+  space_event_.notify_all();
+}
+
+void OutboundQueue::Discard(const ITopic& topic) {
+  {
+    // Waits for an ongoing send, as it may use the topic.
+    std::scoped_lock lock(send_mutex_, queue_mutex_);
+    auto itr = queue_.begin();
+    while (itr != queue_.end()) {
+      if (itr->topic == &topic) {
+        queue_bytes_ -= itr->body.size();
+        Drop(*itr);
+        itr = queue_.erase(itr);
+      } else {
+        ++itr;
+      }
+    }
+  }
+  space_event_.notify_all();
+}
+
+size_t OutboundQueue::QueueDepth() const {
+  std::scoped_lock lock(queue_mutex_);
+  return queue_.size();
+}
+
+size_t OutboundQueue::QueueBytes() const {
+  std::scoped_lock lock(queue_mutex_);
+  return queue_bytes_;
+}
+
+size_t OutboundQueue::InFlight() const {
+  std::scoped_lock lock(queue_mutex_);
+  return in_flight_;
+}
+
+bool OutboundQueue::Send(ITopic& topic, std::vector<uint8_t>& body,
+                         std::shared_ptr<DeliveryPromise> delivery) {
+  // The send mutex is locked, so the token is added before its completion is handled.
+  int token = 0;
+  const uint64_t send_time = SteadyNs();
+  const bool sent = topic.SendBody(body, token);
+
+  std::scoped_lock lock(queue_mutex_);
+  if (sent) {
+    ++sent_;
+    auto [itr, inserted] = pending_list_.try_emplace(token);
+    if (!inserted) {
+      // The token is reused, so the old message will never complete. Its
+      // slot is already free if it completed without a token.
+      if (itr->second.delivery) {
+        itr->second.delivery->set_value({token, false, 0});
+      }
+      if (unknown_done_ > 0) {
+        --unknown_done_;
+      } else if (in_flight_ > 0) {
+        --in_flight_;
+      }
+    }
+    itr->second = {send_time, std::move(delivery)};
+    return true;
+  }
+  // The transport will not complete a message that it didn't accept.
+  if (in_flight_ > 0) {
+    --in_flight_;
+  }
+  if (delivery) {
+    delivery->set_value({token, false, 0});
+  }
+  return false;
+}
+
+void OutboundQueue::SendQueue() {
+  std::vector<Completion> completion_list;
+  {
+    std::scoped_lock send_lock(send_mutex_);
+    std::unique_lock lock(queue_mutex_);
+    completion_list.reserve(done_list_.size());
+    for (const auto& done : done_list_) {
+      auto itr = pending_list_.find(done.token);
+      // Each completion frees a slot in the window.
+      if (in_flight_ > 0) {
+        --in_flight_;
+        if (itr == pending_list_.end()) {
+          // A failure without a response has no token. Its message is
+          // released when the token is reused or the queue is reset.
+          ++unknown_done_;
+        }
+      }
+      if (itr == pending_list_.end()) {
+        continue;
+      }
+      const auto& pending = itr->second;
+      const uint64_t latency = done.done_time > pending.send_time ?
+          done.done_time - pending.send_time : 0;
+      completion_list.push_back({{done.token, done.delivered, latency}, pending.delivery});
+      pending_list_.erase(itr);
+    }
+    done_list_.clear();
+
+    while (active_ && !queue_.empty() && in_flight_ < window_) {
+      Message message = std::move(queue_.front());
+      queue_.pop_front();
+      queue_bytes_ -= message.body.size();
+      ++in_flight_;
+      lock.unlock();
+      space_event_.notify_all();
+
+      Send(*message.topic, message.body, std::move(message.delivery));
+
+      lock.lock();
+    }
+  }
+  Deliver(completion_list);
+}
+
+void OutboundQueue::Deliver(std::vector<Completion>& completion_list) {
+  if (completion_list.empty()) {
+    return;
+  }
+  std::vector<DeliveryResult> result_list;
+  result_list.reserve(completion_list.size());
+  for (auto& completion : completion_list) {
+    if (completion.result.delivered) {
+      delivery_time_.Add(completion.result.latency);
+    }
+    if (completion.delivery) {
+      completion.delivery->set_value(completion.result);
+    }
+    result_list.push_back(completion.result);
+  }
+  if (delivery_callback_) {
+    delivery_callback_(result_list);
+  }
+}
+
+void OutboundQueue::WorkTask() {
+  // A delivery callback that publishes shall not wait on its own thread.
+  NonBlockingThread();
+  while (active_) {
+    {
+      std::unique_lock lock(queue_mutex_);
+      queue_event_.wait_for(lock, 100ms, [&] () -> bool {
+        return !active_ || !done_list_.empty() || (!queue_.empty() && in_flight_ < window_);
+      });
+    }
+    SendQueue();
+  }
+}
+
+} // pub_sub
@@ -4,8 +4,12 @@
  */
 
 #include "pubsub/payload.h"
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
 #include "sparkplug_b.pb.h"
 #include "payloadhelper.h"
+#include "sparkplughelper.h"
 #include "boost/json.hpp"
 #include "util/logstream.h"
 
@@ -14,6 +18,9 @@ using namespace boost::json;
 
 namespace pub_sub {
 
+Payload::Payload() = default;
+Payload::~Payload() = default;
+
 void Payload::Timestamp(uint64_t ms_since_1970, bool set_metrics) {
   timestamp_ = ms_since_1970;
   // Both the payload and its metric have timestamps so the below
@@ -69,6 +76,71 @@ const Payload::MetricList &Payload::Metrics() const {
   return metric_list_;
 }
 
+std::vector<std::shared_ptr<Metric>> Payload::NamedMetrics() const {
+  std::vector<std::shared_ptr<Metric>> metric_list;
+  std::scoped_lock lock(payload_mutex_);
+  metric_list.reserve(metric_list_.size());
+  for (const auto& [name, metric] : metric_list_) {
+    if (metric && !name.empty()) {
+      metric_list.push_back(metric);
+    }
+  }
+  return metric_list;
+}
+
+uint64_t Payload::Commit() {
+  // The version and its snapshot are changed together, so a reader
+  // cannot rebuild the snapshot in between.
+  std::scoped_lock lock(commit_mutex_);
+  ++value_version_;
+  return MakeSnapshot();
+}
+
+uint64_t Payload::MakeSnapshot() const {
+  // Note that the caller shall hold the commit lock. The parsers update the
+  // metrics under the payload lock, so all values belong to the same message.
+  std::vector<MetricValue> value_list;
+  uint64_t version = 0;
+  uint64_t timestamp = 0;
+  {
+    std::scoped_lock lock(payload_mutex_);
+    version = value_version_;
+    timestamp = Timestamp();
+    value_list.reserve(metric_list_.size());
+    for (const auto& [name, metric] : metric_list_) {
+      if (!metric || name.empty()) {
+        continue;
+      }
+      auto& value = value_list.emplace_back();
+      value.name = metric->Name();
+      value.alias = metric->Alias();
+      value.timestamp = metric->Timestamp();
+      value.type = metric->Type();
+      value.is_null = metric->IsNull();
+      value.valid = metric->IsValid();
+      value.value = metric->Value<std::string>();
+      value.unit = metric->Unit();
+    }
+  }
+  snapshot_.store(std::make_shared<const PayloadSnapshot>(version, timestamp,
+                                                          std::move(value_list)));
+  return version;
+}
+
+std::shared_ptr<const PayloadSnapshot> Payload::Snapshot() const {
+  auto snapshot = snapshot_.load();
+  if (snapshot && snapshot->Version() == value_version_) {
+    return snapshot;
+  }
+  std::scoped_lock lock(commit_mutex_);
+  snapshot = snapshot_.load();
+  if (!snapshot || snapshot->Version() != value_version_) {
+    MakeSnapshot();
+    snapshot = snapshot_.load();
+  }
+  return snapshot;
+}
+
 void Payload::DeleteMetrics(const std::string &name) {
   std::scoped_lock lock(payload_mutex_);
   auto itr = std::ranges::find_if(metric_list_, [&] (const auto& metric) {
@@ -77,6 +149,16 @@ void Payload::DeleteMetrics(const std::string &name) {
   if (itr != metric_list_.end()) {
     metric_list_.erase(itr);
   };
+  // The next birth resolves the metrics by name again.
+  std::scoped_lock alias_lock(alias_mutex_);
+  schema_fingerprint_ = 0;
+  birth_list_.clear();
+  alias_index_.clear();
+}
+
+uint64_t Payload::SchemaFingerprint() const {
+  std::scoped_lock lock(alias_mutex_);
+  return schema_fingerprint_;
 }
 
 void Payload::GenerateText() {
@@ -88,8 +170,10 @@ void Payload::GenerateJson() {
   StringToBody(json);
 }
 
-void Payload::GenerateProtobuf() {
+void Payload::GenerateProtobuf(bool write_all) {
   PayloadHelper helper(*this);
+  helper.WriteAllMetrics(write_all);
+  helper.SpliceProperties(true);
   std::scoped_lock lock(payload_mutex_);
   helper.WriteProtobuf();
 }
@@ -126,13 +210,67 @@ std::shared_ptr<Metric> Payload::CreateMetric(const std::string &name) {
   }
 }
 
-std::string Payload::MakeJsonString() const {
-  boost::json::object obj;
+std::vector<std::shared_ptr<Metric>> Payload::CreateMetrics(
+    std::span<const MetricDescriptor> descriptor_list, uint64_t first_alias) {
+  std::vector<std::shared_ptr<Metric>> metric_list(descriptor_list.size());
+  if (descriptor_list.empty()) {
+    return metric_list;
+  }
+
+  // Sorted insertion means that each insert finds its position directly.
+  std::vector<size_t> order(descriptor_list.size());
+  for (size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  const util::string::IgnoreCase less;
+  std::sort(order.begin(), order.end(), [&] (size_t index1, size_t index2) -> bool {
+    return less(descriptor_list[index1].name, descriptor_list[index2].name);
+  });
+
+  std::shared_ptr<Metric[]> block(new Metric[descriptor_list.size()]);
   std::scoped_lock lock(payload_mutex_);
-  for (const auto& [name,metric] : metric_list_) {
-    if (!metric || name.empty()) {
+  const auto alias_list = MakeAliasList(descriptor_list, first_alias);
+  for (const size_t index : order) {
+    const auto& descriptor = descriptor_list[index];
+    if (descriptor.name.empty()) {
+      LOG_ERROR() << "Metric must have a name.";
+      continue;
+    }
+    auto itr = metric_list_.lower_bound(descriptor.name);
+    if (itr != metric_list_.end() && !less(descriptor.name, itr->first)) {
+      metric_list[index] = itr->second;
       continue;
     }
+    // The metric shares the ownership of the block.
+    std::shared_ptr<Metric> metric(block, &block[index]);
+    metric->Name(descriptor.name);
+    metric->Type(descriptor.type);
+    metric->IsReadWrite(descriptor.read_only);
+    // Metrics with the same unit and properties share one property set.
+    MetricPropertyList property_list;
+    if (!descriptor.unit.empty()) {
+      property_list.emplace("unit", MetricProperty("unit", descriptor.unit));
+    }
+    for (const auto& property : descriptor.property_list) {
+      property_list.insert_or_assign(property.Key(), property);
+    }
+    if (!property_list.empty()) {
+      metric->Properties(PropertySet::Intern(std::move(property_list)));
+    }
+    if (alias_list[index] > 0) {
+      metric->Alias(alias_list[index]);
+    }
+    metric_list_.emplace_hint(itr, descriptor.name, metric);
+    metric_list[index] = std::move(metric);
+  }
+  return metric_list;
+}
+
+std::string Payload::MakeJsonString() const {
+  boost::json::object obj;
+  // The metric list is copied, so the encoding doesn't block the writers.
+  for (const auto& metric : NamedMetrics()) {
+    const auto name = metric->Name();
     if (metric->IsNull()) {
       obj[name] = nullptr;
       continue;
@@ -196,15 +334,9 @@ std::string Payload::MakeString() const {
 }
 
 std::string Payload::BodyToString() const {
-  std::ostringstream temp;
-
-  for (uint8_t data : body_) {
-    if (data == 0) {
-      break;
-    }
-    temp << static_cast<char>(data);
-  }
-  return temp.str();
+  // The text ends at the first null character.
+  const auto end = std::find(body_.cbegin(), body_.cend(), 0);
+  return {body_.cbegin(), end};
 }
 
 void Payload::StringToBody(const std::string &body_text) {
@@ -216,11 +348,71 @@ void Payload::StringToBody(const std::string &body_text) {
   }
 }
 
+std::vector<uint64_t> Payload::MakeAliasList(std::span<const MetricDescriptor> descriptor_list,
+                                             uint64_t first_alias) const {
+  // Note that the caller shall hold the payload lock.
+  std::unordered_set<uint64_t> used_list;
+  for (const auto& [name, metric] : metric_list_) {
+    if (metric && metric->Alias() > 0) {
+      used_list.insert(metric->Alias());
+    }
+  }
+  // The fixed aliases are reserved first. A fixed alias that already is in
+  // use is rejected.
+  std::vector<uint64_t> alias_list(descriptor_list.size(), 0);
+  for (size_t index = 0; index < descriptor_list.size(); ++index) {
+    const auto& descriptor = descriptor_list[index];
+    if (descriptor.alias == 0 || metric_list_.contains(descriptor.name)) {
+      continue;
+    }
+    if (!used_list.insert(descriptor.alias).second) {
+      LOG_ERROR() << "The alias is already in use. Metric: " << descriptor.name
+        << ", Alias: " << descriptor.alias;
+      continue;
+    }
+    alias_list[index] = descriptor.alias;
+  }
+  if (first_alias == 0) {
+    return alias_list;
+  }
+
+  // A metric gets the alias of its index in the range. If that alias is in
+  // use, the metric takes a free alias of the range, e.g. the alias of a
+  // metric that has a fixed alias.
+  std::vector<size_t> conflict_list;
+  for (size_t index = 0; index < descriptor_list.size(); ++index) {
+    const auto& descriptor = descriptor_list[index];
+    if (descriptor.alias > 0 || metric_list_.contains(descriptor.name)) {
+      continue;
+    }
+    if (used_list.insert(first_alias + index).second) {
+      alias_list[index] = first_alias + index;
+    } else {
+      conflict_list.push_back(index);
+    }
+  }
+  uint64_t next_alias = first_alias;
+  for (const size_t index : conflict_list) {
+    while (used_list.contains(next_alias)) {
+      ++next_alias;
+    }
+    alias_list[index] = next_alias;
+    used_list.insert(next_alias++);
+  }
+  return alias_list;
+}
+
 void Payload::ParseSparkplugJson(bool create_metrics) {
+  std::vector<std::shared_ptr<Metric>> parsed_list;
   try {
-    const auto json = BodyToString();
+    // The text ends at the first null character.
+    const auto* text = reinterpret_cast<const char*>(body_.data());
+    const std::string_view json(text, std::find(text, text + body_.size(), '\0') - text);
     const auto json_val = parse(json);
     const auto &json_obj = json_val.get_object();
+    parsed_list.reserve(json_obj.size());
+    std::scoped_lock lock(payload_mutex_);
+    ++value_version_;
     for (const auto& [key, val] : json_obj) {
       if (key.empty()) {
         continue;
@@ -283,7 +475,7 @@ void Payload::ParseSparkplugJson(bool create_metrics) {
           break;
 
         case kind::string:
-          metric->Value(std::string(val.get_string()));
+          metric->Value(std::string_view(val.get_string()));
           metric->IsNull(false);
           break;
 
@@ -295,10 +487,13 @@ void Payload::ParseSparkplugJson(bool create_metrics) {
           metric->Type(MetricType::String);
           break;
       }
+      parsed_list.push_back(std::move(metric));
     } // end for loop
   } catch( const std::exception& err) {
     LOG_ERROR() << "JSON parser fail. Error: " << err.what();
   }
+  std::scoped_lock lock(payload_mutex_);
+  parsed_list_ = std::move(parsed_list);
 }
 
 void Payload::ParseText(bool create_metrics) {
@@ -320,13 +515,36 @@ void Payload::ParseText(bool create_metrics) {
   } catch (const std::exception& ) {}
 }
 
-void Payload::ParseSparkplugProtobuf(bool create_metrics) {
+void Payload::ParseSparkplugProtobuf(bool create_metrics, bool birth_message) {
   PayloadHelper helper(*this);
   helper.CreateMetrics(create_metrics);
+  helper.BirthMessage(birth_message);
   std::scoped_lock lock(payload_mutex_);
+  ++value_version_;
+  parsed_list_.clear();
   helper.ParseProtobuf();
 }
 
+std::vector<std::shared_ptr<Metric>> Payload::ParsedMetrics() const {
+  std::scoped_lock lock(payload_mutex_);
+  return parsed_list_;
+}
+
+size_t Payload::MemoryUsage() const {
+  std::scoped_lock lock(payload_mutex_);
+  size_t bytes = sizeof(Payload);
+  bytes += SparkplugHelper::StringHeapSize(uuid_);
+  bytes += body_.capacity();
+  for (const auto& [name, metric] : metric_list_) {
+    bytes += 4 * sizeof(void*); // Map node overhead
+    bytes += SparkplugHelper::StringHeapSize(name);
+    if (metric) {
+      bytes += metric->MemoryUsage();
+    }
+  }
+  return bytes;
+}
+
 bool Payload::IsUpdated() const {
   std::scoped_lock lock(payload_mutex_);
   for (const auto&[name,metric] : metric_list_) {
@@ -4,6 +4,7 @@
  */
 
 #include "payloadhelper.h"
+#include <unordered_map>
 #include "util/logstream.h"
 #include "sparkplughelper.h"
 
@@ -155,38 +156,84 @@ pub_sub::MetricType ProtobufDataTypeToMetricType(uint32_t pb_type) {
   return type;
 }
 
+/** \brief The seq field (varint) is the last field of an encoded payload. */
+constexpr uint8_t kSeqTag = org::eclipse::tahu::protobuf::Payload::kSeqFieldNumber << 3;
+constexpr uint64_t kMaxSeqSlot = 0x3FFF; ///< Largest seq that fits in the 2 byte slot.
+
+/** \brief Appends the seq field with a fixed width, so it can be patched on send. */
+template <typename T>
+void AppendSequenceSlot(T& dest, uint64_t seq_no) {
+  using Byte = typename T::value_type;
+  dest.push_back(static_cast<Byte>(kSeqTag));
+  dest.push_back(static_cast<Byte>((seq_no & 0x7F) | 0x80));
+  dest.push_back(static_cast<Byte>((seq_no >> 7) & 0x7F));
+}
+
+void AppendVarint(std::string& dest, uint64_t value) {
+  while (value >= 0x80) {
+    dest.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  dest.push_back(static_cast<char>(value));
+}
+
+/** \brief FNV-1a hash of the metric names, aliases and data types. */
+uint64_t MakeSchemaFingerprint(const org::eclipse::tahu::protobuf::Payload& pb_payload) {
+  constexpr uint64_t kPrime = 1'099'511'628'211ULL;
+  uint64_t hash = 14'695'981'039'346'656'037ULL;
+  auto add_value = [&] (uint64_t value) {
+    for (size_t byte = 0; byte < 8; ++byte) {
+      hash ^= (value >> (byte * 8)) & 0xFF;
+      hash *= kPrime;
+    }
+  };
+  add_value(static_cast<uint64_t>(pb_payload.metrics_size()));
+  for (const auto& pb_metric : pb_payload.metrics()) {
+    for (const char input : pb_metric.name()) {
+      hash ^= static_cast<uint8_t>(input);
+      hash *= kPrime;
+    }
+    add_value(pb_metric.alias());
+    add_value(pb_metric.datatype());
+  }
+  // 0 means no fingerprint
+  return hash == 0 ? 1 : hash;
+}
+
 }
 
 namespace pub_sub {
+
 PayloadHelper::PayloadHelper(Payload &source)
     : source_(source) {
 }
 
 void PayloadHelper::WriteProtobuf() {
+  if (WriteAllMetrics()) {
+    WriteBirth();
+    return;
+  }
   // Note that dst payload is the protobuf payload not Payload.
   // Source is the Payload and at the end the protobuf dest shall
   // be serialized to the source body (data bytes).
   try {
     org::eclipse::tahu::protobuf::Payload pb_payload; // Note not a Payload is a protobuf payload
     pb_payload.set_timestamp(source_.Timestamp());
-    auto seq_no = source_.SequenceNumber();
-    pb_payload.set_seq(seq_no);
+    const auto seq_no = source_.SequenceNumber();
+    if (seq_no > kMaxSeqSlot) {
+      pb_payload.set_seq(seq_no);
+    }
 
     if (!source_.Uuid().empty()) {
       pb_payload.set_uuid(source_.Uuid());
     }
 
     // METRIC LIST
-    const auto &metric_list = source_.Metrics();
-    for (const auto &[name, metric] : metric_list) {
-      if (name.empty()) {
-        continue;
-      }
-      // If the create_all_metrics_ is false, only updated metric values should
-      // be reported. The NBIRTH amd DBIRTH messages include all metric data, properties and
-      // metadata.
-      const bool include_metric = WriteAllMetrics() || metric->IsUpdated();
-      if (include_metric) {
+    // The metric list is copied, so the encoding doesn't block the writers.
+    // Only updated metric values are reported.
+    const auto metric_list = source_.NamedMetrics();
+    for (const auto &metric : metric_list) {
+      if (metric->IsUpdated()) {
         auto *met = pb_payload.add_metrics();
         if (met == nullptr) {
           continue;
@@ -195,97 +242,209 @@ void PayloadHelper::WriteProtobuf() {
         metric->ResetUpdated();
       }
     }
+    SerializeBody(pb_payload);
+    if (seq_no <= kMaxSeqSlot) {
+      AppendSequenceSlot(source_.Body(), seq_no);
+    }
+  } catch (const std::exception &err) {
+    LOG_ERROR() << "Protobuf Serialization Error: " << err.what();
+  }
+}
 
-    // Serialize the protobuf to the IPayloads body (data bytes)
-    const auto data_size = pb_payload.ByteSizeLong();
-    auto &body = source_.Body();
-    if (data_size == 0) {
-      body.clear();
-      return;
+void PayloadHelper::WriteBirth() {
+  // The NBIRTH and DBIRTH messages include all metric data and properties.
+  // The serialized metric definitions are kept by the payload, so the next
+  // birth only needs to encode the values, if no definition has changed.
+  // Protobuf merges the fields of a sub-message, so each metric is written
+  // as its kept definition bytes followed by its value bytes.
+  try {
+    const auto metric_list = source_.NamedMetrics();
+
+    org::eclipse::tahu::protobuf::Payload pb_header;
+    pb_header.set_timestamp(source_.Timestamp());
+    const auto seq_no = source_.SequenceNumber();
+    if (seq_no > kMaxSeqSlot) {
+      pb_header.set_seq(seq_no);
+    }
+    if (const auto uuid = source_.Uuid(); !uuid.empty()) {
+      pb_header.set_uuid(uuid);
+    }
+
+    std::scoped_lock lock(source_.birth_mutex_);
+    auto& cache = source_.birth_cache_;
+    if (!cache) {
+      cache = std::make_unique<Payload::BirthCache>();
+    }
+    std::unordered_map<const Metric*, Payload::BirthCache::Definition*> old_list;
+    old_list.reserve(cache->definition_list.size());
+    for (auto& definition : cache->definition_list) {
+      old_list.emplace(definition.metric.get(), &definition);
+    }
+
+    std::vector<Payload::BirthCache::Definition> definition_list(metric_list.size());
+    std::string value_bytes;
+    std::string body = pb_header.SerializeAsString();
+    for (size_t index = 0; index < metric_list.size(); ++index) {
+      const auto& metric = metric_list[index];
+      auto& definition = definition_list[index];
+      definition.metric = metric;
+      // The version is read before the metric is written. A concurrent
+      // change is then detected by the next birth.
+      definition.version = metric->DefinitionVersion();
+      if (const auto itr = old_list.find(metric.get());
+          itr != old_list.cend() && itr->second->version == definition.version) {
+        definition.bytes = std::move(itr->second->bytes);
+      } else {
+        Payload_Metric pb_definition;
+        WriteMetricDefinition(*metric, pb_definition);
+        definition.bytes = pb_definition.SerializeAsString();
+        ++source_.definition_encode_count_;
+      }
+
+      Payload_Metric pb_value;
+      WriteMetricValue(*metric, pb_value);
+      metric->ResetUpdated();
+      value_bytes.clear();
+      pb_value.AppendToString(&value_bytes);
+
+      AppendVarint(body, (org::eclipse::tahu::protobuf::Payload::kMetricsFieldNumber << 3) | 2); // Length delimited
+      AppendVarint(body, definition.bytes.size() + value_bytes.size());
+      body.append(definition.bytes);
+      body.append(value_bytes);
     }
-    body.resize(data_size);
-    const bool serialize = pb_payload.SerializeToArray(body.data(), static_cast<int>(body.size()));
-    if (!serialize) {
-      LOG_ERROR() << "Failed to serialize to protobuf.";
-      body.clear();
+    if (seq_no <= kMaxSeqSlot) {
+      AppendSequenceSlot(body, seq_no);
     }
+    cache->definition_list = std::move(definition_list);
+    source_.Body().assign(body.cbegin(), body.cend());
   } catch (const std::exception &err) {
+    std::scoped_lock lock(source_.birth_mutex_);
+    source_.birth_cache_.reset();
     LOG_ERROR() << "Protobuf Serialization Error: " << err.what();
   }
 }
 
+bool PayloadHelper::PatchSequenceNumber(std::vector<uint8_t>& body, uint64_t seq_no) {
+  const size_t size = body.size();
+  if (seq_no > kMaxSeqSlot || size < 3 || body[size - 3] != kSeqTag ||
+      (body[size - 2] & 0x80) == 0 || (body[size - 1] & 0x80) != 0) {
+    return false;
+  }
+  body[size - 2] = static_cast<uint8_t>((seq_no & 0x7F) | 0x80);
+  body[size - 1] = static_cast<uint8_t>((seq_no >> 7) & 0x7F);
+  return true;
+}
+
+void PayloadHelper::SerializeBody(const org::eclipse::tahu::protobuf::Payload& pb_payload) {
+  // Serialize the protobuf to the IPayloads body (data bytes)
+  const auto data_size = pb_payload.ByteSizeLong();
+  auto &body = source_.Body();
+  if (data_size == 0) {
+    body.clear();
+    return;
+  }
+  body.resize(data_size);
+  const bool serialize = pb_payload.SerializeToArray(body.data(), static_cast<int>(body.size()));
+  if (!serialize) {
+    LOG_ERROR() << "Failed to serialize to protobuf.";
+    body.clear();
+  }
+}
+
 void PayloadHelper::WriteMetric(const Metric &metric, Payload_Metric &pb_metric) const {
   try {
-
-    if (WriteAllMetrics() || metric.Alias() == 0) {
-      pb_metric.set_name(metric.Name()); // Include name for tracing purpose
-    }
-    pb_metric.set_alias(metric.Alias());
-    pb_metric.set_timestamp(metric.Timestamp());
-    pb_metric.set_is_historical(metric.IsHistorical());
-    pb_metric.set_is_transient(metric.IsTransient());
-    pb_metric.set_is_null(metric.IsNull());
-
-    // The above is the only parameters to send
-    if (WriteAllMetrics()) {
-      pb_metric.set_datatype(static_cast<uint32_t>(metric.Type()));
-    }
-    switch (metric.Type()) {
-      case MetricType::Int8:
-      case MetricType::Int16:
-      case MetricType::Int32:
-        pb_metric.set_int_value(static_cast<uint32_t>(metric.Value<int32_t>()));
-        break;
-
-      case MetricType::Int64:
-        pb_metric.set_long_value(static_cast<uint64_t>(metric.Value<int64_t>()));
-        break;
-
-      case MetricType::UInt8:
-      case MetricType::UInt16:
-      case MetricType::UInt32:
-        pb_metric.set_int_value(metric.Value<uint32_t>());
-        break;
-
-      case MetricType::UInt64:
-        pb_metric.set_long_value(metric.Value<uint64_t>());
-        break;
-
-      case MetricType::Float:
-        pb_metric.set_float_value(metric.Value<float>());
-        break;
-
-      case MetricType::Double:
-        pb_metric.set_double_value(metric.Value<double>());
-        break;
-
-      case MetricType::Boolean:
-        pb_metric.set_boolean_value(metric.Value<bool>());
-        break;
-
-      case MetricType::String:
-      case MetricType::Unknown:
-      default:
-        pb_metric.set_string_value(metric.Value<std::string>());
-        break;
-    }
-
-    const auto &property_list = metric.Properties();
-
-    if (!property_list.empty()) {
-      auto pb_property_set = std::make_unique<Payload_PropertySet>();
-      const bool changed = WritePropertySet(property_list, *pb_property_set );
-      if (changed) {
-        pb_metric.set_allocated_properties(pb_property_set.release());
-      }
-    }
+    WriteMetricDefinition(metric, pb_metric);
+    WriteMetricValue(metric, pb_metric);
   } catch (const std::exception& err) {
     LOG_ERROR() << "Failed to write metric. Error: " << err.what();
   }
 }
 
+void PayloadHelper::WriteMetricDefinition(const Metric &metric, Payload_Metric &pb_metric) const {
+  if (WriteAllMetrics() || metric.Alias() == 0) {
+    pb_metric.set_name(metric.Name()); // Include name for tracing purpose
+  }
+  pb_metric.set_alias(metric.Alias());
+
+  // The above is the only parameters to send
+  if (WriteAllMetrics()) {
+    pb_metric.set_datatype(static_cast<uint32_t>(metric.Type()));
+  }
+
+  if (const auto property_set = metric.SharedProperties();
+      property_set && SpliceProperties()) {
+    // The interned set is already encoded. The bytes are copied into the
+    // message as the properties field.
+    auto* unknown_fields = pb_metric.GetReflection()->MutableUnknownFields(&pb_metric);
+    unknown_fields->AddLengthDelimited(Payload_Metric::kPropertiesFieldNumber,
+                                       property_set->Encoded(WriteAllMetrics()));
+    return;
+  }
+
+  const auto &property_list = metric.Properties();
+  if (!property_list.empty()) {
+    auto pb_property_set = std::make_unique<Payload_PropertySet>();
+    const bool changed = WritePropertySet(property_list, *pb_property_set );
+    if (changed) {
+      pb_metric.set_allocated_properties(pb_property_set.release());
+    }
+  }
+}
+
+void PayloadHelper::WriteMetricValue(const Metric &metric, Payload_Metric &pb_metric) {
+  pb_metric.set_timestamp(metric.Timestamp());
+  pb_metric.set_is_historical(metric.IsHistorical());
+  pb_metric.set_is_transient(metric.IsTransient());
+  pb_metric.set_is_null(metric.IsNull());
+
+  switch (metric.Type()) {
+    case MetricType::Int8:
+    case MetricType::Int16:
+    case MetricType::Int32:
+      pb_metric.set_int_value(static_cast<uint32_t>(metric.Value<int32_t>()));
+      break;
+
+    case MetricType::Int64:
+      pb_metric.set_long_value(static_cast<uint64_t>(metric.Value<int64_t>()));
+      break;
+
+    case MetricType::UInt8:
+    case MetricType::UInt16:
+    case MetricType::UInt32:
+      pb_metric.set_int_value(metric.Value<uint32_t>());
+      break;
+
+    case MetricType::UInt64:
+      pb_metric.set_long_value(metric.Value<uint64_t>());
+      break;
+
+    case MetricType::Float:
+      pb_metric.set_float_value(metric.Value<float>());
+      break;
+
+    case MetricType::Double:
+      pb_metric.set_double_value(metric.Value<double>());
+      break;
+
+    case MetricType::Boolean:
+      pb_metric.set_boolean_value(metric.Value<bool>());
+      break;
+
+    case MetricType::String:
+    case MetricType::Unknown:
+    default:
+      pb_metric.set_string_value(metric.Value<std::string>());
+      break;
+  }
+}
+
 bool PayloadHelper::WritePropertySet(const MetricPropertyList &property_list,
                                      Payload_PropertySet &pb_property_set) const {
+  return WritePropertySet(property_list, pb_property_set, WriteAllMetrics());
+}
+
+bool PayloadHelper::WritePropertySet(const MetricPropertyList &property_list,
+                                     Payload_PropertySet &pb_property_set, bool with_types) {
   bool changed = false;
   try {
     for (const auto &[name, prop] : property_list) {
@@ -299,7 +458,7 @@ bool PayloadHelper::WritePropertySet(const MetricPropertyList &property_list,
       if (pb_property_value == nullptr) {
         throw std::runtime_error("Failed to create a property value");
       }
-      if (WriteAllMetrics()) {
+      if (with_types) {
         pb_property_value->set_type(static_cast<DataType>(prop.Type()));
       }
       pb_property_value->set_is_null(prop.IsNull());
@@ -383,15 +542,34 @@ void PayloadHelper::ParseProtobuf() {
     if (pb_payload.has_uuid()) {
       source_.Uuid(pb_payload.uuid());
     }
+    // A birth message with the same metric definitions as the previous
+    // birth, reuses the previous metrics instead of looking them up by name.
+    const bool birth = BirthMessage();
+    bool reuse = false;
+    uint64_t fingerprint = 0;
+    std::vector<std::shared_ptr<Metric>> birth_list;
+    if (birth) {
+      fingerprint = MakeSchemaFingerprint(pb_payload);
+      std::scoped_lock lock(source_.alias_mutex_);
+      reuse = fingerprint == source_.schema_fingerprint_ &&
+          source_.birth_list_.size() == static_cast<size_t>(pb_payload.metrics_size());
+      if (reuse) {
+        birth_list = source_.birth_list_;
+      }
+    }
+
     // Read in the metrics
-    for (const auto &pb_metric : pb_payload.metrics()) {
+    for (int index = 0; index < pb_payload.metrics_size(); ++index) {
+      const auto& pb_metric = pb_payload.metrics(index);
       std::shared_ptr<Metric> metric;
       std::string name;
-      if (pb_metric.has_name()) {
+      if (reuse) {
+        metric = birth_list[static_cast<size_t>(index)];
+      } else if (pb_metric.has_name()) {
         name = pb_metric.name();
         metric = source_.GetMetric(name);
       } else if (pb_metric.has_alias()) {
-        metric = source_.GetMetric(pb_metric.alias());
+        metric = FindAlias(pb_metric.alias());
       }
       // It's always possible to create metrics, but you cannot change
       // name, alias and data type on existing metrics.
@@ -407,10 +585,27 @@ void PayloadHelper::ParseProtobuf() {
           metric->Type(ProtobufDataTypeToMetricType(pb_metric.datatype()));
         }
       }
+      if (birth && !reuse) {
+        birth_list.push_back(metric);
+      }
       if (!metric) {
         continue;
       }
       ParseMetric(pb_metric, *metric);
+      source_.parsed_list_.push_back(std::move(metric));
+    }
+
+    if (birth && !reuse) {
+      std::unordered_map<uint64_t, std::shared_ptr<Metric>> alias_index;
+      for (const auto& metric : birth_list) {
+        if (metric && metric->Alias() != 0) {
+          alias_index.emplace(metric->Alias(), metric);
+        }
+      }
+      std::scoped_lock lock(source_.alias_mutex_);
+      source_.schema_fingerprint_ = fingerprint;
+      source_.birth_list_ = std::move(birth_list);
+      source_.alias_index_ = std::move(alias_index);
     }
 
   } catch (const std::exception &err) {
@@ -418,6 +613,17 @@ void PayloadHelper::ParseProtobuf() {
   }
 }
 
+std::shared_ptr<Metric> PayloadHelper::FindAlias(uint64_t alias) const {
+  {
+    std::scoped_lock lock(source_.alias_mutex_);
+    const auto itr = source_.alias_index_.find(alias);
+    if (itr != source_.alias_index_.cend() && itr->second->Alias() == alias) {
+      return itr->second;
+    }
+  }
+  return source_.GetMetric(alias);
+}
+
 std::string PayloadHelper::DebugProtobuf() const {
 
   try {
@@ -450,15 +656,34 @@ std::string PayloadHelper::DebugProtobuf() const {
     if (pb_payload.has_uuid()) {
       source_.Uuid(pb_payload.uuid());
     }
+    // A birth message with the same metric definitions as the previous
+    // birth, reuses the previous metrics instead of looking them up by name.
+    const bool birth = BirthMessage();
+    bool reuse = false;
+    uint64_t fingerprint = 0;
+    std::vector<std::shared_ptr<Metric>> birth_list;
+    if (birth) {
+      fingerprint = MakeSchemaFingerprint(pb_payload);
+      std::scoped_lock lock(source_.alias_mutex_);
+      reuse = fingerprint == source_.schema_fingerprint_ &&
+          source_.birth_list_.size() == static_cast<size_t>(pb_payload.metrics_size());
+      if (reuse) {
+        birth_list = source_.birth_list_;
+      }
+    }
+
     // Read in the metrics
-    for (const auto &pb_metric : pb_payload.metrics()) {
+    for (int index = 0; index < pb_payload.metrics_size(); ++index) {
+      const auto& pb_metric = pb_payload.metrics(index);
       std::shared_ptr<Metric> metric;
       std::string name;
-      if (pb_metric.has_name()) {
+      if (reuse) {
+        metric = birth_list[static_cast<size_t>(index)];
+      } else if (pb_metric.has_name()) {
         name = pb_metric.name();
         metric = source_.GetMetric(name);
       } else if (pb_metric.has_alias()) {
-        metric = source_.GetMetric(pb_metric.alias());
+        metric = FindAlias(pb_metric.alias());
       }
       // It's always possible to create metrics, but you cannot change
       // name, alias and data type on existing metrics.
@@ -549,36 +774,60 @@ void PayloadHelper::ParseMetric(const Payload_Metric &pb_metric, Metric &metric)
     }
 
     if (pb_metric.has_properties()) {
-      const auto &pb_prop_list = pb_metric.properties();
-      for (int key = 0; key < pb_prop_list.keys_size(); ++key) {
-        const auto &prop_key = pb_prop_list.keys(key);
-        const auto value_list_size = pb_prop_list.values_size();
-        if (prop_key.empty() || key >= value_list_size ) {
-          continue;
-        }
-        const auto &pb_property_value = pb_prop_list.values(key);
-
-        MetricProperty *property = metric.GetProperty(prop_key);
-        if (property == nullptr && CreateMetrics()) {
-          property = metric.CreateProperty(prop_key);
-          if (property == nullptr) {
-            throw std::runtime_error("Failed to create metric property");
-          }
-          if (pb_property_value.has_type()) {
-            property->Type( ProtobufDataTypeToMetricType(pb_property_value.type()) );
-          }
-        }
-        if (property == nullptr) {
-          continue;
-        }
-        ParsePropertyValue(pb_property_value, *property);
-      }
+      ParseProperties(pb_metric.properties(), metric);
     }
   } catch (const std::exception& err) {
     LOG_ERROR() << "Parsing of metric failed. Error: " << err.what();
   }
 }
 
+void PayloadHelper::ParseProperties(const Payload_PropertySet& pb_prop_list, Metric& metric) {
+  // Unchanged properties are common, so compare with the interned set first.
+  // The size is compared before the bytes, and the bytes are serialized into
+  // a buffer that is reused by the thread.
+  const auto property_set = metric.SharedProperties();
+  if (property_set) {
+    const bool with_types = pb_prop_list.values_size() > 0 && pb_prop_list.values(0).has_type();
+    const auto& encoded = property_set->Encoded(with_types);
+    if (pb_prop_list.ByteSizeLong() == encoded.size()) {
+      thread_local std::string buffer;
+      buffer.resize(encoded.size());
+      if (pb_prop_list.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buffer.data()))
+          != nullptr && buffer == encoded) {
+        return;
+      }
+    }
+  }
+
+  MetricPropertyList property_list;
+  const auto& current_list = metric.Properties();
+  for (int key = 0; key < pb_prop_list.keys_size(); ++key) {
+    const auto &prop_key = pb_prop_list.keys(key);
+    const auto value_list_size = pb_prop_list.values_size();
+    if (prop_key.empty() || key >= value_list_size ) {
+      continue;
+    }
+    const auto &pb_property_value = pb_prop_list.values(key);
+
+    MetricProperty property;
+    if (const auto exist = current_list.find(prop_key); exist != current_list.cend()) {
+      property = exist->second;
+    } else if (CreateMetrics()) {
+      property.Key(prop_key);
+      if (pb_property_value.has_type()) {
+        property.Type( ProtobufDataTypeToMetricType(pb_property_value.type()) );
+      }
+    } else {
+      continue;
+    }
+    ParsePropertyValue(pb_property_value, property);
+    property_list.insert_or_assign(prop_key, property);
+  }
+  if (!property_list.empty()) {
+    metric.UpdateProperties(property_list);
+  }
+}
+
 void PayloadHelper::ParseMetaData(const Payload_MetaData &pb_meta_data, MetricMetadata &meta_data) {
   try {
     if (pb_meta_data.has_is_multi_part()) {
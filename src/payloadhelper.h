@@ -10,6 +10,21 @@
 
 namespace pub_sub {
 
+/** \brief Birth metric definitions that are kept between births.
+ *
+ * The definition list holds the serialized definition (name, alias, data type
+ * and properties) of each metric in message order, together with the
+ * definition version when the bytes were encoded.
+ */
+struct Payload::BirthCache {
+  struct Definition {
+    std::shared_ptr<Metric> metric;
+    uint64_t version = 0;
+    std::string bytes; ///< Serialized Payload_Metric without value fields.
+  };
+  std::vector<Definition> definition_list;
+};
+
 class PayloadHelper final {
  public:
   PayloadHelper() = delete;
@@ -18,15 +33,43 @@ class PayloadHelper final {
   void WriteAllMetrics(bool write_all) { write_all_metrics_ = write_all; }
   [[nodiscard]] bool WriteAllMetrics() const { return write_all_metrics_; }
 
+  /** \brief Copies the encoded bytes of interned property sets into the messages. */
+  void SpliceProperties(bool splice) { splice_properties_ = splice; }
+  [[nodiscard]] bool SpliceProperties() const { return splice_properties_; }
+
   void CreateMetrics(bool create) { create_metrics_ = create; }
   [[nodiscard]] bool CreateMetrics() const { return create_metrics_; }
 
+  /** \brief Set if the message is a NBIRTH or DBIRTH message. */
+  void BirthMessage(bool birth) { birth_message_ = birth; }
+  [[nodiscard]] bool BirthMessage() const { return birth_message_; }
+
   void WriteProtobuf();
 
+  /** \brief Replaces the sequence number of an encoded protobuf body.
+   *
+   * The sequence number is encoded last with a fixed width, so it can be
+   * assigned when the message is handed over. The slot holds numbers below
+   * 16384. A larger number is encoded as a normal field and can't be patched.
+   * @param body Body that WriteProtobuf() made.
+   * @param seq_no New sequence number.
+   * @return False if the body has no sequence number slot.
+   */
+  static bool PatchSequenceNumber(std::vector<uint8_t>& body, uint64_t seq_no);
+
   void WriteMetric(const Metric& metric,
                           org::eclipse::tahu::protobuf::Payload_Metric& pb_metric) const;
+  /** \brief Writes the name, alias, data type and properties of a metric. */
+  void WriteMetricDefinition(const Metric& metric,
+                             org::eclipse::tahu::protobuf::Payload_Metric& pb_metric) const;
+  /** \brief Writes the timestamp, flags and value of a metric. */
+  static void WriteMetricValue(const Metric& metric,
+                               org::eclipse::tahu::protobuf::Payload_Metric& pb_metric);
   bool WritePropertySet(const MetricPropertyList& property_list,
                    org::eclipse::tahu::protobuf::Payload_PropertySet& pb_property_set) const;
+  static bool WritePropertySet(const MetricPropertyList& property_list,
+                   org::eclipse::tahu::protobuf::Payload_PropertySet& pb_property_set,
+                   bool with_types);
 
   void ParseProtobuf();
   [[nodiscard]] std::string DebugProtobuf() const;
@@ -39,12 +82,21 @@ class PayloadHelper final {
   void ParsePropertyValue(const org::eclipse::tahu::protobuf::Payload_PropertyValue& pb_property_value,
                             MetricProperty& property);
 
+  void ParseProperties(const org::eclipse::tahu::protobuf::Payload_PropertySet& pb_prop_list,
+                       Metric& metric);
+
   void ParsePropertySet(const org::eclipse::tahu::protobuf::Payload_PropertySet& pb_property_set,
                               MetricPropertyList& property_list);
  private:
    Payload& source_;
    bool write_all_metrics_ = false;
    bool create_metrics_ = false;
+   bool birth_message_ = false;
+   bool splice_properties_ = false;
+
+   void WriteBirth();
+   [[nodiscard]] std::shared_ptr<Metric> FindAlias(uint64_t alias) const;
+   void SerializeBody(const org::eclipse::tahu::protobuf::Payload& pb_payload);
 
 };
 
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/payloadsnapshot.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+int CompareIgnoreCase(std::string_view name1, std::string_view name2) {
+  const auto size = std::min(name1.size(), name2.size());
+  for (size_t index = 0; index < size; ++index) {
+    const auto char1 = std::tolower(static_cast<unsigned char>(name1[index]));
+    const auto char2 = std::tolower(static_cast<unsigned char>(name2[index]));
+    if (char1 != char2) {
+      return char1 < char2 ? -1 : 1;
+    }
+  }
+  if (name1.size() == name2.size()) {
+    return 0;
+  }
+  return name1.size() < name2.size() ? -1 : 1;
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+PayloadSnapshot::PayloadSnapshot(uint64_t version, uint64_t timestamp,
+                                 std::vector<MetricValue> metric_list)
+: version_(version),
+  timestamp_(timestamp),
+  metric_list_(std::move(metric_list)) {
+  std::sort(metric_list_.begin(), metric_list_.end(),
+            [] (const MetricValue& value1, const MetricValue& value2) -> bool {
+    return CompareIgnoreCase(value1.name, value2.name) < 0;
+  });
+}
+
+const MetricValue* PayloadSnapshot::GetMetric(std::string_view name) const {
+  const auto itr = std::lower_bound(metric_list_.cbegin(), metric_list_.cend(), name,
+                                    [] (const MetricValue& value, std::string_view key) -> bool {
+    return CompareIgnoreCase(value.name, key) < 0;
+  });
+  if (itr == metric_list_.cend() || CompareIgnoreCase(itr->name, name) != 0) {
+    return nullptr;
+  }
+  return &(*itr);
+}
+
+const MetricValue* PayloadSnapshot::GetMetric(uint64_t alias) const {
+  if (alias == 0) {
+    return nullptr;
+  }
+  const auto itr = std::find_if(metric_list_.cbegin(), metric_list_.cend(),
+                                [&] (const MetricValue& value) -> bool {
+    return value.alias == alias;
+  });
+  return itr == metric_list_.cend() ? nullptr : &(*itr);
+}
+
+} // pub_sub
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/propertyset.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "util/logstream.h"
+#include "payloadhelper.h"
+#include "sparkplughelper.h"
+
+using namespace util::log;
+using namespace org::eclipse::tahu::protobuf;
+
+namespace {
+
+/** \brief Intern pool. The key is the birth encoding of the set. */
+struct InternPool {
+  std::mutex pool_mutex;
+  std::unordered_map<std::string, std::weak_ptr<const pub_sub::PropertySet>> set_list;
+};
+
+InternPool& Pool() {
+  // Never destroyed, so sets that are released at exit can still use it.
+  static auto* pool = new InternPool;
+  return *pool;
+}
+
+std::string Encode(const pub_sub::MetricPropertyList& property_list, bool with_types) {
+  Payload_PropertySet pb_property_set;
+  std::string encoded;
+  if (pub_sub::PayloadHelper::WritePropertySet(property_list, pb_property_set, with_types)) {
+    pb_property_set.SerializeToString(&encoded);
+  }
+  return encoded;
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+PropertySet::PropertySet(MetricPropertyList property_list)
+: property_list_(std::move(property_list)),
+  birth_encoding_(Encode(property_list_, true)),
+  data_encoding_(Encode(property_list_, false)) {
+}
+
+PropertySet::~PropertySet() {
+  if (!interned_) {
+    return;
+  }
+  auto& pool = Pool();
+  std::scoped_lock lock(pool.pool_mutex);
+  // A new set with the same key may already have replaced this set.
+  if (auto itr = pool.set_list.find(birth_encoding_);
+      itr != pool.set_list.end() && itr->second.expired()) {
+    pool.set_list.erase(itr);
+  }
+}
+
+std::shared_ptr<const PropertySet> PropertySet::Intern(MetricPropertyList property_list) {
+  if (property_list.empty()) {
+    return {};
+  }
+  std::shared_ptr<PropertySet> property_set(new PropertySet(std::move(property_list)));
+  if (property_set->birth_encoding_.empty()) {
+    return {}; // No valid properties
+  }
+
+  auto& pool = Pool();
+  std::scoped_lock lock(pool.pool_mutex);
+  auto& entry = pool.set_list[property_set->birth_encoding_];
+  if (auto exist = entry.lock(); exist) {
+    return exist;
+  }
+  property_set->interned_ = true;
+  entry = property_set;
+  return property_set;
+}
+
+size_t PropertySet::InternedCount() {
+  auto& pool = Pool();
+  std::scoped_lock lock(pool.pool_mutex);
+  return pool.set_list.size();
+}
+
+const MetricProperty* PropertySet::GetProperty(const std::string& key) const {
+  const auto itr = property_list_.find(key);
+  return itr == property_list_.cend() ? nullptr : &itr->second;
+}
+
+size_t PropertySet::MemoryUsage() const {
+  size_t bytes = sizeof(PropertySet);
+  bytes += SparkplugHelper::StringHeapSize(birth_encoding_);
+  bytes += SparkplugHelper::StringHeapSize(data_encoding_);
+  for (const auto& [key, property] : property_list_) {
+    bytes += 4 * sizeof(void*); // Map node overhead
+    bytes += SparkplugHelper::StringHeapSize(key);
+    bytes += property.MemoryUsage();
+  }
+  return bytes;
+}
+
+} // pub_sub
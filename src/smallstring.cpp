@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/smallstring.h"
+
+#include <cstring>
+#include <utility>
+
+namespace pub_sub {
+
+SmallString::SmallString(std::string_view text) {
+  SetInlineSize(0);
+  Assign(text);
+}
+
+SmallString::SmallString(const SmallString& text) {
+  SetInlineSize(0);
+  Assign(text.View());
+}
+
+SmallString::SmallString(SmallString&& text) noexcept {
+  std::memcpy(buffer_, text.buffer_, sizeof(buffer_));
+  text.SetInlineSize(0);
+}
+
+SmallString::~SmallString() {
+  Clear();
+}
+
+SmallString& SmallString::operator=(const SmallString& text) {
+  if (this != &text) {
+    Assign(text.View());
+  }
+  return *this;
+}
+
+SmallString& SmallString::operator=(SmallString&& text) noexcept {
+  if (this != &text) {
+    Clear();
+    std::memcpy(buffer_, text.buffer_, sizeof(buffer_));
+    text.SetInlineSize(0);
+  }
+  return *this;
+}
+
+void SmallString::Assign(std::string_view text) {
+  if (IsInline() && text.size() <= kInlineSize) {
+    std::memmove(buffer_, text.data(), text.size());
+    SetInlineSize(text.size());
+    return;
+  }
+  if (!IsInline()) {
+    auto heap = GetHeap();
+    if (text.size() <= heap.capacity) {
+      std::memmove(heap.data, text.data(), text.size());
+      heap.size = text.size();
+      SetHeap(heap);
+      return;
+    }
+  }
+  // The text may point into this string, so copy it before the old buffer is released.
+  Heap heap;
+  heap.capacity = text.size();
+  heap.size = text.size();
+  heap.data = new char[heap.capacity];
+  std::memcpy(heap.data, text.data(), text.size());
+  Clear();
+  SetHeap(heap);
+}
+
+void SmallString::Clear() {
+  if (!IsInline()) {
+    delete [] GetHeap().data;
+  }
+  SetInlineSize(0);
+}
+
+std::string_view SmallString::View() const {
+  if (IsInline()) {
+    const auto unused = static_cast<unsigned char>(buffer_[kInlineSize]);
+    return {buffer_, kInlineSize - unused};
+  }
+  const auto heap = GetHeap();
+  return {heap.data, heap.size};
+}
+
+bool SmallString::IsInline() const {
+  return static_cast<unsigned char>(buffer_[kInlineSize]) != kHeapMode;
+}
+
+size_t SmallString::HeapSize() const {
+  return IsInline() ? 0 : GetHeap().capacity;
+}
+
+SmallString::Heap SmallString::GetHeap() const {
+  Heap heap;
+  std::memcpy(&heap, buffer_, sizeof(heap));
+  return heap;
+}
+
+void SmallString::SetHeap(const Heap& heap) {
+  std::memcpy(buffer_, &heap, sizeof(heap));
+  buffer_[kInlineSize] = static_cast<char>(kHeapMode);
+}
+
+void SmallString::SetInlineSize(size_t size) {
+  buffer_[kInlineSize] = static_cast<char>(kInlineSize - size);
+}
+
+} // pub_sub
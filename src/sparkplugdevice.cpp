@@ -53,13 +53,21 @@ ITopic *SparkplugDevice::AddMetric(const std::shared_ptr<Metric> &value) {
   return topic;
 }
 
+std::vector<std::shared_ptr<Metric>> SparkplugDevice::AddMetrics(
+    std::span<const MetricDescriptor> descriptor_list) {
+  // The aliases are unique within the node.
+  auto* topic = GetTopicByMessageType("DBIRTH");
+  if (topic == nullptr) {
+    return {};
+  }
+  return parent_.CreateBirthMetrics(topic->GetPayload(), Name(), descriptor_list);
+}
+
 ITopic *SparkplugDevice::CreateTopic() {
   // Note that parent to the topic is the node not this device.
   // The topic is however added to this device.
   auto topic = std::make_unique<SparkplugTopic>(parent_);
-  std::scoped_lock list_lock(topic_mutex_);
-  topic_list_.emplace_back(std::move(topic));
-  return topic_list_.back().get();
+  return AddTopic(std::move(topic));
 }
 
 bool SparkplugDevice::Start() {
@@ -217,12 +225,18 @@ void SparkplugDevice::Poll() {
       break;
 
     default:
+      UpdateTopicNames();
       SetAllMetricsInvalid();
       device_state_ = DeviceState::Offline;
       break;
   }
 }
 
+void SparkplugDevice::Rebirth() {
+  auto online = DeviceState::Online;
+  device_state_.compare_exchange_strong(online, DeviceState::Offline);
+}
+
 void SparkplugDevice::SetAllMetricsInvalid() {
   for (auto& topic : topic_list_) {
     if (!topic || topic->MessageType() != "DBIRTH") {
@@ -233,14 +247,32 @@ void SparkplugDevice::SetAllMetricsInvalid() {
 
 }
 
+void SparkplugDevice::UpdateTopicNames() {
+  // The group and node names are normally set after the device was created,
+  // so the topic names are updated once when the device is started. Note that
+  // the topic name is only changed if needed, as a new name drops any topic alias.
+  auto update_name = [&] (const std::string& message_type) {
+    auto* topic = GetTopicByMessageType(message_type);
+    if (topic == nullptr) {
+      return;
+    }
+    std::string topic_name(kNamespace);
+    topic_name.append("/").append(GroupId());
+    topic_name.append("/").append(message_type);
+    topic_name.append("/").append(parent_.Name());
+    topic_name.append("/").append(Name());
+    if (topic->Topic() != topic_name) {
+      topic->Topic(topic_name);
+    }
+  };
+  update_name("DBIRTH");
+  update_name("DDEATH");
+}
+
 void SparkplugDevice::PublishDeviceBirth() {
 
   auto* birth_topic = GetTopicByMessageType("DBIRTH");
   if (birth_topic != nullptr) {
-    std::ostringstream topic_name;
-    topic_name << "spvBv1.0/" << GroupId() << "/DBIRTH/" << parent_.Name() << "/" << Name();
-    birth_topic->Topic(topic_name.str());
-
     auto& payload = birth_topic->GetPayload();
     payload.Timestamp(SparkplugHelper::NowMs());
     // Todo: Handle sequence number
@@ -256,9 +288,6 @@ void SparkplugDevice::PublishDeviceDeath() {
 
   auto* death_topic = GetTopicByMessageType("DDEATH");
   if (death_topic != nullptr) {
-    std::ostringstream topic_name;
-    topic_name << "spvBv1.0/" << GroupId() << "/DDEATH/" << parent_.Name() << "/" << Name();
-    death_topic->Topic(topic_name.str());
     auto& payload = death_topic->GetPayload();
     payload.Timestamp(SparkplugHelper::NowMs());
     // Todo: Handle sequence number
@@ -21,6 +21,8 @@ class SparkplugDevice : public IPubSubClient {
   bool IsOffline() const override;
 
   ITopic* AddMetric(const std::shared_ptr<Metric>& value) override;
+  std::vector<std::shared_ptr<Metric>> AddMetrics(
+      std::span<const MetricDescriptor> descriptor_list) override;
   ITopic* CreateTopic() override;
 
   bool Start() override;
@@ -28,6 +30,7 @@ class SparkplugDevice : public IPubSubClient {
   [[nodiscard]] bool IsConnected() const override;
 
   void Poll();
+  void Rebirth(); ///< Publish DBIRTH at next poll. Used when the node has a new session.
   void SetAllMetricsInvalid();
 
 
@@ -44,6 +47,7 @@ class SparkplugDevice : public IPubSubClient {
 
   void CreateDeviceDeathTopic();
   void CreateDeviceBirthTopic();
+  void UpdateTopicNames();
 
   void PublishDeviceBirth();
   void PublishDeviceDeath();
@@ -23,4 +23,14 @@ uint64_t SparkplugHelper::NowMs() {
   return ms;
 }
 
+uint64_t SparkplugHelper::NowNs() {
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      SystemClock::now().time_since_epoch());
+  return static_cast<uint64_t>(ns.count());
+}
+
+size_t SparkplugHelper::StringHeapSize(const std::string& text) {
+  return text.capacity() >= sizeof(std::string) ? text.capacity() + 1 : 0;
+}
+
 } // pub_sub
\ No newline at end of file
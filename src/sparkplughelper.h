@@ -9,6 +9,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 namespace pub_sub {
 
@@ -23,6 +24,18 @@ class SparkplugHelper {
    */
   static uint64_t NowMs();
 
+  /** \brief Returns number of nanoseconds since 1970 (UTC). */
+  static uint64_t NowNs();
+
+  /** \brief Returns the heap memory (bytes) that a string uses.
+   *
+   * Short strings are stored inside the string object (SSO) and
+   * don't use any heap memory.
+   * @param text String to check.
+   * @return Number of heap bytes.
+   */
+  static size_t StringHeapSize(const std::string& text);
+
 };
 
 } // pub_sub
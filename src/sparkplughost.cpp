@@ -5,6 +5,7 @@
 
 #include "sparkplughost.h"
 
+#include <array>
 #include <string_view>
 #include <chrono>
 #include "util/logstream.h"
@@ -17,12 +18,17 @@ using namespace std::chrono_literals;
 namespace {
   constexpr std::string_view kNamespace = "spBv1.0";
   constexpr std::string_view kState = "STATE";
+  constexpr std::string_view kSharePrefix = "$share/";
+  constexpr std::array<std::string_view, 4> kPrivateMessageTypes = {
+      "NBIRTH", "NDEATH", "DBIRTH", "DDEATH"};
+  constexpr std::array<std::string_view, 4> kSharedMessageTypes = {
+      "NDATA", "DDATA", "NCMD", "DCMD"};
 }
 
 namespace pub_sub {
 SparkplugHost::SparkplugHost()
 : SparkplugNode() {
-  topic_list_.clear(); // Remove any topic created by the Sparkplug node
+  ClearTopics(); // Remove any topic created by the Sparkplug node
   CreateStateTopic();
 
 }
@@ -46,6 +52,7 @@ bool SparkplugHost::Start() {
 
   // Add the normal metrics as this host is publishing the STATE message.
   AddDefaultMetrics();
+  StartTracer();
 
   if (auto* state_topic = GetTopicByMessageType(kState.data());
       state_topic != nullptr) {
@@ -59,75 +66,71 @@ bool SparkplugHost::Start() {
     state_topic->Publish(true); // This defines that this node will publish this topic.
   }
 
-  // Add standard subscriptions
-  std::ostringstream namespace_sub;
-  namespace_sub << kNamespace << "/#";
-
-  std::ostringstream state_sub;
-  state_sub << kNamespace << "/" << kState << "/" << Name();
-
-  // Note that we add first in the subscription list
-  AddSubscriptionFront(state_sub.str());
-  AddSubscriptionFront(namespace_sub.str());
+  AddStandardSubscriptions();
 
   // Set the host ID as Listen pre-text debugger text
   if (listen_ && !Name().empty()) {
     listen_->PreText(Name());
   }
 
-  std::ostringstream connect_string;
-  switch (Transport()) {
-    case TransportLayer::MqttWebSocket:
-      connect_string << "ws://";
-      break;
+  // The in-process transport doesn't need any MQTT handle.
+  if (!IsInProcess()) {
+    std::ostringstream connect_string;
+    switch (Transport()) {
+      case TransportLayer::MqttWebSocket:
+        connect_string << "ws://";
+        break;
 
-    case TransportLayer::MqttTcpTls:
-      connect_string << "ssl://";
-      break;
+      case TransportLayer::MqttTcpTls:
+        connect_string << "ssl://";
+        break;
 
-    case TransportLayer::MqttWebSocketTls:
-      connect_string << "wss://";
-      break;
+      case TransportLayer::MqttWebSocketTls:
+        connect_string << "wss://";
+        break;
 
-    default:
-      connect_string << "tcp://";
-      break;
-  }
-  connect_string << Broker() << ":" << Port();
-  MQTTAsync_createOptions create_options = MQTTAsync_createOptions_initializer5;
-  if (const auto create = MQTTAsync_createWithOptions(&handle_, connect_string.str().c_str(),
-                                       name_.c_str(),
-                                       MQTTCLIENT_PERSISTENCE_NONE, nullptr,
-                                       Version() == ProtocolVersion::Mqtt5 ? &create_options : nullptr);
-      create != MQTTASYNC_SUCCESS) {
-    std::ostringstream err;
-    err << "Failed to create the MQTT handle.";
-    const auto* cause = MQTTAsync_strerror(create);
-    if (cause != nullptr && strlen(cause) > 0) {
-      err << " Error: " << cause;
+      default:
+        connect_string << "tcp://";
+        break;
     }
-    LOG_ERROR() << err.str();
-    return false;
-  }
-
-  ResetConnectionLost();
-  ResetDelivered();
-  // Setting up the callback. The OnDeliveryComplete is not set
-  // as the function doesn't return the correct send token.
-  if (const auto callback = MQTTAsync_setCallbacks(handle_, this,
-                                               OnConnectionLost,
-                                               OnMessageArrived,
-                                               nullptr);
-      callback != MQTTASYNC_SUCCESS) {
-    std::ostringstream err;
-    err << "Failed to set the MQTT callbacks.";
-    const auto* cause = MQTTAsync_strerror(callback);
-    if (cause != nullptr && strlen(cause) > 0) {
-      err << "Error: " << cause;
+    connect_string << Broker() << ":" << Port();
+    MQTTAsync_createOptions create_options = MQTTAsync_createOptions_initializer5;
+    MQTTAsync handle = nullptr;
+    const auto create = MQTTAsync_createWithOptions(&handle, connect_string.str().c_str(),
+                                         name_.c_str(),
+                                         MQTTCLIENT_PERSISTENCE_NONE, nullptr,
+                                         Version() == ProtocolVersion::Mqtt5 ? &create_options : nullptr);
+    handle_ = handle;
+    if (create != MQTTASYNC_SUCCESS) {
+      std::ostringstream err;
+      err << "Failed to create the MQTT handle.";
+      const auto* cause = MQTTAsync_strerror(create);
+      if (cause != nullptr && strlen(cause) > 0) {
+        err << " Error: " << cause;
+      }
+      LOG_ERROR() << err.str();
+      return false;
     }
 
-    LOG_ERROR() << err.str();
-    return false;
+    ResetConnectionLost();
+    ResetDelivered();
+    // Setting up the callback. The OnDeliveryComplete is not set
+    // as the function doesn't return the correct send token.
+    if (const auto callback = MQTTAsync_setCallbacks(handle_, this,
+                                                 OnConnectionLost,
+                                                 OnMessageArrived,
+                                                 nullptr);
+        callback != MQTTASYNC_SUCCESS) {
+      std::ostringstream err;
+      err << "Failed to set the MQTT callbacks.";
+      const auto* cause = MQTTAsync_strerror(callback);
+      if (cause != nullptr && strlen(cause) > 0) {
+        err << "Error: " << cause;
+      }
+
+      LOG_ERROR() << err.str();
+      return false;
+    }
   }
 
   if (listen_ && listen_->IsActive()) {
@@ -151,11 +154,69 @@ bool SparkplugHost::Stop() {
   if (work_thread_.joinable()) {
     work_thread_.join();
   }
-  MQTTAsync_destroy(&handle_);
-  handle_ = nullptr;
+  DestroyHandle();
+  if (auto tracer = Tracer(); tracer) {
+    tracer->Stop();
+  }
   return true;
 }
 
+void SparkplugHost::AddStandardSubscriptions() {
+  // Remove any previous subscriptions as the settings may have changed.
+  for (const auto& topic : standard_subscriptions_) {
+    DeleteSubscription(topic);
+  }
+  standard_subscriptions_.clear();
+
+  const bool shared = !ShareName().empty() && Version() == ProtocolVersion::Mqtt5;
+  if (!ShareName().empty() && !shared) {
+    LOG_INFO() << "Shared subscriptions require MQTT 5. Host: " << Name();
+  }
+
+  const auto& filter = Filter();
+  auto add_subscriptions = [&] (std::string_view prefix, std::string_view message_type) {
+    for (auto& topic : filter.MakeSubscriptions(prefix, message_type)) {
+      standard_subscriptions_.emplace_back(std::move(topic));
+    }
+  };
+
+  std::ostringstream state_sub;
+  state_sub << kNamespace << "/" << kState << "/" << Name();
+  standard_subscriptions_.emplace_back(state_sub.str());
+
+  if (shared) {
+    // The BIRTH, DEATH and STATE messages are needed by all hosts, so the
+    // metric alias numbers can be resolved. The data and command messages are
+    // load balanced between the hosts by the broker.
+    for (const auto message_type : kPrivateMessageTypes) {
+      add_subscriptions(kNamespace, message_type);
+    }
+    std::ostringstream share_prefix;
+    share_prefix << kSharePrefix << ShareName() << "/" << kNamespace;
+    for (const auto message_type : kSharedMessageTypes) {
+      add_subscriptions(share_prefix.str(), message_type);
+    }
+  } else if (filter.IsNarrowing()) {
+    // Only subscribe on the included groups, nodes and message types.
+    add_subscriptions(kNamespace, "+");
+  } else {
+    std::ostringstream namespace_sub;
+    namespace_sub << kNamespace << "/#";
+    standard_subscriptions_.emplace_back(namespace_sub.str());
+  }
+
+  if (shared || filter.IsNarrowing()) {
+    std::ostringstream all_state_sub;
+    all_state_sub << kNamespace << "/" << kState << "/#";
+    standard_subscriptions_.emplace_back(all_state_sub.str());
+  }
+
+  // Note that we add first in the subscription list
+  for (const auto& topic : standard_subscriptions_) {
+    AddSubscriptionFront(topic);
+  }
+}
+
 void SparkplugHost::CreateStateTopic() {
   // Check if the STATE topic already exists
   auto* topic = GetTopicByMessageType("STATE");
@@ -291,6 +352,11 @@ bool SparkplugHost::SendConnect() {
   will_options.qos = static_cast<int>(QualityOfService::Qos1);
 
   const auto& body = payload.Body();
+  if (IsInProcess()) {
+    ResetDelivered();
+    ResetConnectionLost();
+    return ConnectBus(state_topic->Topic(), body, true);
+  }
   will_options.payload.len = static_cast<int>(body.size());
   will_options.payload.data = body.data();
 
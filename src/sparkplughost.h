@@ -39,8 +39,10 @@ class SparkplugHost : public SparkplugNode {
   std::atomic<bool> stop_work_task_ = true;
   uint64_t start_time_ = 0; ///< Start time (ms) of the host. Set by Start()
   uint64_t host_timer_ = 0; ///< The host timer is used by the thread
+  std::vector<std::string> standard_subscriptions_; ///< Subscriptions added by Start()
 
   void CreateStateTopic();
+  void AddStandardSubscriptions();
   void AddDefaultMetrics();
 
   void HostTask();
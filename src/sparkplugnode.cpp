@@ -5,6 +5,7 @@
 
 
 #include "sparkplugnode.h"
+#include <algorithm>
 #include <chrono>
 #include "util/utilfactory.h"
 #include "util/logstream.h"
@@ -34,6 +35,23 @@ constexpr std::string_view kOs = "Properties/OS";
 constexpr std::string_view kOsVersion = "Properties/OS Version";
 constexpr std::string_view kMqttVersion = "Properties/MQTT Version";
 
+constexpr std::string_view kStatsMessagesIn = "Node Control/Stats/Messages In";
+constexpr std::string_view kStatsMessagesOut = "Node Control/Stats/Messages Out";
+constexpr std::string_view kStatsBytesIn = "Node Control/Stats/Bytes In";
+constexpr std::string_view kStatsBytesOut = "Node Control/Stats/Bytes Out";
+constexpr std::string_view kStatsDropped = "Node Control/Stats/Dropped Messages";
+constexpr std::string_view kStatsPublishFailures = "Node Control/Stats/Publish Failures";
+constexpr std::string_view kStatsParseErrors = "Node Control/Stats/Parse Errors";
+constexpr std::string_view kStatsQueueDepth = "Node Control/Stats/Queue Depth";
+constexpr std::string_view kStatsMemory = "Node Control/Stats/Memory Usage";
+constexpr std::string_view kStatsParseTime = "Node Control/Stats/Parse Time P99";
+constexpr std::string_view kStatsEncodeTime = "Node Control/Stats/Encode Time P99";
+constexpr std::string_view kStatsDeliveryTime = "Node Control/Stats/Delivery Time P99";
+constexpr uint64_t kStatisticsInterval = 10'000; ///< Statistics publish interval (ms)
+
+constexpr std::string_view kLatencyProbe = "Node Control/Latency Probe";
+constexpr uint64_t kLatencyProbeInterval = 1'000; ///< Latency probe publish interval (ms)
+
 constexpr std::string_view kState = "STATE";
 
 constexpr std::string_view kNodeBirth = "NBIRTH";
@@ -65,7 +83,8 @@ bool IsSparkplugDevice(const pub_sub::IPubSubClient* client) {
 namespace pub_sub {
 
 SparkplugNode::SparkplugNode()
-: listen_(std::move(util::UtilFactory::CreateListen("ListenProxy", "LISMQTT"))) {
+: listen_(std::move(util::UtilFactory::CreateListen("ListenProxy", "LISMQTT"))),
+  random_(std::random_device()()) {
   CreateNodeBirthTopic();
   CreateNodeDeathTopic();
 }
@@ -93,9 +112,17 @@ void SparkplugNode::OnConnectionLost(void *context, char *cause) {
 int SparkplugNode::OnMessageArrived(void* context, char* topic_name,
                                     int topicLen, MQTTAsync_message* message) {
   auto *node = reinterpret_cast<SparkplugNode *>(context);
-  const std::string topic_id = topic_name != nullptr && topicLen > 0 ? topic_name : "";
+  OutboundQueue::NonBlockingThread(); // Publishing shall not delay the acknowledges
+  // The topic length is 0 if the topic name is null terminated.
+  const std::string_view topic_id = topic_name == nullptr ? std::string_view() :
+      topicLen > 0 ? std::string_view(topic_name, topicLen) : std::string_view(topic_name);
+  // Drop unwanted messages before any copy of the topic name or payload
   if (node != nullptr && message != nullptr && !topic_id.empty()) {
-    node->Message(topic_id, *message);
+    if (node->Filter().IsAccepted(topic_id)) {
+      node->Message(std::string(topic_id), *message);
+    } else {
+      node->Statistics().AddDroppedMessage();
+    }
   }
 
   if (topic_name != nullptr) {
@@ -181,6 +208,68 @@ void SparkplugNode::OnDisconnectFailure5(void* context, MQTTAsync_failureData5*
   }
 }
 
+void SparkplugNode::OnStandbyConnectionLost(void *context, char *cause) {
+  auto *node = reinterpret_cast<SparkplugNode *>(context);
+  if (node != nullptr) {
+    LOG_INFO() << "Standby connection lost. Reason: " << (cause != nullptr ? cause : "");
+    node->standby_connected_ = false;
+    node->standby_failed_ = true;
+  }
+  if (cause != nullptr) {
+    MQTTAsync_free(cause);
+  }
+}
+
+int SparkplugNode::OnStandbyMessageArrived(void*, char* topic_name, int,
+                                           MQTTAsync_message* message) {
+  // The standby session has no subscriptions, so the message is dropped.
+  if (topic_name != nullptr) {
+    MQTTAsync_free(topic_name);
+  }
+  if (message != nullptr) {
+    MQTTAsync_freeMessage(&message);
+  }
+  return MQTTASYNC_TRUE;
+}
+
+void SparkplugNode::OnStandbyConnect(void* context, MQTTAsync_successData*) {
+  auto *node = reinterpret_cast<SparkplugNode *>(context);
+  if (node != nullptr) {
+    node->standby_alias_max_ = 0;
+    node->standby_connected_ = true;
+  }
+}
+
+void SparkplugNode::OnStandbyConnectFailure(void* context, MQTTAsync_failureData* response) {
+  auto *node = reinterpret_cast<SparkplugNode *>(context);
+  if (node != nullptr) {
+    LOG_INFO() << "Failed to connect the standby broker. Error: "
+        << MQTTAsync_strerror(response != nullptr ? response->code : MQTTASYNC_FAILURE);
+    node->standby_failed_ = true;
+  }
+}
+
+void SparkplugNode::OnStandbyConnect5(void* context, MQTTAsync_successData5* response) {
+  auto *node = reinterpret_cast<SparkplugNode *>(context);
+  if (node == nullptr || response == nullptr) {
+    return;
+  }
+  auto& properties = response->properties;
+  const int alias_max = MQTTProperties_hasProperty(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) ?
+      MQTTProperties_getNumericValue(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) : 0;
+  node->standby_alias_max_ = alias_max > 0 ? static_cast<uint16_t>(alias_max) : 0;
+  node->standby_connected_ = true;
+}
+
+void SparkplugNode::OnStandbyConnectFailure5(void* context, MQTTAsync_failureData5* response) {
+  auto *node = reinterpret_cast<SparkplugNode *>(context);
+  if (node != nullptr) {
+    LOG_INFO() << "Failed to connect the standby broker. Error: "
+        << MQTTAsync_strerror(response != nullptr ? response->code : MQTTASYNC_FAILURE);
+    node->standby_failed_ = true;
+  }
+}
+
 void SparkplugNode::Connect(const MQTTAsync_successData &response) {
   const auto& info = response.alt.connect;
   server_uri_ = info.serverURI != nullptr ? info.serverURI : std::string();
@@ -203,6 +292,7 @@ void SparkplugNode::Connect(const MQTTAsync_successData &response) {
   }
 
   server_session_ = info.sessionPresent;
+  ResetTopicAliases(0);
 
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("Connected. URI: %s, Version: %d, Session: %d",
@@ -231,6 +321,7 @@ void SparkplugNode::ConnectFailure(const MQTTAsync_failureData &response) {
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("%s", err.str().c_str());
   }
+  SetConnectionLost(); // Try the next broker without waiting on the timeout
   SetDelivered();
   node_event_.notify_one();
 }
@@ -258,6 +349,12 @@ void SparkplugNode::Connect5(const MQTTAsync_successData5 &response) {
 
   server_session_ = info.sessionPresent;
 
+  // Topic aliases are only valid within this network connection.
+  auto& properties = const_cast<MQTTProperties&>(response.properties);
+  const int alias_max = MQTTProperties_hasProperty(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) ?
+      MQTTProperties_getNumericValue(&properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM) : 0;
+  ResetTopicAliases(alias_max > 0 ? static_cast<uint16_t>(alias_max) : 0);
+
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("Connected. URI: %s, Version: %d, Session: %d",
                         server_uri_.c_str(), server_version_, server_session_);
@@ -285,6 +382,7 @@ void SparkplugNode::ConnectFailure5(const MQTTAsync_failureData5 &response) {
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("%s", err.str().c_str());
   }
+  SetConnectionLost(); // Try the next broker without waiting on the timeout
   SetDelivered();
   node_event_.notify_one();
 }
@@ -294,10 +392,13 @@ void SparkplugNode::ConnectionLost(const std::string& reason) {
   err << "Connection lost. Reason: " << reason;
   LOG_INFO() << err.str(); // Not an error. This is a normal event
 
+  uint64_t no_loss = 0;
+  lost_ns_.compare_exchange_strong(no_loss, SparkplugHelper::NowNs());
   SetConnectionLost();
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("%s", err.str().c_str());
   }
+  node_event_.notify_one(); // Switch to the standby session directly
 }
 
 void SparkplugNode::SubscribeFailure(const MQTTAsync_failureData &response) {
@@ -325,10 +426,15 @@ void SparkplugNode::SubscribeFailure5(const MQTTAsync_failureData5 &response) {
 }
 
 void SparkplugNode::Message(const std::string& topic_name, const MQTTAsync_message& message) {
+  arrival_ns_ = LatencyProbe() ? SparkplugHelper::NowNs() : 0;
   if (message.payloadlen < 0) {
     LOG_ERROR() << "Invalid payload length. Length: " << message.payloadlen;
     return;
   }
+  if (capture_.IsActive()) {
+    capture_.Capture(topic_name, message.payload, static_cast<size_t>(message.payloadlen),
+                     message.retained != 0);
+  }
 
   // I need to find the STATE,NBIRTH or DBIRTH topic for each message
 
@@ -336,7 +442,11 @@ void SparkplugNode::Message(const std::string& topic_name, const MQTTAsync_messa
   SparkplugTopic temp_topic(*this);
   temp_topic.Topic(topic_name);
   const std::string& message_type = temp_topic.MessageType();
-  if (listen_ && listen_->IsActive()) {
+  if (auto tracer = listen_ && listen_->IsActive() && AsyncTrace() ? Tracer() : nullptr;
+      tracer) {
+    tracer->Trace(false, topic_name, message.payload,
+                  static_cast<size_t>(message.payloadlen));
+  } else if (listen_ && listen_->IsActive()) {
     // Using the temp topic to parse the payload
     try {
       Payload &payload = temp_topic.GetPayload();
@@ -361,6 +471,9 @@ void SparkplugNode::Message(const std::string& topic_name, const MQTTAsync_messa
   const auto& node_name = temp_topic.NodeId();
   const auto& device_name = temp_topic.DeviceId();
 
+  statistics_.AddMessageIn(static_cast<size_t>(message.payloadlen));
+  ScopedTimer parse_timer(statistics_.ParseTime());
+
   if (message_type == kState ) {
     HandleStateMessage(node_name, message);
   } else if (message_type == kNodeBirth) {
@@ -454,7 +567,10 @@ bool SparkplugNode::Start() {
   }
 
   AddDefaultMetrics();
-
+  StartTracer();
+  if (!LocalEndpoint().empty() && !local_hub_.Start(LocalEndpoint())) {
+    return false;
+  }
 
   // Set the publishing flag to true. This defines that these messages should not be
   // updated from a subscription.
@@ -493,6 +609,7 @@ bool SparkplugNode::Start() {
   // Set alias numbers to all metrics.
   AssignAliasNumbers();
 
+  outbound_.Start();
   stop_node_task_ = false;
   work_thread_ = std::thread(&SparkplugNode::NodeTask, this);
 
@@ -510,55 +627,64 @@ bool SparkplugNode::Stop() {
   if (work_thread_.joinable()) {
     work_thread_.join();
   }
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
+  outbound_.Stop();
+  DestroyHandle();
+  local_hub_.Stop();
+  if (auto tracer = Tracer(); tracer) {
+    tracer->Stop();
   }
 
   return true;
 }
 
-bool SparkplugNode::CreateNode() {
+uint64_t SparkplugNode::DroppedTraces() const {
+  const auto tracer = Tracer();
+  return tracer ? tracer->DroppedTraces() : 0;
+}
 
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
+void SparkplugNode::StartTracer() {
+  auto tracer = Tracer();
+  if (!AsyncTrace()) {
+    if (tracer) {
+      tracer->Stop();
+    }
+    return;
   }
+  // The ring buffer is only allocated if the messages are traced. This
+  // keeps the remote nodes of a host small.
+  if (!tracer) {
+    tracer = std::make_shared<ListenTracer>(listen_.get());
+    tracer_.store(tracer);
+  }
+  tracer->SampleRate(TraceSampleRate());
+  tracer->Start();
+}
+
+bool SparkplugNode::CreateNode() {
+
+  DestroyHandle();
 
 
     // Set the host ID as Listen pre-text debugger text
   if (listen_ && !Name().empty()) {
     listen_->PreText(Name());
   }
-
-  std::ostringstream connect_string;
-  switch (Transport()) {
-    case TransportLayer::MqttWebSocket:
-      connect_string << "ws://";
-      break;
-
-    case TransportLayer::MqttTcpTls:
-      connect_string << "ssl://";
-      break;
-
-    case TransportLayer::MqttWebSocketTls:
-      connect_string << "wss://";
-      break;
-
-    default:
-      connect_string << "tcp://";
-      break;
+  if (IsInProcess()) {
+    return true; // No MQTT handle is needed
   }
-  connect_string << Broker() << ":" << Port();
+
+  const auto connect_string = ConnectString(server_index_);
   if (listen_ && listen_->IsActive()) {
     listen_->ListenText("Creating Node");
   }
   MQTTAsync_createOptions create_options = MQTTAsync_createOptions_initializer5;
 
-  const auto create = MQTTAsync_createWithOptions(&handle_, connect_string.str().c_str(),
+  MQTTAsync handle = nullptr;
+  const auto create = MQTTAsync_createWithOptions(&handle, connect_string.c_str(),
                                        name_.c_str(),
                                        MQTTCLIENT_PERSISTENCE_NONE, nullptr,
                                        Version() == ProtocolVersion::Mqtt5 ? &create_options : nullptr);
+  handle_ = handle;
   if (create != MQTTASYNC_SUCCESS) {
     std::ostringstream err;
     err << "Failed to create the MQTT handle.";
@@ -589,6 +715,34 @@ bool SparkplugNode::CreateNode() {
   return true;
 }
 
+std::string SparkplugNode::ConnectString(size_t server_index) const {
+  std::ostringstream connect_string;
+  switch (Transport()) {
+    case TransportLayer::MqttWebSocket:
+      connect_string << "ws://";
+      break;
+
+    case TransportLayer::MqttTcpTls:
+      connect_string << "ssl://";
+      break;
+
+    case TransportLayer::MqttWebSocketTls:
+      connect_string << "wss://";
+      break;
+
+    default:
+      connect_string << "tcp://";
+      break;
+  }
+  if (server_index == 0 || server_index >= NofServers()) {
+    connect_string << Broker() << ":" << Port();
+  } else {
+    const auto& standby = StandbyBrokers()[server_index - 1];
+    connect_string << standby.broker << ":" << standby.port;
+  }
+  return connect_string.str();
+}
+
 
 
 bool SparkplugNode::SendConnect() {
@@ -598,19 +752,37 @@ bool SparkplugNode::SendConnect() {
     return false;
   }
 
+  // Each new session shall increment the bdSeq.
+  bd_sequence_number_ = NextBdSeq();
+  const auto body = CreateDeathBody(bd_sequence_number_);
+  if (IsInProcess()) {
+    return ConnectBus(node_death->Topic(), body, false);
+  }
+  ResetConnectionLost();
+  return ConnectMqtt(handle_, node_death->Topic(), body, false);
+}
+
+std::vector<uint8_t> SparkplugNode::CreateDeathBody(uint64_t bd_seq) {
+  auto* node_death = GetTopicByMessageType(kNodeDeath.data());
+  if (node_death == nullptr) {
+    return {};
+  }
   auto& payload = node_death->GetPayload();
-  payload.SetValue(kBdSeq.data(),bd_sequence_number_);
+  payload.SetValue(kBdSeq.data(), bd_seq);
   payload.Timestamp(SparkplugHelper::NowMs());
   payload.SequenceNumber(0);
   payload.GenerateProtobuf();
-  const auto& body = payload.Body();
+  return payload.Body();
+}
 
+bool SparkplugNode::ConnectMqtt(MQTTAsync handle, const std::string& will_topic,
+                                const std::vector<uint8_t>& will_body, bool standby) {
   MQTTAsync_willOptions will_options = MQTTAsync_willOptions_initializer;
   will_options.retained = MQTTASYNC_TRUE;
-  will_options.topicName = node_death->Topic().c_str();
+  will_options.topicName = will_topic.c_str();
   will_options.message = nullptr; // If message is null, the payload is sent instead.
-  will_options.payload.data = body.data();
-  will_options.payload.len = static_cast<int>(body.size());
+  will_options.payload.data = will_body.data();
+  will_options.payload.len = static_cast<int>(will_body.size());
   will_options.retained = 0; // Must be false
   will_options.qos = static_cast<int>(QualityOfService::Qos1); // Must be Qos1
 
@@ -621,15 +793,15 @@ bool SparkplugNode::SendConnect() {
   connect_options.keepAliveInterval = 60; // 60 seconds between keep alive messages.
   // connect_options.cleansession = MQTTASYNC_TRUE; // Must not have a persistent connection.
   connect_options.connectTimeout = 10; // Wait max 10 seconds on connect.
-  connect_options.onSuccess = OnConnect;
-  connect_options.onFailure = OnConnectFailure;
+  connect_options.onSuccess = standby ? OnStandbyConnect : OnConnect;
+  connect_options.onFailure = standby ? OnStandbyConnectFailure : OnConnectFailure;
   connect_options.context = this;
   if (Version() == ProtocolVersion::Mqtt5) {
     connect_options.MQTTVersion = MQTTVERSION_5;
     connect_options.onSuccess = nullptr;
     connect_options.onFailure = nullptr;
-    connect_options.onSuccess5 = OnConnect5;
-    connect_options.onFailure5 = OnConnectFailure5;
+    connect_options.onSuccess5 = standby ? OnStandbyConnect5 : OnConnect5;
+    connect_options.onFailure5 = standby ? OnStandbyConnectFailure5 : OnConnectFailure5;
   }
   connect_options.automaticReconnect = 0; // No automatic reconnect
   connect_options.retryInterval = 0;
@@ -644,7 +816,7 @@ bool SparkplugNode::SendConnect() {
     InitSsl(); // Fill the ssl_options_ structure with values
     connect_options.ssl = &ssl_options_;
   }
-  const auto connect = MQTTAsync_connect(handle_, &connect_options);
+  const auto connect = MQTTAsync_connect(handle, &connect_options);
   if (connect != MQTTASYNC_SUCCESS) {
     LOG_ERROR()  << "Failed to connect to the MQTT broker. Error: " << MQTTAsync_strerror(connect);
     return false;
@@ -652,6 +824,212 @@ bool SparkplugNode::SendConnect() {
   return true;
 }
 
+void SparkplugNode::CreateStandby() {
+  DestroyStandby();
+  standby_index_ = (server_index_ + 1) % NofServers();
+  // The standby death certificate uses the next bdSeq, so a host doesn't
+  // mix it up with the death certificate of the active session.
+  standby_bd_seq_ = NextBdSeq();
+  standby_connected_ = false;
+  standby_failed_ = false;
+
+  const auto connect_string = ConnectString(standby_index_);
+  MQTTAsync_createOptions create_options = MQTTAsync_createOptions_initializer5;
+  const auto create = MQTTAsync_createWithOptions(&standby_handle_, connect_string.c_str(),
+                                       name_.c_str(),
+                                       MQTTCLIENT_PERSISTENCE_NONE, nullptr,
+                                       Version() == ProtocolVersion::Mqtt5 ? &create_options : nullptr);
+  if (create != MQTTASYNC_SUCCESS) {
+    LOG_ERROR() << "Failed to create the standby MQTT handle. Error: " << MQTTAsync_strerror(create);
+    standby_handle_ = nullptr;
+    standby_failed_ = true;
+    return;
+  }
+  const auto callback = MQTTAsync_setCallbacks(standby_handle_, this,
+                                               OnStandbyConnectionLost,
+                                               OnStandbyMessageArrived,
+                                               nullptr);
+  const auto* node_death = GetTopicByMessageType(kNodeDeath.data());
+  const auto body = CreateDeathBody(standby_bd_seq_);
+  CreateDeathBody(bd_sequence_number_); // Restore the active death certificate
+  if (callback != MQTTASYNC_SUCCESS || node_death == nullptr ||
+      !ConnectMqtt(standby_handle_, node_death->Topic(), body, true)) {
+    standby_failed_ = true;
+    return;
+  }
+  if (listen_ && listen_->IsActive()) {
+    listen_->ListenText("Connecting standby. URI: %s", connect_string.c_str());
+  }
+}
+
+void SparkplugNode::DestroyStandby() {
+  if (standby_handle_ == nullptr) {
+    return;
+  }
+  DisconnectHandle(standby_handle_);
+  MQTTAsync_destroy(&standby_handle_);
+  standby_handle_ = nullptr;
+  standby_connected_ = false;
+}
+
+void SparkplugNode::DisconnectHandle(MQTTAsync handle) {
+  // A normal disconnect doesn't publish the will (NDEATH).
+  if (handle == nullptr || !MQTTAsync_isConnected(handle)) {
+    return;
+  }
+  MQTTAsync_disconnectOptions disconnect_options = MQTTAsync_disconnectOptions_initializer;
+  if (Version() == ProtocolVersion::Mqtt5) {
+    disconnect_options = MQTTAsync_disconnectOptions_initializer5;
+  }
+  disconnect_options.timeout = 100;
+  if (MQTTAsync_disconnect(handle, &disconnect_options) != MQTTASYNC_SUCCESS) {
+    return;
+  }
+  for (size_t timeout = 0; MQTTAsync_isConnected(handle) && timeout < 20; ++timeout) {
+    std::this_thread::sleep_for(5ms);
+  }
+}
+
+bool SparkplugNode::SwitchToStandby(bool publish_death) {
+  if (standby_handle_ == nullptr || !standby_connected_ || standby_failed_ ||
+      !MQTTAsync_isConnected(standby_handle_)) {
+    return false;
+  }
+  // The standby session shall now deliver its messages to the node.
+  const auto callback = MQTTAsync_setCallbacks(standby_handle_, this,
+                                               OnConnectionLost,
+                                               OnMessageArrived,
+                                               nullptr);
+  if (callback != MQTTASYNC_SUCCESS) {
+    LOG_ERROR() << "Failed to set the standby MQTT callbacks. Error: " << MQTTAsync_strerror(callback);
+    DestroyStandby();
+    return false;
+  }
+  if (publish_death) {
+    PublishNodeDeath();
+    DisconnectHandle(handle_);
+  }
+  DestroyHandle();
+
+  handle_ = standby_handle_; // The outbound queue sends on the new session
+  standby_handle_ = nullptr;
+  standby_connected_ = false;
+  server_index_ = standby_index_;
+  bd_sequence_number_ = standby_bd_seq_;
+  CreateDeathBody(bd_sequence_number_); // NDEATH that matches the new session
+  server_uri_ = ConnectString(server_index_);
+  ResetTopicAliases(standby_alias_max_);
+  ResetConnectionLost();
+  retry_count_ = 0;
+
+  // The host STATE of the previous broker is not valid on this broker. The
+  // retained STATE arrives after the subscription is started.
+  ResetHostState();
+  StartSubscription();
+  if (WaitOnHostOnline()) {
+    node_state_ = NodeState::WaitOnHost;
+  } else {
+    PublishNodeBirth();
+    RebirthDevices();
+    PollDevices();
+  }
+
+  const auto lost = lost_ns_.exchange(0);
+  const auto now = SparkplugHelper::NowNs();
+  statistics_.AddFailover(lost > 0 && now > lost ? now - lost : 0);
+  standby_timer_ = 0; // Connect the next standby broker
+
+  LOG_INFO() << "Switched to the standby broker. Server: " << server_uri_;
+  if (listen_ && listen_->IsActive()) {
+    listen_->ListenText("Switched to standby. URI: %s", server_uri_.c_str());
+  }
+  return true;
+}
+
+bool SparkplugNode::ConnectBus(const std::string& will_topic,
+                               const std::vector<uint8_t>& will_body, bool will_retained) {
+  auto will = std::make_shared<const std::vector<uint8_t>>(will_body);
+  InProcessBus::Instance().Connect(this,
+      [this] (const std::string& topic_name, const BusBuffer& body, bool retained) {
+        BusMessage(topic_name, body, retained);
+      }, will_topic, std::move(will), will_retained);
+
+  server_uri_ = "inproc://";
+  server_version_ = static_cast<int>(Version());
+  server_session_ = 0;
+  ResetTopicAliases(0); // Topic aliases have no meaning in-process
+
+  if (listen_ && listen_->IsActive()) {
+    listen_->ListenText("Connected. URI: %s", server_uri_.c_str());
+  }
+  SetDelivered();
+  node_event_.notify_one();
+  return true;
+}
+
+void SparkplugNode::DestroyHandle() {
+  {
+    // The outbound queue's thread may send with the handle.
+    auto send_lock = outbound_.LockSend();
+    if (MQTTAsync handle = handle_.exchange(nullptr); handle != nullptr) {
+      MQTTAsync_destroy(&handle);
+      outbound_.Reset();
+    }
+  }
+  if (IsInProcess()) {
+    // Sends the will message if the node still is connected.
+    InProcessBus::Instance().Disconnect(this, true);
+  }
+}
+
+void SparkplugNode::BusMessage(const std::string& topic_name, const BusBuffer& body,
+                               bool retained) {
+  // The message payload points to the shared bus buffer. No copy is made.
+  if (body && !body->empty()) {
+    InjectMessage(topic_name, body->data(), body->size(), retained);
+  } else {
+    InjectMessage(topic_name, nullptr, 0, retained);
+  }
+}
+
+void SparkplugNode::InjectMessage(const std::string& topic_name, const void* payload,
+                                  size_t payload_size, bool retained) {
+  if (!Filter().IsAccepted(topic_name)) {
+    statistics_.AddDroppedMessage();
+    return;
+  }
+  MQTTAsync_message message = MQTTAsync_message_initializer;
+  if (payload != nullptr && payload_size > 0) {
+    message.payload = const_cast<void*>(payload);
+    message.payloadlen = static_cast<int>(payload_size);
+  }
+  message.retained = retained ? 1 : 0;
+  Message(topic_name, message);
+}
+
+void SparkplugNode::PublishLocal(const std::string& message_type, const std::string& topic_name,
+                                 const BusBuffer& body) {
+  // The BIRTH messages are retained, so new consumers get the metric definitions.
+  if (message_type == kNodeBirth) {
+    local_hub_.ClearRetained();
+    local_hub_.Publish(topic_name, body, true);
+  } else if (message_type == kDeviceBirth) {
+    local_hub_.Publish(topic_name, body, true);
+  } else if (message_type == kNodeDeath) {
+    local_hub_.ClearRetained();
+    local_hub_.Publish(topic_name, body, false);
+  } else if (message_type == kDeviceDeath) {
+    std::string birth_topic = topic_name;
+    if (const auto type_pos = birth_topic.find(kDeviceDeath); type_pos != std::string::npos) {
+      birth_topic.replace(type_pos, kDeviceDeath.size(), kDeviceBirth);
+      local_hub_.ClearRetained(birth_topic);
+    }
+    local_hub_.Publish(topic_name, body, false);
+  } else {
+    local_hub_.Publish(topic_name, body, false);
+  }
+}
+
 void SparkplugNode::CreateNodeDeathTopic() {
   auto* topic = GetTopicByMessageType("NDEATH");
   if (topic != nullptr) {
@@ -747,6 +1125,10 @@ void SparkplugNode::StartSubscription() {
     if (listen_ && listen_->IsActive()) {
       listen_->ListenText("Subscribe: %s", topic.c_str());
     }
+    if (IsInProcess()) {
+      InProcessBus::Instance().Subscribe(this, topic);
+      continue;
+    }
     const auto subscribe = MQTTAsync_subscribe(handle_, topic.c_str(),
                                                static_cast<int>(qos), &options);
     if (subscribe != MQTTASYNC_SUCCESS) {
@@ -758,21 +1140,71 @@ void SparkplugNode::StartSubscription() {
 
 ITopic *SparkplugNode::CreateTopic() {
   auto topic = std::make_unique<SparkplugTopic>(*this);
-  std::scoped_lock list_lock(topic_mutex_);
-
-  topic_list_.emplace_back(std::move(topic));
-  return topic_list_.back().get();
+  return AddTopic(std::move(topic));
 }
 
 ITopic *SparkplugNode::AddMetric(const std::shared_ptr<Metric> &value) {
   return nullptr;
 }
 
+std::vector<std::shared_ptr<Metric>> SparkplugNode::AddMetrics(
+    std::span<const MetricDescriptor> descriptor_list) {
+  auto* topic = GetTopicByMessageType(kNodeBirth.data());
+  if (topic == nullptr) {
+    return {};
+  }
+  return CreateBirthMetrics(topic->GetPayload(), "", descriptor_list);
+}
+
+std::vector<std::shared_ptr<Metric>> SparkplugNode::CreateBirthMetrics(Payload& payload,
+    const std::string& device_name, std::span<const MetricDescriptor> descriptor_list) {
+  if (!UseAliasTable()) {
+    // Later ranges shall not overlap the fixed aliases.
+    uint64_t fixed_next = 0;
+    for (const auto& descriptor : descriptor_list) {
+      fixed_next = std::max(fixed_next, descriptor.alias + 1);
+    }
+    const auto first_alias = ReserveAliases(descriptor_list.size());
+    uint64_t next_alias = next_alias_;
+    while (next_alias < fixed_next && !next_alias_.compare_exchange_weak(next_alias, fixed_next)) {
+    }
+    return payload.CreateMetrics(descriptor_list, first_alias);
+  }
+  // Take the aliases from the alias file, so they are kept between restarts.
+  std::vector<MetricDescriptor> stable_list(descriptor_list.begin(), descriptor_list.end());
+  for (auto& descriptor : stable_list) {
+    const auto key = AliasTable::MakeKey(device_name, descriptor.name);
+    if (descriptor.alias != 0 && !alias_table_.Alias(key, descriptor.alias)) {
+      LOG_ERROR() << "The alias is used by another metric. Metric: " << key
+        << ", Alias: " << descriptor.alias;
+      descriptor.alias = 0;
+    }
+    if (descriptor.alias == 0) {
+      descriptor.alias = alias_table_.Alias(key);
+    }
+  }
+  alias_table_.Save();
+  return payload.CreateMetrics(stable_list);
+}
+
 bool SparkplugNode::IsConnected() const {
-  return handle_ != nullptr && MQTTAsync_isConnected(handle_);
+  if (IsInProcess()) {
+    return InProcessBus::Instance().IsConnected(this);
+  }
+  const MQTTAsync handle = handle_;
+  return handle != nullptr && MQTTAsync_isConnected(handle);
 }
 
 void SparkplugNode::SendDisconnect() {
+  if (IsInProcess()) {
+    InProcessBus::Instance().Disconnect(this, false);
+    if (listen_ && listen_->IsActive()) {
+      listen_->ListenText("Node disconnected. Node: %s", Name().c_str());
+    }
+    SetDelivered();
+    node_event_.notify_one();
+    return;
+  }
   MQTTAsync_disconnectOptions disconnect_options = MQTTAsync_disconnectOptions_initializer;
   if (Version() == ProtocolVersion::Mqtt5) {
     disconnect_options = MQTTAsync_disconnectOptions_initializer5;
@@ -867,12 +1299,12 @@ bool SparkplugNode::IsOffline() const {
 }
 
 void SparkplugNode::NodeTask() {
+  OutboundQueue::NonBlockingThread(); // A full queue shall not delay the failover
   node_timer_ = 0;
   node_state_ = NodeState::Idle;
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  server_index_ = 0; // Start with the primary broker
+  retry_count_ = 0;
+  DestroyHandle();
 
   while (!stop_node_task_) {
     std::unique_lock node_lock(node_mutex_);
@@ -895,8 +1327,12 @@ void SparkplugNode::NodeTask() {
         DoWaitOnDisconnect();
         break;
 
+      case NodeState::WaitOnHost:
+        DoWaitOnHost();
+        break;
+
       default: // Invalid/Unknown state
-        node_timer_ = SparkplugHelper::NowMs() + 10'000;
+        node_timer_ = SparkplugHelper::NowMs() + NextRetryDelay();
         node_state_ = NodeState::Idle;
         break;
     }
@@ -926,10 +1362,8 @@ void SparkplugNode::NodeTask() {
       }
     }
   }
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  DestroyStandby();
+  DestroyHandle();
 }
 
 void SparkplugNode::DoIdle() {
@@ -937,12 +1371,9 @@ void SparkplugNode::DoIdle() {
   const bool timeout = now >= node_timer_;
 
   // Destroy any previously created context/handle.
-  if (handle_ != nullptr) {
-    MQTTAsync_destroy(&handle_);
-    handle_ = nullptr;
-  }
+  DestroyHandle();
 
-  // Check the retry timeout first (10s)
+  // Check the retry timeout first, see NextRetryDelay()
   if (!timeout) {
     return;
   }
@@ -959,13 +1390,15 @@ void SparkplugNode::DoIdle() {
   // to the MQTT server.
   const auto create = CreateNode();
   if (!create) {
-    node_timer_ = now + 10'000; // 10 second to next create try
+    StepServer();
+    node_timer_ = now + NextRetryDelay();
     return;
   }
 
   const auto connect = SendConnect();
   if (!connect) {
-    node_timer_ = now + 10'000; // 10 second to next create try
+    StepServer();
+    node_timer_ = now + NextRetryDelay();
     return;
   }
 
@@ -978,9 +1411,10 @@ void SparkplugNode::DoWaitOnConnect() {
   const auto now = SparkplugHelper::NowMs();
   const bool timeout = now >= node_timer_;
 
-  // Connection timeout
-  if (timeout && !IsConnected()) {
-    node_timer_ = now + 10'000; // Retry in 10 seconds
+  // Connection timeout or connect failure. Try the next broker.
+  if ((timeout || IsConnectionLost()) && !IsConnected()) {
+    StepServer();
+    node_timer_ = now + NextRetryDelay();
     node_state_ = NodeState::Idle;
     return;
   }
@@ -992,31 +1426,307 @@ void SparkplugNode::DoWaitOnConnect() {
 
   // Start subscriptions and publish NBIRTH message.
   // We will not check that it is delivered.
+  retry_count_ = 0;
+  lost_ns_ = 0;
+  standby_timer_ = now;
   StartSubscription();
   PublishNodeBirth();
   node_state_ = NodeState::Online;
+  RebirthDevices(); // Devices that was online on the previous session
   PollDevices(); // Speed up the DBIRTH sending
 }
 
 void SparkplugNode::DoOnline() {
   const auto now = SparkplugHelper::NowMs();
   if (stop_node_task_ || !InService() || (WaitOnHostOnline() && !IsHostOnline())) {
+    DestroyStandby();
     PollDevices(); // This generates DDEATH messages
     PublishNodeDeath();
     SendDisconnect();
     node_timer_ = now + 5'000;
     node_state_ = NodeState::WaitOnDisconnect;
+  } else if (IsConnectionLost() || !IsConnected()) {
+    // The broker publishes the NDEATH of the lost session.
+    if (!SwitchToStandby(false)) {
+      DestroyStandby();
+      StepServer();
+      node_timer_ = now + NextRetryDelay();
+      node_state_ = NodeState::Idle;
+    }
+  } else if (next_server_.exchange(false)) {
+    lost_ns_ = SparkplugHelper::NowNs();
+    if (!SwitchToStandby(true)) {
+      DestroyStandby();
+      PublishNodeDeath();
+      SendDisconnect();
+      StepServer();
+      node_timer_ = now + 5'000;
+      node_state_ = NodeState::WaitOnDisconnect;
+    }
   } else {
+    if (HotStandby() && NofServers() > 1 && !IsInProcess()) {
+      if (standby_handle_ != nullptr && standby_failed_) {
+        DestroyStandby();
+        standby_timer_ = now + ReconnectDelayMax();
+      }
+      if (standby_handle_ == nullptr && now >= standby_timer_) {
+        CreateStandby();
+      }
+    }
     PollDevices();
+    if (PublishStatistics() && now >= statistics_timer_) {
+      PublishNodeStatistics();
+      statistics_timer_ = now + kStatisticsInterval;
+    }
+    if (LatencyProbe() && now >= latency_probe_timer_) {
+      PublishLatencyProbe();
+      latency_probe_timer_ = now + kLatencyProbeInterval;
+    }
+  }
+}
+
+ITopic* SparkplugNode::CreateNodeDataTopic() {
+  auto* data_topic = GetTopicByMessageType(kNodeData.data());
+  if (data_topic == nullptr) {
+    data_topic = CreateTopic();
+    if (data_topic == nullptr) {
+      LOG_ERROR() << "Failed to create the NDATA topic. Internal error.";
+      return nullptr;
+    }
+  }
+  std::ostringstream topic_name;
+  topic_name << kNamespace << "/" << GroupId() << "/" << kNodeData << "/" << Name();
+  data_topic->Topic(topic_name.str());
+  data_topic->Namespace(kNamespace.data());
+  data_topic->GroupId(GroupId());
+  data_topic->MessageType(kNodeData.data());
+  data_topic->NodeId(Name());
+  data_topic->Publish(true);
+  data_topic->Qos(QualityOfService::Qos0);
+  data_topic->Retained(false);
+  return data_topic;
+}
+
+void SparkplugNode::AddStatisticsMetrics(Payload& payload) {
+  auto* data_topic = CreateNodeDataTopic();
+  if (data_topic == nullptr) {
+    return;
+  }
+
+  // The metrics are defined in the NBIRTH and shared with the NDATA message.
+  auto& data_payload = data_topic->GetPayload();
+  auto add_metric = [&] (std::string_view name, const std::string& unit) {
+    auto metric = payload.CreateMetric(name.data());
+    if (metric) {
+      metric->Type(MetricType::UInt64);
+      metric->Value(uint64_t{0});
+      metric->Unit(unit);
+      data_payload.AddMetric(metric);
+    }
+  };
+  add_metric(kStatsMessagesIn, "");
+  add_metric(kStatsMessagesOut, "");
+  add_metric(kStatsBytesIn, "B");
+  add_metric(kStatsBytesOut, "B");
+  add_metric(kStatsDropped, "");
+  add_metric(kStatsPublishFailures, "");
+  add_metric(kStatsParseErrors, "");
+  add_metric(kStatsQueueDepth, "");
+  add_metric(kStatsMemory, "B");
+  add_metric(kStatsParseTime, "ns");
+  add_metric(kStatsEncodeTime, "ns");
+  add_metric(kStatsDeliveryTime, "ns");
+}
+
+void SparkplugNode::PublishNodeStatistics() {
+  auto* data_topic = GetTopicByMessageType(kNodeData.data());
+  if (data_topic == nullptr || !IsConnected()) {
+    return;
+  }
+  const auto& statistics = Statistics();
+  auto& payload = data_topic->GetPayload();
+  payload.SetValue(kStatsMessagesIn.data(), statistics.MessagesIn());
+  payload.SetValue(kStatsMessagesOut.data(), statistics.MessagesOut());
+  payload.SetValue(kStatsBytesIn.data(), statistics.BytesIn());
+  payload.SetValue(kStatsBytesOut.data(), statistics.BytesOut());
+  payload.SetValue(kStatsDropped.data(), statistics.DroppedMessages());
+  payload.SetValue(kStatsPublishFailures.data(), statistics.PublishFailures());
+  payload.SetValue(kStatsParseErrors.data(), statistics.ParseErrors());
+  payload.SetValue(kStatsQueueDepth.data(), static_cast<uint64_t>(QueueDepth()));
+  payload.SetValue(kStatsMemory.data(), static_cast<uint64_t>(MemoryUsage()));
+  payload.SetValue(kStatsParseTime.data(), statistics.ParseTime().Percentile(99.0));
+  payload.SetValue(kStatsEncodeTime.data(), statistics.EncodeTime().Percentile(99.0));
+  payload.SetValue(kStatsDeliveryTime.data(), outbound_.DeliveryTime().Percentile(99.0));
+  payload.Timestamp(SparkplugHelper::NowMs());
+  data_topic->DoPublish();
+}
+
+void SparkplugNode::AddLatencyProbeMetric(Payload& payload) {
+  auto* data_topic = CreateNodeDataTopic();
+  if (data_topic == nullptr) {
+    return;
+  }
+  auto probe = payload.CreateMetric(kLatencyProbe.data());
+  if (probe) {
+    probe->Type(MetricType::UInt64);
+    probe->Unit("ns");
+    probe->Value(SparkplugHelper::NowNs());
+    data_topic->GetPayload().AddMetric(probe);
+  }
+}
+
+void SparkplugNode::PublishLatencyProbe() {
+  auto* data_topic = GetTopicByMessageType(kNodeData.data());
+  if (data_topic == nullptr || !IsConnected()) {
+    return;
+  }
+  auto& payload = data_topic->GetPayload();
+  payload.Timestamp(SparkplugHelper::NowMs());
+  data_topic->DoPublish(); // The probe value is set by the DoPublish() function
+}
+
+void SparkplugNode::UpdateLatencyProbe(Payload& payload) const {
+  if (!LatencyProbe()) {
+    return;
+  }
+  if (auto probe = payload.GetMetric(kLatencyProbe.data()); probe) {
+    probe->Value(SparkplugHelper::NowNs());
+  }
+}
+
+void SparkplugNode::RecordLatency(SparkplugNode& node, const Payload& payload) {
+  const auto probe = payload.GetMetric(kLatencyProbe.data());
+  if (!probe) {
+    return;
+  }
+  const auto probe_ns = probe->Value<uint64_t>();
+  if (probe_ns == 0 || probe_ns == node.last_probe_ns_) {
+    return; // No new probe in this message
+  }
+  node.last_probe_ns_ = probe_ns;
+
+  const auto ingest_ns = SparkplugHelper::NowNs();
+  // The remote node holds its own values while the host aggregates all nodes.
+  auto& statistics = node.Statistics();
+  if (arrival_ns_ >= probe_ns) {
+    statistics.TransferTime().Add(arrival_ns_ - probe_ns);
+    statistics_.TransferTime().Add(arrival_ns_ - probe_ns);
+  }
+  if (ingest_ns >= probe_ns) {
+    statistics.IngestTime().Add(ingest_ns - probe_ns);
+    statistics_.IngestTime().Add(ingest_ns - probe_ns);
+  }
+}
+
+void SparkplugNode::CheckSequenceNumber(SparkplugNode& node, const Payload& payload,
+                                        bool birth) {
+  if (!ShareName().empty() && Version() == ProtocolVersion::Mqtt5) {
+    return; // A shared subscription only receives a part of the messages
+  }
+  if (Filter().IsPartialNode()) {
+    return; // The filter drops a part of the node's messages
+  }
+  const auto sequence = static_cast<int>(payload.SequenceNumber() % 256);
+  if (!birth && node.expected_sequence_ >= 0 && sequence != node.expected_sequence_) {
+    node.Statistics().AddSequenceGap();
+    statistics_.AddSequenceGap();
+    if (listen_ && listen_->IsActive()) {
+      listen_->ListenText("Sequence Gap: %s/%s, Expected/Received: %d/%d",
+                          node.GroupId().c_str(), node.Name().c_str(),
+                          node.expected_sequence_, sequence);
+    }
+  }
+  node.expected_sequence_ = (sequence + 1) % 256;
+}
+
+const IPubSubClient* SparkplugNode::GetRemoteNode(const std::string& group_id,
+                                                  const std::string& node_id) const {
+  std::scoped_lock list_lock(list_mutex_);
+  for (const auto& node : node_list_) {
+    if (node && IEquals(group_id, node->GroupId()) && IEquals(node_id, node->Name())) {
+      return node.get();
+    }
+  }
+  return nullptr;
+}
+
+size_t SparkplugNode::QueueDepth() const {
+  // Messages in the outbound queue are not yet handed over to the MQTT library.
+  const size_t queued = outbound_.QueueDepth();
+  const MQTTAsync handle = handle_;
+  if (handle == nullptr) {
+    return queued;
+  }
+  MQTTAsync_token* token_list = nullptr;
+  const int pending = MQTTAsync_getPendingTokens(handle, &token_list);
+  size_t count = 0;
+  if (pending == MQTTASYNC_SUCCESS && token_list != nullptr) {
+    while (token_list[count] != -1) {
+      ++count;
+    }
+  }
+  if (token_list != nullptr) {
+    MQTTAsync_free(token_list);
   }
+  return queued + count;
 }
 
 void SparkplugNode::DoWaitOnDisconnect() {
   const auto now = SparkplugHelper::NowMs();
   const bool timeout = now >= node_timer_;
   if (timeout || IsDelivered() ) {
-    node_timer_ = now + 10'000; // Retry in 10s
+    node_timer_ = now + NextRetryDelay();
+    node_state_ = NodeState::Idle;
+  }
+}
+
+void SparkplugNode::DoWaitOnHost() {
+  const auto now = SparkplugHelper::NowMs();
+  if (stop_node_task_ || !InService()) {
+    // No NBIRTH has been sent on this session, so no NDEATH is needed.
+    DestroyStandby();
+    SendDisconnect();
+    node_timer_ = now + 5'000;
+    node_state_ = NodeState::WaitOnDisconnect;
+  } else if (IsConnectionLost() || !IsConnected()) {
+    DestroyStandby();
+    StepServer();
+    node_timer_ = now + NextRetryDelay();
     node_state_ = NodeState::Idle;
+  } else if (IsHostOnline()) {
+    PublishNodeBirth();
+    node_state_ = NodeState::Online;
+    RebirthDevices();
+    PollDevices();
+  }
+}
+
+uint64_t SparkplugNode::NextBdSeq() {
+  if (bd_seq_used_) {
+    last_bd_seq_ = (last_bd_seq_ + 1) % 256;
+  }
+  bd_seq_used_ = true;
+  return last_bd_seq_;
+}
+
+uint64_t SparkplugNode::NextRetryDelay() {
+  const uint64_t min_delay = std::max<uint64_t>(ReconnectDelayMin(), 1);
+  const uint64_t max_delay = std::max(ReconnectDelayMax(), min_delay);
+  const auto shift = std::min<uint64_t>(retry_count_++, 20);
+  const auto delay = std::min(max_delay, min_delay << shift);
+  std::uniform_int_distribution<uint64_t> jitter(delay / 2, delay);
+  return jitter(random_);
+}
+
+void SparkplugNode::StepServer() {
+  server_index_ = (server_index_ + 1) % NofServers();
+}
+
+void SparkplugNode::RebirthDevices() {
+  for ( auto& [name, device] : device_list_ ) {
+    if (device) {
+      device->Rebirth();
+    }
   }
 }
 
@@ -1028,7 +1738,9 @@ void SparkplugNode::PublishNodeBirth() {
   if (birth_topic != nullptr) {
     auto& payload = birth_topic->GetPayload();
     payload.Timestamp(SparkplugHelper::NowMs());
-    birth_topic->DoPublish();
+    // The bdSeq shall match the death certificate of the current session.
+    payload.SetValue(kBdSeq.data(), bd_sequence_number_);
+    birth_topic->DoPublish(); // Restarts the sequence number
   } else {
     LOG_ERROR() << "No NBIRTH message defined. Internal error";
   }
@@ -1173,6 +1885,7 @@ void SparkplugNode::HandleStateMessage(const std::string& host_name, const MQTTA
       payload.ParseSparkplugJson(true);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the STATE payload. Error: " << err.what();
   }
 }
@@ -1212,6 +1925,7 @@ void SparkplugNode::HandleNodeBirthMessage(const std::string &group_name,
   }
 
   // Update the metrics. It is the online metrics that is of interest.
+  birth_topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
   auto &payload = birth_topic->GetPayload();
   auto &payload_data = payload.Body();
   try {
@@ -1219,9 +1933,12 @@ void SparkplugNode::HandleNodeBirthMessage(const std::string &group_name,
     payload_data.resize(data_size);
     if (message.payload != nullptr && data_size > 0) {
       std::memcpy(payload_data.data(), message.payload, data_size);
-      payload.ParseSparkplugProtobuf(true);
+      payload.ParseSparkplugProtobuf(true, true);
+      CheckSequenceNumber(*node, payload, true);
+      NotifyChanges(*birth_topic);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the NBIRTH  payload. Error: " << err.what();
   }
 
@@ -1259,12 +1976,14 @@ void SparkplugNode::HandleNodeDeathMessage(const std::string &group_name,
       payload.ParseSparkplugProtobuf(true);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the NDEATH payload. Error: " << err.what();
   }
 
   // Todo: Check that the NBIRTH and NDEATH bdSeqNo match. Otherwise ignore
   // Set all metrics as STALE (invalid).
   birth_topic->SetAllMetricsInvalid();
+  node->expected_sequence_ = -1; // Restarts with the next NBIRTH
 }
 
 void SparkplugNode::HandleNodeCommandMessage(const std::string &group_name,
@@ -1287,6 +2006,7 @@ void SparkplugNode::HandleNodeCommandMessage(const std::string &group_name,
   }
 
   // Update the metrics. It is the online metrics that is of interest.
+  birth_topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
   auto &payload = birth_topic->GetPayload();
   auto &payload_data = payload.Body();
   try {
@@ -1297,10 +2017,17 @@ void SparkplugNode::HandleNodeCommandMessage(const std::string &group_name,
       payload.ParseSparkplugProtobuf(false);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the NCMD payload. Error: " << err.what();
   }
 
-  // Todo: Handle any of the commands. Need to define what is a command.
+  if (const auto next_server = payload.GetMetric(kNextServer.data());
+      next_server && next_server->Value<bool>()) {
+    next_server->Value(false);
+    next_server_ = true;
+    node_event_.notify_one();
+  }
+  // Todo: Handle any of the other commands. Need to define what is a command.
 }
 
 void SparkplugNode::HandleNodeDataMessage(const std::string &group_name,
@@ -1326,6 +2053,7 @@ void SparkplugNode::HandleNodeDataMessage(const std::string &group_name,
   }
 
   // Update the metrics. It is the online metrics that is of interest.
+  birth_topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
   auto &payload = birth_topic->GetPayload();
   auto &payload_data = payload.Body();
   try {
@@ -1334,8 +2062,14 @@ void SparkplugNode::HandleNodeDataMessage(const std::string &group_name,
     if (message.payload != nullptr && data_size > 0) {
       std::memcpy(payload_data.data(), message.payload, data_size);
       payload.ParseSparkplugProtobuf(false); // Note that metrics must exist.
+      CheckSequenceNumber(*node, payload, false);
+      NotifyChanges(*birth_topic);
+      if (LatencyProbe()) {
+        RecordLatency(*node, payload);
+      }
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the NDATA  payload. Error: " << err.what();
   }
 }
@@ -1378,7 +2112,16 @@ void SparkplugNode::HandleDeviceBirthMessage(const std::string &group_name,
   auto* device = node->GetDevice(device_name);
   if (device == nullptr) {
     // Questionable if a node should be created here without NBIRTH message
-   device = node->CreateDevice(device_name);
+    device = node->CreateDevice(device_name);
+    if (device != nullptr) {
+      // The device belongs to a remote node, so its BIRTH/DEATH is received, not published.
+      if (auto* topic = device->GetTopicByMessageType(kDeviceBirth.data()); topic != nullptr) {
+        topic->Publish(false);
+      }
+      if (auto* topic = device->GetTopicByMessageType(kDeviceDeath.data()); topic != nullptr) {
+        topic->Publish(false);
+      }
+    }
   }
   if (device == nullptr) {
     LOG_ERROR() << "Failed to create a device node. Group/Node/Device: "
@@ -1398,9 +2141,12 @@ void SparkplugNode::HandleDeviceBirthMessage(const std::string &group_name,
     payload_data.resize(data_size);
     if (message.payload != nullptr && data_size > 0) {
       std::memcpy(payload_data.data(), message.payload, data_size);
-      payload.ParseSparkplugProtobuf(true);
+      payload.ParseSparkplugProtobuf(true, true);
+      CheckSequenceNumber(*node, payload, false);
+      NotifyChanges(*dbirth_topic);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the DBIRTH  payload. Error: " << err.what();
   }
 }
@@ -1420,23 +2166,25 @@ void SparkplugNode::HandleDeviceDeathMessage(const std::string &group_name,
     // If the node doesn't exist, neither do the device.
     return;
   }
-
-  auto* device = node->GetDevice(device_name);
-  if (device == nullptr) {
-    // If the device doesn't exist, then do nothing.
-    return;
-  }
-
-  // Need both birth and death topic
-  auto *birth_topic = device->GetTopicByMessageType(kDeviceBirth.data());
-  auto *death_topic = device->GetTopicByMessageType(kDeviceDeath.data());
-  if (birth_topic == nullptr || death_topic == nullptr || death_topic->Publish()) {
-    // Ignore if this device publish data
+  auto *nbirth_topic = node->GetTopicByMessageType(kNodeBirth.data());
+  if (nbirth_topic == nullptr || nbirth_topic->Publish()) {
+    // Ignore if this node publish data
     return;
   }
 
-  // Update the metrics. It is the online metrics that is of interest.
-  auto &payload = death_topic->GetPayload();
+  // Need both birth and death topic to update the device.
+  auto* device = node->GetDevice(device_name);
+  auto *birth_topic = device != nullptr ?
+      device->GetTopicByMessageType(kDeviceBirth.data()) : nullptr;
+  auto *death_topic = device != nullptr ?
+      device->GetTopicByMessageType(kDeviceDeath.data()) : nullptr;
+  const bool update_device = birth_topic != nullptr && death_topic != nullptr
+      && !death_topic->Publish();
+
+  // The DDEATH uses a sequence number of the node, so the sequence
+  // is checked even if the device is unknown.
+  Payload unknown_payload;
+  auto &payload = update_device ? death_topic->GetPayload() : unknown_payload;
   auto &payload_data = payload.Body();
   try {
     const auto data_size = static_cast<size_t>(message.payloadlen);
@@ -1444,12 +2192,16 @@ void SparkplugNode::HandleDeviceDeathMessage(const std::string &group_name,
     if (message.payload != nullptr && data_size > 0) {
       std::memcpy(payload_data.data(), message.payload, data_size);
       payload.ParseSparkplugProtobuf(true);
+      CheckSequenceNumber(*node, payload, false);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the DDEATH  payload. Error: " << err.what();
   }
-  // Set all metrics in the device as STALE (invalid)
-  birth_topic->SetAllMetricsInvalid();
+  if (update_device) {
+    // Set all metrics in the device as STALE (invalid)
+    birth_topic->SetAllMetricsInvalid();
+  }
 }
 
 void SparkplugNode::HandleDeviceCommandMessage(const std::string &group_name,
@@ -1493,6 +2245,7 @@ void SparkplugNode::HandleDeviceCommandMessage(const std::string &group_name,
     return;
   }
   // Update the metrics. It is the online metrics that is of interest.
+  birth_topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
   auto &payload = birth_topic->GetPayload();
   auto &payload_data = payload.Body();
   try {
@@ -1503,6 +2256,7 @@ void SparkplugNode::HandleDeviceCommandMessage(const std::string &group_name,
       payload.ParseSparkplugProtobuf(true);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the DBIRTH  payload. Error: " << err.what();
   }
 
@@ -1550,6 +2304,7 @@ void SparkplugNode::HandleDeviceDataMessage(const std::string &group_name,
     return;
   }
   // Update the metrics. It is the online metrics that is of interest.
+  birth_topic->Statistics().AddMessage(static_cast<size_t>(message.payloadlen));
   auto &payload = birth_topic->GetPayload();
   auto &payload_data = payload.Body();
   try {
@@ -1558,44 +2313,82 @@ void SparkplugNode::HandleDeviceDataMessage(const std::string &group_name,
     if (message.payload != nullptr && data_size > 0) {
       std::memcpy(payload_data.data(), message.payload, data_size);
       payload.ParseSparkplugProtobuf(true);
+      CheckSequenceNumber(*node, payload, false);
+      NotifyChanges(*birth_topic);
     }
   } catch (const std::exception &err) {
+    statistics_.AddParseError();
     LOG_ERROR() << "Failed to parse the DBIRTH  payload. Error: " << err.what();
   }
 }
 
 void SparkplugNode::AssignAliasNumbers() {
-  uint64_t alias_number = 1;
-  auto topic = GetTopicByMessageType("NBIRTH");
-  if (topic != nullptr) {
-    auto& payload = topic->GetPayload();
-    auto& metric_list = payload.Metrics();
-    for (auto& [name, metric] : metric_list) {
-      if (metric) {
-        metric->Alias(alias_number);
-        ++alias_number;
-      }
-    }
+  // Metrics declared by AddMetrics() already have their aliases.
+  const bool stable = UseAliasTable();
+  std::vector<std::pair<std::string, Payload*>> payload_list;
+  if (auto* topic = GetTopicByMessageType("NBIRTH"); topic != nullptr) {
+    payload_list.emplace_back(std::string(), &topic->GetPayload());
   }
-
   for (auto& [device_name, device] : device_list_) {
     if (device) {
       auto* birth_topic = device->GetTopicByMessageType("DBIRTH");
       if (birth_topic != nullptr) {
-        auto& payload = birth_topic->GetPayload();
-        auto& metric_list = payload.Metrics();
-        for (auto& [name, metric] : metric_list) {
-          if (metric) {
-            metric->Alias(alias_number);
-            ++alias_number;
-          }
+        payload_list.emplace_back(device_name, &birth_topic->GetPayload());
+      }
+    }
+  }
+
+  if (!stable) {
+    for (auto& [device_name, payload] : payload_list) {
+      for (auto& [name, metric] : payload->Metrics()) {
+        if (metric && metric->Alias() == 0) {
+          metric->Alias(ReserveAliases(1));
         }
       }
     }
+    LOG_TRACE() << "Max alias number. Alias: " << next_alias_ - 1;
+    return;
   }
 
-  LOG_TRACE() << "Max alias number. Alias: " << alias_number;
+  // The fixed aliases are stored before any new alias is assigned.
+  for (auto& [device_name, payload] : payload_list) {
+    for (auto& [name, metric] : payload->Metrics()) {
+      if (!metric || metric->Alias() == 0) {
+        continue;
+      }
+      const auto key = AliasTable::MakeKey(device_name, metric->Name());
+      if (!alias_table_.Alias(key, metric->Alias())) {
+        LOG_ERROR() << "The alias is used by another metric. Metric: " << key
+          << ", Alias: " << metric->Alias();
+        metric->Alias(0); // Gets a new alias below
+      }
+    }
+  }
+  for (auto& [device_name, payload] : payload_list) {
+    for (auto& [name, metric] : payload->Metrics()) {
+      if (metric && metric->Alias() == 0) {
+        metric->Alias(alias_table_.Alias(AliasTable::MakeKey(device_name, metric->Name())));
+      }
+    }
+  }
+  alias_table_.Save();
+  LOG_TRACE() << "Max alias number. Alias: " << alias_table_.NextAlias() - 1;
+}
 
+bool SparkplugNode::UseAliasTable() {
+  const auto& alias_file = AliasFile();
+  if (alias_file.empty()) {
+    return false;
+  }
+  if (alias_table_.Filename() != alias_file) {
+    alias_table_.Load(alias_file);
+  }
+  // Ranges reserved by ReserveAliases() shall not overlap the stored aliases.
+  uint64_t next_alias = next_alias_;
+  const uint64_t table_next = alias_table_.NextAlias();
+  while (next_alias < table_next && !next_alias_.compare_exchange_weak(next_alias, table_next)) {
+  }
+  return true;
 }
 
 void SparkplugNode::AddDefaultMetrics() {
@@ -1668,6 +2461,13 @@ void SparkplugNode::AddDefaultMetrics() {
     mqtt_version->Type(MetricType::String);
     mqtt_version->Value(VersionAsString());
   }
+
+  if (PublishStatistics()) {
+    AddStatisticsMetrics(payload);
+  }
+  if (LatencyProbe()) {
+    AddLatencyProbeMetric(payload);
+  }
 }
 
 bool SparkplugNode::IsHostOnline() const {
@@ -1689,6 +2489,21 @@ bool SparkplugNode::IsHostOnline() const {
   return false;
 }
 
+void SparkplugNode::ResetHostState() {
+  std::scoped_lock list_lock(list_mutex_);
+  for ( const auto& node : node_list_) {
+    if (!node || !IsSparkplugHost(node.get())) {
+      continue;
+    }
+    auto* state_topic = node->GetTopicByMessageType("STATE");
+    // Only the remote hosts, a local host publishes its own STATE.
+    if (state_topic == nullptr || state_topic->Publish()) {
+      continue;
+    }
+    state_topic->GetPayload().SetValue("online", false);
+  }
+}
+
 void SparkplugNode::InitMqtt() const {
   static bool done_init = false;
   if (!done_init) {
@@ -7,11 +7,16 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <random>
 #include <thread>
 #include <MQTTAsync.h>
 #include <util/ilisten.h>
 #include "pubsub/ipubsubclient.h"
+#include "pubsub/aliastable.h"
 #include "sparkplughelper.h"
+#include "listentracer.h"
+#include "inprocessbus.h"
+#include "localhub.h"
 
 
 namespace pub_sub {
@@ -31,19 +36,55 @@ class SparkplugNode : public IPubSubClient {
 
   ITopic* CreateTopic() override;
   ITopic* AddMetric(const std::shared_ptr<Metric>& value) override;
+  std::vector<std::shared_ptr<Metric>> AddMetrics(
+      std::span<const MetricDescriptor> descriptor_list) override;
   [[nodiscard]] bool IsConnected() const override;
 
   [[nodiscard]] const std::string& ServerUri() const { return server_uri_; }
   [[nodiscard]] int ServerVersion() const { return server_version_; }
   [[nodiscard]] int ServerSession() const { return server_session_; }
 
-  MQTTAsync& Handle() { return handle_; }
+  [[nodiscard]] MQTTAsync Handle() const { return handle_; }
+  [[nodiscard]] bool IsInProcess() const { return Transport() == TransportLayer::InProcess; }
   util::log::IListen* Listen() { return listen_.get(); }
+  [[nodiscard]] std::shared_ptr<ListenTracer> Tracer() const { return tracer_.load(); }
+  [[nodiscard]] uint64_t DroppedTraces() const override;
+  [[nodiscard]] size_t QueueDepth() const override;
+  void InjectMessage(const std::string& topic_name, const void* payload,
+                     size_t payload_size, bool retained) override;
+  [[nodiscard]] const IPubSubClient* GetRemoteNode(const std::string& group_id,
+                                                   const std::string& node_id) const override;
+  void UpdateLatencyProbe(Payload& payload) const;
+  [[nodiscard]] bool IsLocalHub() const { return local_hub_.IsStarted(); }
+  void PublishLocal(const std::string& message_type, const std::string& topic_name,
+                    const BusBuffer& body);
 
   uint64_t NextSequenceNumber() { return sequence_number_++; }
+  void ResetSequenceNumber() { sequence_number_ = 0; }
+
+  /** \brief Reserves a range of metric aliases for the node and its devices.
+   *
+   * @param count Number of aliases.
+   * @return First alias in the range.
+   */
+  uint64_t ReserveAliases(size_t count) { return next_alias_.fetch_add(count); }
+
+  /** \brief Creates birth metrics for the node or one of its devices.
+   *
+   * If the node has an alias file, the aliases are taken from the file,
+   * otherwise a range of aliases is reserved.
+   * @param payload NBIRTH or DBIRTH payload.
+   * @param device_name Device name or empty for node metrics.
+   * @param descriptor_list Metric definitions.
+   * @return Metrics in descriptor order.
+   */
+  std::vector<std::shared_ptr<Metric>> CreateBirthMetrics(Payload& payload,
+      const std::string& device_name, std::span<const MetricDescriptor> descriptor_list);
  protected:
-  MQTTAsync handle_ = nullptr;
+  std::atomic<MQTTAsync> handle_ = nullptr; ///< Read by the outbound queue's thread.
   std::unique_ptr<util::log::IListen> listen_;
+  std::atomic<std::shared_ptr<ListenTracer>> tracer_; ///< Created on start if tracing is active
+  LocalHub local_hub_; ///< Fan-out to local consumers
   std::condition_variable node_event_; ///< Can be used to speed up the scanning of the thread
   std::mutex node_mutex_; ///< Used to wait for events
   std::thread work_thread_; ///< Handles the online connect and subscription
@@ -64,6 +105,10 @@ class SparkplugNode : public IPubSubClient {
   virtual bool SendConnect();
   void StartSubscription();
   void SendDisconnect();
+  bool ConnectBus(const std::string& will_topic, const std::vector<uint8_t>& will_body,
+                  bool will_retained);
+  void DestroyHandle();
+  void BusMessage(const std::string& topic_name, const BusBuffer& body, bool retained);
 
   void Connect(const MQTTAsync_successData& response);
   void ConnectFailure(const MQTTAsync_failureData& response);
@@ -97,12 +142,29 @@ class SparkplugNode : public IPubSubClient {
   static void OnDisconnect5(void* context, MQTTAsync_successData5* response);
   static void OnDisconnectFailure5(void* context, MQTTAsync_failureData5* response);
 
+  static void OnStandbyConnectionLost(void *context, char *cause);
+  static int OnStandbyMessageArrived(void* context, char* topic_name, int topicLen,
+                                     MQTTAsync_message* message);
+  static void OnStandbyConnect(void* context, MQTTAsync_successData* response);
+  static void OnStandbyConnectFailure(void* context, MQTTAsync_failureData* response);
+  static void OnStandbyConnect5(void* context, MQTTAsync_successData5* response);
+  static void OnStandbyConnectFailure5(void* context, MQTTAsync_failureData5* response);
+
   [[nodiscard]] IPubSubClient* CreateDevice(const std::string& device_name) override;
   void DeleteDevice(const std::string& device_name) override;
   [[nodiscard]] IPubSubClient* GetDevice(const std::string& device_name) override;
   [[nodiscard]] const IPubSubClient* GetDevice(const std::string& device_name) const override;
 
+  /** \brief Returns the connect string (URI) of a broker.
+   *
+   * @param server_index 0 is the primary broker, 1 is the first standby broker.
+   * @return Connect string as 'tcp://127.0.0.1:1883'.
+   */
+  [[nodiscard]] std::string ConnectString(size_t server_index) const;
+  [[nodiscard]] size_t NofServers() const { return StandbyBrokers().size() + 1; }
+
   void InitMqtt() const;
+  void StartTracer();
   void InitSsl();
   static int SslErrorCallback(const char *error, size_t len, void *context);
 
@@ -113,18 +175,40 @@ class SparkplugNode : public IPubSubClient {
   using DeviceList =  std::map<std::string, std::unique_ptr<SparkplugDevice>, util::string::IgnoreCase>;
 
   uint64_t bd_sequence_number_ = 0; ///< Birth/Death sequence number
+  uint64_t last_bd_seq_ = 0; ///< bdSeq of the last CONNECT on any handle
+  bool bd_seq_used_ = false; ///< True if a CONNECT has been sent
   std::atomic<uint8_t> sequence_number_ = 0; ///< Message sequence number. The range is 0-255.
 
   enum class NodeState {
     Idle,             ///< Initial state, wait on in-service
     WaitOnConnect,    ///< Wait on connect
     Online,
-    WaitOnDisconnect
+    WaitOnDisconnect,
+    WaitOnHost        ///< Wait on the host STATE before the NBIRTH
   };
 
   std::atomic<NodeState> node_state_ = NodeState::Idle;
   std::atomic<bool> stop_node_task_ = true;
   uint64_t node_timer_ = SparkplugHelper::NowMs();
+  uint64_t statistics_timer_ = 0; ///< Next time to publish the statistics
+  uint64_t latency_probe_timer_ = 0; ///< Next time to publish the latency probe
+  uint64_t arrival_ns_ = 0; ///< Arrival time of the current message (latency probe)
+  std::atomic<uint64_t> last_probe_ns_ = 0; ///< Last received latency probe (remote node)
+  int expected_sequence_ = -1; ///< Next expected sequence number (remote node). -1 if unknown.
+  size_t server_index_ = 0; ///< Active broker. 0 is the primary broker.
+  uint64_t retry_count_ = 0; ///< Number of failed connects in a row
+  std::minstd_rand random_; ///< Reconnect jitter
+  std::atomic<uint64_t> lost_ns_ = 0; ///< Time when the connection was lost (ns)
+
+  MQTTAsync standby_handle_ = nullptr; ///< Pre-connected session to the next broker
+  size_t standby_index_ = 0; ///< Broker of the standby session
+  uint64_t standby_bd_seq_ = 0; ///< bdSeq of the standby death certificate
+  uint64_t standby_timer_ = 0; ///< Next time to create a standby session
+  std::atomic<bool> standby_connected_ = false;
+  std::atomic<bool> standby_failed_ = false; ///< Standby connect failed or lost
+  std::atomic<uint16_t> standby_alias_max_ = 0; ///< Topic Alias Maximum (MQTT 5)
+  std::atomic<uint64_t> next_alias_ = 1; ///< Next free metric alias
+  AliasTable alias_table_; ///< Persisted aliases if an alias file is used
   DeviceList device_list_; ///< Sparkplug devices in this node
 
   using NodeList = std::vector< std::unique_ptr<IPubSubClient> >;
@@ -142,6 +226,13 @@ class SparkplugNode : public IPubSubClient {
   void AddDefaultMetrics();
   void PublishNodeBirth();
   void PublishNodeDeath();
+  ITopic* CreateNodeDataTopic();
+  void AddStatisticsMetrics(Payload& payload);
+  void PublishNodeStatistics();
+  void AddLatencyProbeMetric(Payload& payload);
+  void PublishLatencyProbe();
+  void RecordLatency(SparkplugNode& node, const Payload& payload);
+  void CheckSequenceNumber(SparkplugNode& node, const Payload& payload, bool birth);
   void PollDevices();
 
   void NodeTask();
@@ -149,6 +240,19 @@ class SparkplugNode : public IPubSubClient {
   void DoWaitOnConnect();
   void DoOnline();
   void DoWaitOnDisconnect();
+  void DoWaitOnHost();
+
+  uint64_t NextRetryDelay();
+  uint64_t NextBdSeq(); ///< Returns the bdSeq of a new MQTT session.
+  void StepServer();
+  void RebirthDevices();
+  std::vector<uint8_t> CreateDeathBody(uint64_t bd_seq); ///< Updates the NDEATH payload.
+  bool ConnectMqtt(MQTTAsync handle, const std::string& will_topic,
+                   const std::vector<uint8_t>& will_body, bool standby);
+  void CreateStandby();
+  void DestroyStandby();
+  bool SwitchToStandby(bool publish_death);
+  void DisconnectHandle(MQTTAsync handle);
 
   void HandleStateMessage(const std::string& host_name, const MQTTAsync_message& message);
 
@@ -171,8 +275,10 @@ class SparkplugNode : public IPubSubClient {
                                   const std::string& device_name, const MQTTAsync_message& message);
 
   void AssignAliasNumbers();
+  bool UseAliasTable();
 
   [[nodiscard]] bool IsHostOnline() const;
+  void ResetHostState(); ///< The host STATE is unknown on a new broker.
 
 
 };
@@ -7,6 +7,8 @@
 #include "MQTTAsync.h"
 #include "util/logstream.h"
 #include "sparkplugnode.h"
+#include "inprocessbus.h"
+#include "payloadhelper.h"
 
 #include <array>
 #include <algorithm>
@@ -22,52 +24,162 @@ SparkplugTopic::SparkplugTopic(SparkplugNode& parent)
   Namespace(kNamespace.data());
 }
 
-void SparkplugTopic::DoPublish() {
+SparkplugTopic::~SparkplugTopic() {
+  parent_.Outbound().Discard(*this);
+}
+
+void SparkplugTopic::DoPublish(std::shared_ptr<DeliveryPromise> delivery) {
   auto& payload = GetPayload();
-  if (MessageType() == "STATE") {
-    // Payload is a JSON string
-    payload.GenerateJson();
-  } else {
-     // Payload is a protobuf data buffer
-     payload.SequenceNumber(parent_.NextSequenceNumber());
-     payload.GenerateProtobuf();
+  auto& statistics = parent_.Statistics();
+  {
+    ScopedTimer encode_timer(statistics.EncodeTime(), &Statistics().ProcessTime());
+    if (MessageType() == "STATE") {
+      // Payload is a JSON string
+      payload.GenerateJson();
+    } else {
+      // Payload is a protobuf data buffer. A message to the MQTT broker gets
+      // its sequence number when it is handed over, see SendBody().
+      if (parent_.IsInProcess()) {
+        payload.SequenceNumber(NextSequenceNumber());
+      }
+      parent_.UpdateLatencyProbe(payload);
+      payload.GenerateProtobuf(IsBirthMessageType());
+    }
   }
 
   auto& body = payload.Body();
+  if (!parent_.IsInProcess()) {
+    // The BIRTH and DEATH certificates are never dropped by the outbound queue.
+    parent_.Outbound().Publish(*this, body, IsCertificateMessageType(), std::move(delivery));
+    return;
+  }
+  // The in-process receivers and the local consumers share one copy of the body.
+  const auto buffer = std::make_shared<const std::vector<uint8_t>>(body);
+  TraceBody(*buffer, payload.SequenceNumber());
+  if (parent_.IsLocalHub()) {
+    parent_.PublishLocal(MessageType(), Topic(), buffer);
+  }
+  const bool delivered = InProcessBus::Instance().Publish(Topic(), buffer, Retained());
+  if (delivered) {
+    statistics.AddMessageOut(body.size());
+    Statistics().AddMessage(body.size());
+  } else {
+    statistics.AddPublishFailure();
+    Statistics().AddFailure();
+  }
+  if (delivery) {
+    delivery->set_value({0, delivered, 0});
+  }
+}
+
+uint64_t SparkplugTopic::NextSequenceNumber() {
+  // The NBIRTH starts the sequence of the session.
+  if (MessageType() == "NBIRTH") {
+    parent_.ResetSequenceNumber();
+  }
+  return parent_.NextSequenceNumber();
+}
+
+void SparkplugTopic::TraceBody(const std::vector<uint8_t>& body, uint64_t seq) {
+  auto* listen = parent_.Listen();
+  if (listen == nullptr || !listen->IsActive() || listen->LogLevel() != 3) {
+    return;
+  }
+  if (auto tracer = parent_.AsyncTrace() ? parent_.Tracer() : nullptr; tracer) {
+    tracer->Trace(true, Topic(), body.data(), body.size());
+  } else {
+    const auto json = GetPayload().MakeJsonString();
+    listen->ListenText("Publish: %s: %s, %d",
+                       Topic().c_str(), json.c_str(), static_cast<int>(seq));
+  }
+}
+
+bool SparkplugTopic::SendBody(std::vector<uint8_t>& body, int& token) {
+  auto& statistics = parent_.Statistics();
+  // The sequence number is assigned in the order the messages are handed
+  // over, so a dropped message doesn't leave a hole in the sequence. The
+  // encoded body has a fixed width slot for it, that is patched in place.
+  uint64_t seq = 0;
+  if (MessageType() != "STATE") {
+    seq = NextSequenceNumber();
+    PayloadHelper::PatchSequenceNumber(body, seq);
+    GetPayload().SequenceNumber(seq);
+  }
+  TraceBody(body, seq);
+  if (parent_.IsLocalHub()) {
+    // The local consumers get the same messages as the broker.
+    parent_.PublishLocal(MessageType(), Topic(),
+                         std::make_shared<const std::vector<uint8_t>>(body));
+  }
+
   MQTTAsync_message  message = MQTTAsync_message_initializer;
   message.payload = body.data();
   message.payloadlen = static_cast<int>(body.size());
   message.qos = static_cast<int>(Qos());
   message.retained = Retained() ? 1 : 0;
 
-
   MQTTAsync_responseOptions options = MQTTAsync_responseOptions_initializer;
-  options.onSuccess = nullptr; // OnSend;
   if (parent_.Version() == ProtocolVersion::Mqtt5) {
+    options.onSuccess5 = OnSend5;
     options.onFailure5 = OnSendFailure5;
   } else {
+    options.onSuccess = OnSend;
     options.onFailure = OnSendFailure;
   }
   options.context = this;
 
+  // Replace the topic name with a topic alias after the first publish
   const auto& topic_name  = Topic();
+  bool send_name = true;
+  const uint16_t alias = GetTopicAlias(parent_, send_name);
+  if (alias > 0) {
+    MQTTProperty property;
+    property.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+    property.value.integer2 = alias;
+    MQTTProperties_add(&message.properties, &property);
+  }
+
+  const auto send = MQTTAsync_sendMessage(parent_.Handle(),
+                                          send_name ? topic_name.c_str() : "",
+                                          &message, &options );
+  MQTTProperties_free(&message.properties);
+  token = options.token;
+  if (send == MQTTASYNC_SUCCESS) {
+    statistics.AddMessageOut(body.size());
+    Statistics().AddMessage(body.size());
+    return true;
+  }
+  statistics.AddPublishFailure();
+  Statistics().AddFailure();
   auto* listen = parent_.Listen();
-  if (listen != nullptr && listen->IsActive() && listen->LogLevel() == 3) {
-    const auto json = payload.MakeJsonString();
-    listen->ListenText("Publish: %s: %s, %d",
-                       topic_name.c_str(), json.c_str(), static_cast<int>(payload.SequenceNumber()) );
+  if (listen != nullptr && listen->IsActive()) {
+    listen->ListenText("Publish Fail: %s", topic_name.c_str());
   }
-  const auto send = MQTTAsync_sendMessage(parent_.Handle(), topic_name.c_str(), &message, &options );
-  if (send != MQTTASYNC_SUCCESS) {
-    if (listen != nullptr && listen->IsActive()) {
-      listen->ListenText("Publish Fail: %s", topic_name.c_str());
-    }
+  return false;
+}
+
+void SparkplugTopic::OnSend(void *context, MQTTAsync_successData *response) {
+  auto *topic = reinterpret_cast<SparkplugTopic *>(context);
+  if (topic != nullptr) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, true);
+    topic->ConfirmTopicAlias();
+  }
+}
+
+void SparkplugTopic::OnSend5(void *context, MQTTAsync_successData5 *response) {
+  auto *topic = reinterpret_cast<SparkplugTopic *>(context);
+  if (topic != nullptr) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, true);
+    topic->ConfirmTopicAlias();
   }
 }
 
 void SparkplugTopic::OnSendFailure(void *context, MQTTAsync_failureData *response) {
   auto *topic = reinterpret_cast<SparkplugTopic *>(context);
   if (topic != nullptr) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, false);
+    topic->parent_.Statistics().AddPublishFailure();
+    topic->Statistics().AddFailure();
     auto* listen = topic->parent_.Listen();
     if (listen != nullptr && listen->IsActive() && response != nullptr) {
       listen->ListenText("Publish Send Failure: %s, Error: %s",
@@ -80,6 +192,9 @@ void SparkplugTopic::OnSendFailure(void *context, MQTTAsync_failureData *respons
 void SparkplugTopic::OnSendFailure5(void *context, MQTTAsync_failureData5 *response) {
   auto *topic = reinterpret_cast<SparkplugTopic *>(context);
   if (topic != nullptr) {
+    topic->parent_.Outbound().Complete(response != nullptr ? response->token : 0, false);
+    topic->parent_.Statistics().AddPublishFailure();
+    topic->Statistics().AddFailure();
     auto* listen = topic->parent_.Listen();
     if (listen != nullptr && listen->IsActive() && response != nullptr) {
       listen->ListenText("Publish Send Failure: %s, Error: %s",
@@ -89,6 +204,11 @@ void SparkplugTopic::OnSendFailure5(void *context, MQTTAsync_failureData5 *respo
   }
 }
 
+bool SparkplugTopic::IsConflatable() const {
+  // The DATA messages only report the changed metrics.
+  return false;
+}
+
 bool SparkplugTopic::IsValidMessageType() const {
   constexpr std::array<std::string_view, 8> valid_message_types = {
       "NBIRTH", "NDEATH", "DBIRTH", "DDEATH", "NDATA", "NCMD", "DCMD", "STATE"
@@ -99,6 +219,16 @@ bool SparkplugTopic::IsValidMessageType() const {
   });
 }
 
+bool SparkplugTopic::IsCertificateMessageType() const {
+  constexpr std::array<std::string_view, 5> certificate_message_types = {
+      "NBIRTH", "NDEATH", "DBIRTH", "DDEATH", "STATE"
+  };
+  return std::any_of(certificate_message_types.cbegin(), certificate_message_types.cend(),
+                     [&] (const auto& type) -> bool {
+                       return MessageType() == type;
+                     });
+}
+
 bool SparkplugTopic::IsBirthMessageType() const {
   constexpr std::array<std::string_view, 3> birth_message_types = {
       "NBIRTH", "DBIRTH", "STATE"
@@ -15,17 +15,27 @@ class SparkplugTopic : public ITopic {
  public:
   explicit SparkplugTopic(SparkplugNode& parent);
   SparkplugTopic() = delete;
+  ~SparkplugTopic() override;
 
-  void DoPublish() override;
+  using ITopic::DoPublish;
+  void DoPublish(std::shared_ptr<DeliveryPromise> delivery) override;
+  bool SendBody(std::vector<uint8_t>& body, int& token) override;
+  [[nodiscard]] bool IsConflatable() const override;
 
  private:
   SparkplugNode& parent_;
 
+  uint64_t NextSequenceNumber();
+  void TraceBody(const std::vector<uint8_t>& body, uint64_t seq);
+
   [[nodiscard]] bool IsValidMessageType() const;
   [[nodiscard]] bool IsBirthMessageType() const;
+  [[nodiscard]] bool IsCertificateMessageType() const;
 
   void SendComplete(const MQTTAsync_successData& response);
 
+  static void OnSend(void *context, MQTTAsync_successData *response);
+  static void OnSend5(void *context, MQTTAsync_successData5 *response);
   static void OnSendFailure(void *context, MQTTAsync_failureData *response);
   static void OnSendFailure5(void *context, MQTTAsync_failureData5 *response);
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/statistics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+
+size_t ThreadShard() {
+  static std::atomic<size_t> next_shard = 0;
+  thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+  return shard;
+}
+
+}
+
+namespace pub_sub {
+
+StatCounter::~StatCounter() {
+  delete shard_list_.load();
+}
+
+StatCounter::ShardList& StatCounter::Shards() {
+  auto* shard_list = shard_list_.load(std::memory_order_acquire);
+  if (shard_list == nullptr) {
+    auto* new_list = new ShardList;
+    if (shard_list_.compare_exchange_strong(shard_list, new_list,
+                                            std::memory_order_acq_rel)) {
+      shard_list = new_list;
+    } else {
+      delete new_list; // Another thread allocated the shards
+    }
+  }
+  return *shard_list;
+}
+
+void StatCounter::Add(uint64_t value) {
+  Shards()[ThreadShard() % kShards].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t StatCounter::Value() const {
+  const auto* shard_list = shard_list_.load(std::memory_order_acquire);
+  if (shard_list == nullptr) {
+    return 0;
+  }
+  uint64_t sum = 0;
+  for (const auto& shard : *shard_list) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void StatCounter::Reset() {
+  auto* shard_list = shard_list_.load(std::memory_order_acquire);
+  if (shard_list == nullptr) {
+    return;
+  }
+  for (auto& shard : *shard_list) {
+    shard.value = 0;
+  }
+}
+
+LatencyHistogram::~LatencyHistogram() {
+  delete bucket_list_.load();
+}
+
+LatencyHistogram::BucketList& LatencyHistogram::Buckets() {
+  auto* bucket_list = bucket_list_.load(std::memory_order_acquire);
+  if (bucket_list == nullptr) {
+    auto* new_list = new BucketList{};
+    if (bucket_list_.compare_exchange_strong(bucket_list, new_list,
+                                             std::memory_order_acq_rel)) {
+      bucket_list = new_list;
+    } else {
+      delete new_list; // Another thread allocated the buckets
+    }
+  }
+  return *bucket_list;
+}
+
+size_t LatencyHistogram::HeapSize() const {
+  return bucket_list_.load(std::memory_order_relaxed) != nullptr ? sizeof(BucketList) : 0;
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  value = std::min(value, (uint64_t{1} << (kMaxMagnitude + 1)) - 1);
+  const auto magnitude = static_cast<size_t>(std::bit_width(value) - 1);
+  const auto sub_bucket = static_cast<size_t>(value >> (magnitude - kSubBits)) - kSubBuckets;
+  return kSubBuckets + (magnitude - kSubBits) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketValue(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  const size_t magnitude = (index - kSubBuckets) / kSubBuckets + kSubBits;
+  const size_t sub_bucket = (index - kSubBuckets) % kSubBuckets;
+  return static_cast<uint64_t>(kSubBuckets + sub_bucket) << (magnitude - kSubBits);
+}
+
+void LatencyHistogram::Add(uint64_t value_ns) {
+  Buckets()[BucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value_ns, std::memory_order_relaxed);
+
+  uint64_t min_value = min_.load(std::memory_order_relaxed);
+  while (value_ns < min_value &&
+         !min_.compare_exchange_weak(min_value, value_ns, std::memory_order_relaxed)) {
+  }
+  uint64_t max_value = max_.load(std::memory_order_relaxed);
+  while (value_ns > max_value &&
+         !max_.compare_exchange_weak(max_value, value_ns, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  if (auto* bucket_list = bucket_list_.load(std::memory_order_acquire);
+      bucket_list != nullptr) {
+    for (auto& bucket : *bucket_list) {
+      bucket = 0;
+    }
+  }
+  count_ = 0;
+  sum_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::Min() const {
+  return count_ > 0 ? min_.load() : 0;
+}
+
+uint64_t LatencyHistogram::Mean() const {
+  const uint64_t count = count_;
+  return count > 0 ? sum_ / count : 0;
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  const auto* bucket_list = bucket_list_.load(std::memory_order_acquire);
+  if (bucket_list == nullptr) {
+    return 0;
+  }
+  uint64_t total = 0;
+  for (const auto& bucket : *bucket_list) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  const auto limit = std::max(static_cast<uint64_t>(
+      std::ceil(percentile * static_cast<double>(total) / 100.0)), uint64_t{1});
+
+  uint64_t sum = 0;
+  for (size_t index = 0; index < bucket_list->size(); ++index) {
+    sum += (*bucket_list)[index].load(std::memory_order_relaxed);
+    if (sum >= limit) {
+      return BucketValue(index);
+    }
+  }
+  return Max();
+}
+
+void TopicStatistics::Reset() {
+  messages_ = 0;
+  bytes_ = 0;
+  failures_ = 0;
+  process_time_.Reset();
+}
+
+void ClientStatistics::Reset() {
+  messages_in_.Reset();
+  bytes_in_.Reset();
+  messages_out_.Reset();
+  bytes_out_.Reset();
+  dropped_messages_.Reset();
+  publish_failures_.Reset();
+  parse_errors_.Reset();
+  sequence_gaps_.Reset();
+  failovers_.Reset();
+  parse_time_.Reset();
+  encode_time_.Reset();
+  transfer_time_.Reset();
+  ingest_time_.Reset();
+  failover_time_.Reset();
+}
+
+} // pub_sub
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/topicfilter.h"
+
+#include <array>
+
+namespace {
+
+constexpr std::string_view kState = "STATE";
+constexpr std::string_view kWildcard = "+";
+
+/** \brief Maximum number of subscriptions that a filter generates.
+ *
+ * If the include lists generate more subscriptions, the node level is
+ * replaced by a wildcard, and the node filtering is done on the inbound
+ * messages instead.
+ */
+constexpr size_t kMaxSubscriptions = 64;
+
+}
+
+namespace pub_sub {
+
+void TopicFilter::IncludeGroup(const std::string& group_id) {
+  include_groups_.insert(group_id);
+}
+
+void TopicFilter::ExcludeGroup(const std::string& group_id) {
+  exclude_groups_.insert(group_id);
+}
+
+void TopicFilter::IncludeNode(const std::string& node_id) {
+  include_nodes_.insert(node_id);
+}
+
+void TopicFilter::ExcludeNode(const std::string& node_id) {
+  exclude_nodes_.insert(node_id);
+}
+
+void TopicFilter::IncludeDevice(const std::string& device_id) {
+  include_devices_.insert(device_id);
+}
+
+void TopicFilter::ExcludeDevice(const std::string& device_id) {
+  exclude_devices_.insert(device_id);
+}
+
+void TopicFilter::IncludeMessageType(const std::string& message_type) {
+  include_message_types_.insert(message_type);
+}
+
+void TopicFilter::ExcludeMessageType(const std::string& message_type) {
+  exclude_message_types_.insert(message_type);
+}
+
+void TopicFilter::Clear() {
+  include_groups_.clear();
+  exclude_groups_.clear();
+  include_nodes_.clear();
+  exclude_nodes_.clear();
+  include_devices_.clear();
+  exclude_devices_.clear();
+  include_message_types_.clear();
+  exclude_message_types_.clear();
+}
+
+bool TopicFilter::IsEmpty() const {
+  return include_groups_.empty() && exclude_groups_.empty() &&
+         include_nodes_.empty() && exclude_nodes_.empty() &&
+         include_devices_.empty() && exclude_devices_.empty() &&
+         include_message_types_.empty() && exclude_message_types_.empty();
+}
+
+bool TopicFilter::IsNarrowing() const {
+  return !include_groups_.empty() || !include_nodes_.empty() ||
+         !include_message_types_.empty();
+}
+
+bool TopicFilter::IsPartialNode() const {
+  return !include_devices_.empty() || !exclude_devices_.empty() ||
+         !include_message_types_.empty() || !exclude_message_types_.empty();
+}
+
+bool TopicFilter::IsLevelAccepted(const NameList& include_list,
+                                  const NameList& exclude_list,
+                                  std::string_view name) {
+  if (!include_list.empty() && include_list.find(name) == include_list.cend()) {
+    return false;
+  }
+  return exclude_list.empty() || exclude_list.find(name) == exclude_list.cend();
+}
+
+bool TopicFilter::IsAccepted(std::string_view topic_name) const {
+  if (IsEmpty()) {
+    return true;
+  }
+
+  // Split the topic into levels without copying the name.
+  std::array<std::string_view, 5> level_list;
+  size_t level = 0;
+  while (level < level_list.size()) {
+    const auto slash = topic_name.find('/');
+    level_list[level++] = topic_name.substr(0, slash);
+    if (slash == std::string_view::npos) {
+      break;
+    }
+    topic_name.remove_prefix(slash + 1);
+  }
+
+  if (level_list[1] == kState) {
+    // The host STATE messages are needed by all nodes and hosts, so they
+    // are only dropped if they are explicitly excluded.
+    return exclude_message_types_.find(kState) == exclude_message_types_.cend();
+  }
+  return IsAccepted(level_list[1], level_list[2], level_list[3],
+                    level_list[4]);
+}
+
+bool TopicFilter::IsAccepted(std::string_view group_id,
+                             std::string_view message_type,
+                             std::string_view node_id,
+                             std::string_view device_id) const {
+  if (!IsLevelAccepted(include_message_types_, exclude_message_types_,
+                       message_type)) {
+    return false;
+  }
+  if (!IsLevelAccepted(include_groups_, exclude_groups_, group_id)) {
+    return false;
+  }
+  if (!IsLevelAccepted(include_nodes_, exclude_nodes_, node_id)) {
+    return false;
+  }
+  // Node messages have no device level and always pass the device filter.
+  if (device_id.empty()) {
+    return true;
+  }
+  return IsLevelAccepted(include_devices_, exclude_devices_, device_id);
+}
+
+std::vector<std::string> TopicFilter::MakeSubscriptions(
+    std::string_view prefix, std::string_view message_type) const {
+  std::vector<std::string> subscription_list;
+  if (message_type != kWildcard &&
+      !IsLevelAccepted(include_message_types_, exclude_message_types_,
+                       message_type)) {
+    return subscription_list;
+  }
+
+  std::vector<std::string_view> group_list(include_groups_.cbegin(),
+                                           include_groups_.cend());
+  if (group_list.empty()) {
+    group_list.emplace_back(kWildcard);
+  }
+
+  std::vector<std::string_view> type_list;
+  if (message_type == kWildcard && !include_message_types_.empty()) {
+    type_list.assign(include_message_types_.cbegin(),
+                     include_message_types_.cend());
+  } else {
+    type_list.emplace_back(message_type);
+  }
+
+  std::vector<std::string_view> node_list(include_nodes_.cbegin(),
+                                          include_nodes_.cend());
+  if (node_list.empty() ||
+      group_list.size() * type_list.size() * node_list.size() >
+          kMaxSubscriptions) {
+    node_list.assign(1, kWildcard);
+  }
+
+  for (const auto group : group_list) {
+    for (const auto type : type_list) {
+      for (const auto node : node_list) {
+        std::string topic(prefix);
+        topic.append("/").append(group);
+        topic.append("/").append(type);
+        topic.append("/").append(node);
+        topic.append("/#");
+        subscription_list.emplace_back(std::move(topic));
+      }
+    }
+  }
+  return subscription_list;
+}
+
+} // pub_sub
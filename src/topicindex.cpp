@@ -0,0 +1,194 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/topicindex.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "pubsub/itopic.h"
+
+namespace {
+
+char ToLower(char in_char) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(in_char)));
+}
+
+} // end namespace
+
+namespace pub_sub {
+
+size_t TopicIndex::IHash::operator()(std::string_view key) const {
+  // FNV-1a on the lower case characters
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char in_char : key) {
+    hash ^= static_cast<uint8_t>(ToLower(in_char));
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool TopicIndex::IEqual::operator()(std::string_view key1, std::string_view key2) const {
+  return key1.size() == key2.size()
+    && std::equal(key1.cbegin(), key1.cend(), key2.cbegin(),
+                  [] (char char1, char char2) -> bool {
+      return ToLower(char1) == ToLower(char2);
+    });
+}
+
+TopicIndex::TopicIndex(const TopicList& topic_list, std::recursive_mutex& list_mutex)
+: topic_list_(topic_list),
+  list_mutex_(list_mutex) {
+}
+
+TopicIndex::RenameGuard::RenameGuard(ITopic& topic)
+: topic_(topic),
+  index_(TopicIndex::IndexOf(topic)) {
+  if (index_ != nullptr) {
+    index_->list_mutex_.lock();
+    index_->UnindexKeys(topic_);
+  }
+}
+
+TopicIndex::RenameGuard::~RenameGuard() {
+  if (index_ != nullptr) {
+    index_->IndexKeys(topic_);
+    index_->list_mutex_.unlock();
+  }
+}
+
+TopicIndex* TopicIndex::IndexOf(const ITopic& topic) {
+  return topic.index_;
+}
+
+void TopicIndex::Add(ITopic& topic) {
+  std::scoped_lock lock(list_mutex_);
+  topic.index_ = this;
+  topic.index_order_ = next_order_++;
+  IndexKeys(topic);
+}
+
+void TopicIndex::Remove(ITopic& topic) {
+  std::scoped_lock lock(list_mutex_);
+  if (topic.index_ != this) {
+    return;
+  }
+  UnindexKeys(topic);
+  topic.index_ = nullptr;
+}
+
+void TopicIndex::Clear() {
+  std::scoped_lock lock(list_mutex_);
+  for (const auto& topic : topic_list_) {
+    if (topic && topic->index_ == this) {
+      topic->index_ = nullptr;
+    }
+  }
+  name_index_.clear();
+  iname_index_.clear();
+  type_index_.clear();
+  unnamed_list_.clear();
+}
+
+template <typename Index>
+void TopicIndex::Insert(Index& index, std::string_view key, ITopic& topic) {
+  auto [itr, inserted] = index.emplace(key, &topic);
+  // The first topic in the list wins, as a linear search would find.
+  if (!inserted && itr->second->index_order_ > topic.index_order_) {
+    index.erase(itr);
+    index.emplace(key, &topic);
+  }
+}
+
+template <typename Index, typename KeyOf>
+void TopicIndex::Erase(Index& index, std::string_view key, const ITopic& topic,
+                       KeyOf key_of) {
+  auto itr = index.find(key);
+  if (itr == index.end() || itr->second != &topic) {
+    return;
+  }
+  index.erase(itr);
+
+  // Another topic may have the same key. The list is in index order.
+  for (const auto& other : topic_list_) {
+    if (!other || other.get() == &topic || other->index_ != this) {
+      continue;
+    }
+    const std::string_view other_key = key_of(*other);
+    if (!other_key.empty() && index.key_eq()(other_key, key)) {
+      index.emplace(other_key, other.get());
+      break;
+    }
+  }
+}
+
+void TopicIndex::IndexKeys(ITopic& topic) {
+  if (topic.topic_.empty()) {
+    unnamed_list_.insert(&topic);
+  } else {
+    Insert(name_index_, topic.topic_, topic);
+    Insert(iname_index_, topic.topic_, topic);
+  }
+  if (!topic.message_type_.empty()) {
+    Insert(type_index_, topic.message_type_, topic);
+  }
+}
+
+void TopicIndex::UnindexKeys(ITopic& topic) {
+  unnamed_list_.erase(&topic);
+  auto name_of = [] (const ITopic& other) -> std::string_view {
+    return other.topic_;
+  };
+  auto type_of = [] (const ITopic& other) -> std::string_view {
+    return other.message_type_;
+  };
+  if (!topic.topic_.empty()) {
+    Erase(name_index_, topic.topic_, topic, name_of);
+    Erase(iname_index_, topic.topic_, topic, name_of);
+  }
+  if (!topic.message_type_.empty()) {
+    Erase(type_index_, topic.message_type_, topic, type_of);
+  }
+}
+
+void TopicIndex::IndexUnnamed() {
+  // The topic name is generated from its levels at the first call to Topic().
+  for (auto itr = unnamed_list_.begin(); itr != unnamed_list_.end(); ) {
+    auto* topic = *itr;
+    if (topic->Topic().empty()) {
+      ++itr;
+      continue;
+    }
+    itr = unnamed_list_.erase(itr);
+    Insert(name_index_, topic->topic_, *topic);
+    Insert(iname_index_, topic->topic_, *topic);
+  }
+}
+
+ITopic* TopicIndex::Find(std::string_view topic_name) {
+  std::scoped_lock lock(list_mutex_);
+  if (!unnamed_list_.empty()) {
+    IndexUnnamed();
+  }
+  const auto itr = name_index_.find(topic_name);
+  return itr == name_index_.cend() ? nullptr : itr->second;
+}
+
+ITopic* TopicIndex::IFind(std::string_view topic_name) {
+  std::scoped_lock lock(list_mutex_);
+  if (!unnamed_list_.empty()) {
+    IndexUnnamed();
+  }
+  const auto itr = iname_index_.find(topic_name);
+  return itr == iname_index_.cend() ? nullptr : itr->second;
+}
+
+ITopic* TopicIndex::FindByMessageType(std::string_view message_type) const {
+  std::scoped_lock lock(list_mutex_);
+  const auto itr = type_index_.find(message_type);
+  return itr == type_index_.cend() ? nullptr : itr->second;
+}
+
+} // pub_sub
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pubsub/topicmatcher.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr std::string_view kPlus = "+";
+constexpr std::string_view kHash = "#";
+
+} // end namespace
+
+namespace pub_sub {
+
+bool TopicMatcher::Node::IsEmpty() const {
+  return child_list.empty() && !plus && handler_list.empty() && hash_list.empty();
+}
+
+bool TopicMatcher::IsValidFilter(std::string_view filter) {
+  if (filter.empty()) {
+    return false;
+  }
+  while (true) {
+    const auto slash = filter.find('/');
+    const auto level = filter.substr(0, slash);
+    if (level.find('#') != std::string_view::npos
+        && (level != kHash || slash != std::string_view::npos)) {
+      return false; // '#' shall be the last level
+    }
+    if (level.find('+') != std::string_view::npos && level != kPlus) {
+      return false;
+    }
+    if (slash == std::string_view::npos) {
+      break;
+    }
+    filter.remove_prefix(slash + 1);
+  }
+  return true;
+}
+
+uint64_t TopicMatcher::AddHandler(const std::string& filter, OnMessage on_message) {
+  if (!on_message || !IsValidFilter(filter)) {
+    return 0;
+  }
+  std::scoped_lock lock(matcher_mutex_);
+  Node* node = &root_;
+  std::string_view remaining = filter;
+  bool hash = false;
+  while (true) {
+    const auto slash = remaining.find('/');
+    const auto level = remaining.substr(0, slash);
+    if (level == kHash) {
+      hash = true;
+      break;
+    }
+    if (level == kPlus) {
+      if (!node->plus) {
+        node->plus = std::make_unique<Node>();
+        node->plus->level = level;
+        node->plus->parent = node;
+      }
+      node = node->plus.get();
+    } else if (auto itr = node->child_list.find(level); itr != node->child_list.end()) {
+      node = itr->second.get();
+    } else {
+      auto child = std::make_unique<Node>();
+      child->level = level;
+      child->parent = node;
+      Node* next = child.get();
+      node->child_list.emplace(next->level, std::move(child));
+      node = next;
+    }
+    if (slash == std::string_view::npos) {
+      break;
+    }
+    remaining.remove_prefix(slash + 1);
+  }
+
+  const uint64_t handler_id = next_id_++;
+  auto& handler_list = hash ? node->hash_list : node->handler_list;
+  handler_list.push_back({handler_id, std::move(on_message)});
+  location_list_.emplace(handler_id, Location{node, hash});
+  return handler_id;
+}
+
+void TopicMatcher::RemoveHandler(uint64_t handler_id) {
+  std::scoped_lock lock(matcher_mutex_);
+  const auto itr = location_list_.find(handler_id);
+  if (itr == location_list_.end()) {
+    return;
+  }
+  auto [node, hash] = itr->second;
+  location_list_.erase(itr);
+
+  auto& handler_list = hash ? node->hash_list : node->handler_list;
+  std::erase_if(handler_list, [&] (const Handler& handler) -> bool {
+    return handler.id == handler_id;
+  });
+  Prune(node);
+}
+
+void TopicMatcher::Prune(Node* node) {
+  while (node != &root_ && node->IsEmpty()) {
+    Node* parent = node->parent;
+    if (parent->plus.get() == node) {
+      parent->plus.reset();
+    } else {
+      parent->child_list.erase(node->level);
+    }
+    node = parent;
+  }
+}
+
+void TopicMatcher::Clear() {
+  std::scoped_lock lock(matcher_mutex_);
+  root_.child_list.clear();
+  root_.plus.reset();
+  root_.handler_list.clear();
+  root_.hash_list.clear();
+  location_list_.clear();
+}
+
+bool TopicMatcher::IsEmpty() const {
+  std::scoped_lock lock(matcher_mutex_);
+  return location_list_.empty();
+}
+
+size_t TopicMatcher::Handlers() const {
+  std::scoped_lock lock(matcher_mutex_);
+  return location_list_.size();
+}
+
+template <typename Visitor>
+void TopicMatcher::Match(const Node& node, std::string_view topic_name, size_t position,
+                         bool dollar, Visitor& visitor) {
+  // A '#' filter also matches its parent level i.e. 'a/#' matches 'a'.
+  if (!dollar) {
+    for (const auto& handler : node.hash_list) {
+      visitor(handler);
+    }
+  }
+  if (position == std::string_view::npos) {
+    for (const auto& handler : node.handler_list) {
+      visitor(handler);
+    }
+    return;
+  }
+
+  const auto slash = topic_name.find('/', position);
+  const auto level = slash == std::string_view::npos ?
+      topic_name.substr(position) : topic_name.substr(position, slash - position);
+  const auto next = slash == std::string_view::npos ? std::string_view::npos : slash + 1;
+
+  if (const auto itr = node.child_list.find(level); itr != node.child_list.cend()) {
+    Match(*itr->second, topic_name, next, false, visitor);
+  }
+  if (node.plus && !dollar) {
+    Match(*node.plus, topic_name, next, false, visitor);
+  }
+}
+
+size_t TopicMatcher::Dispatch(std::string_view topic_name,
+                              std::span<const uint8_t> body) const {
+  if (topic_name.empty()) {
+    return 0;
+  }
+  std::scoped_lock lock(matcher_mutex_);
+  size_t count = 0;
+  auto visitor = [&] (const Handler& handler) {
+    ++count;
+    handler.on_message(topic_name, body);
+  };
+  Match(root_, topic_name, 0, topic_name.front() == '$', visitor);
+  return count;
+}
+
+bool TopicMatcher::IsMatch(std::string_view topic_name) const {
+  if (topic_name.empty()) {
+    return false;
+  }
+  std::scoped_lock lock(matcher_mutex_);
+  bool match = false;
+  auto visitor = [&] (const Handler&) {
+    match = true;
+  };
+  Match(root_, topic_name, 0, topic_name.front() == '$', visitor);
+  return match;
+}
+
+} // pub_sub
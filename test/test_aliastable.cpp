@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <filesystem>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "pubsub/aliastable.h"
+
+namespace {
+
+std::string TestFile() {
+  auto path = std::filesystem::temp_directory_path();
+  path.append("test");
+  std::filesystem::create_directories(path);
+  path.append("aliases.txt");
+  std::filesystem::remove(path);
+  return path.string();
+}
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestAliasTable, KeepAliases) {
+  const std::string filename = TestFile();
+  {
+    AliasTable table;
+    EXPECT_TRUE(table.Load(filename)); // Missing file is OK
+    EXPECT_EQ(table.Size(), 0);
+    EXPECT_EQ(table.Alias("Speed"), 1);
+    EXPECT_EQ(table.Alias("Temperature"), 2);
+    EXPECT_EQ(table.Alias(AliasTable::MakeKey("Device1", "Speed")), 3);
+    EXPECT_EQ(table.Alias("speed"), 1); // Keys ignore case
+    EXPECT_TRUE(table.Alias("Fixed", 100));
+    EXPECT_TRUE(table.Alias("Fixed", 100));
+    EXPECT_FALSE(table.Alias("Other", 100)); // Used by another key
+    EXPECT_EQ(table.Find("Other"), 0);
+    EXPECT_EQ(table.NextAlias(), 101);
+
+    // A node metric name with a '/' doesn't collide with a device metric
+    EXPECT_NE(AliasTable::MakeKey("", "Device1/Speed"), AliasTable::MakeKey("Device1", "Speed"));
+    EXPECT_TRUE(table.IsModified());
+    EXPECT_TRUE(table.Save());
+    EXPECT_FALSE(table.IsModified());
+  }
+
+  // A restart keeps the aliases and a new metric doesn't shift them
+  AliasTable table;
+  ASSERT_TRUE(table.Load(filename));
+  EXPECT_EQ(table.Size(), 4);
+  EXPECT_EQ(table.Alias("Acceleration"), 101);
+  EXPECT_EQ(table.Alias("Speed"), 1);
+  EXPECT_EQ(table.Alias("Temperature"), 2);
+  EXPECT_EQ(table.Find("Device1/Speed"), 3);
+  EXPECT_EQ(table.Find("Unknown"), 0);
+  EXPECT_TRUE(table.Save());
+  std::filesystem::remove(filename);
+}
+
+} // end namespace pub_sub::test
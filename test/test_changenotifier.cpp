@@ -0,0 +1,184 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/changenotifier.h"
+#include "pubsub/outboundqueue.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+pub_sub::ChangeSet MakeChangeSet(const std::string& topic_name,
+                                 const std::vector<std::shared_ptr<pub_sub::Metric>>& metric_list) {
+  pub_sub::ChangeSet change_set;
+  change_set.topic_name = topic_name;
+  change_set.metric_list = metric_list;
+  return change_set;
+}
+
+/** \brief Executor that runs the tasks when the test calls RunAll(). */
+class ManualExecutor {
+ public:
+  void Execute(std::function<void()> task) {
+    std::scoped_lock lock(mutex_);
+    task_list_.push_back(std::move(task));
+  }
+
+  void RunAll() {
+    std::vector<std::function<void()>> task_list;
+    {
+      std::scoped_lock lock(mutex_);
+      task_list.swap(task_list_);
+    }
+    for (auto& task : task_list) {
+      task();
+    }
+  }
+ private:
+  std::mutex mutex_;
+  std::vector<std::function<void()>> task_list_;
+};
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestChangeNotifier, InternalThread) {
+  auto metric1 = std::make_shared<Metric>(std::string("Metric1"));
+  auto metric2 = std::make_shared<Metric>(std::string("Metric2"));
+
+  std::mutex mutex;
+  std::vector<size_t> size_list;
+  ChangeNotifier notifier;
+  EXPECT_FALSE(notifier.IsActive());
+  ASSERT_TRUE(notifier.Start([&] (const ChangeSet& change_set) {
+    std::scoped_lock lock(mutex);
+    size_list.push_back(change_set.metric_list.size());
+  }));
+  EXPECT_TRUE(notifier.IsActive());
+
+  notifier.Notify(MakeChangeSet("a/b", {metric1, metric2}));
+  notifier.Notify(MakeChangeSet("a/b", {metric1}));
+  notifier.Notify(MakeChangeSet("a/b", {})); // Empty sets are ignored
+
+  for (size_t wait = 0; wait < 300 && notifier.Delivered() < 2; ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(notifier.Delivered(), 2);
+  notifier.Stop();
+  EXPECT_FALSE(notifier.IsActive());
+
+  std::scoped_lock lock(mutex);
+  ASSERT_EQ(size_list.size(), 2);
+  EXPECT_EQ(size_list[0], 2);
+  EXPECT_EQ(size_list[1], 1);
+}
+
+TEST(TestChangeNotifier, DropAndConflate) {
+  auto metric1 = std::make_shared<Metric>(std::string("Metric1"));
+  auto metric2 = std::make_shared<Metric>(std::string("Metric2"));
+  ManualExecutor executor;
+  std::vector<ChangeSet> delivered_list;
+
+  ChangeNotifier notifier;
+  notifier.MaxQueueSize(1);
+  notifier.Policy(ChangePolicy::Drop);
+  notifier.SetExecutor([&] (std::function<void()> task) {
+    executor.Execute(std::move(task));
+  });
+  ASSERT_TRUE(notifier.Start([&] (const ChangeSet& change_set) {
+    delivered_list.push_back(change_set);
+  }));
+
+  // The consumer falls behind
+  notifier.Notify(MakeChangeSet("a/b", {metric1}));
+  notifier.Notify(MakeChangeSet("a/b", {metric2}));
+  EXPECT_EQ(notifier.QueueDepth(), 1);
+  EXPECT_EQ(notifier.Dropped(), 1);
+
+  notifier.Policy(ChangePolicy::Conflate);
+  notifier.Notify(MakeChangeSet("a/b", {metric2, metric1}));
+  EXPECT_EQ(notifier.QueueDepth(), 1);
+  EXPECT_EQ(notifier.Conflated(), 1);
+
+  // Another topic replaces the oldest set
+  notifier.Notify(MakeChangeSet("a/c", {metric1}));
+  EXPECT_EQ(notifier.Dropped(), 2);
+
+  executor.RunAll();
+  ASSERT_EQ(delivered_list.size(), 1);
+  EXPECT_EQ(delivered_list[0].topic_name, "a/c");
+  EXPECT_EQ(notifier.QueueDepth(), 0);
+
+  notifier.Stop();
+  delivered_list.clear();
+  ASSERT_TRUE(notifier.Start([&] (const ChangeSet& change_set) {
+    delivered_list.push_back(change_set);
+  }));
+  notifier.Notify(MakeChangeSet("a/b", {metric1}));
+  notifier.Notify(MakeChangeSet("a/b", {metric2}));
+  executor.RunAll();
+  ASSERT_EQ(delivered_list.size(), 1);
+  EXPECT_EQ(delivered_list[0].metric_list.size(), 2); // Conflated
+  notifier.Stop();
+}
+
+TEST(TestChangeNotifier, Block) {
+  auto metric1 = std::make_shared<Metric>(std::string("Metric1"));
+  std::atomic<size_t> count = 0;
+  ChangeNotifier notifier;
+  notifier.MaxQueueSize(2);
+  notifier.Policy(ChangePolicy::Block);
+  ASSERT_TRUE(notifier.Start([&] (const ChangeSet&) {
+    std::this_thread::sleep_for(1ms); // Slow consumer
+    ++count;
+  }));
+  for (size_t index = 0; index < 50; ++index) {
+    notifier.Notify(MakeChangeSet("a/b", {metric1}));
+  }
+  for (size_t wait = 0; wait < 300 && count < 50; ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(count, 50);
+  EXPECT_EQ(notifier.Dropped(), 0);
+  notifier.Stop();
+}
+
+TEST(TestChangeNotifier, NonBlockingThread) {
+  auto metric1 = std::make_shared<Metric>(std::string("Metric1"));
+  ManualExecutor executor;
+  ChangeNotifier notifier;
+  EXPECT_EQ(notifier.Policy(), ChangePolicy::Conflate);
+  notifier.MaxQueueSize(1);
+  notifier.Policy(ChangePolicy::Block);
+  notifier.SetExecutor([&] (std::function<void()> task) {
+    executor.Execute(std::move(task));
+  });
+  ASSERT_TRUE(notifier.Start([&] (const ChangeSet&) {}));
+
+  // The consumer never runs, but the client's receive thread doesn't wait.
+  std::thread receiver([&] {
+    OutboundQueue::NonBlockingThread();
+    notifier.Notify(MakeChangeSet("a/b", {metric1}));
+    notifier.Notify(MakeChangeSet("a/b", {metric1}));
+  });
+  receiver.join();
+  EXPECT_EQ(notifier.QueueDepth(), 1);
+  EXPECT_EQ(notifier.Conflated(), 1);
+
+  executor.RunAll();
+  notifier.Stop();
+}
+
+} // pub_sub::test
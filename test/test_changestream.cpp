@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/changestream.h"
+
+using namespace std::chrono_literals;
+
+namespace pub_sub::test {
+
+TEST(TestChangeStream, NamePattern) {
+  EXPECT_TRUE(ChangeStream::IsMatch("Line1/*", "Line1/Temperature"));
+  EXPECT_TRUE(ChangeStream::IsMatch("*/Temp?", "Line2/Temp1"));
+  EXPECT_TRUE(ChangeStream::IsMatch("*", ""));
+  EXPECT_FALSE(ChangeStream::IsMatch("Line1/*", "Line2/Temperature"));
+  EXPECT_FALSE(ChangeStream::IsMatch("*/Temp?", "Line2/Temp"));
+}
+
+TEST(TestChangeStream, LatestValue) {
+  auto temperature = std::make_shared<Metric>(std::string("Line1/Temperature"));
+  auto pressure = std::make_shared<Metric>(std::string("Line1/Pressure"));
+  auto speed = std::make_shared<Metric>(std::string("Line2/Speed"));
+  speed->Alias(12);
+  auto other = std::make_shared<Metric>(std::string("Line2/Other"));
+
+  std::mutex mutex;
+  std::vector<size_t> size_list;
+  std::string last_value;
+  ChangeStream stream;
+  EXPECT_TRUE(stream.IsEmpty());
+  MetricSelection selection;
+  selection.name_list.emplace_back("Line1/*");
+  selection.alias_list.push_back(12);
+  const auto subscription = stream.Subscribe(selection, 100,
+      [&] (const std::vector<std::shared_ptr<Metric>>& metric_list) {
+    std::scoped_lock lock(mutex);
+    size_list.push_back(metric_list.size());
+    for (const auto& metric : metric_list) {
+      if (metric == temperature) {
+        last_value = metric->Value<std::string>();
+      }
+    }
+  });
+  ASSERT_NE(subscription, 0);
+  EXPECT_FALSE(stream.IsEmpty());
+
+  const std::vector<std::shared_ptr<Metric>> change_list = {temperature, pressure, speed, other};
+  for (size_t value = 0; value < 1'000; ++value) {
+    temperature->Value(std::to_string(value));
+    stream.Update(change_list);
+    if (value % 100 == 0) {
+      std::this_thread::sleep_for(10ms);
+    }
+  }
+  std::this_thread::sleep_for(300ms);
+  stream.Unsubscribe(subscription);
+  EXPECT_TRUE(stream.IsEmpty());
+
+  std::scoped_lock lock(mutex);
+  ASSERT_FALSE(size_list.empty());
+  EXPECT_LT(size_list.size(), 10); // Far less than the number of updates
+  for (const auto size : size_list) {
+    EXPECT_EQ(size, 3);
+  }
+  EXPECT_EQ(last_value, "999");
+}
+
+TEST(TestChangeStream, NewMetric) {
+  std::mutex mutex;
+  std::vector<std::string> name_list;
+  ChangeStream stream;
+  MetricSelection selection;
+  selection.name_list.emplace_back("Line1/*");
+  const auto subscription = stream.Subscribe(selection, 0,
+      [&] (const std::vector<std::shared_ptr<Metric>>& metric_list) {
+    std::scoped_lock lock(mutex);
+    for (const auto& metric : metric_list) {
+      name_list.push_back(metric->Name());
+    }
+  });
+  ASSERT_NE(subscription, 0);
+
+  // The new metric may get the address of the deleted metric.
+  auto other = std::make_shared<Metric>(std::string("Line2/Other"));
+  stream.Update({other});
+  other.reset();
+  auto temperature = std::make_shared<Metric>(std::string("Line1/Temperature"));
+  stream.Update({temperature});
+
+  for (size_t wait = 0; wait < 100; ++wait) {
+    {
+      std::scoped_lock lock(mutex);
+      if (!name_list.empty()) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  stream.Unsubscribe(subscription);
+  std::scoped_lock lock(mutex);
+  ASSERT_EQ(name_list.size(), 1);
+  EXPECT_EQ(name_list.front(), "Line1/Temperature");
+}
+
+} // pub_sub::test
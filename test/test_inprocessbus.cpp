@@ -0,0 +1,199 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "inprocessbus.h"
+#include "pubsub/pubsubfactory.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+  constexpr std::string_view kGroup = "BusGroup";
+  constexpr std::string_view kNode = "BusNode";
+  constexpr std::string_view kHost = "BusHost";
+
+/** \brief Collects received messages. */
+class TestReceiver {
+ public:
+  void OnMessage(const std::string& topic_name, const pub_sub::BusBuffer&, bool retained) {
+    std::scoped_lock lock(mutex_);
+    topic_list_.push_back(topic_name);
+    if (retained) {
+      ++retained_;
+    }
+  }
+
+  [[nodiscard]] size_t Count() const {
+    std::scoped_lock lock(mutex_);
+    return topic_list_.size();
+  }
+  [[nodiscard]] size_t Retained() const {
+    std::scoped_lock lock(mutex_);
+    return retained_;
+  }
+
+  [[nodiscard]] bool WaitFor(size_t count) const {
+    for (size_t wait = 0; wait < 200 && Count() < count; ++wait) {
+      std::this_thread::sleep_for(10ms);
+    }
+    return Count() >= count;
+  }
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::string> topic_list_;
+  size_t retained_ = 0;
+};
+
+pub_sub::BusBuffer MakeBuffer(std::string_view text) {
+  return std::make_shared<const std::vector<uint8_t>>(text.cbegin(), text.cend());
+}
+
+}
+
+namespace pub_sub::test {
+
+TEST(TestInProcessBus, IsMatch) {
+  EXPECT_TRUE(InProcessBus::IsMatch("spBv1.0/#", "spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_TRUE(InProcessBus::IsMatch("spBv1.0/+/NDATA/#", "spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_TRUE(InProcessBus::IsMatch("spBv1.0/+/NDATA/+", "spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_TRUE(InProcessBus::IsMatch("spBv1.0/STATE/#", "spBv1.0/STATE"));
+  EXPECT_TRUE(InProcessBus::IsMatch("#", "spBv1.0/STATE/Host1"));
+  EXPECT_TRUE(InProcessBus::IsMatch("a/b", "a/b"));
+
+  EXPECT_FALSE(InProcessBus::IsMatch("spBv1.0/+/NDATA", "spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_FALSE(InProcessBus::IsMatch("spBv1.0/+/NBIRTH/#", "spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_FALSE(InProcessBus::IsMatch("a/b/c", "a/b"));
+  EXPECT_FALSE(InProcessBus::IsMatch("#", "$SYS/broker"));
+  EXPECT_FALSE(InProcessBus::IsMatch("", "a"));
+}
+
+TEST(TestInProcessBus, RetainedAndWill) {
+  auto& bus = InProcessBus::Instance();
+  TestReceiver receiver;
+  const int receiver_id = 0;
+  const int sender_id = 0;
+
+  bus.Connect(&sender_id, {}, "test/bus/will", MakeBuffer("offline"), true);
+  EXPECT_TRUE(bus.Publish("test/bus/state", MakeBuffer("online"), true));
+  EXPECT_FALSE(bus.Publish("test/bus/+", MakeBuffer("invalid"), false));
+
+  bus.Connect(&receiver_id,
+              [&] (const std::string& topic_name, const BusBuffer& body, bool retained) {
+    receiver.OnMessage(topic_name, body, retained);
+  });
+  EXPECT_TRUE(bus.IsConnected(&receiver_id));
+  EXPECT_TRUE(bus.Subscribe(&receiver_id, "test/bus/#"));
+  EXPECT_TRUE(receiver.WaitFor(1));
+  EXPECT_EQ(receiver.Retained(), 1);
+
+  // Lost connection sends the will message.
+  bus.Disconnect(&sender_id, true);
+  EXPECT_FALSE(bus.IsConnected(&sender_id));
+  EXPECT_TRUE(receiver.WaitFor(2));
+
+  // Remove the retained messages.
+  bus.Publish("test/bus/state", {}, true);
+  bus.Publish("test/bus/will", {}, true);
+  EXPECT_TRUE(receiver.WaitFor(4));
+  bus.Disconnect(&receiver_id, false);
+}
+
+TEST(TestInProcessBus, SharedSubscription) {
+  auto& bus = InProcessBus::Instance();
+  std::array<TestReceiver, 2> receiver_list;
+  const std::array<int, 2> id_list = {0, 0};
+  for (size_t index = 0; index < receiver_list.size(); ++index) {
+    auto& receiver = receiver_list[index];
+    bus.Connect(&id_list[index],
+                [&] (const std::string& topic_name, const BusBuffer& body, bool retained) {
+      receiver.OnMessage(topic_name, body, retained);
+    });
+    EXPECT_TRUE(bus.Subscribe(&id_list[index], "$share/Test/test/shared/#"));
+  }
+
+  const auto body = MakeBuffer("data");
+  for (size_t message = 0; message < 10; ++message) {
+    EXPECT_TRUE(bus.Publish("test/shared/data", body, false));
+  }
+  EXPECT_TRUE(receiver_list[0].WaitFor(5));
+  EXPECT_TRUE(receiver_list[1].WaitFor(5));
+  std::this_thread::sleep_for(10ms);
+  EXPECT_EQ(receiver_list[0].Count() + receiver_list[1].Count(), 10);
+
+  for (const auto& id : id_list) {
+    bus.Disconnect(&id, false);
+  }
+}
+
+TEST(TestInProcessBus, NodeAndHost) {
+  auto host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+  ASSERT_TRUE(host);
+  host->Transport(TransportLayer::InProcess);
+  host->Name(kHost.data());
+  host->Version(ProtocolVersion::Mqtt5);
+  host->LatencyProbe(true);
+  host->InService(true);
+  ASSERT_TRUE(host->Start());
+  // The host must subscribe before the node sends its NBIRTH.
+  for (size_t online = 0; online < 500 && !host->IsOnline(); ++online) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(host->IsOnline());
+
+  auto node = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode);
+  ASSERT_TRUE(node);
+  node->Transport(TransportLayer::InProcess);
+  node->Name(kNode.data());
+  node->GroupId(kGroup.data());
+  node->Version(ProtocolVersion::Mqtt5);
+  node->LatencyProbe(true);
+  node->InService(true);
+  ASSERT_TRUE(node->Start());
+
+  for (size_t online = 0; online < 500; ++online) {
+    if (node->IsOnline()) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(host->IsConnected());
+  EXPECT_TRUE(host->IsOnline());
+  EXPECT_TRUE(node->IsConnected());
+  EXPECT_TRUE(node->IsOnline());
+
+  // The node publish a latency probe each second.
+  const IPubSubClient* remote_node = nullptr;
+  for (size_t probe = 0; probe < 300; ++probe) {
+    remote_node = host->GetRemoteNode(kGroup.data(), kNode.data());
+    if (remote_node != nullptr && remote_node->Statistics().TransferTime().Count() > 0) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(remote_node != nullptr);
+  EXPECT_GT(remote_node->Statistics().TransferTime().Count(), 0);
+  EXPECT_GT(host->Statistics().MessagesIn(), 0);
+  EXPECT_EQ(host->Statistics().SequenceGaps(), 0);
+
+  node->InService(false);
+  EXPECT_TRUE(node->Stop());
+  EXPECT_FALSE(node->IsConnected());
+  node.reset();
+
+  host->InService(false);
+  EXPECT_TRUE(host->Stop());
+  EXPECT_FALSE(host->IsConnected());
+  host.reset();
+}
+
+} // pub_sub::test
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <array>
+#include <string_view>
+
+#include <gtest/gtest.h>
+#include "listentracer.h"
+
+namespace {
+  constexpr std::string_view kTopic = "spBv1.0/Group1/NDATA/Node1";
+}
+
+namespace pub_sub::test {
+
+TEST(TestListenTracer, DropTraces) {
+  ListenTracer tracer(nullptr);
+  const std::array<uint8_t, 4> body = {1, 2, 3, 4};
+
+  // Not started. Should not trace anything.
+  tracer.Trace(false, kTopic, body.data(), body.size());
+  EXPECT_EQ(tracer.DroppedTraces(), 0);
+
+  EXPECT_EQ(tracer.HandledTraces(), 0);
+
+  // Each trace is either handled or dropped if the ring buffer is full.
+  tracer.Start();
+  for (size_t index = 0; index < 10'000; ++index) {
+    tracer.Trace(false, kTopic, body.data(), body.size());
+  }
+  tracer.Stop();
+  EXPECT_EQ(tracer.HandledTraces() + tracer.DroppedTraces(), 10'000);
+}
+
+TEST(TestListenTracer, SampleRate) {
+  ListenTracer tracer(nullptr);
+  tracer.SampleRate(0);
+  EXPECT_EQ(tracer.SampleRate(), 1);
+
+  tracer.SampleRate(100);
+  EXPECT_EQ(tracer.SampleRate(), 100);
+
+  const std::array<uint8_t, 4> body = {1, 2, 3, 4};
+  tracer.Start();
+  for (size_t index = 0; index < 10'000; ++index) {
+    tracer.Trace(true, kTopic, body.data(), body.size());
+  }
+  tracer.Stop();
+  EXPECT_EQ(tracer.DroppedTraces(), 0); // Only 100 traces in the ring buffer
+  EXPECT_EQ(tracer.HandledTraces(), 100);
+}
+
+} // pub_sub::test
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "localhub.h"
+#include "pubsub/localsubscriber.h"
+#include "pubsub/payload.h"
+#include "pubsub/pubsubfactory.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::string_view kGroup = "LocalGroup";
+constexpr std::string_view kNode = "LocalNode";
+
+std::string TestEndpoint() {
+  auto path = std::filesystem::temp_directory_path();
+  path.append("pubsub_localhub.sock");
+  return path.string();
+}
+
+pub_sub::BusBuffer MakeBuffer(std::string_view text) {
+  return std::make_shared<const std::vector<uint8_t>>(text.cbegin(), text.cend());
+}
+
+/** \brief Collects received messages. */
+class TestConsumer {
+ public:
+  void OnMessage(const std::string& topic_name, const std::vector<uint8_t>& body) {
+    std::scoped_lock lock(mutex_);
+    topic_list_.push_back(topic_name);
+    body_list_.push_back(body);
+  }
+
+  [[nodiscard]] size_t Count() const {
+    std::scoped_lock lock(mutex_);
+    return topic_list_.size();
+  }
+
+  [[nodiscard]] std::string Topic(size_t index) const {
+    std::scoped_lock lock(mutex_);
+    return index < topic_list_.size() ? topic_list_[index] : std::string();
+  }
+
+  [[nodiscard]] std::vector<uint8_t> Body(size_t index) const {
+    std::scoped_lock lock(mutex_);
+    return index < body_list_.size() ? body_list_[index] : std::vector<uint8_t>();
+  }
+
+  [[nodiscard]] bool WaitFor(size_t count) const {
+    for (size_t wait = 0; wait < 300 && Count() < count; ++wait) {
+      std::this_thread::sleep_for(10ms);
+    }
+    return Count() >= count;
+  }
+
+  pub_sub::LocalSubscriber::OnMessage Callback() {
+    return [this] (const std::string& topic_name, const std::vector<uint8_t>& body) {
+      OnMessage(topic_name, body);
+    };
+  }
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::string> topic_list_;
+  std::vector<std::vector<uint8_t>> body_list_;
+};
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestLocalHub, FanOut) {
+#ifdef _WIN32
+  GTEST_SKIP() << "The local hub is not supported on Windows";
+#endif
+  LocalHub hub;
+  ASSERT_TRUE(hub.Start(TestEndpoint()));
+  hub.Publish("test/local/birth", MakeBuffer("birth"), true);
+
+  std::array<TestConsumer, 2> consumer_list;
+  std::array<LocalSubscriber, 2> subscriber_list;
+  for (size_t index = 0; index < subscriber_list.size(); ++index) {
+    ASSERT_TRUE(subscriber_list[index].Connect(TestEndpoint(),
+                                               consumer_list[index].Callback()));
+  }
+  for (size_t wait = 0; wait < 300 && hub.Consumers() < subscriber_list.size(); ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(hub.Consumers(), subscriber_list.size());
+
+  // New consumers start with the retained message.
+  for (const auto& consumer : consumer_list) {
+    ASSERT_TRUE(consumer.WaitFor(1));
+    EXPECT_EQ(consumer.Topic(0), "test/local/birth");
+  }
+
+  const std::string large_body(100'000, 'x'); // Larger than the socket buffer
+  hub.Publish("test/local/data", MakeBuffer(large_body), false);
+  hub.Publish("test/local/empty", {}, false);
+  for (const auto& consumer : consumer_list) {
+    ASSERT_TRUE(consumer.WaitFor(3));
+    EXPECT_EQ(consumer.Topic(1), "test/local/data");
+    EXPECT_EQ(consumer.Body(1).size(), large_body.size());
+    EXPECT_TRUE(consumer.Body(2).empty());
+  }
+  EXPECT_EQ(hub.DroppedMessages(), 0);
+
+  // Deleting the retained message doesn't send any frame to the consumers.
+  hub.ClearRetained("test/local/birth");
+  hub.Publish("test/local/last", MakeBuffer("last"), false);
+  for (const auto& consumer : consumer_list) {
+    ASSERT_TRUE(consumer.WaitFor(4));
+    EXPECT_EQ(consumer.Topic(3), "test/local/last");
+  }
+
+  TestConsumer new_consumer;
+  LocalSubscriber new_subscriber;
+  ASSERT_TRUE(new_subscriber.Connect(TestEndpoint(), new_consumer.Callback()));
+  for (size_t wait = 0; wait < 300 && hub.Consumers() <= subscriber_list.size(); ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  hub.Publish("test/local/new", MakeBuffer("new"), false);
+  ASSERT_TRUE(new_consumer.WaitFor(1));
+  EXPECT_EQ(new_consumer.Topic(0), "test/local/new");
+  new_subscriber.Disconnect();
+  for (size_t wait = 0; wait < 300 && hub.Consumers() > subscriber_list.size(); ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+
+  subscriber_list[0].Disconnect();
+  EXPECT_FALSE(subscriber_list[0].IsConnected());
+  for (size_t wait = 0; wait < 300 && hub.Consumers() > 1; ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(hub.Consumers(), 1);
+
+  hub.Stop();
+  for (size_t wait = 0; wait < 300 && subscriber_list[1].IsConnected(); ++wait) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_FALSE(subscriber_list[1].IsConnected());
+  EXPECT_FALSE(std::filesystem::exists(TestEndpoint()));
+}
+
+TEST(TestLocalHub, SparkplugNode) {
+#ifdef _WIN32
+  GTEST_SKIP() << "The local hub is not supported on Windows";
+#endif
+  auto node = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode);
+  ASSERT_TRUE(node);
+  node->Transport(TransportLayer::InProcess);
+  node->Name(kNode.data());
+  node->GroupId(kGroup.data());
+  node->LocalEndpoint(TestEndpoint());
+  node->InService(true);
+  ASSERT_TRUE(node->Start());
+
+  for (size_t online = 0; online < 500 && !node->IsOnline(); ++online) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(node->IsOnline());
+
+  // A late consumer receives the NBIRTH message first.
+  TestConsumer consumer;
+  LocalSubscriber subscriber;
+  ASSERT_TRUE(subscriber.Connect(TestEndpoint(), consumer.Callback()));
+  ASSERT_TRUE(consumer.WaitFor(1));
+  EXPECT_NE(consumer.Topic(0).find("/NBIRTH/"), std::string::npos);
+
+  Payload payload;
+  payload.Body() = consumer.Body(0);
+  payload.ParseSparkplugProtobuf(true);
+  EXPECT_FALSE(payload.Metrics().empty());
+
+  node->InService(false);
+  EXPECT_TRUE(node->Stop());
+  subscriber.Disconnect();
+  EXPECT_FALSE(std::filesystem::exists(TestEndpoint()));
+}
+
+} // pub_sub::test
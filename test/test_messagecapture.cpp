@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/messagecapture.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string TestFile() {
+  auto path = std::filesystem::temp_directory_path();
+  path.append("test");
+  std::filesystem::create_directories(path);
+  path.append("capture.bin");
+  std::filesystem::remove(path);
+  return path.string();
+}
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestMessageCapture, CaptureAndReplay) {
+  const std::string filename = TestFile();
+  const std::vector<uint8_t> body = {1, 2, 3, 4, 5};
+
+  MessageCapture capture;
+  capture.RingSize(100); // Forces several file writes
+  ASSERT_TRUE(capture.Start(filename));
+  EXPECT_TRUE(capture.IsActive());
+  for (size_t index = 0; index < 10; ++index) {
+    const std::string topic_name = "spBv1.0/Group/NDATA/Node" + std::to_string(index);
+    capture.Capture(topic_name, body.data(), index % body.size(), index == 0);
+    std::this_thread::sleep_for(20ms); // Let the writer empty the ring
+  }
+  capture.Capture(std::string(200, 'A'), nullptr, 0, false); // Larger than the ring
+  capture.Stop();
+  EXPECT_FALSE(capture.IsActive());
+  EXPECT_EQ(capture.Captured(), 10);
+  EXPECT_EQ(capture.Dropped(), 1);
+
+  MessageReplay replay;
+  ASSERT_TRUE(replay.Open(filename));
+  EXPECT_TRUE(replay.IsOpen());
+  ASSERT_EQ(replay.NofMessages(), 10);
+
+  const auto& message_list = replay.Messages();
+  EXPECT_TRUE(message_list[0].retained);
+  EXPECT_FALSE(message_list[1].retained);
+  EXPECT_EQ(message_list[3].topic_name, "spBv1.0/Group/NDATA/Node3");
+  ASSERT_EQ(message_list[3].payload.size(), 3);
+  EXPECT_EQ(message_list[3].payload[2], 3);
+  EXPECT_GE(message_list[9].arrival_time, message_list[0].arrival_time);
+
+  // Maximum speed
+  replay.Speed(0.0);
+  std::vector<std::string> topic_list;
+  EXPECT_EQ(replay.Replay([&] (const CapturedMessage& message) {
+    topic_list.emplace_back(message.topic_name);
+  }), 10);
+  ASSERT_EQ(topic_list.size(), 10);
+  EXPECT_EQ(topic_list[9], "spBv1.0/Group/NDATA/Node9");
+
+  // Original speed takes about the same time as the capture
+  replay.Speed(1.0);
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(replay.Replay([] (const CapturedMessage&) {}), 10);
+  const auto duration = std::chrono::steady_clock::now() - start;
+  const auto captured = std::chrono::nanoseconds(message_list[9].arrival_time
+                                                   - message_list[0].arrival_time);
+  EXPECT_GE(duration, captured);
+
+  replay.Close();
+  EXPECT_FALSE(replay.IsOpen());
+  std::filesystem::remove(filename);
+}
+
+} // end namespace pub_sub::test
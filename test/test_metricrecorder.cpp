@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "pubsub/metricrecorder.h"
+
+namespace {
+
+std::string TestDirectory() {
+  auto path = std::filesystem::temp_directory_path();
+  path.append("test").append("recorder");
+  std::filesystem::remove_all(path);
+  return path.string();
+}
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestMetricRecorder, RecordAndQuery) {
+  auto temperature = std::make_shared<Metric>(std::string("Temperature"));
+  temperature->Type(MetricType::Double);
+  auto counter = std::make_shared<Metric>(std::string("Counter"));
+  counter->Type(MetricType::Int64);
+  counter->Alias(12);
+  auto status = std::make_shared<Metric>(std::string("Status"));
+  status->Type(MetricType::String);
+
+  MetricRecorder recorder;
+  recorder.Directory(TestDirectory());
+  recorder.ChunkSize(7);
+  recorder.MaxSegmentSize(300); // Forces several segment files
+  ASSERT_TRUE(recorder.Start());
+  EXPECT_TRUE(recorder.IsActive());
+
+  for (int64_t index = 0; index < 100; ++index) {
+    const auto time = static_cast<uint64_t>(1'000 + index * 10);
+    temperature->Timestamp(time);
+    counter->Timestamp(time);
+    status->Timestamp(time);
+    temperature->Value(20.0 + static_cast<double>(index % 5) * 0.25);
+    counter->Value(index * index - 50);
+    status->Value(std::string("Step ") + std::to_string(index));
+    status->IsNull(index == 3);
+    recorder.Record("Group", "Node", "", {temperature, counter, status});
+  }
+  recorder.Flush();
+  EXPECT_EQ(recorder.Recorded(), 300);
+  EXPECT_EQ(recorder.Dropped(), 0);
+
+  const auto key_list = recorder.SeriesKeys();
+  ASSERT_EQ(key_list.size(), 3);
+  EXPECT_EQ(key_list[0], "Group/Node//Counter");
+
+  const auto temp_list = recorder.Query(
+      MetricRecorder::MakeSeriesKey("Group", "Node", "", "Temperature"), 1'100, 1'500);
+  ASSERT_EQ(temp_list.size(), 41);
+  EXPECT_EQ(temp_list.front().timestamp, 1'100);
+  EXPECT_EQ(temp_list.back().timestamp, 1'500);
+  EXPECT_DOUBLE_EQ(temp_list[1].float_value, 20.25);
+
+  const auto counter_list = recorder.Query("Group/Node//Counter", 0, 10'000);
+  ASSERT_EQ(counter_list.size(), 100);
+  EXPECT_EQ(counter_list[3].int_value, -41);
+  EXPECT_EQ(counter_list[99].int_value, 9'751);
+
+  const auto status_list = recorder.Query("Group/Node//Status", 0, 10'000);
+  ASSERT_EQ(status_list.size(), 100);
+  EXPECT_EQ(status_list[3].quality, SampleQuality::Null);
+  EXPECT_EQ(status_list[50].quality, SampleQuality::Good);
+  EXPECT_EQ(status_list[50].text_value, "Step 50");
+
+  recorder.Stop();
+  EXPECT_FALSE(recorder.IsActive());
+
+  // Another reader may query the segment files
+  MetricRecorder reader;
+  reader.Directory(recorder.Directory());
+  EXPECT_EQ(reader.Query("Group/Node//Counter", 0, 10'000).size(), 100);
+  EXPECT_TRUE(reader.Query("Group/Node//Unknown", 0, 10'000).empty());
+}
+
+} // end namespace pub_sub::test
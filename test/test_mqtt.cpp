@@ -206,6 +206,64 @@ TEST_F(TestMqtt, IValue) {
 
 }
 
+TEST_F(TestMqtt, DecodeText) {
+  auto client = PubSubFactory::CreatePubSubClient(PubSubType::Mqtt5Client);
+  ASSERT_TRUE(client);
+  auto inject = [&] (const std::string& topic_name, const std::string& text) {
+    client->InjectMessage(topic_name, text.data(), text.size(), false);
+    auto* topic = client->GetTopic(topic_name);
+    return topic != nullptr ? topic->GetPayload().GetMetric(topic_name) : nullptr;
+  };
+
+  // The type is guessed from the first value.
+  auto temperature = inject("test/Temperature", "23.4 C");
+  ASSERT_TRUE(temperature);
+  EXPECT_EQ(temperature->Type(), MetricType::Double);
+  EXPECT_EQ(temperature->Unit(), "C");
+  EXPECT_DOUBLE_EQ(temperature->Value<double>(), 23.4);
+
+  size_t messages = 0;
+  temperature->SetOnMessage([&] (Metric&) { ++messages; });
+  inject("test/Temperature", "+25 C");
+  EXPECT_DOUBLE_EQ(temperature->Value<double>(), 25.0);
+  EXPECT_EQ(messages, 1);
+
+  auto running = inject("test/Running", "true");
+  ASSERT_TRUE(running);
+  EXPECT_EQ(running->Type(), MetricType::Boolean);
+  EXPECT_TRUE(running->Value<bool>());
+
+  auto status = inject("test/Status", "Hello Ingemar");
+  ASSERT_TRUE(status);
+  EXPECT_EQ(status->Type(), MetricType::String);
+  EXPECT_EQ(status->Value<std::string>(), "Hello Ingemar");
+
+  // The content type defines the type of new topics.
+  auto* counter_topic = client->CreateTopic();
+  ASSERT_TRUE(counter_topic != nullptr);
+  counter_topic->Topic("test/Counter");
+  counter_topic->ContentType("text/plain; type=int");
+  auto counter = inject("test/Counter", "42");
+  ASSERT_TRUE(counter);
+  EXPECT_EQ(counter->Type(), MetricType::Int64);
+  EXPECT_EQ(counter->Value<int64_t>(), 42);
+
+  // JSON metrics fire their callbacks as well.
+  auto* json_topic = client->CreateTopic();
+  ASSERT_TRUE(json_topic != nullptr);
+  json_topic->Topic("test/Json");
+  json_topic->ContentType("application/json");
+  auto speed = json_topic->CreateMetric("Speed");
+  ASSERT_TRUE(speed);
+  speed->Type(MetricType::Double);
+  size_t json_messages = 0;
+  speed->SetOnMessage([&] (Metric&) { ++json_messages; });
+  const std::string json = R"({"Speed": 12.5})";
+  client->InjectMessage("test/Json", json.data(), json.size(), false);
+  EXPECT_DOUBLE_EQ(speed->Value<double>(), 12.5);
+  EXPECT_EQ(json_messages, 1);
+}
+
 TEST_F(TestMqtt, Mqtt3Client) { // NOLINT
  if (broker_.empty()) {
     GTEST_SKIP();
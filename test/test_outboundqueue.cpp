@@ -0,0 +1,521 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/itopic.h"
+#include "pubsub/outboundqueue.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/** \brief Assigns the send tokens and completes them in send order. */
+class TokenSource {
+ public:
+  int Next() { return ++last_token_; }
+
+  void CompleteNext(pub_sub::OutboundQueue& queue, bool delivered = true) {
+    queue.Complete(++last_completed_, delivered);
+  }
+ private:
+  std::atomic<int> last_token_ = 0;
+  std::atomic<int> last_completed_ = 0;
+};
+
+/** \brief Topic that records the sent bodies. The test completes the messages. */
+class TestTopic : public pub_sub::ITopic {
+ public:
+  explicit TestTopic(TokenSource& source)
+  : source_(source) {
+  }
+
+  using pub_sub::ITopic::DoPublish;
+  void DoPublish(std::shared_ptr<pub_sub::DeliveryPromise>) override {}
+
+  bool SendBody(std::vector<uint8_t>& body, int& token) override {
+    std::scoped_lock lock(mutex_);
+    token = source_.Next();
+    body_list_.push_back(body);
+    return true;
+  }
+
+  [[nodiscard]] std::vector<std::vector<uint8_t>> Bodies() const {
+    std::scoped_lock lock(mutex_);
+    return body_list_;
+  }
+
+  [[nodiscard]] size_t NofSent() const {
+    std::scoped_lock lock(mutex_);
+    return body_list_.size();
+  }
+ private:
+  TokenSource& source_;
+  mutable std::mutex mutex_;
+  std::vector<std::vector<uint8_t>> body_list_;
+};
+
+/** \brief Topic that publishes through an outbound queue. */
+class QueueTopic : public TestTopic {
+ public:
+  QueueTopic(TokenSource& source, pub_sub::OutboundQueue& queue)
+  : TestTopic(source),
+    queue_(queue) {
+  }
+
+  using pub_sub::ITopic::DoPublish;
+  void DoPublish(std::shared_ptr<pub_sub::DeliveryPromise> delivery) override {
+    queue_.Publish(*this, std::vector<uint8_t>(10, 0), false, std::move(delivery));
+  }
+ private:
+  pub_sub::OutboundQueue& queue_;
+};
+
+/** \brief Topic that only sends the changed values. */
+class DeltaTopic : public TestTopic {
+ public:
+  using TestTopic::TestTopic;
+  [[nodiscard]] bool IsConflatable() const override { return false; }
+};
+
+std::vector<uint8_t> MakeBody(uint8_t value, size_t size = 10) {
+  return std::vector<uint8_t>(size, value);
+}
+
+bool WaitFor(const std::function<bool()>& condition) {
+  for (size_t timeout = 0; timeout < 200 && !condition(); ++timeout) {
+    std::this_thread::sleep_for(10ms);
+  }
+  return condition();
+}
+
+} // end namespace
+
+namespace pub_sub::test {
+
+TEST(TestOutboundQueue, NotStarted) {
+  TokenSource source;
+  TestTopic topic(source);
+  OutboundQueue queue;
+  EXPECT_FALSE(queue.IsActive());
+  for (uint8_t index = 0; index < 10; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index)));
+  }
+  EXPECT_EQ(topic.NofSent(), 10);
+  EXPECT_EQ(queue.QueueDepth(), 0);
+  EXPECT_EQ(queue.InFlight(), 0);
+}
+
+TEST(TestOutboundQueue, InFlightWindow) {
+  TokenSource source;
+  TestTopic topic(source);
+  OutboundQueue queue;
+  queue.InFlightWindow(2);
+  ASSERT_TRUE(queue.Start());
+  EXPECT_TRUE(queue.IsActive());
+
+  for (uint8_t index = 0; index < 5; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index)));
+  }
+  EXPECT_EQ(topic.NofSent(), 2);
+  EXPECT_EQ(queue.InFlight(), 2);
+  EXPECT_EQ(queue.QueueDepth(), 3);
+  EXPECT_EQ(queue.QueueBytes(), 30);
+
+  for (size_t complete = 0; complete < 5; ++complete) {
+    source.CompleteNext(queue);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(WaitFor([&] { return topic.NofSent() == 5; }));
+  EXPECT_TRUE(WaitFor([&] { return queue.InFlight() == 0; }));
+  EXPECT_EQ(queue.QueueDepth(), 0);
+  EXPECT_EQ(queue.Sent(), 5);
+
+  // The send order is kept.
+  const auto body_list = topic.Bodies();
+  for (size_t index = 0; index < body_list.size(); ++index) {
+    EXPECT_EQ(body_list[index][0], index);
+  }
+  queue.Stop();
+  EXPECT_FALSE(queue.IsActive());
+}
+
+TEST(TestOutboundQueue, DropOldest) {
+  TokenSource source;
+  TestTopic topic(source);
+  topic.Policy(PublishPolicy::DropOldest);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(30);
+  ASSERT_TRUE(queue.Start());
+
+  for (uint8_t index = 0; index < 6; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index)));
+  }
+  // One message in flight, three queued and two dropped.
+  EXPECT_EQ(queue.QueueDepth(), 3);
+  EXPECT_LE(queue.QueueBytes(), queue.ByteLimit());
+  EXPECT_EQ(queue.Dropped(), 2);
+
+  for (size_t complete = 0; complete < 4; ++complete) {
+    source.CompleteNext(queue);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(WaitFor([&] { return topic.NofSent() == 4; }));
+  const auto body_list = topic.Bodies();
+  ASSERT_EQ(body_list.size(), 4);
+  EXPECT_EQ(body_list[0][0], 0);
+  EXPECT_EQ(body_list[1][0], 3);
+  EXPECT_EQ(body_list[3][0], 5);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, Conflate) {
+  TokenSource source;
+  TestTopic topic1(source);
+  topic1.Policy(PublishPolicy::Conflate);
+  TestTopic topic2(source);
+  topic2.Policy(PublishPolicy::Conflate);
+
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(1'000);
+  ASSERT_TRUE(queue.Start());
+
+  EXPECT_TRUE(queue.Publish(topic1, MakeBody(1)));
+  for (uint8_t index = 2; index < 10; ++index) {
+    EXPECT_TRUE(queue.Publish(topic1, MakeBody(index)));
+    EXPECT_TRUE(queue.Publish(topic2, MakeBody(index)));
+  }
+  // Only the latest value of each topic is queued.
+  EXPECT_EQ(queue.QueueDepth(), 2);
+  EXPECT_EQ(queue.Conflated(), 14);
+  EXPECT_EQ(queue.Dropped(), 0);
+
+  source.CompleteNext(queue);
+  EXPECT_TRUE(WaitFor([&] { return topic1.NofSent() == 2; }));
+  source.CompleteNext(queue);
+  EXPECT_TRUE(WaitFor([&] { return topic2.NofSent() == 1; }));
+  EXPECT_EQ(topic1.Bodies().back()[0], 9);
+  EXPECT_EQ(topic2.Bodies().back()[0], 9);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, ConflateDelta) {
+  TokenSource source;
+  DeltaTopic topic(source);
+  topic.Policy(PublishPolicy::Conflate);
+
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(30);
+  ASSERT_TRUE(queue.Start());
+
+  for (uint8_t index = 0; index < 6; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index)));
+  }
+  // The changes are never replaced. The oldest are dropped instead.
+  EXPECT_EQ(queue.Conflated(), 0);
+  EXPECT_EQ(queue.QueueDepth(), 3);
+  EXPECT_EQ(queue.Dropped(), 2);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, KeepNeverDropped) {
+  TokenSource source;
+  TestTopic data_topic(source);
+  data_topic.Policy(PublishPolicy::Conflate);
+  TestTopic birth_topic(source);
+  birth_topic.Policy(PublishPolicy::DropOldest);
+
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(20);
+  ASSERT_TRUE(queue.Start());
+
+  EXPECT_TRUE(queue.Publish(data_topic, MakeBody(0)));
+  EXPECT_TRUE(queue.Publish(birth_topic, MakeBody(1), true));
+  EXPECT_TRUE(queue.Publish(birth_topic, MakeBody(2), true));
+  EXPECT_TRUE(queue.Publish(birth_topic, MakeBody(3), true));
+  // The queue only holds kept messages, so the new messages are dropped.
+  EXPECT_FALSE(queue.Publish(data_topic, MakeBody(4)));
+  EXPECT_FALSE(queue.Publish(data_topic, MakeBody(5)));
+
+  // The kept messages exceed the byte limit but are still queued.
+  EXPECT_EQ(queue.QueueDepth(), 3);
+  EXPECT_EQ(birth_topic.NofSent(), 0);
+
+  for (size_t complete = 0; complete < 4; ++complete) {
+    source.CompleteNext(queue);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(WaitFor([&] { return birth_topic.NofSent() == 3; }));
+  EXPECT_EQ(queue.Dropped(), 2);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, BlockTimeout) {
+  TokenSource source;
+  TestTopic topic(source);
+  topic.Policy(PublishPolicy::Block);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(10);
+  queue.BlockTimeout(50);
+  ASSERT_TRUE(queue.Start());
+
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(0)));
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(1)));
+
+  // The queue is full and nothing completes.
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(queue.Publish(topic, MakeBody(2)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+  EXPECT_EQ(queue.Dropped(), 1);
+
+  // A completion gives space to a blocked publisher.
+  queue.BlockTimeout(5'000);
+  std::thread complete([&] {
+    std::this_thread::sleep_for(50ms);
+    source.CompleteNext(queue);
+  });
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(3)));
+  complete.join();
+  EXPECT_EQ(queue.Dropped(), 1);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, NonBlockingThread) {
+  TokenSource source;
+  TestTopic topic(source);
+  topic.Policy(PublishPolicy::Block);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  queue.ByteLimit(10);
+  queue.BlockTimeout(5'000);
+  ASSERT_TRUE(queue.Start());
+
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(0)));
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(1)));
+
+  // A client thread drops the oldest message instead of waiting.
+  std::thread client([&] {
+    OutboundQueue::NonBlockingThread();
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(2)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+  });
+  client.join();
+  EXPECT_EQ(queue.Dropped(), 1);
+  EXPECT_EQ(queue.QueueDepth(), 1);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, Reset) {
+  TokenSource source;
+  TestTopic topic(source);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  ASSERT_TRUE(queue.Start());
+
+  for (uint8_t index = 0; index < 4; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index)));
+  }
+  EXPECT_EQ(queue.QueueDepth(), 3);
+
+  // The connection is destroyed and the pending messages will never complete.
+  queue.Reset();
+  EXPECT_EQ(queue.QueueDepth(), 0);
+  EXPECT_EQ(queue.InFlight(), 0);
+  EXPECT_EQ(queue.Dropped(), 3);
+
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(4)));
+  EXPECT_EQ(topic.NofSent(), 2);
+
+  queue.Discard(topic);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, DeliveryFuture) {
+  TokenSource source;
+  TestTopic topic(source);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  ASSERT_TRUE(queue.Start());
+
+  auto delivery1 = std::make_shared<DeliveryPromise>();
+  const DeliveryFuture future1 = delivery1->get_future().share();
+  auto delivery2 = std::make_shared<DeliveryPromise>();
+  const DeliveryFuture future2 = delivery2->get_future().share();
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(1), false, delivery1));
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(2), false, delivery2));
+  EXPECT_EQ(future1.wait_for(10ms), std::future_status::timeout);
+
+  std::this_thread::sleep_for(5ms);
+  source.CompleteNext(queue);
+  ASSERT_EQ(future1.wait_for(2s), std::future_status::ready);
+  EXPECT_EQ(future1.get().token, 1);
+  EXPECT_TRUE(future1.get().delivered);
+  EXPECT_GE(future1.get().latency, 5'000'000);
+
+  // The second message is sent when the first completes.
+  EXPECT_TRUE(WaitFor([&] { return topic.NofSent() == 2; }));
+  source.CompleteNext(queue, false);
+  ASSERT_EQ(future2.wait_for(2s), std::future_status::ready);
+  EXPECT_EQ(future2.get().token, 2);
+  EXPECT_FALSE(future2.get().delivered);
+
+  EXPECT_EQ(queue.DeliveryTime().Count(), 1);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, PublishAsync) {
+  TokenSource source;
+  OutboundQueue queue;
+  QueueTopic topic(source, queue);
+  ASSERT_TRUE(queue.Start());
+
+  // Concurrent publishers get their own delivery handles.
+  constexpr size_t kNofMessages = 100;
+  std::vector<DeliveryFuture> future_list1;
+  std::vector<DeliveryFuture> future_list2;
+  std::thread publisher1([&] {
+    for (size_t index = 0; index < kNofMessages; ++index) {
+      future_list1.push_back(topic.PublishAsync());
+      topic.DoPublish();
+    }
+  });
+  std::thread publisher2([&] {
+    for (size_t index = 0; index < kNofMessages; ++index) {
+      future_list2.push_back(topic.PublishAsync());
+    }
+  });
+  publisher1.join();
+  publisher2.join();
+  ASSERT_EQ(topic.NofSent(), 3 * kNofMessages);
+  for (size_t complete = 0; complete < 3 * kNofMessages; ++complete) {
+    source.CompleteNext(queue);
+  }
+
+  std::vector<int> token_list;
+  for (const auto* future_list : {&future_list1, &future_list2}) {
+    for (const auto& future : *future_list) {
+      ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+      EXPECT_TRUE(future.get().delivered);
+      token_list.push_back(future.get().token);
+    }
+  }
+  std::sort(token_list.begin(), token_list.end());
+  EXPECT_EQ(std::adjacent_find(token_list.cbegin(), token_list.cend()), token_list.cend());
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, UnknownCompletion) {
+  TokenSource source;
+  TestTopic topic(source);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  ASSERT_TRUE(queue.Start());
+
+  auto delivery = std::make_shared<DeliveryPromise>();
+  const DeliveryFuture future = delivery->get_future().share();
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(0), false, delivery));
+  EXPECT_TRUE(queue.Publish(topic, MakeBody(1)));
+  EXPECT_EQ(queue.QueueDepth(), 1);
+
+  // A failure without a token still frees the slot.
+  queue.Complete(0, false);
+  EXPECT_TRUE(WaitFor([&] { return topic.NofSent() == 2; }));
+  EXPECT_EQ(queue.InFlight(), 1);
+  EXPECT_EQ(future.wait_for(0s), std::future_status::timeout);
+
+  // The unknown message is released on reset.
+  queue.Reset();
+  ASSERT_EQ(future.wait_for(0s), std::future_status::ready);
+  EXPECT_FALSE(future.get().delivered);
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, DeliveryBatch) {
+  TokenSource source;
+  TestTopic topic(source);
+
+  std::mutex mutex;
+  std::vector<size_t> batch_list;
+  size_t nof_results = 0;
+  OutboundQueue queue;
+  queue.OnDelivery([&] (const std::vector<DeliveryResult>& result_list) {
+    std::scoped_lock lock(mutex);
+    batch_list.push_back(result_list.size());
+    nof_results += result_list.size();
+  });
+  ASSERT_TRUE(queue.Start());
+
+  constexpr size_t kNofMessages = 5'000;
+  for (size_t index = 0; index < kNofMessages; ++index) {
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(static_cast<uint8_t>(index))));
+  }
+  EXPECT_EQ(queue.InFlight(), queue.InFlightWindow());
+  // The transport completes the messages that are sent.
+  size_t completed = 0;
+  for (size_t timeout = 0; completed < kNofMessages && timeout < 2'000; ++timeout) {
+    for (const size_t sent = topic.NofSent(); completed < sent; ++completed) {
+      source.CompleteNext(queue);
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_TRUE(WaitFor([&] {
+    std::scoped_lock lock(mutex);
+    return nof_results == kNofMessages;
+  }));
+  EXPECT_EQ(topic.NofSent(), kNofMessages);
+  EXPECT_EQ(queue.InFlight(), 0);
+  {
+    // Many completions are handled by each wakeup.
+    std::scoped_lock lock(mutex);
+    EXPECT_LT(batch_list.size(), kNofMessages);
+  }
+  queue.Stop();
+}
+
+TEST(TestOutboundQueue, DeliveryDropped) {
+  TokenSource source;
+  TestTopic topic(source);
+  topic.Policy(PublishPolicy::Conflate);
+  OutboundQueue queue;
+  queue.InFlightWindow(1);
+  ASSERT_TRUE(queue.Start());
+
+  std::vector<DeliveryFuture> future_list;
+  for (uint8_t index = 0; index < 3; ++index) {
+    auto delivery = std::make_shared<DeliveryPromise>();
+    future_list.push_back(delivery->get_future().share());
+    EXPECT_TRUE(queue.Publish(topic, MakeBody(index), false, delivery));
+  }
+  // The second message was replaced by the third.
+  ASSERT_EQ(future_list[1].wait_for(0s), std::future_status::ready);
+  EXPECT_FALSE(future_list[1].get().delivered);
+  EXPECT_EQ(future_list[1].get().token, 0);
+
+  // The connection is lost before the messages completed.
+  queue.Reset();
+  ASSERT_EQ(future_list[0].wait_for(0s), std::future_status::ready);
+  EXPECT_FALSE(future_list[0].get().delivered);
+  EXPECT_EQ(future_list[0].get().token, 1);
+  ASSERT_EQ(future_list[2].wait_for(0s), std::future_status::ready);
+  EXPECT_FALSE(future_list[2].get().delivered);
+  queue.Stop();
+}
+
+} // end namespace pub_sub::test
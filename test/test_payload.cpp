@@ -3,6 +3,9 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <atomic>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <util/timestamp.h>
 #include "sparkplug_b.pb.h"
@@ -243,4 +246,396 @@ TEST(IPayload, TestMetric) {
   std::cout << dest.DebugString() << std::endl;
 }
 
-} // end namespace
\ No newline at end of file
+TEST(IPayload, TextBody) {
+  Payload payload;
+  constexpr std::string_view kText = "23.5 C";
+  payload.Body().assign(kText.cbegin(), kText.cend());
+  payload.Body().push_back(0);
+  payload.Body().push_back('x');
+  EXPECT_EQ(payload.BodyToString(), kText);
+
+  auto metric = payload.CreateMetric("Temperature");
+  ASSERT_TRUE(metric);
+  metric->IsValid(false);
+  metric->Value(std::string_view("23.5"));
+  EXPECT_EQ(metric->Value<std::string>(), "23.5");
+  EXPECT_TRUE(metric->IsValid());
+}
+
+TEST(IPayload, Snapshot) {
+  Payload payload;
+  auto metric1 = payload.CreateMetric("Metric1");
+  auto metric2 = payload.CreateMetric("Metric2");
+  ASSERT_TRUE(metric1 && metric2);
+  metric1->Type(MetricType::Int64);
+  metric2->Type(MetricType::Int64);
+  metric1->Value(int64_t{0});
+  metric2->Value(int64_t{0});
+
+  const auto first = payload.Snapshot();
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first->Version(), 1);
+  EXPECT_EQ(first->Metrics().size(), 2);
+  EXPECT_EQ(first->GetValue<int64_t>("metric1"), 0);
+
+  // Readers get consistent values while a writer commits.
+  std::atomic<bool> stop = false;
+  std::thread writer([&] () {
+    for (int64_t value = 1; value <= 1'000; ++value) {
+      metric1->Value(value);
+      metric2->Value(value);
+      payload.Commit();
+    }
+    stop = true;
+  });
+  while (!stop) {
+    const auto snapshot = payload.Snapshot();
+    EXPECT_EQ(snapshot->GetValue<int64_t>("Metric1"), snapshot->GetValue<int64_t>("Metric2"));
+  }
+  writer.join();
+
+  // The old snapshot is unchanged
+  EXPECT_EQ(first->GetValue<int64_t>("Metric1"), 0);
+  const auto last = payload.Snapshot();
+  EXPECT_EQ(last->Version(), 1'001);
+  EXPECT_EQ(last->GetValue<int64_t>("Metric2"), 1'000);
+  EXPECT_EQ(last->GetMetric("Metric3"), nullptr);
+
+  // Inbound messages are committed automatically
+  payload.StringToBody(R"({"Metric1": 5, "Metric2": 5})");
+  payload.ParseSparkplugJson(false);
+  EXPECT_EQ(payload.Snapshot()->GetValue<int64_t>("Metric1"), 5);
+  EXPECT_EQ(payload.Snapshot()->Version(), 1'002);
+  EXPECT_EQ(payload.Snapshot(), payload.Snapshot()); // Unchanged values share the snapshot
+}
+
+TEST(IPayload, CreateMetrics) {
+  Payload payload;
+  auto exist = payload.CreateMetric("Metric5");
+  ASSERT_TRUE(exist);
+
+  std::vector<MetricDescriptor> descriptor_list(10);
+  for (size_t index = 0; index < descriptor_list.size(); ++index) {
+    auto& descriptor = descriptor_list[index];
+    descriptor.name = "Metric" + std::to_string(descriptor_list.size() - index);
+    descriptor.type = MetricType::Double;
+    descriptor.unit = "m/s";
+  }
+  descriptor_list[0].alias = 1'000;
+  descriptor_list[1].property_list.emplace_back("Key", "Value");
+
+  const auto metric_list = payload.CreateMetrics(descriptor_list, 100);
+  ASSERT_EQ(metric_list.size(), descriptor_list.size());
+  EXPECT_EQ(payload.Metrics().size(), descriptor_list.size());
+  EXPECT_EQ(metric_list[5], exist); // Existing metric is not replaced
+
+  EXPECT_EQ(metric_list[0]->Name(), "Metric10");
+  EXPECT_EQ(metric_list[0]->Alias(), 1'000);
+  EXPECT_EQ(metric_list[1]->Alias(), 101);
+  EXPECT_EQ(metric_list[9]->Alias(), 109);
+  EXPECT_EQ(metric_list[9]->Type(), MetricType::Double);
+  EXPECT_EQ(metric_list[9]->Unit(), "m/s");
+  EXPECT_TRUE(metric_list[1]->GetProperty("Key") != nullptr);
+  EXPECT_EQ(payload.GetMetric("metric3"), metric_list[7]);
+  EXPECT_EQ(exist->Alias(), 0); // Existing metrics keep their alias
+  EXPECT_EQ(payload.GetMetric(uint64_t{104}), metric_list[4]);
+
+  payload.DeleteMetrics("Metric1");
+  EXPECT_EQ(payload.Metrics().size(), descriptor_list.size() - 1);
+  EXPECT_EQ(metric_list[9]->Name(), "Metric1"); // Still owned by the caller
+
+  // Aliases in use are skipped and duplicate fixed aliases are rejected.
+  std::vector<MetricDescriptor> alias_descriptor_list(3);
+  alias_descriptor_list[0].name = "Alias1";
+  alias_descriptor_list[1].name = "Alias2";
+  alias_descriptor_list[1].alias = 201;
+  alias_descriptor_list[2].name = "Alias3";
+  alias_descriptor_list[2].alias = 1'000; // Used by Metric10
+  const auto alias_list = payload.CreateMetrics(alias_descriptor_list, 200);
+  ASSERT_EQ(alias_list.size(), 3);
+  EXPECT_EQ(alias_list[0]->Alias(), 200);
+  EXPECT_EQ(alias_list[1]->Alias(), 201);
+  EXPECT_EQ(alias_list[2]->Alias(), 0);
+
+  std::vector<MetricDescriptor> skip_descriptor_list(3);
+  skip_descriptor_list[0].name = "Skip1";
+  skip_descriptor_list[0].alias = 300;
+  skip_descriptor_list[1].name = "Skip2";
+  skip_descriptor_list[2].name = "Skip3";
+  skip_descriptor_list[2].alias = 302; // The range alias of Skip2
+  const auto skip_list = payload.CreateMetrics(skip_descriptor_list, 301);
+  ASSERT_EQ(skip_list.size(), 3);
+  EXPECT_EQ(skip_list[0]->Alias(), 300);
+  EXPECT_EQ(skip_list[1]->Alias(), 301);
+  EXPECT_EQ(skip_list[2]->Alias(), 302);
+
+  std::vector<MetricDescriptor> used_descriptor_list(2);
+  used_descriptor_list[0].name = "Used1";
+  used_descriptor_list[0].alias = 402;
+  used_descriptor_list[1].name = "Used2"; // 402 is used by Used1
+  const auto used_list = payload.CreateMetrics(used_descriptor_list, 401);
+  ASSERT_EQ(used_list.size(), 2);
+  EXPECT_EQ(used_list[0]->Alias(), 402);
+  EXPECT_EQ(used_list[1]->Alias(), 401);
+}
+
+TEST(IPayload, BirthCache) {
+  Payload payload;
+  auto speed = payload.CreateMetric("Speed");
+  speed->Type(MetricType::Double);
+  speed->Unit("m/s");
+  speed->Alias(1);
+  auto status = payload.CreateMetric("Status");
+  status->Type(MetricType::String);
+  status->Alias(2);
+
+  speed->Value(1.5);
+  status->Value(std::string("Running"));
+  payload.Timestamp(1'000);
+  payload.SequenceNumber(0);
+  payload.GenerateProtobuf(true);
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 2);
+
+  // Rebirth with new values keeps the encoded definitions
+  speed->Value(2.5);
+  status->Value(std::string("Stopped"));
+  payload.Timestamp(2'000);
+  payload.SequenceNumber(1);
+  payload.GenerateProtobuf(true);
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 2);
+
+  Payload reader;
+  reader.Body(payload.Body());
+  reader.ParseSparkplugProtobuf(true);
+  EXPECT_EQ(reader.Timestamp(), 2'000);
+  EXPECT_EQ(reader.SequenceNumber(), 1);
+  EXPECT_DOUBLE_EQ(reader.GetValue<double>("Speed"), 2.5);
+  EXPECT_EQ(reader.GetValue<std::string>("Status"), "Stopped");
+  EXPECT_EQ(reader.GetMetric("Speed")->Unit(), "m/s");
+  EXPECT_EQ(reader.GetMetric(uint64_t{2}), reader.GetMetric("Status"));
+
+  // Data messages don't use the kept birth
+  speed->Value(3.5);
+  payload.GenerateProtobuf();
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 2);
+
+  // Only the changed and new definitions are encoded
+  speed->Unit("km/h");
+  payload.GenerateProtobuf(true);
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 3);
+
+  payload.CreateMetric("Counter")->Type(MetricType::Int64);
+  payload.GenerateProtobuf(true);
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 4);
+
+  Payload new_reader;
+  new_reader.Body(payload.Body());
+  new_reader.ParseSparkplugProtobuf(true);
+  EXPECT_EQ(new_reader.Metrics().size(), 3);
+  EXPECT_EQ(new_reader.GetMetric("Speed")->Unit(), "km/h");
+  EXPECT_EQ(new_reader.GetMetric("Counter")->Type(), MetricType::Int64);
+
+  payload.DeleteMetrics("Counter");
+  payload.GenerateProtobuf(true);
+  EXPECT_EQ(payload.DefinitionEncodeCount(), 4);
+
+  Payload last_reader;
+  last_reader.Body(payload.Body());
+  last_reader.ParseSparkplugProtobuf(true);
+  EXPECT_EQ(last_reader.Metrics().size(), 2);
+  EXPECT_DOUBLE_EQ(last_reader.GetValue<double>("Speed"), 3.5);
+  EXPECT_EQ(last_reader.GetMetric("Speed")->Type(), MetricType::Double);
+}
+
+TEST(IPayload, SchemaFingerprint) {
+  Payload node;
+  auto speed = node.CreateMetric("Speed");
+  speed->Type(MetricType::Double);
+  speed->Alias(10);
+  auto counter = node.CreateMetric("Counter");
+  counter->Type(MetricType::Int64);
+  counter->Alias(11);
+  speed->Value(1.0);
+  counter->Value(int64_t{1});
+  node.GenerateProtobuf(true);
+
+  Payload host;
+  EXPECT_EQ(host.SchemaFingerprint(), 0);
+  host.Body(node.Body());
+  host.ParseSparkplugProtobuf(true, true);
+  const auto fingerprint = host.SchemaFingerprint();
+  EXPECT_NE(fingerprint, 0);
+  const auto host_speed = host.GetMetric("Speed");
+  ASSERT_TRUE(host_speed);
+
+  // Unchanged rebirth reuses the metrics
+  speed->Value(2.0);
+  node.GenerateProtobuf(true);
+  host.Body(node.Body());
+  host.ParseSparkplugProtobuf(true, true);
+  EXPECT_EQ(host.SchemaFingerprint(), fingerprint);
+  EXPECT_EQ(host.GetMetric("Speed"), host_speed);
+  EXPECT_DOUBLE_EQ(host_speed->Value<double>(), 2.0);
+
+  // Data messages only include the aliases
+  counter->Value(int64_t{5});
+  node.GenerateProtobuf();
+  host.Body(node.Body());
+  host.ParseSparkplugProtobuf(false);
+  EXPECT_EQ(host.GetValue<int64_t>("Counter"), 5);
+
+  // Data messages that may create metrics don't change the birth lookup
+  counter->Value(int64_t{6});
+  node.GenerateProtobuf();
+  host.Body(node.Body());
+  host.ParseSparkplugProtobuf(true);
+  EXPECT_EQ(host.SchemaFingerprint(), fingerprint);
+  EXPECT_EQ(host.GetValue<int64_t>("Counter"), 6);
+
+  // Changed definitions gives a new fingerprint
+  node.CreateMetric("Status")->Alias(12);
+  node.GenerateProtobuf(true);
+  host.Body(node.Body());
+  host.ParseSparkplugProtobuf(true, true);
+  EXPECT_NE(host.SchemaFingerprint(), fingerprint);
+  EXPECT_EQ(host.Metrics().size(), 3);
+  EXPECT_EQ(host.GetMetric(uint64_t{12}), host.GetMetric("Status"));
+}
+
+TEST(IPayload, PatchSequenceNumber) {
+  Payload payload;
+  auto speed = payload.CreateMetric("Speed");
+  speed->Type(MetricType::Double);
+  speed->Value(1.5);
+  payload.Timestamp(1'000);
+  payload.SequenceNumber(1);
+  payload.GenerateProtobuf();
+
+  // The sequence number is patched in place and only one seq field is sent.
+  auto body = payload.Body();
+  const auto size = body.size();
+  EXPECT_TRUE(PayloadHelper::PatchSequenceNumber(body, 200));
+  EXPECT_EQ(body.size(), size);
+
+  org::eclipse::tahu::protobuf::Payload pb_payload;
+  ASSERT_TRUE(pb_payload.ParseFromArray(body.data(), static_cast<int>(body.size())));
+  EXPECT_EQ(pb_payload.seq(), 200);
+  EXPECT_EQ(pb_payload.ByteSizeLong(), size); // No duplicate seq field
+
+  Payload reader;
+  reader.Body(body);
+  reader.ParseSparkplugProtobuf(true);
+  EXPECT_EQ(reader.SequenceNumber(), 200);
+  EXPECT_DOUBLE_EQ(reader.GetValue<double>("Speed"), 1.5);
+
+  // A birth has the same slot.
+  payload.SequenceNumber(0);
+  payload.GenerateProtobuf(true);
+  body = payload.Body();
+  EXPECT_TRUE(PayloadHelper::PatchSequenceNumber(body, 5));
+  reader.Body(body);
+  reader.ParseSparkplugProtobuf(true, true);
+  EXPECT_EQ(reader.SequenceNumber(), 5);
+
+  // A text body has no slot.
+  std::vector<uint8_t> text = {'1', '2', '3'};
+  EXPECT_FALSE(PayloadHelper::PatchSequenceNumber(text, 5));
+}
+
+TEST(IPayload, PropertySet) {
+  const size_t nof_sets = PropertySet::InternedCount();
+  {
+    std::vector<MetricDescriptor> descriptor_list(100);
+    for (size_t index = 0; index < descriptor_list.size(); ++index) {
+      auto& descriptor = descriptor_list[index];
+      descriptor.name = "Metric" + std::to_string(index);
+      descriptor.type = MetricType::Double;
+      descriptor.unit = index % 2 == 0 ? "m/s" : "km/h";
+    }
+    Payload payload;
+    const auto metric_list = payload.CreateMetrics(descriptor_list, 1);
+    EXPECT_EQ(PropertySet::InternedCount(), nof_sets + 2);
+    EXPECT_EQ(metric_list[0]->SharedProperties(), metric_list[2]->SharedProperties());
+    EXPECT_NE(metric_list[0]->SharedProperties(), metric_list[1]->SharedProperties());
+    EXPECT_EQ(metric_list[1]->Unit(), "km/h");
+
+    // Changing one metric doesn't change the other metrics
+    metric_list[2]->Unit("km/h");
+    EXPECT_EQ(metric_list[2]->SharedProperties(), metric_list[1]->SharedProperties());
+    EXPECT_EQ(metric_list[0]->Unit(), "m/s");
+
+    // Changeable properties are a copy
+    auto* property = metric_list[4]->GetProperty("unit");
+    ASSERT_TRUE(property != nullptr);
+    EXPECT_FALSE(metric_list[4]->SharedProperties());
+    property->Value(std::string("mph"));
+    EXPECT_EQ(metric_list[4]->Unit(), "mph");
+    EXPECT_EQ(metric_list[0]->Unit(), "m/s");
+    metric_list[4]->InternProperties();
+    EXPECT_TRUE(metric_list[4]->SharedProperties());
+
+    // The encoded sets are copied into the birth message
+    payload.GenerateProtobuf(true);
+    Payload reader;
+    reader.Body(payload.Body());
+    reader.ParseSparkplugProtobuf(true);
+    EXPECT_EQ(reader.Metrics().size(), 100);
+    EXPECT_EQ(reader.GetMetric("Metric4")->Unit(), "mph");
+    EXPECT_EQ(reader.GetMetric("Metric99")->Unit(), "km/h");
+    EXPECT_EQ(reader.GetMetric("Metric0")->SharedProperties(),
+              reader.GetMetric("Metric98")->SharedProperties());
+
+    // Unchanged properties keep the set
+    const auto reader_set = reader.GetMetric("Metric0")->SharedProperties();
+    reader.Body(payload.Body());
+    reader.ParseSparkplugProtobuf(true);
+    EXPECT_EQ(reader.GetMetric("Metric0")->SharedProperties(), reader_set);
+  }
+  // The sets are released with the last metric
+  EXPECT_EQ(PropertySet::InternedCount(), nof_sets);
+}
+
+TEST(IPayload, MetricFootprint) {
+  // Budget for a mirrored metric with a short name, a numeric value and a
+  // shared unit. The budget includes the metric list node.
+  constexpr size_t kMaxMetricSize = 128;
+  constexpr size_t kMaxBytesPerMetric = 192;
+  EXPECT_LE(sizeof(Metric), kMaxMetricSize);
+
+  constexpr size_t kNofMetrics = 10'000;
+  std::vector<MetricDescriptor> descriptor_list(kNofMetrics);
+  for (size_t index = 0; index < descriptor_list.size(); ++index) {
+    auto& descriptor = descriptor_list[index];
+    descriptor.name = "Line1/Motor" + std::to_string(index) + "/Speed";
+    descriptor.type = MetricType::Double;
+    descriptor.unit = "rpm";
+  }
+  Payload payload;
+  const auto metric_list = payload.CreateMetrics(descriptor_list, 1);
+  for (size_t index = 0; index < metric_list.size(); ++index) {
+    metric_list[index]->Value(1'234.5678 + static_cast<double>(index));
+  }
+  const size_t bytes_per_metric = (payload.MemoryUsage() - sizeof(Payload)) / kNofMetrics;
+  std::cout << "Metric size: " << sizeof(Metric)
+            << ", Bytes per metric: " << bytes_per_metric << std::endl;
+  EXPECT_LE(bytes_per_metric, kMaxBytesPerMetric);
+
+  // Long values are stored on the heap
+  const std::string long_value(100, 'A');
+  metric_list[0]->Value(long_value);
+  EXPECT_EQ(metric_list[0]->Value<std::string>(), long_value);
+  EXPECT_GE(metric_list[0]->MemoryUsage(), sizeof(Metric) + long_value.size());
+  metric_list[0]->Value(std::string("Short"));
+  EXPECT_EQ(metric_list[0]->Value<std::string>(), "Short");
+
+  // Flags are independent
+  auto& metric = *metric_list[1];
+  metric.IsNull(true);
+  metric.IsHistorical(true);
+  metric.IsNull(false);
+  EXPECT_TRUE(metric.IsHistorical());
+  EXPECT_FALSE(metric.IsNull());
+  EXPECT_FALSE(metric.IsTransient());
+}
+
+} // end namespace
@@ -4,7 +4,10 @@
  */
 
 #include "test_sparkplug.h"
+#include <array>
+#include <algorithm>
 #include <chrono>
+#include <iostream>
 
 #include <MQTTAsync.h>
 #include <util/utilfactory.h>
@@ -25,6 +28,7 @@ namespace {
   constexpr std::string_view kNode = "Node1";
   constexpr uint16_t kBasicPort = 1883; ///< Simple no TLS port
   constexpr uint16_t kFailingPort = 1773; ///< Dummy port testing
+  constexpr uint16_t kStandbyPort = 1884; ///< Second local broker (failover)
 
   std::string kBroker; ///< Broker in use
   std::string kBrokerName; ///< Name of broker in use
@@ -266,4 +270,199 @@ TEST_F(TestSparkplug, TestNode) {
   node.reset();
 }
 
-} // pub_sub::test
\ No newline at end of file
+TEST_F(TestSparkplug, TestSharedHosts) {
+  if (kBroker.empty()) {
+    GTEST_SKIP_("No MQTT broker detected");
+  }
+  std::array<std::unique_ptr<IPubSubClient>, 2> host_list;
+  for (size_t index = 0; index < host_list.size(); ++index) {
+    auto& host = host_list[index];
+    host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+    ASSERT_TRUE(host);
+    host->Broker(kBroker);
+    host->Port(kBasicPort);
+    host->Name(std::string(kHost) + "_" + std::to_string(index + 1));
+    host->Version(ProtocolVersion::Mqtt5);
+    host->ShareName("Hosts");
+    host->InService(true);
+
+    const bool start = host->Start();
+    ASSERT_TRUE(start);
+
+    const auto& subscription_list = host->Subscriptions();
+    const bool shared = std::any_of(subscription_list.cbegin(), subscription_list.cend(),
+                                    [] (const std::string& topic) -> bool {
+      return topic == "$share/Hosts/spBv1.0/+/NDATA/#";
+    });
+    EXPECT_TRUE(shared);
+    const bool all_topics = std::any_of(subscription_list.cbegin(), subscription_list.cend(),
+                                    [] (const std::string& topic) -> bool {
+      return topic == "spBv1.0/#";
+    });
+    EXPECT_FALSE(all_topics);
+  }
+
+  for (size_t online = 0; online < 1000; ++online) {
+    if (host_list[0]->IsOnline() && host_list[1]->IsOnline()) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(host_list[0]->IsOnline());
+  EXPECT_TRUE(host_list[1]->IsOnline());
+
+  // Publish NDATA messages and check that they are split between the hosts.
+  auto publisher = PubSubFactory::CreatePubSubClient(PubSubType::Mqtt5Client);
+  ASSERT_TRUE(publisher);
+  publisher->Broker(kBroker);
+  publisher->Port(kBasicPort);
+  publisher->Name("SharedPublisher");
+  publisher->Version(ProtocolVersion::Mqtt5);
+
+  constexpr std::string_view data_topic = "spBv1.0/Group1/NDATA/Node1";
+  auto value = PubSubFactory::CreateMetric(data_topic);
+  value->Type(MetricType::UInt64);
+  value->Value(uint64_t{0});
+  auto* publish = publisher->AddMetric(value);
+  ASSERT_TRUE(publish != nullptr);
+  publish->Qos(QualityOfService::Qos1);
+  publish->Publish(true);
+  ASSERT_TRUE(publisher->Start());
+  for (size_t online = 0; online < 1000 && !publisher->IsOnline(); ++online) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(publisher->IsOnline());
+
+  std::array<uint64_t, 2> start_list = {host_list[0]->Statistics().MessagesIn(),
+                                        host_list[1]->Statistics().MessagesIn()};
+  std::array<uint64_t, 2> received_list = {0, 0};
+  constexpr uint64_t nof_messages = 100;
+  for (uint64_t index = 0; index < nof_messages; ++index) {
+    value->Value(index);
+    publish->DoPublish();
+  }
+  for (size_t received = 0; received < 1000; ++received) {
+    for (size_t index = 0; index < host_list.size(); ++index) {
+      received_list[index] = host_list[index]->Statistics().MessagesIn() - start_list[index];
+    }
+    if (received_list[0] + received_list[1] >= nof_messages) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  std::cout << "Shared Messages (Host1/Host2): " << received_list[0]
+            << "/" << received_list[1] << std::endl;
+  EXPECT_EQ(received_list[0] + received_list[1], nof_messages);
+  EXPECT_GT(received_list[0], 0);
+  EXPECT_GT(received_list[1], 0);
+
+  EXPECT_TRUE(publisher->Stop());
+  publisher.reset();
+
+  for (auto& host : host_list) {
+    host->InService(false);
+    EXPECT_TRUE(host->Stop());
+    host.reset();
+  }
+}
+
+TEST_F(TestSparkplug, TestLatencyProbe) {
+  if (kBroker.empty()) {
+    GTEST_SKIP_("No MQTT broker detected");
+  }
+  auto host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+  ASSERT_TRUE(host);
+  host->Broker(kBroker);
+  host->Port(kBasicPort);
+  host->Name(kHost.data());
+  host->Version(ProtocolVersion::Mqtt5);
+  host->LatencyProbe(true);
+  host->InService(true);
+  ASSERT_TRUE(host->Start());
+
+  auto node = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode);
+  ASSERT_TRUE(node);
+  node->Broker(kBroker);
+  node->Port(kBasicPort);
+  node->Name(kNode.data());
+  node->GroupId(kGroup.data());
+  node->Version(ProtocolVersion::Mqtt5);
+  node->LatencyProbe(true);
+  node->InService(true);
+  ASSERT_TRUE(node->Start());
+
+  // The node publish a probe each second.
+  const IPubSubClient* remote_node = nullptr;
+  for (size_t probe = 0; probe < 500; ++probe) {
+    remote_node = host->GetRemoteNode(kGroup.data(), kNode.data());
+    if (remote_node != nullptr && remote_node->Statistics().TransferTime().Count() > 1) {
+      break;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(remote_node != nullptr);
+  const auto& transfer_time = remote_node->Statistics().TransferTime();
+  const auto& ingest_time = remote_node->Statistics().IngestTime();
+  EXPECT_GT(transfer_time.Count(), 0);
+  EXPECT_GT(ingest_time.Count(), 0);
+  std::cout << "Transfer Time (P50/P99) [ns]: " << transfer_time.Percentile(50)
+            << "/" << transfer_time.Percentile(99) << std::endl;
+  std::cout << "Ingest Time (P50/P99) [ns]: " << ingest_time.Percentile(50)
+            << "/" << ingest_time.Percentile(99) << std::endl;
+
+  node->InService(false);
+  EXPECT_TRUE(node->Stop());
+  node.reset();
+
+  host->InService(false);
+  EXPECT_TRUE(host->Stop());
+  host.reset();
+}
+
+TEST_F(TestSparkplug, TestFailover) {
+  // Needs two local brokers, e.g. 'mosquitto -p 1883' and 'mosquitto -p 1884'.
+  auto detect = PubSubFactory::CreatePubSubClient(PubSubType::DetectMqttBroker);
+  detect->Broker(kLocalBroker.data());
+  detect->Port(kStandbyPort);
+  detect->Name("StandbyBroker");
+  const bool standby_exist = detect->Start();
+  detect->Stop();
+  if (kBrokerName != "LocalBroker" || !standby_exist) {
+    GTEST_SKIP_("No local standby MQTT broker detected");
+  }
+
+  auto node = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode);
+  ASSERT_TRUE(node);
+  node->Broker(kBroker);
+  node->Port(kBasicPort);
+  node->AddStandbyBroker(kBroker, kStandbyPort);
+  node->HotStandby(true);
+  node->Name(kNode.data());
+  node->GroupId(kGroup.data());
+  node->Version(ProtocolVersion::Mqtt5);
+  node->InService(true);
+  ASSERT_TRUE(node->Start());
+
+  for (size_t online = 0; online < 1000 && !node->IsOnline(); ++online) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(node->IsOnline());
+
+  // Wait until the standby session is connected, then switch broker.
+  std::this_thread::sleep_for(1s);
+  node->NextServer();
+  const auto& statistics = node->Statistics();
+  for (size_t failover = 0; failover < 1000 && statistics.Failovers() == 0; ++failover) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(statistics.Failovers(), 1);
+  EXPECT_TRUE(node->IsOnline());
+  EXPECT_TRUE(node->IsConnected());
+  std::cout << "Failover Time [ns]: " << statistics.FailoverTime().Max() << std::endl;
+
+  node->InService(false);
+  EXPECT_TRUE(node->Stop());
+  node.reset();
+}
+
+} // pub_sub::test
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/statistics.h"
+#include "pubsub/pubsubfactory.h"
+#include "pubsub/payload.h"
+
+namespace pub_sub::test {
+
+TEST(TestStatistics, Counter) {
+  StatCounter counter;
+  std::vector<std::thread> thread_list;
+  for (size_t thread = 0; thread < 4; ++thread) {
+    thread_list.emplace_back([&] () {
+      for (size_t index = 0; index < 1'000; ++index) {
+        counter.Add();
+      }
+    });
+  }
+  for (auto& thread : thread_list) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.Value(), 4'000);
+  counter.Reset();
+  EXPECT_EQ(counter.Value(), 0);
+}
+
+TEST(TestStatistics, Footprint) {
+  // The remote nodes and topics of a host shall not carry unused buckets.
+  EXPECT_LE(sizeof(TopicStatistics), 64);
+  EXPECT_LE(sizeof(ClientStatistics), 512);
+
+  StatCounter counter;
+  EXPECT_EQ(counter.Value(), 0);
+  counter.Reset();
+  EXPECT_EQ(counter.Value(), 0);
+}
+
+TEST(TestStatistics, Histogram) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Count(), 0);
+  EXPECT_EQ(histogram.Min(), 0);
+  EXPECT_EQ(histogram.Percentile(50), 0);
+  EXPECT_EQ(histogram.HeapSize(), 0); // Allocated on the first add
+
+  for (uint64_t value = 1; value <= 1'000; ++value) {
+    histogram.Add(value * 1'000);
+  }
+  EXPECT_EQ(histogram.Count(), 1'000);
+  EXPECT_EQ(histogram.Min(), 1'000);
+  EXPECT_EQ(histogram.Max(), 1'000'000);
+  EXPECT_EQ(histogram.Mean(), 500'500);
+
+  // The histogram buckets have a relative error less than 25%.
+  const auto median = histogram.Percentile(50);
+  EXPECT_GT(median, 375'000);
+  EXPECT_LE(median, 500'000);
+
+  const auto p99 = histogram.Percentile(99);
+  EXPECT_GT(p99, 742'000);
+  EXPECT_LE(p99, 990'000);
+
+  constexpr uint64_t long_time = uint64_t{1} << 50; // About 13 days
+  histogram.Add(long_time); // Should be clamped to the last bucket
+  EXPECT_EQ(histogram.Max(), long_time);
+  EXPECT_EQ(histogram.Percentile(100), uint64_t{7} << 38);
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.Count(), 0);
+}
+
+TEST(TestStatistics, MemoryUsage) {
+  auto client = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugNode);
+  ASSERT_TRUE(client);
+  const auto empty_size = client->MemoryUsage();
+  EXPECT_GT(empty_size, 0);
+
+  auto* topic = client->CreateTopic();
+  ASSERT_TRUE(topic != nullptr);
+  topic->Topic("spBv1.0/Group1/NDATA/Node1");
+  for (size_t index = 0; index < 100; ++index) {
+    auto metric = topic->CreateMetric("Metric_With_A_Long_Name_" + std::to_string(index));
+    ASSERT_TRUE(metric);
+    metric->Value(static_cast<double>(index));
+  }
+  EXPECT_GT(client->MemoryUsage(), empty_size + 100 * sizeof(Metric));
+  EXPECT_EQ(client->QueueDepth(), 0);
+}
+
+TEST(TestStatistics, DeviceDeathSequence) {
+  auto host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+  ASSERT_TRUE(host);
+
+  // The DDEATH uses a sequence number of the node, so the NDATA after it is not a gap.
+  auto inject = [&] (const std::string& topic_name, uint64_t sequence) {
+    Payload payload;
+    payload.Timestamp(1'000 + sequence);
+    payload.SequenceNumber(sequence);
+    payload.GenerateProtobuf();
+    const auto& body = payload.Body();
+    host->InjectMessage(topic_name, body.data(), body.size(), false);
+  };
+  inject("spBv1.0/Group1/NBIRTH/Node1", 0);
+  inject("spBv1.0/Group1/DBIRTH/Node1/Device1", 1);
+  inject("spBv1.0/Group1/DDEATH/Node1/Device1", 2);
+  inject("spBv1.0/Group1/NDATA/Node1", 3);
+  EXPECT_EQ(host->Statistics().SequenceGaps(), 0);
+
+  inject("spBv1.0/Group1/DDEATH/Node1/Device2", 4); // Unknown device
+  inject("spBv1.0/Group1/NDATA/Node1", 5);
+  EXPECT_EQ(host->Statistics().SequenceGaps(), 0);
+
+  inject("spBv1.0/Group1/NDATA/Node1", 7);
+  EXPECT_EQ(host->Statistics().SequenceGaps(), 1);
+}
+
+TEST(TestStatistics, FilteredSequence) {
+  auto host = PubSubFactory::CreatePubSubClient(PubSubType::SparkplugHost);
+  ASSERT_TRUE(host);
+  host->Filter().ExcludeMessageType("DDATA");
+
+  // The dropped DDATA messages uses sequence numbers of the node.
+  auto inject = [&] (const std::string& topic_name, uint64_t sequence) {
+    Payload payload;
+    payload.Timestamp(1'000 + sequence);
+    payload.SequenceNumber(sequence);
+    payload.GenerateProtobuf();
+    const auto& body = payload.Body();
+    host->InjectMessage(topic_name, body.data(), body.size(), false);
+  };
+  inject("spBv1.0/Group1/NBIRTH/Node1", 0);
+  inject("spBv1.0/Group1/DDATA/Node1/Device1", 1);
+  inject("spBv1.0/Group1/NDATA/Node1", 2);
+  inject("spBv1.0/Group1/DDATA/Node1/Device1", 3);
+  inject("spBv1.0/Group1/NDATA/Node1", 4);
+  EXPECT_EQ(host->Statistics().SequenceGaps(), 0);
+}
+
+} // pub_sub::test
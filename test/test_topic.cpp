@@ -2,6 +2,7 @@
  * Copyright 2024 Ingemar Hedvall
  * SPDX-License-Identifier: MIT
  */
+#include <string>
 #include <string_view>
 
 #include <gtest/gtest.h>
@@ -82,5 +83,52 @@ TEST(TestTopic, Properties ) {
   }
 }
 
+TEST(TestTopic, TopicIndex) {
+  auto client = PubSubFactory::CreatePubSubClient(PubSubType::Mqtt3Client);
+  ASSERT_TRUE(client);
+
+  constexpr size_t kNofTopics = 20'000;
+  for (size_t index = 0; index < kNofTopics; ++index) {
+    auto* topic = client->CreateTopic();
+    ASSERT_TRUE(topic != nullptr);
+    topic->Topic("Plant/Line/Value" + std::to_string(index));
+  }
+  EXPECT_TRUE(client->GetTopic("Plant/Line/Value0") != nullptr);
+  EXPECT_TRUE(client->GetTopic("Plant/Line/Value19999") != nullptr);
+  EXPECT_TRUE(client->GetTopic("plant/line/value19999") == nullptr);
+  EXPECT_TRUE(client->GetITopic("plant/line/value19999") != nullptr);
+
+  // The message type lookup returns the first topic in the list.
+  auto* first = client->GetTopic("Plant/Line/Value0");
+  EXPECT_EQ(client->GetTopicByMessageType("Value0"), first);
+
+  // The index follows a rename.
+  first->Topic("Plant/Line/Renamed");
+  EXPECT_TRUE(client->GetTopic("Plant/Line/Value0") == nullptr);
+  EXPECT_EQ(client->GetTopic("Plant/Line/Renamed"), first);
+  first->MessageType("Renamed");
+  EXPECT_EQ(client->GetTopicByMessageType("renamed"), first);
+
+  // A duplicate name returns the first topic until it's deleted.
+  auto* duplicate = client->CreateTopic();
+  ASSERT_TRUE(duplicate != nullptr);
+  duplicate->Topic("Plant/Line/Renamed");
+  EXPECT_EQ(client->GetTopic("Plant/Line/Renamed"), first);
+  client->DeleteTopic("Plant/Line/Renamed");
+  EXPECT_EQ(client->GetTopic("Plant/Line/Renamed"), duplicate);
+  client->DeleteTopic("Plant/Line/Renamed");
+  EXPECT_TRUE(client->GetTopic("Plant/Line/Renamed") == nullptr);
+
+  // A topic name that is generated from its levels.
+  auto* level_topic = client->CreateTopic();
+  ASSERT_TRUE(level_topic != nullptr);
+  level_topic->Namespace("spBv1.0");
+  level_topic->GroupId("Group");
+  level_topic->MessageType("NDATA");
+  level_topic->NodeId("Node");
+  EXPECT_EQ(client->GetTopic("spBv1.0/Group/NDATA/Node"), level_topic);
+  EXPECT_EQ(client->GetTopicByMessageType("NDATA"), level_topic);
+}
+
 } // pub_sub::test
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <string_view>
+
+#include <gtest/gtest.h>
+#include "pubsub/topicfilter.h"
+
+namespace pub_sub::test {
+
+TEST(TestTopicFilter, EmptyFilter) {
+  TopicFilter filter;
+  EXPECT_TRUE(filter.IsEmpty());
+  EXPECT_FALSE(filter.IsNarrowing());
+  EXPECT_FALSE(filter.IsPartialNode());
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/Group1/NDATA/Node1"));
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/STATE/Host1"));
+}
+
+TEST(TestTopicFilter, IncludeExclude) {
+  TopicFilter filter;
+  filter.IncludeGroup("Group1");
+  filter.ExcludeNode("Node2");
+  EXPECT_FALSE(filter.IsPartialNode());
+  filter.ExcludeDevice("Device2");
+  EXPECT_FALSE(filter.IsEmpty());
+  EXPECT_TRUE(filter.IsNarrowing());
+  EXPECT_TRUE(filter.IsPartialNode());
+
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/Group1/NBIRTH/Node1"));
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/Group1/DDATA/Node1/Device1"));
+  EXPECT_FALSE(filter.IsAccepted("spBv1.0/Group1/DDATA/Node1/Device2"));
+  EXPECT_FALSE(filter.IsAccepted("spBv1.0/Group1/NDATA/Node2"));
+  EXPECT_FALSE(filter.IsAccepted("spBv1.0/Group2/NDATA/Node1"));
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/STATE/Host1"));
+
+  filter.ExcludeMessageType("STATE");
+  EXPECT_FALSE(filter.IsAccepted("spBv1.0/STATE/Host1"));
+
+  filter.Clear();
+  EXPECT_TRUE(filter.IsEmpty());
+  EXPECT_TRUE(filter.IsAccepted("spBv1.0/Group2/NDATA/Node2"));
+}
+
+TEST(TestTopicFilter, Subscriptions) {
+  TopicFilter filter;
+  filter.IncludeGroup("Group1");
+  filter.IncludeNode("Node1");
+  filter.IncludeNode("Node2");
+
+  const auto all_list = filter.MakeSubscriptions("spBv1.0", "+");
+  ASSERT_EQ(all_list.size(), 2);
+  EXPECT_EQ(all_list[0], "spBv1.0/Group1/+/Node1/#");
+  EXPECT_EQ(all_list[1], "spBv1.0/Group1/+/Node2/#");
+
+  filter.IncludeMessageType("NDATA");
+  const auto data_list = filter.MakeSubscriptions("$share/Hosts/spBv1.0", "NDATA");
+  ASSERT_EQ(data_list.size(), 2);
+  EXPECT_EQ(data_list[0], "$share/Hosts/spBv1.0/Group1/NDATA/Node1/#");
+
+  const auto birth_list = filter.MakeSubscriptions("spBv1.0", "NBIRTH");
+  EXPECT_TRUE(birth_list.empty());
+}
+
+} // pub_sub::test
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Ingemar Hedvall
+ * SPDX-License-Identifier: MIT
+ */
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "pubsub/topicmatcher.h"
+
+namespace pub_sub::test {
+
+TEST(TestTopicMatcher, Wildcards) {
+  EXPECT_TRUE(TopicMatcher::IsValidFilter("a/+/c"));
+  EXPECT_TRUE(TopicMatcher::IsValidFilter("#"));
+  EXPECT_FALSE(TopicMatcher::IsValidFilter("a/#/c"));
+  EXPECT_FALSE(TopicMatcher::IsValidFilter("a/b+"));
+  EXPECT_FALSE(TopicMatcher::IsValidFilter(""));
+
+  TopicMatcher matcher;
+  EXPECT_TRUE(matcher.IsEmpty());
+  size_t exact = 0;
+  size_t plus = 0;
+  size_t hash = 0;
+  size_t all = 0;
+  const auto exact_id = matcher.AddHandler("plant/line1/temp",
+      [&] (std::string_view, std::span<const uint8_t>) { ++exact; });
+  matcher.AddHandler("plant/+/temp",
+      [&] (std::string_view, std::span<const uint8_t>) { ++plus; });
+  matcher.AddHandler("plant/#",
+      [&] (std::string_view, std::span<const uint8_t>) { ++hash; });
+  matcher.AddHandler("#",
+      [&] (std::string_view, std::span<const uint8_t>) { ++all; });
+  EXPECT_EQ(matcher.AddHandler("plant/#/temp",
+      [] (std::string_view, std::span<const uint8_t>) {}), 0);
+  EXPECT_EQ(matcher.Handlers(), 4);
+
+  const std::string text = "23.4";
+  const std::span<const uint8_t> body(reinterpret_cast<const uint8_t*>(text.data()),
+                                      text.size());
+  EXPECT_EQ(matcher.Dispatch("plant/line1/temp", body), 4);
+  EXPECT_EQ(matcher.Dispatch("plant/line2/temp", body), 3);
+  EXPECT_EQ(matcher.Dispatch("plant", body), 2); // 'plant/#' matches 'plant'
+  EXPECT_EQ(matcher.Dispatch("plant/line1/temp/raw", body), 2);
+  EXPECT_EQ(matcher.Dispatch("$SYS/broker", body), 0);
+  EXPECT_EQ(exact, 1);
+  EXPECT_EQ(plus, 2);
+  EXPECT_EQ(hash, 4);
+  EXPECT_EQ(all, 4);
+
+  matcher.RemoveHandler(exact_id);
+  EXPECT_EQ(matcher.Dispatch("plant/line1/temp", body), 3);
+  EXPECT_EQ(exact, 1);
+
+  matcher.Clear();
+  EXPECT_TRUE(matcher.IsEmpty());
+  EXPECT_FALSE(matcher.IsMatch("plant/line1/temp"));
+}
+
+TEST(TestTopicMatcher, ManyFilters) {
+  TopicMatcher matcher;
+  std::vector<uint64_t> id_list;
+  for (size_t line = 0; line < 1'000; ++line) {
+    const std::string prefix = "plant/line" + std::to_string(line);
+    id_list.push_back(matcher.AddHandler(prefix + "/temp",
+        [] (std::string_view, std::span<const uint8_t>) {}));
+    id_list.push_back(matcher.AddHandler(prefix + "/#",
+        [] (std::string_view, std::span<const uint8_t>) {}));
+    id_list.push_back(matcher.AddHandler("+/line" + std::to_string(line) + "/+",
+        [] (std::string_view, std::span<const uint8_t>) {}));
+  }
+  EXPECT_EQ(matcher.Handlers(), 3'000);
+  EXPECT_EQ(matcher.Dispatch("plant/line500/temp", {}), 3);
+  EXPECT_EQ(matcher.Dispatch("plant/line500/pressure", {}), 2);
+  EXPECT_FALSE(matcher.IsMatch("plant/line1000/temp"));
+
+  for (const auto handler_id : id_list) {
+    matcher.RemoveHandler(handler_id);
+  }
+  EXPECT_TRUE(matcher.IsEmpty());
+  EXPECT_FALSE(matcher.IsMatch("plant/line500/temp"));
+}
+
+} // pub_sub::test